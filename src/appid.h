@@ -4,7 +4,8 @@
 #include <shobjidl.h>
 #include <propkey.h>
 #include <propvarutil.h>
-#include "detours.h"
+#include "hook.h"
+#include "hook_stats.h"
 
 typedef HRESULT(WINAPI *pPSStringFromPropertyKey)(
     REFPROPERTYKEY pkey,
@@ -17,6 +18,7 @@ HRESULT WINAPI MyPSStringFromPropertyKey(
     LPWSTR psz,
     UINT cch)
 {
+    HOOK_STATS_SCOPE(kPSStringFromPropertyKey);
     HRESULT result = RawPSStringFromPropertyKey(pkey, psz, cch);
     if (SUCCEEDED(result))
     {
@@ -29,21 +31,11 @@ HRESULT WINAPI MyPSStringFromPropertyKey(
     return result;
 }
 
-void SetAppId()
+// Register hook that keeps Windows from grouping us with an installed browser
+inline void AddAppIdHooks(hook::Registry &registry)
 {
-    // Initialize function pointer with original API address
-    RawPSStringFromPropertyKey = PSStringFromPropertyKey;
-
-    // Create hook using Detours
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawPSStringFromPropertyKey),
-                 reinterpret_cast<void*>(MyPSStringFromPropertyKey));
-    LONG status = DetourTransactionCommit();
-    if (status != NO_ERROR)
-    {
-        DebugLog(L"DetourAttach PSStringFromPropertyKey failed: %d", status);
-    }
+    registry.Add({L"PSStringFromPropertyKey", L"propsys.dll", "PSStringFromPropertyKey", nullptr,
+                  reinterpret_cast<void **>(&RawPSStringFromPropertyKey), reinterpret_cast<void *>(MyPSStringFromPropertyKey), nullptr});
 }
 
 #endif  // VIVALDI_PLUS_APPID_H_
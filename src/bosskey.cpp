@@ -0,0 +1,389 @@
+#include "bosskey.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace bosskey {
+
+namespace {
+
+// Delayed unmute retry configuration
+constexpr uint32_t UNMUTE_RETRY_DELAY_MS = 500;
+
+// PID cache to avoid frequent process enumeration
+constexpr uint64_t PID_CACHE_DURATION_MS = 5000;  // 5 seconds
+
+// Trim order: renderers first, then utilities, GPU and finally the browser itself
+int TrimRank(const std::wstring& type) {
+  if (type == L"renderer") {
+    return 0;
+  }
+  if (type == L"gpu-process") {
+    return 2;
+  }
+  if (type.empty()) {
+    return 3;
+  }
+  return 1;
+}
+
+}  // namespace
+
+BossKey::BossKey(const Platform& platform, const Options& options)
+    : platform_(platform), options_(options) {}
+
+// Get all PIDs of current application (using cache)
+std::vector<ProcessId> BossKey::GetAppPids() {
+  uint64_t current_time = platform_.tasks->NowMs();
+
+  // Use lock to ensure thread-safe access
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+
+  // Update cache if expired or empty
+  if (cached_pids_.empty() ||
+      (current_time - last_update_time_) > PID_CACHE_DURATION_MS) {
+    cached_pids_ = platform_.processes->EnumerateAppProcesses();
+    last_update_time_ = current_time;
+  }
+
+  return cached_pids_;
+}
+
+// Force refresh cache (call when process state might have changed)
+void BossKey::InvalidatePidCache() {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cached_pids_.clear();
+  last_update_time_ = 0;
+}
+
+// Mute or unmute process audio sessions
+// Returns true if any session was found
+bool BossKey::MuteProcess(const std::vector<ProcessId>& pids,
+                          bool set_mute,
+                          bool save_mute_state) {
+  return platform_.audio->UpdateSessions(
+      pids, [&](std::wstring_view session_id, bool is_muted) -> std::optional<bool> {
+        std::lock_guard<std::mutex> lock(audio_state_mutex_);
+
+        if (save_mute_state) {
+          // Save the current mute state for this specific session
+          original_mute_states_[std::wstring(session_id)] = is_muted;
+          if (!is_muted) {
+            has_unmuted_sessions_.store(true, std::memory_order_release);
+          }
+        }
+
+        if (set_mute) {
+          // Mute all sessions
+          return true;
+        }
+
+        // Restore original mute state for this session
+        auto it = original_mute_states_.find(std::wstring(session_id));
+        if (it != original_mute_states_.end()) {
+          return it->second;
+        }
+
+        // Session not found in saved states (might be newly created)
+        // Unmute if we had any unmuted sessions originally
+        if (has_unmuted_sessions_.load(std::memory_order_acquire)) {
+          return false;
+        }
+        return std::nullopt;
+      });
+}
+
+void BossKey::ClearSavedMuteStates() {
+  {
+    std::lock_guard<std::mutex> lock(audio_state_mutex_);
+    original_mute_states_.clear();
+  }
+  has_unmuted_sessions_.store(false, std::memory_order_release);
+}
+
+// Delayed unmute retry handler, catches audio sessions that appear late after show
+void BossKey::HandleUnmuteRetry() {
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    unmute_retry_task_ = 0;
+  }
+
+  if (IsHidden()) {
+    // Still hidden, don't retry
+    return;
+  }
+
+  MuteProcess(GetAppPids(), false, false);
+
+  // Clean up saved states after retry
+  ClearSavedMuteStates();
+}
+
+// Throttle or suspend browser child processes into `targets`
+// Renderers frozen by freeze_toggle are not suspended a second time
+// Caller must hold policy_mutex_ and make sure `targets` is empty
+void BossKey::ApplyPolicyLocked(const std::vector<ProcessId>& pids, ProcessPolicy policy,
+                                std::vector<PolicyTarget>* targets) {
+  auto* processes = platform_.processes;
+  const ProcessId self_pid = processes->GetCurrentProcessId();
+
+  std::unordered_set<ProcessId> frozen;
+  if (policy == ProcessPolicy::kFreeze) {
+    for (const auto& target : frozen_targets_) {
+      frozen.insert(target.pid);
+    }
+  }
+
+  for (ProcessId pid : pids) {
+    // Never throttle the browser process: it runs the hotkey thread
+    if (pid == self_pid || frozen.count(pid)) {
+      continue;
+    }
+
+    ProcessHandle process = processes->Open(pid);
+    if (!process) {
+      continue;
+    }
+
+    if (policy == ProcessPolicy::kFreeze) {
+      // Only renderers are frozen; GPU, network and audio services must keep running
+      if (processes->GetType(process) != L"renderer" || !processes->Suspend(process)) {
+        processes->Close(process);
+        continue;
+      }
+      targets->push_back({pid, process, 0});
+    } else {
+      uint32_t saved_state = processes->EnterEcoMode(process);
+      if (saved_state == 0) {
+        processes->Close(process);
+        continue;
+      }
+      targets->push_back({pid, process, saved_state});
+    }
+  }
+
+  if (options_.log) {
+    options_.log(policy == ProcessPolicy::kFreeze ? L"Process policy freeze applied to %zu processes"
+                                                  : L"Process policy eco applied to %zu processes",
+                 targets->size());
+  }
+}
+
+// Undo ApplyPolicyLocked, in the same order the processes were throttled
+// Caller must hold policy_mutex_
+void BossKey::RevertPolicyLocked(ProcessPolicy policy, std::vector<PolicyTarget>* targets) {
+  auto* processes = platform_.processes;
+  for (const auto& target : *targets) {
+    if (policy == ProcessPolicy::kFreeze) {
+      processes->Resume(target.process);
+    } else {
+      processes->LeaveEcoMode(target.process, target.saved_state);
+    }
+    processes->Close(target.process);
+  }
+  targets->clear();
+}
+
+// Apply hidden_policy from config
+// Runs after muting on the hide worker
+void BossKey::ApplyHiddenPolicy(const std::vector<ProcessId>& pids) {
+  if (options_.hidden_policy == ProcessPolicy::kNone) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(policy_mutex_);
+
+  // Browser may have been shown again while audio was being muted
+  if (!IsHidden() || applied_policy_ != ProcessPolicy::kNone) {
+    return;
+  }
+  ApplyPolicyLocked(pids, options_.hidden_policy, &policy_targets_);
+  applied_policy_ = options_.hidden_policy;
+}
+
+// Runs synchronously on show so renderers can paint the restored windows
+// Renderers frozen by freeze_toggle stay frozen
+void BossKey::RevertHiddenPolicy() {
+  std::lock_guard<std::mutex> lock(policy_mutex_);
+  RevertPolicyLocked(applied_policy_, &policy_targets_);
+  applied_policy_ = ProcessPolicy::kNone;
+}
+
+// Trim working sets of browser processes above trim_threshold_bytes
+// When stop_on_show is set, trimming is abandoned once the browser is shown again
+void BossKey::TrimWorkingSets(const std::vector<ProcessId>& pids, bool stop_on_show) {
+  struct TrimTarget {
+    int rank;
+    ProcessId pid;
+    ProcessHandle process;
+  };
+
+  auto* processes = platform_.processes;
+  std::vector<TrimTarget> targets;
+  targets.reserve(pids.size());
+  for (ProcessId pid : pids) {
+    ProcessHandle process = processes->Open(pid);
+    if (!process) {
+      continue;
+    }
+    targets.push_back({TrimRank(processes->GetType(process)), pid, process});
+  }
+  std::stable_sort(targets.begin(), targets.end(),
+                   [](const TrimTarget& a, const TrimTarget& b) { return a.rank < b.rank; });
+
+  uint64_t total_reclaimed = 0;
+  for (const auto& target : targets) {
+    // Stop as soon as the browser is shown again: pages are about to be touched
+    if (stop_on_show && !IsHidden()) {
+      processes->Close(target.process);
+      continue;
+    }
+
+    uint64_t before = 0;
+    if (processes->GetWorkingSetSize(target.process, &before) &&
+        before >= options_.trim_threshold_bytes && processes->TrimWorkingSet(target.process)) {
+      uint64_t after = before;
+      processes->GetWorkingSetSize(target.process, &after);
+      uint64_t reclaimed = before > after ? before - after : 0;
+      total_reclaimed += reclaimed;
+      if (options_.log) {
+        options_.log(L"Trimmed pid %u: %llu KB reclaimed (%llu KB -> %llu KB)", target.pid,
+                     static_cast<unsigned long long>(reclaimed / 1024),
+                     static_cast<unsigned long long>(before / 1024),
+                     static_cast<unsigned long long>(after / 1024));
+      }
+    }
+    processes->Close(target.process);
+  }
+
+  if (options_.log) {
+    options_.log(L"Working set trim finished: %llu KB reclaimed",
+                 static_cast<unsigned long long>(total_reclaimed / 1024));
+  }
+}
+
+// Toggle hide/show windows and mute/unmute audio
+void BossKey::HideAndShow() {
+  std::lock_guard<std::mutex> action_lock(action_mutex_);
+
+  // Get PIDs from cache (fast if cached, a full process enumeration otherwise)
+  auto vivaldi_pids = GetAppPids();
+
+  if (!IsHidden()) {
+    // ===== HIDE MODE =====
+    // 1. Stop any pending retry timer
+    TaskId pending_retry = 0;
+    {
+      std::lock_guard<std::mutex> lock(timer_mutex_);
+      pending_retry = unmute_retry_task_;
+      unmute_retry_task_ = 0;
+    }
+    if (pending_retry) {
+      platform_.tasks->CancelDelayedTask(pending_retry);
+    }
+
+    // 2. Hide windows immediately (this must be synchronous for user experience)
+    auto hidden = platform_.windows->HideBrowserWindows(platform_.processes->GetCurrentProcessId());
+    hwnd_list_.insert(hwnd_list_.end(), hidden.begin(), hidden.end());
+
+    // 3. Update hide state before async audio processing
+    is_hide_.store(true, std::memory_order_release);
+
+    // 4. Clear saved audio states, mute audio, apply hidden-state policy and
+    //    trim memory asynchronously (don't block window hiding)
+    //    The states are cleared in the task, after the unmute of a previous
+    //    show that may still be queued has used them
+    platform_.tasks->PostTask([this, vivaldi_pids]() {
+      ClearSavedMuteStates();
+      MuteProcess(vivaldi_pids, true, true);
+      ApplyHiddenPolicy(vivaldi_pids);
+      if (options_.trim_on_hide) {
+        TrimWorkingSets(vivaldi_pids, true);
+      }
+    });
+
+  } else {
+    // ===== SHOW MODE =====
+    // 1. Update hide state first
+    is_hide_.store(false, std::memory_order_release);
+
+    // 2. Resume or un-throttle child processes before the windows repaint
+    RevertHiddenPolicy();
+
+    // 3. Restore windows immediately (synchronous for smooth UX)
+    for (auto r_iter = hwnd_list_.rbegin(); r_iter != hwnd_list_.rend(); ++r_iter) {
+      platform_.windows->RestoreWindow(*r_iter);
+    }
+    hwnd_list_.clear();
+
+    // 4. Unmute audio asynchronously (don't block window showing)
+    platform_.tasks->PostTask([this, vivaldi_pids]() {
+      bool found_sessions = MuteProcess(vivaldi_pids, false);
+
+      // If we found sessions and had unmuted ones, set up a retry timer
+      // to handle late-loading audio sessions
+      if (found_sessions && has_unmuted_sessions_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        unmute_retry_task_ = platform_.tasks->PostDelayedTask(
+            UNMUTE_RETRY_DELAY_MS, [this]() { HandleUnmuteRetry(); });
+      } else {
+        // No need to retry, clean up now
+        ClearSavedMuteStates();
+      }
+    });
+  }
+}
+
+// Toggle mute of browser audio without hiding windows
+void BossKey::MuteToggle() {
+  std::lock_guard<std::mutex> action_lock(action_mutex_);
+
+  // While hidden the boss key owns the mute state
+  if (IsHidden()) {
+    return;
+  }
+
+  auto vivaldi_pids = GetAppPids();
+  // Only flipped under action_mutex_, so load/store is race-free
+  bool mute = !is_toggle_muted_.load(std::memory_order_acquire);
+  is_toggle_muted_.store(mute, std::memory_order_release);
+  platform_.tasks->PostTask([this, vivaldi_pids, mute]() {
+    if (mute) {
+      // Start from a clean snapshot, exactly like the boss key does on hide
+      ClearSavedMuteStates();
+      MuteProcess(vivaldi_pids, true, true);
+      return;
+    }
+
+    MuteProcess(vivaldi_pids, false);
+    ClearSavedMuteStates();
+  });
+}
+
+// Toggle suspension of renderer processes without hiding windows
+void BossKey::FreezeToggle() {
+  std::lock_guard<std::mutex> action_lock(action_mutex_);
+
+  // While hidden the boss key owns the process policy
+  if (IsHidden()) {
+    return;
+  }
+
+  auto vivaldi_pids = GetAppPids();
+  std::lock_guard<std::mutex> lock(policy_mutex_);
+  if (frozen_targets_.empty()) {
+    ApplyPolicyLocked(vivaldi_pids, ProcessPolicy::kFreeze, &frozen_targets_);
+  } else {
+    RevertPolicyLocked(ProcessPolicy::kFreeze, &frozen_targets_);
+  }
+}
+
+// Trim working sets of browser processes on demand
+void BossKey::TrimMemory() {
+  auto vivaldi_pids = GetAppPids();
+  platform_.tasks->PostTask([this, vivaldi_pids]() {
+    TrimWorkingSets(vivaldi_pids, false);
+  });
+}
+
+}  // namespace bosskey
@@ -0,0 +1,183 @@
+#ifndef VIVALDI_PLUS_BOSSKEY_H_
+#define VIVALDI_PLUS_BOSSKEY_H_
+
+// Platform-neutral boss key state machine.
+// All window, process, audio and timer operations go through the narrow
+// backend interfaces below, so this header must not include <windows.h>.
+// hotkey.cpp provides the Win32 backends, bosskey_fake.h in-memory ones.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace bosskey {
+
+using ProcessId = uint32_t;
+using WindowHandle = uintptr_t;
+using ProcessHandle = uintptr_t;  // 0 means invalid
+using TaskId = uint64_t;          // 0 means invalid
+
+// What to do with child processes while hidden (mirrors hidden_policy in config.ini)
+enum class ProcessPolicy
+{
+  kNone,
+  kEco,
+  kFreeze,
+};
+
+class WindowBackend {
+ public:
+  virtual ~WindowBackend() = default;
+
+  // Hide every visible top-level browser window owned by `owner`
+  // Returns the hidden windows in enumeration order
+  virtual std::vector<WindowHandle> HideBrowserWindows(ProcessId owner) = 0;
+
+  // Show a previously hidden window and bring it to the foreground
+  virtual void RestoreWindow(WindowHandle window) = 0;
+};
+
+class ProcessBackend {
+ public:
+  virtual ~ProcessBackend() = default;
+
+  // All processes running the browser executable (browser + children)
+  virtual std::vector<ProcessId> EnumerateAppProcesses() = 0;
+  virtual ProcessId GetCurrentProcessId() = 0;
+
+  // Handles keep the process object alive, so a recycled PID is never touched
+  virtual ProcessHandle Open(ProcessId pid) = 0;
+  virtual void Close(ProcessHandle process) = 0;
+
+  // Chromium process type (--type= value), empty for the browser process
+  virtual std::wstring GetType(ProcessHandle process) = 0;
+
+  virtual bool Suspend(ProcessHandle process) = 0;
+  virtual bool Resume(ProcessHandle process) = 0;
+
+  // Lower priority and enable power throttling
+  // Returns opaque saved state for LeaveEcoMode, 0 on failure
+  virtual uint32_t EnterEcoMode(ProcessHandle process) = 0;
+  virtual void LeaveEcoMode(ProcessHandle process, uint32_t saved_state) = 0;
+
+  virtual bool GetWorkingSetSize(ProcessHandle process, uint64_t* bytes) = 0;
+  virtual bool TrimWorkingSet(ProcessHandle process) = 0;
+};
+
+class AudioBackend {
+ public:
+  virtual ~AudioBackend() = default;
+
+  // Returns the desired mute state for a session, or nullopt to leave it alone
+  using MuteDecision = std::function<std::optional<bool>(std::wstring_view session_id, bool is_muted)>;
+
+  // Visit every audio session owned by one of `pids` and apply `decide`
+  // Returns true if any session was found
+  virtual bool UpdateSessions(const std::vector<ProcessId>& pids, const MuteDecision& decide) = 0;
+};
+
+class TaskRunner {
+ public:
+  virtual ~TaskRunner() = default;
+
+  virtual void PostTask(std::function<void()> task) = 0;
+  virtual TaskId PostDelayedTask(uint32_t delay_ms, std::function<void()> task) = 0;
+
+  // Cancels a pending delayed task and waits for it if it is already running
+  virtual void CancelDelayedTask(TaskId id) = 0;
+
+  // Monotonic clock in milliseconds
+  virtual uint64_t NowMs() = 0;
+};
+
+struct Platform {
+  WindowBackend* windows = nullptr;
+  ProcessBackend* processes = nullptr;
+  AudioBackend* audio = nullptr;
+  TaskRunner* tasks = nullptr;
+};
+
+struct Options {
+  ProcessPolicy hidden_policy = ProcessPolicy::kNone;
+  bool trim_on_hide = false;
+  uint64_t trim_threshold_bytes = 64ull * 1024 * 1024;
+  // Debug log sink, nullptr disables logging
+  void (*log)(const wchar_t* format, ...) = nullptr;
+};
+
+class BossKey {
+ public:
+  BossKey(const Platform& platform, const Options& options);
+
+  BossKey(const BossKey&) = delete;
+  BossKey& operator=(const BossKey&) = delete;
+
+  // Hotkey actions, serialized against each other so any thread may call them
+  void HideAndShow();
+  void MuteToggle();
+  void FreezeToggle();
+  void TrimMemory();
+
+  bool IsHidden() const { return is_hide_.load(std::memory_order_acquire); }
+
+  // All PIDs of the browser, cached for a few seconds
+  std::vector<ProcessId> GetAppPids();
+  void InvalidatePidCache();
+
+ private:
+  struct PolicyTarget {
+    ProcessId pid;
+    ProcessHandle process;
+    uint32_t saved_state;
+  };
+
+  bool MuteProcess(const std::vector<ProcessId>& pids, bool set_mute, bool save_mute_state = false);
+  void ClearSavedMuteStates();
+  void HandleUnmuteRetry();
+
+  void ApplyPolicyLocked(const std::vector<ProcessId>& pids, ProcessPolicy policy,
+                         std::vector<PolicyTarget>* targets);
+  void RevertPolicyLocked(ProcessPolicy policy, std::vector<PolicyTarget>* targets);
+  void ApplyHiddenPolicy(const std::vector<ProcessId>& pids);
+  void RevertHiddenPolicy();
+
+  void TrimWorkingSets(const std::vector<ProcessId>& pids, bool stop_on_show);
+
+  const Platform platform_;
+  const Options options_;
+
+  std::mutex action_mutex_;  // Held by HideAndShow, MuteToggle and FreezeToggle
+  std::atomic<bool> is_hide_{false};
+  std::vector<WindowHandle> hwnd_list_;  // Guarded by action_mutex_
+
+  std::unordered_map<std::wstring, bool> original_mute_states_;
+  std::atomic<bool> has_unmuted_sessions_{false};
+  std::atomic<bool> is_toggle_muted_{false};
+  std::mutex audio_state_mutex_;
+
+  TaskId unmute_retry_task_ = 0;
+  std::mutex timer_mutex_;
+
+  // Process policy bookkeeping (kept in apply order for restore)
+  // hidden_policy and freeze_toggle are tracked apart, so showing the browser
+  // never resumes renderers the user froze before hiding it
+  ProcessPolicy applied_policy_ = ProcessPolicy::kNone;
+  std::vector<PolicyTarget> policy_targets_;
+  std::vector<PolicyTarget> frozen_targets_;
+  std::mutex policy_mutex_;
+
+  std::vector<ProcessId> cached_pids_;
+  uint64_t last_update_time_ = 0;
+  std::mutex cache_mutex_;
+};
+
+}  // namespace bosskey
+
+#endif  // VIVALDI_PLUS_BOSSKEY_H_
@@ -0,0 +1,518 @@
+#ifndef VIVALDI_PLUS_BOSSKEY_FAKE_H_
+#define VIVALDI_PLUS_BOSSKEY_FAKE_H_
+
+// In-memory backends for the boss key state machine.
+// They simulate any number of windows, processes and audio sessions without
+// touching the OS, so bosskey.cpp can be exercised and timed on any platform.
+// Header-only on purpose: not part of the shipped DLL.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bosskey.h"
+
+namespace bosskey {
+namespace fake {
+
+struct FakeWindow {
+  ProcessId owner = 0;
+  bool visible = true;
+  uint64_t hide_count = 0;
+  uint64_t restore_count = 0;
+};
+
+class FakeWindowBackend : public WindowBackend {
+ public:
+  WindowHandle AddWindow(ProcessId owner, bool visible = true) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WindowHandle handle = next_handle_++;
+    windows_.emplace(handle, FakeWindow{owner, visible, 0, 0});
+    return handle;
+  }
+
+  std::vector<WindowHandle> HideBrowserWindows(ProcessId owner) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<WindowHandle> hidden;
+    for (auto& [handle, window] : windows_) {
+      if (window.visible && window.owner == owner) {
+        window.visible = false;
+        ++window.hide_count;
+        hidden.push_back(handle);
+      }
+    }
+    return hidden;
+  }
+
+  void RestoreWindow(WindowHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = windows_.find(handle);
+    if (it != windows_.end()) {
+      it->second.visible = true;
+      ++it->second.restore_count;
+      restore_order_.push_back(handle);
+    }
+  }
+
+  size_t CountVisible(ProcessId owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (const auto& [handle, window] : windows_) {
+      count += (window.visible && window.owner == owner) ? 1 : 0;
+    }
+    return count;
+  }
+
+  std::vector<FakeWindow> Windows() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<FakeWindow> windows;
+    for (const auto& [handle, window] : windows_) {
+      windows.push_back(window);
+    }
+    return windows;
+  }
+
+  std::vector<WindowHandle> TakeRestoreOrder() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::exchange(restore_order_, {});
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<WindowHandle, FakeWindow> windows_;  // Ordered like EnumWindows
+  std::vector<WindowHandle> restore_order_;
+  WindowHandle next_handle_ = 0x1000;
+};
+
+struct FakeProcess {
+  std::wstring type;
+  int suspend_count = 0;
+  uint32_t priority = 0x20;  // NORMAL_PRIORITY_CLASS
+  bool eco = false;
+  uint64_t working_set = 0;
+  uint64_t trimmed_working_set = 0;  // Working set left after a trim
+};
+
+class FakeProcessBackend : public ProcessBackend {
+ public:
+  static constexpr uint32_t kIdlePriority = 0x40;  // IDLE_PRIORITY_CLASS
+
+  explicit FakeProcessBackend(ProcessId self_pid = 1) : self_pid_(self_pid) {
+    processes_[self_pid_] = FakeProcess{};
+  }
+
+  void AddProcess(ProcessId pid, std::wstring type, uint64_t working_set = 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FakeProcess process;
+    process.type = std::move(type);
+    process.working_set = working_set;
+    processes_[pid] = std::move(process);
+  }
+
+  void RemoveProcess(ProcessId pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    processes_.erase(pid);
+  }
+
+  FakeProcess Get(ProcessId pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = processes_.find(pid);
+    return it != processes_.end() ? it->second : FakeProcess{};
+  }
+
+  size_t OpenHandleCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return handles_.size();
+  }
+
+  uint64_t enumerate_calls() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enumerate_calls_;
+  }
+
+  std::vector<ProcessId> EnumerateAppProcesses() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++enumerate_calls_;
+    std::vector<ProcessId> pids;
+    pids.reserve(processes_.size());
+    for (const auto& [pid, process] : processes_) {
+      pids.push_back(pid);
+    }
+    return pids;
+  }
+
+  ProcessId GetCurrentProcessId() override {
+    return self_pid_;
+  }
+
+  ProcessHandle Open(ProcessId pid) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (processes_.find(pid) == processes_.end()) {
+      return 0;
+    }
+    ProcessHandle handle = next_handle_++;
+    handles_[handle] = pid;
+    return handle;
+  }
+
+  void Close(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handles_.erase(handle);
+  }
+
+  std::wstring GetType(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    return process ? process->type : std::wstring();
+  }
+
+  bool Suspend(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    if (!process) {
+      return false;
+    }
+    ++process->suspend_count;
+    return true;
+  }
+
+  bool Resume(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    if (!process || process->suspend_count == 0) {
+      return false;
+    }
+    --process->suspend_count;
+    return true;
+  }
+
+  uint32_t EnterEcoMode(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    if (!process) {
+      return 0;
+    }
+    uint32_t saved = process->priority;
+    process->priority = kIdlePriority;
+    process->eco = true;
+    return saved;
+  }
+
+  void LeaveEcoMode(ProcessHandle handle, uint32_t saved_state) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto* process = Lookup(handle)) {
+      process->priority = saved_state;
+      process->eco = false;
+    }
+  }
+
+  bool GetWorkingSetSize(ProcessHandle handle, uint64_t* bytes) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    if (!process) {
+      return false;
+    }
+    *bytes = process->working_set;
+    return true;
+  }
+
+  bool TrimWorkingSet(ProcessHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* process = Lookup(handle);
+    if (!process) {
+      return false;
+    }
+    process->working_set = process->trimmed_working_set;
+    return true;
+  }
+
+ private:
+  // Caller holds mutex_
+  FakeProcess* Lookup(ProcessHandle handle) {
+    auto handle_it = handles_.find(handle);
+    if (handle_it == handles_.end()) {
+      return nullptr;
+    }
+    auto it = processes_.find(handle_it->second);
+    return it != processes_.end() ? &it->second : nullptr;
+  }
+
+  const ProcessId self_pid_;
+  std::mutex mutex_;
+  std::map<ProcessId, FakeProcess> processes_;
+  std::unordered_map<ProcessHandle, ProcessId> handles_;
+  ProcessHandle next_handle_ = 1;
+  uint64_t enumerate_calls_ = 0;
+};
+
+struct FakeSession {
+  std::wstring id;
+  ProcessId pid = 0;
+  bool muted = false;
+};
+
+class FakeAudioBackend : public AudioBackend {
+ public:
+  void AddSession(std::wstring id, ProcessId pid, bool muted = false) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.push_back(FakeSession{std::move(id), pid, muted});
+  }
+
+  std::vector<FakeSession> Sessions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_;
+  }
+
+  bool UpdateSessions(const std::vector<ProcessId>& pids, const MuteDecision& decide) override {
+    std::unordered_set<ProcessId> pid_set(pids.begin(), pids.end());
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool found_any_session = false;
+    for (auto& session : sessions_) {
+      if (pid_set.find(session.pid) == pid_set.end()) {
+        continue;
+      }
+      found_any_session = true;
+      if (auto mute = decide(session.id, session.muted)) {
+        session.muted = *mute;
+      }
+    }
+    return found_any_session;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<FakeSession> sessions_;
+};
+
+// Deterministic task runner driven by a virtual clock.
+// Posted tasks run when RunUntilIdle() is called, delayed tasks once the
+// clock has been advanced past their deadline.
+class FakeTaskRunner : public TaskRunner {
+ public:
+  void PostTask(std::function<void()> task) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_.push_back(std::move(task));
+  }
+
+  TaskId PostDelayedTask(uint32_t delay_ms, std::function<void()> task) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TaskId id = next_id_++;
+    delayed_.emplace(id, std::make_pair(now_ms_ + delay_ms, std::move(task)));
+    return id;
+  }
+
+  void CancelDelayedTask(TaskId id) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    delayed_.erase(id);
+  }
+
+  uint64_t NowMs() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return now_ms_;
+  }
+
+  // Move the virtual clock and queue every delayed task that became due
+  void AdvanceTime(uint64_t ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    now_ms_ += ms;
+    for (auto it = delayed_.begin(); it != delayed_.end();) {
+      if (it->second.first <= now_ms_) {
+        ready_.push_back(std::move(it->second.second));
+        it = delayed_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Run posted tasks (including tasks they post) until the queue is empty
+  // Returns the number of tasks run
+  size_t RunUntilIdle() {
+    size_t count = 0;
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ready_.empty()) {
+          return count;
+        }
+        task = std::move(ready_.front());
+        ready_.pop_front();
+      }
+      task();
+      ++count;
+    }
+  }
+
+  size_t PendingDelayed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return delayed_.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::function<void()>> ready_;
+  std::map<TaskId, std::pair<uint64_t, std::function<void()>>> delayed_;
+  uint64_t now_ms_ = 0;
+  TaskId next_id_ = 1;
+};
+
+// Task runner with a worker thread of its own, standing in for the
+// executor::Sequence hotkey.cpp uses: tasks run one at a time in posting order,
+// off the posting thread, delayed ones once due on the steady clock.
+class ThreadedTaskRunner : public TaskRunner {
+ public:
+  ThreadedTaskRunner() : start_(Clock::now()), thread_([this]() { Loop(); }) {}
+
+  ~ThreadedTaskRunner() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  void PostTask(std::function<void()> task) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.push_back({0, std::move(task)});
+    }
+    wake_.notify_all();
+  }
+
+  TaskId PostDelayedTask(uint32_t delay_ms, std::function<void()> task) override {
+    TaskId id;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      id = next_id_++;
+      delayed_.emplace(id, std::make_pair(Clock::now() + std::chrono::milliseconds(delay_ms), std::move(task)));
+    }
+    wake_.notify_all();
+    return id;
+  }
+
+  void CancelDelayedTask(TaskId id) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    delayed_.erase(id);
+    std::erase_if(ready_, [id](const Item& item) { return item.id == id; });
+    if (std::this_thread::get_id() != thread_.get_id()) {
+      finished_.wait(lock, [this, id]() { return running_ != id; });
+    }
+    finished_.notify_all();
+  }
+
+  uint64_t NowMs() override {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_).count();
+  }
+
+  // Wait until no task is queued, delayed or running
+  void WaitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this]() { return ready_.empty() && delayed_.empty() && !busy_; });
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Item {
+    TaskId id;  // 0 for tasks posted without a delay
+    std::function<void()> run;
+  };
+
+  void Loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      auto now = Clock::now();
+      for (auto it = delayed_.begin(); it != delayed_.end();) {
+        if (it->second.first <= now) {
+          ready_.push_back({it->first, std::move(it->second.second)});
+          it = delayed_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+
+      if (!ready_.empty()) {
+        Item item = std::move(ready_.front());
+        ready_.pop_front();
+        running_ = item.id;
+        busy_ = true;
+        lock.unlock();
+        item.run();
+        lock.lock();
+        running_ = 0;
+        busy_ = false;
+        finished_.notify_all();
+        continue;
+      }
+
+      if (stop_) {
+        return;
+      }
+      if (delayed_.empty()) {
+        wake_.wait(lock);
+      } else {
+        auto next = delayed_.begin()->second.first;
+        for (const auto& [id, entry] : delayed_) {
+          next = std::min(next, entry.first);
+        }
+        wake_.wait_until(lock, next);
+      }
+    }
+  }
+
+  const Clock::time_point start_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable finished_;
+  std::deque<Item> ready_;
+  std::map<TaskId, std::pair<Clock::time_point, std::function<void()>>> delayed_;
+  TaskId next_id_ = 1;
+  TaskId running_ = 0;
+  bool busy_ = false;
+  bool stop_ = false;
+  std::thread thread_;  // Last, starts once everything above is constructed
+};
+
+// Bundle of all fake backends wired into a Platform
+struct FakePlatform {
+  FakeWindowBackend windows;
+  FakeProcessBackend processes;
+  FakeAudioBackend audio;
+  FakeTaskRunner tasks;
+
+  Platform Get() {
+    return Platform{&windows, &processes, &audio, &tasks};
+  }
+
+  // Populate a browser with `renderers` renderer processes, each owning one
+  // audio session, and `windows_count` top-level windows
+  void Populate(size_t renderers, size_t windows_count, uint64_t working_set = 0) {
+    const ProcessId self = processes.GetCurrentProcessId();
+    processes.AddProcess(self + 1, L"gpu-process", working_set);
+    processes.AddProcess(self + 2, L"utility", working_set);
+    for (size_t i = 0; i < renderers; ++i) {
+      ProcessId pid = self + 3 + static_cast<ProcessId>(i);
+      processes.AddProcess(pid, L"renderer", working_set);
+      audio.AddSession(L"session-" + std::to_wstring(pid), pid, (i % 4) == 0);
+    }
+    for (size_t i = 0; i < windows_count; ++i) {
+      windows.AddWindow(self);
+    }
+  }
+};
+
+}  // namespace fake
+}  // namespace bosskey
+
+#endif  // VIVALDI_PLUS_BOSSKEY_FAKE_H_
@@ -0,0 +1,251 @@
+#ifndef VIVALDI_PLUS_CACHE_BUDGET_H_
+#define VIVALDI_PLUS_CACHE_BUDGET_H_
+
+//
+// Disk cache budget ([cache] section) for the directory given to the browser
+// with --disk-cache-dir.
+// budget: a low-priority pass after startup, repeated hourly, evicts least
+// recently used simple cache entries and idle cache stores until the cache
+// fits (cache_plan.h).
+// clear_on_exit: the cache directory is renamed when the browser exits,
+// which is instant, and deleted in the background on the next start. If it
+// is still in use at exit, the next start renames it before the browser
+// opens it.
+//
+
+#include <windows.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cache_plan.h"
+#include "config.h"
+#include "executor.h"
+#include "utils.h"
+
+namespace cache_budget
+{
+
+constexpr DWORD kFirstPassDelayMs = 60 * 1000;
+constexpr DWORD kPassIntervalMs = 60 * 60 * 1000;
+
+// Renamed cache directories and evicted stores wait next to the cache directory
+constexpr wchar_t kTrashInfix[] = L".vivaldi_plus_trash.";
+
+inline std::wstring cache_dir;
+inline std::wstring profile_dir;
+inline std::atomic<bool> owner{false};
+
+inline bool IsBudgetSet()
+{
+    return GetConfig().GetCacheBudgetMb() != 0 || GetConfig().GetCacheBudgetPercent() != 0;
+}
+
+inline bool IsEnabled()
+{
+    return IsBudgetSet() || GetConfig().IsCacheClearOnExit();
+}
+
+inline void DeleteTree(const std::wstring &path)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((path + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                   FIND_FIRST_EX_LARGE_FETCH);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+                continue;
+
+            std::wstring child = path + L"\\" + data.cFileName;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                // Junctions are unlinked, never followed
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                {
+                    RemoveDirectoryW(child.c_str());
+                }
+                else
+                {
+                    DeleteTree(child);
+                }
+            }
+            else
+            {
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_READONLY)
+                    SetFileAttributesW(child.c_str(), FILE_ATTRIBUTE_NORMAL);
+                DeleteFileW(child.c_str());
+            }
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+    RemoveDirectoryW(path.c_str());
+}
+
+// Rename instead of delete: instant, and fails as a whole if any file inside is open
+inline bool MoveToTrash(const std::wstring &path)
+{
+    static std::atomic<uint32_t> sequence{0};
+    wchar_t suffix[40];
+    swprintf_s(suffix, L"%lX%X", GetCurrentProcessId(), sequence.fetch_add(1));
+    std::wstring trash = cache_dir + kTrashInfix + std::to_wstring(GetTickCount64()) + L"." + suffix;
+    return MoveFileExW(path.c_str(), trash.c_str(), 0) != FALSE;
+}
+
+inline void EmptyTrash()
+{
+    size_t slash = cache_dir.find_last_of(L'\\');
+    if (slash == std::wstring::npos)
+        return;
+
+    std::wstring parent = cache_dir.substr(0, slash);
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((cache_dir + kTrashInfix + L"*").c_str(), FindExInfoBasic, &data,
+                                   FindExSearchLimitToDirectories, nullptr, 0);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            DeleteTree(parent + L"\\" + data.cFileName);
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+}
+
+// All files below the cache directory, returns their total size
+inline uint64_t Scan(std::vector<CacheFile> *files)
+{
+    uint64_t total = 0;
+    std::vector<std::wstring> pending(1);
+    while (!pending.empty())
+    {
+        std::wstring relative = std::move(pending.back());
+        pending.pop_back();
+
+        std::wstring pattern = cache_dir + L"\\" + (relative.empty() ? L"*" : relative + L"\\*");
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                       FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE)
+            continue;
+
+        do
+        {
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0 ||
+                (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                continue;
+
+            std::wstring path = relative.empty() ? data.cFileName : relative + L"\\" + data.cFileName;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                pending.push_back(std::move(path));
+                continue;
+            }
+
+            // Access times are coarse or disabled on many volumes, writes count as use too
+            uint64_t size = static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+            uint64_t accessed = static_cast<uint64_t>(data.ftLastAccessTime.dwHighDateTime) << 32 |
+                                data.ftLastAccessTime.dwLowDateTime;
+            uint64_t written = static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32 |
+                               data.ftLastWriteTime.dwLowDateTime;
+            files->push_back({std::move(path), size, accessed > written ? accessed : written});
+            total += size;
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+    return total;
+}
+
+inline void EnforceBudget()
+{
+    std::vector<CacheFile> files;
+    uint64_t total = Scan(&files);
+
+    ULARGE_INTEGER available;
+    uint64_t free_bytes = GetDiskFreeSpaceExW(cache_dir.c_str(), &available, nullptr, nullptr) ? available.QuadPart : 0;
+    uint64_t budget =
+        ResolveBudget(GetConfig().GetCacheBudgetMb(), GetConfig().GetCacheBudgetPercent(), free_bytes, total);
+
+    std::vector<Candidate> candidates = Group(files);
+    size_t evicted = 0;
+    uint64_t freed = 0;
+    for (size_t i : SelectEvictions(candidates, total, budget))
+    {
+        const Candidate &candidate = candidates[i];
+        if (candidate.whole_store)
+        {
+            // A store the browser has open cannot be renamed and stays
+            std::wstring store = cache_dir + L"\\" + candidate.store;
+            if (!MoveToTrash(store))
+                continue;
+        }
+        else
+        {
+            for (size_t file : candidate.files)
+            {
+                DeleteFileW((cache_dir + L"\\" + files[file].path).c_str());
+            }
+        }
+        evicted++;
+        freed += candidate.size;
+    }
+    EmptyTrash();
+
+    DebugLog(L"Cache budget: %llu MB of %llu MB used, evicted %zu entries/stores (%llu MB)", total >> 20,
+             budget >> 20, evicted, freed >> 20);
+
+    executor::GetExecutor().PostDelayed(executor::Priority::kIdleIo, kPassIntervalMs, EnforceBudget);
+}
+
+// Browser process, before the browser entry point
+// `profile` is the data directory the browser opens, the local copy with a shadow
+inline void Start(const std::wstring &profile)
+{
+    if (!IsEnabled())
+        return;
+
+    // Without --disk-cache-dir the cache lives in the profile, leave it to the browser
+    cache_dir = GetSwitchValue(L"--disk-cache-dir");
+    if (cache_dir.empty())
+        return;
+
+    cache_dir = GetAbsolutePath(cache_dir);
+    while (cache_dir.size() > 3 && cache_dir.back() == L'\\')
+    {
+        cache_dir.pop_back();
+    }
+    profile_dir = profile;
+
+    // The last session could not discard its cache at exit; the browser has not opened it yet
+    if (GetConfig().IsCacheClearOnExit() && !IsProfileInUse(profile_dir))
+        MoveToTrash(cache_dir);
+}
+
+// Deferred startup task: only a process that became the browser (not one
+// that handed its command line to a running browser) gets here
+inline void OnStartupDone()
+{
+    if (cache_dir.empty())
+        return;
+
+    owner = true;
+    executor::Executor &executor = executor::GetExecutor();
+    executor.Post(executor::Priority::kIdleIo, EmptyTrash);
+    if (IsBudgetSet())
+        executor.PostDelayed(executor::Priority::kIdleIo, kFirstPassDelayMs, EnforceBudget);
+}
+
+// Process exit (process_exit.h): the rename is instant, deleting waits for the next start
+inline void OnExit()
+{
+    if (owner && GetConfig().IsCacheClearOnExit())
+        MoveToTrash(cache_dir);
+}
+
+}  // namespace cache_budget
+
+#endif  // VIVALDI_PLUS_CACHE_BUDGET_H_
@@ -0,0 +1,166 @@
+#ifndef VIVALDI_PLUS_CACHE_PLAN_H_
+#define VIVALDI_PLUS_CACHE_PLAN_H_
+
+// Platform-neutral part of the disk cache budget (cache_budget.h).
+// The scanned cache directory is split into eviction candidates: single
+// entries of Chromium's simple cache backend, whose files can be removed
+// while the browser runs (a missing entry reads as a miss), and whole stores
+// of any other layout, which are only removed if nothing in them is open.
+// Candidates are evicted least recently used first until the cache is below
+// the low watermark.
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cache_budget
+{
+
+// Evict down to this share of the budget, so the pass does not run on every small overshoot
+constexpr uint64_t kLowWatermarkPercent = 90;
+
+struct CacheFile
+{
+    std::wstring path;  // Relative to the cache directory
+    uint64_t size;
+    uint64_t used;  // Later of last access and last write, FILETIME units
+};
+
+struct Candidate
+{
+    std::wstring store;         // Directory relative to the cache directory
+    bool whole_store;           // Remove the directory, otherwise only `files`
+    std::vector<size_t> files;  // Indices into the scanned files
+    uint64_t size = 0;
+    uint64_t used = 0;
+};
+
+// Simple cache entry files are named <16 hex digits>_0, _1 or _s
+inline bool IsSimpleEntry(std::wstring_view name)
+{
+    if (name.size() != 18 || name[16] != L'_' || (name[17] != L'0' && name[17] != L'1' && name[17] != L's'))
+        return false;
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        wchar_t ch = name[i];
+        if (!((ch >= L'0' && ch <= L'9') || (ch >= L'a' && ch <= L'f')))
+            return false;
+    }
+    return true;
+}
+
+// Budget in bytes: a fixed size, or a share of the space the cache may use
+// (free space plus the cache itself); 0 = unlimited
+inline uint64_t ResolveBudget(uint64_t budget_mb, uint32_t percent, uint64_t free_bytes, uint64_t cache_bytes)
+{
+    if (percent)
+        return (free_bytes + cache_bytes) / 100 * (percent < 100 ? percent : 100);
+    return budget_mb << 20;
+}
+
+inline std::vector<Candidate> Group(const std::vector<CacheFile> &files)
+{
+    std::vector<Candidate> candidates;
+    std::unordered_map<std::wstring, size_t> stores;   // Whole-store candidate per directory
+    std::unordered_map<std::wstring, size_t> entries;  // Entry candidate per store and hash
+    std::unordered_map<std::wstring, bool> simple;     // Directories holding simple cache entries
+
+    for (const auto &file : files)
+    {
+        size_t slash = file.path.find_last_of(L'\\');
+        std::wstring_view name = slash == std::wstring::npos ? std::wstring_view(file.path)
+                                                             : std::wstring_view(file.path).substr(slash + 1);
+        if (IsSimpleEntry(name))
+            simple[slash == std::wstring::npos ? std::wstring() : file.path.substr(0, slash)] = true;
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const CacheFile &file = files[i];
+        size_t slash = file.path.find_last_of(L'\\');
+        std::wstring store = slash == std::wstring::npos ? std::wstring() : file.path.substr(0, slash);
+        std::wstring_view name = std::wstring_view(file.path).substr(slash == std::wstring::npos ? 0 : slash + 1);
+
+        // The index of a simple cache store lives in its index-dir subdirectory
+        size_t parent = store.find_last_of(L'\\');
+        std::wstring_view leaf = std::wstring_view(store).substr(parent == std::wstring::npos ? 0 : parent + 1);
+        if (leaf == L"index-dir" && simple.count(parent == std::wstring::npos ? std::wstring() : store.substr(0, parent)))
+            continue;
+
+        size_t index;
+        if (simple.count(store))
+        {
+            // Other files of a simple cache store (its index) are kept
+            if (!IsSimpleEntry(name))
+                continue;
+
+            std::wstring key = store + L'\\' + std::wstring(name.substr(0, 16));
+            auto it = entries.find(key);
+            if (it == entries.end())
+            {
+                it = entries.emplace(std::move(key), candidates.size()).first;
+                candidates.push_back({store, false, {}, 0, 0});
+            }
+            index = it->second;
+        }
+        else
+        {
+            // Files at the top of the cache directory belong to no store
+            if (store.empty())
+                continue;
+
+            auto it = stores.find(store);
+            if (it == stores.end())
+            {
+                it = stores.emplace(store, candidates.size()).first;
+                candidates.push_back({store, true, {}, 0, 0});
+            }
+            index = it->second;
+        }
+
+        Candidate &candidate = candidates[index];
+        candidate.files.push_back(i);
+        candidate.size += file.size;
+        candidate.used = std::max(candidate.used, file.used);
+    }
+    return candidates;
+}
+
+// Candidates to evict, least recently used first, to get `total` below the low
+// watermark of `budget`; empty while the cache fits the budget
+inline std::vector<size_t> SelectEvictions(const std::vector<Candidate> &candidates, uint64_t total, uint64_t budget)
+{
+    std::vector<size_t> selected;
+    if (budget == 0 || total <= budget)
+        return selected;
+
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&candidates](size_t a, size_t b) { return candidates[a].used < candidates[b].used; });
+
+    uint64_t target = budget / 100 * kLowWatermarkPercent;
+    for (size_t i : order)
+    {
+        if (total <= target)
+            break;
+        selected.push_back(i);
+        total -= std::min(total, candidates[i].size);
+    }
+    return selected;
+}
+
+}  // namespace cache_budget
+
+#endif  // VIVALDI_PLUS_CACHE_PLAN_H_
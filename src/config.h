@@ -2,12 +2,36 @@
 #define VIVALDI_PLUS_CONFIG_H_
 
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <windows.h>
 #include <shlwapi.h>
 
 // Forward declaration from utils.h
 std::wstring GetAppDir();
 
+// What to do with the browser process tree while it is hidden by the boss key
+enum class HiddenPolicy
+{
+    kNone,    // Leave processes untouched
+    kEco,     // EcoQoS power throttling and idle priority class for child processes
+    kFreeze,  // Suspend renderer processes until the browser is shown again
+};
+
+// Resources given to one Chromium child process type when it is spawned ([process_policy])
+// Every field has an "unchanged" value, only configured settings are applied
+struct ProcessPolicy
+{
+    std::wstring type;               // --type value, optionally ".<utility sub-type>" (e.g. "utility.audio")
+    DWORD priority_class = 0;        // 0 = unchanged
+    int memory_priority = -1;        // MEMORY_PRIORITY_VERY_LOW .. MEMORY_PRIORITY_NORMAL, -1 = unchanged
+    int eco_qos = -1;                // 1 = EcoQoS, 0 = never throttle, -1 = unchanged
+    DWORD64 cpu_sets = 0;            // Preferred logical processors (soft), 0 = unchanged
+    DWORD64 affinity = 0;            // Allowed logical processors (hard), 0 = unchanged
+    UINT working_set_mb = 0;         // Hard working set cap, 0 = none
+};
+
 // Configuration manager for vivaldi_plus
 // Reads settings from config.ini in the application directory
 class Config
@@ -17,16 +41,49 @@ private:
     bool win32k_enabled_;
     bool debug_log_enabled_;
     std::wstring command_line_;
+    std::wstring startup_trace_;  // Trace JSON output path, empty = disabled
+    bool startup_prefetch_;
+    bool shadow_enabled_;
+    UINT shadow_sync_minutes_;
+    UINT cache_budget_mb_;  // Disk cache size limit, 0 = none
+    UINT cache_budget_percent_;  // Limit as share of the cache drive's space, 0 = none
+    bool cache_clear_on_exit_;
+    bool sqlite_maintenance_;
+    UINT sqlite_time_budget_seconds_;
+    bool dedup_enabled_;
+    std::vector<std::wstring> dedup_dirs_;  // Data directories of other installs to deduplicate with
+    std::wstring dedup_store_;  // Shared store of linked files, empty = %app%\..\Shared
+    std::vector<std::pair<std::wstring, std::wstring>> storage_mappings_;  // [storage] sub-directory, target
     std::wstring disable_features_;
     bool has_custom_disable_features_;
     std::wstring boss_key_;  // Boss key hotkey string (e.g., "Ctrl+Alt+B")
+    std::wstring mute_toggle_key_;
+    std::wstring freeze_toggle_key_;
+    std::wstring trim_memory_key_;
+    HiddenPolicy hidden_policy_;
+    bool trim_on_hide_;
+    std::vector<std::wstring> disabled_hooks_;  // Hooks switched off in [hooks]
+    std::vector<ProcessPolicy> process_policies_;
+    UINT trim_threshold_mb_;
 
     Config()
     {
         // Initialize with default values
         win32k_enabled_ = false;  // Default: do not force enable win32k (safer)
         debug_log_enabled_ = false;  // Default: no debug logging
+        startup_prefetch_ = false;  // Default: no startup prefetch
+        shadow_enabled_ = false;  // Default: run from the data directory directly
+        shadow_sync_minutes_ = 10;
+        cache_budget_mb_ = 0;  // Default: no disk cache limit
+        cache_budget_percent_ = 0;
+        cache_clear_on_exit_ = false;
+        sqlite_maintenance_ = false;  // Default: leave the profile databases alone
+        sqlite_time_budget_seconds_ = 5;
+        dedup_enabled_ = false;  // Default: no hard links between data directories
         has_custom_disable_features_ = false;
+        hidden_policy_ = HiddenPolicy::kNone;
+        trim_on_hide_ = false;  // Default: keep working sets untouched
+        trim_threshold_mb_ = 64;
         LoadConfig();
     }
 
@@ -34,7 +91,8 @@ private:
     {
         config_path_ = GetAppDir() + L"\\config.ini";
 
-        if (!PathFileExistsW(config_path_.c_str()))
+        // GetFileAttributesW instead of PathFileExistsW keeps shlwapi.dll out of child processes
+        if (GetFileAttributesW(config_path_.c_str()) == INVALID_FILE_ATTRIBUTES)
         {
             return;  // Use defaults if config doesn't exist
         }
@@ -49,6 +107,17 @@ private:
         // 1 = enabled (output debug logs for troubleshooting)
         debug_log_enabled_ = (GetPrivateProfileIntW(L"general", L"debug_log", 0, config_path_.c_str()) != 0);
 
+        // Read startup_trace setting from [general] section
+        // Path of a Chrome trace-event JSON file with the startup timeline, empty = disabled
+        wchar_t trace_buffer[MAX_PATH];
+        GetPrivateProfileStringW(L"general", L"startup_trace", L"", trace_buffer, MAX_PATH, config_path_.c_str());
+        startup_trace_ = trace_buffer;
+
+        // Read startup_prefetch setting from [general] section
+        // 0 = disabled (default)
+        // 1 = learn the files read at startup and prefetch them on the next launch
+        startup_prefetch_ = (GetPrivateProfileIntW(L"general", L"startup_prefetch", 0, config_path_.c_str()) != 0);
+
         // Read additional command line arguments
         wchar_t buffer[4096];
         GetPrivateProfileStringW(L"general", L"command_line", L"", buffer, 4096, config_path_.c_str());
@@ -72,11 +141,248 @@ private:
             has_custom_disable_features_ = false;
         }
 
+        // Read profile shadow settings from [dir_setting] section
+        // shadow=1 runs the browser from a local copy of the data directory,
+        // synced back every shadow_sync_interval minutes (0 = only at exit)
+        shadow_enabled_ = (GetPrivateProfileIntW(L"dir_setting", L"shadow", 0, config_path_.c_str()) != 0);
+        shadow_sync_minutes_ = GetPrivateProfileIntW(L"dir_setting", L"shadow_sync_interval", 10, config_path_.c_str());
+
+        // Read disk cache settings from [cache] section
+        // budget=<MB> or budget=<percent>% of the space available to the cache, empty = unlimited
+        // clear_on_exit=1 discards the cache when the browser exits
+        wchar_t budget_buffer[32];
+        GetPrivateProfileStringW(L"cache", L"budget", L"", budget_buffer, 32, config_path_.c_str());
+        if (wcschr(budget_buffer, L'%'))
+        {
+            cache_budget_percent_ = _wtoi(budget_buffer);
+        }
+        else
+        {
+            cache_budget_mb_ = _wtoi(budget_buffer);
+        }
+        cache_clear_on_exit_ = (GetPrivateProfileIntW(L"cache", L"clear_on_exit", 0, config_path_.c_str()) != 0);
+
+        // Read SQLite maintenance settings from [maintenance] section
+        // sqlite=1 compacts the profile databases before the relaunch, for at most sqlite_time_budget seconds
+        sqlite_maintenance_ = (GetPrivateProfileIntW(L"maintenance", L"sqlite", 0, config_path_.c_str()) != 0);
+        sqlite_time_budget_seconds_ =
+            GetPrivateProfileIntW(L"maintenance", L"sqlite_time_budget", 5, config_path_.c_str());
+
+        // Read deduplication settings from [maintenance] section
+        // dedup=1 hard-links identical read-mostly files of this data directory and the
+        // semicolon-separated dedup_dirs into the dedup_store directory
+        dedup_enabled_ = (GetPrivateProfileIntW(L"maintenance", L"dedup", 0, config_path_.c_str()) != 0);
+        wchar_t dedup_buffer[4096];
+        GetPrivateProfileStringW(L"maintenance", L"dedup_dirs", L"", dedup_buffer, 4096, config_path_.c_str());
+        for (std::wstring_view dirs = dedup_buffer; !dirs.empty();)
+        {
+            size_t separator = dirs.find(L';');
+            std::wstring_view dir = Trim(dirs.substr(0, separator));
+            if (!dir.empty())
+                dedup_dirs_.emplace_back(dir);
+            dirs = separator == std::wstring_view::npos ? std::wstring_view() : dirs.substr(separator + 1);
+        }
+        GetPrivateProfileStringW(L"maintenance", L"dedup_store", L"", dedup_buffer, 4096, config_path_.c_str());
+        dedup_store_ = dedup_buffer;
+
+        // Read [storage] section: <profile sub-directory>=<target directory>
+        wchar_t storage_section[8192];
+        DWORD storage_length = GetPrivateProfileSectionW(L"storage", storage_section, 8192, config_path_.c_str());
+        for (const wchar_t *entry = storage_section; storage_length > 0 && *entry; entry += wcslen(entry) + 1)
+        {
+            std::wstring_view line(entry);
+            size_t equals = line.find(L'=');
+            if (equals == std::wstring_view::npos)
+                continue;
+
+            std::wstring_view relative = Trim(line.substr(0, equals));
+            std::wstring_view target = Trim(line.substr(equals + 1));
+            if (!relative.empty() && !target.empty())
+                storage_mappings_.emplace_back(relative, target);
+        }
+
         // Read boss_key setting from [hotkey] section
         // Example: boss_key=Ctrl+Alt+B
         wchar_t boss_key_buffer[256];
         GetPrivateProfileStringW(L"hotkey", L"boss_key", L"", boss_key_buffer, 256, config_path_.c_str());
         boss_key_ = boss_key_buffer;
+
+        // Read additional hotkey actions from [hotkey] section
+        // All of them are served by the same hotkey thread as boss_key
+        GetPrivateProfileStringW(L"hotkey", L"mute_toggle", L"", boss_key_buffer, 256, config_path_.c_str());
+        mute_toggle_key_ = boss_key_buffer;
+        GetPrivateProfileStringW(L"hotkey", L"freeze_toggle", L"", boss_key_buffer, 256, config_path_.c_str());
+        freeze_toggle_key_ = boss_key_buffer;
+        GetPrivateProfileStringW(L"hotkey", L"trim_memory", L"", boss_key_buffer, 256, config_path_.c_str());
+        trim_memory_key_ = boss_key_buffer;
+
+        // Read hidden_policy setting from [hotkey] section
+        // none = leave processes running (default)
+        // eco = throttle child processes while hidden
+        // freeze = suspend renderer processes while hidden
+        wchar_t policy_buffer[32];
+        GetPrivateProfileStringW(L"hotkey", L"hidden_policy", L"none", policy_buffer, 32, config_path_.c_str());
+        if (_wcsicmp(policy_buffer, L"eco") == 0)
+        {
+            hidden_policy_ = HiddenPolicy::kEco;
+        }
+        else if (_wcsicmp(policy_buffer, L"freeze") == 0)
+        {
+            hidden_policy_ = HiddenPolicy::kFreeze;
+        }
+
+        // Read working-set trim settings from [hotkey] section
+        // trim_on_hide=1 trims browser processes whose working set exceeds trim_threshold_mb
+        trim_on_hide_ = (GetPrivateProfileIntW(L"hotkey", L"trim_on_hide", 0, config_path_.c_str()) != 0);
+        trim_threshold_mb_ = GetPrivateProfileIntW(L"hotkey", L"trim_threshold_mb", 64, config_path_.c_str());
+
+        // Read [hooks] section: <hook name>=0 disables that hook
+        // Section data is a sequence of "key=value\0" entries terminated by an empty string
+        wchar_t hooks_buffer[4096];
+        DWORD hooks_length = GetPrivateProfileSectionW(L"hooks", hooks_buffer, 4096, config_path_.c_str());
+        for (const wchar_t *entry = hooks_buffer; hooks_length > 0 && *entry; entry += wcslen(entry) + 1)
+        {
+            std::wstring_view line(entry);
+            size_t equals = line.find(L'=');
+            if (equals != std::wstring_view::npos && _wtoi(entry + equals + 1) == 0)
+            {
+                std::wstring_view name = line.substr(0, equals);
+                while (!name.empty() && (name.back() == L' ' || name.back() == L'\t'))
+                {
+                    name.remove_suffix(1);
+                }
+                disabled_hooks_.emplace_back(name);
+            }
+        }
+
+        // Read [process_policy] section: <type>.<setting>=<value>
+        // The type is split off at the last dot, so "utility.audio.priority" configures "utility.audio"
+        wchar_t policy_section[8192];
+        DWORD policy_length = GetPrivateProfileSectionW(L"process_policy", policy_section, 8192, config_path_.c_str());
+        for (const wchar_t *entry = policy_section; policy_length > 0 && *entry; entry += wcslen(entry) + 1)
+        {
+            std::wstring_view line(entry);
+            size_t equals = line.find(L'=');
+            size_t dot = line.substr(0, equals).rfind(L'.');
+            if (equals == std::wstring_view::npos || dot == std::wstring_view::npos || dot == 0)
+                continue;
+
+            std::wstring_view key = Trim(line.substr(dot + 1, equals - dot - 1));
+            std::wstring value(Trim(line.substr(equals + 1)));
+            ParsePolicySetting(GetOrAddPolicy(Trim(line.substr(0, dot))), key, value);
+        }
+    }
+
+    static std::wstring_view Trim(std::wstring_view text)
+    {
+        while (!text.empty() && (text.front() == L' ' || text.front() == L'\t'))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == L' ' || text.back() == L'\t'))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    ProcessPolicy &GetOrAddPolicy(std::wstring_view type)
+    {
+        for (auto &policy : process_policies_)
+        {
+            if (policy.type.size() == type.size() && _wcsnicmp(policy.type.c_str(), type.data(), type.size()) == 0)
+            {
+                return policy;
+            }
+        }
+        ProcessPolicy &policy = process_policies_.emplace_back();
+        policy.type = type;
+        return policy;
+    }
+
+    // Logical processor list such as "0-3,6", processors beyond 63 are ignored
+    static DWORD64 ParseProcessorList(const std::wstring &list)
+    {
+        DWORD64 mask = 0;
+        for (const wchar_t *p = list.c_str(); *p;)
+        {
+            wchar_t *end = nullptr;
+            unsigned long first = wcstoul(p, &end, 10);
+            if (end == p)
+                break;
+
+            unsigned long last = first;
+            p = end;
+            if (*p == L'-')
+            {
+                last = wcstoul(p + 1, &end, 10);
+                p = end;
+            }
+            for (unsigned long cpu = first; cpu <= last && cpu < 64; cpu++)
+            {
+                mask |= 1ull << cpu;
+            }
+            while (*p == L',' || *p == L' ')
+            {
+                p++;
+            }
+        }
+        return mask;
+    }
+
+    static void ParsePolicySetting(ProcessPolicy &policy, std::wstring_view key, const std::wstring &value)
+    {
+        static constexpr struct
+        {
+            const wchar_t *name;
+            DWORD priority_class;
+            int memory_priority;
+        } kLevels[] = {
+            {L"idle", IDLE_PRIORITY_CLASS, MEMORY_PRIORITY_VERY_LOW},
+            {L"very_low", IDLE_PRIORITY_CLASS, MEMORY_PRIORITY_VERY_LOW},
+            {L"low", IDLE_PRIORITY_CLASS, MEMORY_PRIORITY_LOW},
+            {L"medium", BELOW_NORMAL_PRIORITY_CLASS, MEMORY_PRIORITY_MEDIUM},
+            {L"below_normal", BELOW_NORMAL_PRIORITY_CLASS, MEMORY_PRIORITY_BELOW_NORMAL},
+            {L"normal", NORMAL_PRIORITY_CLASS, MEMORY_PRIORITY_NORMAL},
+            {L"above_normal", ABOVE_NORMAL_PRIORITY_CLASS, -1},
+            {L"high", HIGH_PRIORITY_CLASS, -1},
+        };
+        auto is = [key](const wchar_t *name) {
+            return key.size() == wcslen(name) && _wcsnicmp(key.data(), name, key.size()) == 0;
+        };
+
+        if (is(L"priority") || is(L"memory_priority"))
+        {
+            for (const auto &level : kLevels)
+            {
+                if (_wcsicmp(value.c_str(), level.name) != 0)
+                    continue;
+                if (is(L"priority"))
+                {
+                    policy.priority_class = level.priority_class;
+                }
+                else
+                {
+                    policy.memory_priority = level.memory_priority;
+                }
+            }
+        }
+        else if (is(L"eco_qos"))
+        {
+            policy.eco_qos = _wtoi(value.c_str()) != 0 ? 1 : 0;
+        }
+        else if (is(L"cpu_sets"))
+        {
+            policy.cpu_sets = ParseProcessorList(value);
+        }
+        else if (is(L"affinity"))
+        {
+            policy.affinity = ParseProcessorList(value);
+        }
+        else if (is(L"working_set_mb"))
+        {
+            policy.working_set_mb = _wtoi(value.c_str());
+        }
     }
 
 public:
@@ -101,6 +407,97 @@ public:
         return debug_log_enabled_;
     }
 
+    // Returns the file the startup timeline is written to, as configured
+    // Empty string if startup tracing is disabled (default)
+    const std::wstring& GetStartupTracePath() const
+    {
+        return startup_trace_;
+    }
+
+    // Returns true if the startup read set is learned and prefetched
+    // Default is false
+    bool IsStartupPrefetchEnabled() const
+    {
+        return startup_prefetch_;
+    }
+
+    // Returns true if the browser runs from a local copy of the data directory
+    // Default is false
+    bool IsShadowEnabled() const
+    {
+        return shadow_enabled_;
+    }
+
+    // Minutes between syncs of the local copy back to the data directory, 0 = only at exit
+    // Default is 10
+    UINT GetShadowSyncMinutes() const
+    {
+        return shadow_sync_minutes_;
+    }
+
+    // Returns the disk cache size limit in MB, 0 = none
+    // Default is 0
+    UINT GetCacheBudgetMb() const
+    {
+        return cache_budget_mb_;
+    }
+
+    // Returns the disk cache size limit in percent of the space available to it, 0 = none
+    // Default is 0
+    UINT GetCacheBudgetPercent() const
+    {
+        return cache_budget_percent_;
+    }
+
+    // Returns true if the disk cache is discarded when the browser exits
+    // Default is false
+    bool IsCacheClearOnExit() const
+    {
+        return cache_clear_on_exit_;
+    }
+
+    // Returns true if the profile databases are maintained before the browser starts
+    // Default is false
+    bool IsSqliteMaintenanceEnabled() const
+    {
+        return sqlite_maintenance_;
+    }
+
+    // Returns the time the database maintenance may delay a start, in seconds
+    // Default is 5
+    UINT GetSqliteTimeBudgetSeconds() const
+    {
+        return sqlite_time_budget_seconds_;
+    }
+
+    // Returns true if identical files of the data directories are hard-linked
+    // Default is false
+    bool IsDedupEnabled() const
+    {
+        return dedup_enabled_;
+    }
+
+    // Returns the data directories of other installs to deduplicate with, unexpanded
+    // Default is empty
+    const std::vector<std::wstring>& GetDedupDirs() const
+    {
+        return dedup_dirs_;
+    }
+
+    // Returns the shared store directory, unexpanded
+    // Default is empty (%app%\..\Shared)
+    const std::wstring& GetDedupStore() const
+    {
+        return dedup_store_;
+    }
+
+    // Returns the [storage] mappings: directory relative to the data directory, unexpanded target
+    // Default is empty
+    const std::vector<std::pair<std::wstring, std::wstring>>& GetStorageMappings() const
+    {
+        return storage_mappings_;
+    }
+
     // Returns additional command line arguments from config
     const std::wstring& GetCommandLine() const
     {
@@ -129,6 +526,82 @@ public:
         return boss_key_;
     }
 
+    // Returns hotkey toggling browser audio mute without hiding windows
+    // Empty string if not configured
+    const std::wstring& GetMuteToggleKey() const
+    {
+        return mute_toggle_key_;
+    }
+
+    // Returns hotkey toggling suspension of renderer processes
+    // Empty string if not configured
+    const std::wstring& GetFreezeToggleKey() const
+    {
+        return freeze_toggle_key_;
+    }
+
+    // Returns hotkey trimming working sets of browser processes on demand
+    // Empty string if not configured
+    const std::wstring& GetTrimMemoryKey() const
+    {
+        return trim_memory_key_;
+    }
+
+    // Returns the policy applied to browser processes while hidden by the boss key
+    // Default is HiddenPolicy::kNone
+    HiddenPolicy GetHiddenPolicy() const
+    {
+        return hidden_policy_;
+    }
+
+    // Returns true if working sets should be trimmed when hiding with the boss key
+    // Default is false
+    bool IsTrimOnHideEnabled() const
+    {
+        return trim_on_hide_;
+    }
+
+    // Returns minimum working set (in MB) a process needs before it is trimmed
+    // Default is 64
+    UINT GetTrimThresholdMb() const
+    {
+        return trim_threshold_mb_;
+    }
+
+    // Returns false if the hook was switched off in the [hooks] section
+    // Default is true for every hook
+    bool IsHookEnabled(const wchar_t *name) const
+    {
+        for (const auto &disabled : disabled_hooks_)
+        {
+            if (_wcsicmp(disabled.c_str(), name) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns true if any [process_policy] entry is configured
+    bool HasProcessPolicies() const
+    {
+        return !process_policies_.empty();
+    }
+
+    // Returns the spawn-time policy for a process type ("renderer", "utility.audio", ...)
+    // nullptr if that type has no policy
+    const ProcessPolicy *GetProcessPolicy(std::wstring_view type) const
+    {
+        for (const auto &policy : process_policies_)
+        {
+            if (policy.type.size() == type.size() && _wcsnicmp(policy.type.c_str(), type.data(), type.size()) == 0)
+            {
+                return &policy;
+            }
+        }
+        return nullptr;
+    }
+
     // Delete copy constructor and assignment operator
     Config(const Config&) = delete;
     Config& operator=(const Config&) = delete;
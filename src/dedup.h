@@ -0,0 +1,416 @@
+#ifndef VIVALDI_PLUS_DEDUP_H_
+#define VIVALDI_PLUS_DEDUP_H_
+
+//
+// Cross-profile deduplication ([maintenance] dedup): identical extension,
+// component and dictionary files of this and the configured data directories
+// become hard links into a shared store (dedup_plan.h). A weekly idle I/O
+// pass does the work some minutes after startup. Browser code opening a
+// linked file for writing first gets its own copy (CreateFileW, CreateFile2,
+// CopyFileW and CopyFileExW hooks), so the other names keep their contents.
+// The hooks stay installed while the store exists, also with dedup turned
+// off, since the links outlive the setting.
+//
+// Not covered: NtCreateFile called directly, which Chromium only does for
+// the sandbox broker on behalf of renderers, and child processes, which never
+// get handles to the deduplicated areas. The component updater and extension
+// installs unpack into new directories and rename them into place, and a
+// rename or delete only affects the name it is given.
+//
+
+#include <windows.h>
+#include <shlobj.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "dedup_plan.h"
+#include "executor.h"
+#include "hook.h"
+#include "hook_stats.h"
+#include "state_store.h"
+#include "utils.h"
+
+namespace dedup
+{
+
+constexpr DWORD kFirstPassDelayMs = 5 * 60 * 1000;
+constexpr DWORD kReadChunk = 1 << 20;
+constexpr wchar_t kCopySuffix[] = L".vivaldi_plus_copy";
+
+inline std::wstring data_root;           // Data directory this browser opens, the local copy with a shadow
+inline std::vector<std::wstring> roots;  // All deduplicated data directories, set before the hooks
+inline bool protecting = false;          // Copy-on-write hooks are installed
+inline executor::CancellationToken cancel = executor::CancellationToken::Create();
+
+inline bool IsEnabled()
+{
+    return GetConfig().IsDedupEnabled();
+}
+
+inline uint64_t ToUint64(DWORD high, DWORD low)
+{
+    return static_cast<uint64_t>(high) << 32 | low;
+}
+
+inline std::wstring StorePath()
+{
+    const std::wstring &store = GetConfig().GetDedupStore();
+    return ResolvePath(store.empty() ? L"%app%\\..\\Shared" : store);
+}
+
+// Links made by earlier passes may still exist, even with dedup turned off
+inline bool HasStore()
+{
+    DWORD attributes = GetFileAttributesW(StorePath().c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+// Win32 file system operations of the pass
+
+inline bool List(const std::wstring &dir, std::vector<Entry> *entries)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((dir + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                   FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0 ||
+            (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            continue;
+
+        entries->push_back({data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0,
+                            ToUint64(data.nFileSizeHigh, data.nFileSizeLow),
+                            ToUint64(data.ftLastWriteTime.dwHighDateTime, data.ftLastWriteTime.dwLowDateTime)});
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    return true;
+}
+
+inline bool Identify(const std::wstring &path, Identity *identity)
+{
+    HANDLE file = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, kShareAll, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(file, &info) != FALSE;
+    CloseHandle(file);
+    if (ok)
+    {
+        *identity = {info.dwVolumeSerialNumber, ToUint64(info.nFileIndexHigh, info.nFileIndexLow),
+                     info.nNumberOfLinks, ToUint64(info.nFileSizeHigh, info.nFileSizeLow),
+                     ToUint64(info.ftLastWriteTime.dwHighDateTime, info.ftLastWriteTime.dwLowDateTime)};
+    }
+    return ok;
+}
+
+inline HANDLE OpenForReading(const std::wstring &path)
+{
+    return CreateFileW(path.c_str(), GENERIC_READ, kShareAll, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+}
+
+inline bool Read(const std::wstring &path, const std::function<void(const uint8_t *, size_t)> &sink)
+{
+    HANDLE file = OpenForReading(path);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::vector<uint8_t> buffer(kReadChunk);
+    DWORD read = 0;
+    bool ok;
+    while ((ok = ReadFile(file, buffer.data(), kReadChunk, &read, nullptr) != FALSE) && read > 0)
+    {
+        sink(buffer.data(), read);
+    }
+    CloseHandle(file);
+    return ok;
+}
+
+inline bool SameContents(const std::wstring &a, const std::wstring &b)
+{
+    HANDLE first = OpenForReading(a);
+    if (first == INVALID_HANDLE_VALUE)
+        return false;
+    HANDLE second = OpenForReading(b);
+    if (second == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(first);
+        return false;
+    }
+
+    std::vector<uint8_t> left(kReadChunk), right(kReadChunk);
+    bool same = true;
+    for (;;)
+    {
+        DWORD left_read = 0, right_read = 0;
+        if (!ReadFile(first, left.data(), kReadChunk, &left_read, nullptr) ||
+            !ReadFile(second, right.data(), kReadChunk, &right_read, nullptr) || left_read != right_read ||
+            memcmp(left.data(), right.data(), left_read) != 0)
+        {
+            same = false;
+            break;
+        }
+        if (left_read == 0)
+            break;
+    }
+    CloseHandle(first);
+    CloseHandle(second);
+    return same;
+}
+
+inline bool Link(const std::wstring &existing, const std::wstring &path)
+{
+    return CreateHardLinkW(path.c_str(), existing.c_str(), nullptr) != FALSE;
+}
+
+inline bool Replace(const std::wstring &from, const std::wstring &to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+inline bool Remove(const std::wstring &path)
+{
+    return DeleteFileW(path.c_str()) != FALSE;
+}
+
+inline bool MakeDirectory(const std::wstring &path)
+{
+    int result = SHCreateDirectoryExW(nullptr, path.c_str(), nullptr);
+    return result == ERROR_SUCCESS || result == ERROR_ALREADY_EXISTS;
+}
+
+// Walker threads are not executor workers, give them the idle I/O treatment too
+inline void EnterWorker()
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+}
+
+inline void RunPass()
+{
+    Report last;
+    {
+        state_store::Snapshot snapshot;
+        state_format::Record record;
+        if (snapshot.Find(state_store::kDedupReport, &record) && record.version == kReportVersion)
+            DecodeReport(record.data, record.size, &last);
+    }
+
+    FILETIME time;
+    GetSystemTimeAsFileTime(&time);
+    uint64_t now = ToUint64(time.dwHighDateTime, time.dwLowDateTime);
+    if (now - last.last_pass < kPassInterval)
+        return;
+
+    // Another browser may be updating its own directory, only ours is protected by the hook
+    std::vector<std::wstring> idle;
+    for (const auto &root : roots)
+    {
+        if (root == data_root || !IsProfileInUse(root))
+            idle.push_back(root);
+    }
+
+    ULONGLONG start = GetTickCount64();
+    FileSystem fs{List, Identify, Read, SameContents, Link, Replace, Remove, MakeDirectory, EnterWorker};
+    Report report = Deduplicate(fs, idle, StorePath(), now, kMaxWorkers, cancel);
+    if (cancel.IsCancelled())
+        return;
+
+    std::vector<uint8_t> bytes = EncodeReport(report);
+    state_store::Update([&bytes](state_format::Builder &builder) {
+        builder.Set(state_store::kDedupReport, kReportVersion, bytes.data(), bytes.size());
+    });
+
+    DebugLog(L"Dedup: %zu directories, %llu files scanned, %llu linked, %llu MB reclaimed, "
+             L"%llu unused store files removed (%llu MB) in %llu ms",
+             idle.size(), report.files_scanned, report.files_linked, report.bytes_reclaimed >> 20,
+             report.store_removed, report.bytes_freed >> 20, GetTickCount64() - start);
+}
+
+// Copy-on-write
+
+// `path` lies in a deduplicated area of one of the data directories
+inline bool IsSharedPath(std::wstring_view path)
+{
+    if (path.starts_with(L"\\\\?\\"))
+        path.remove_prefix(4);
+
+    for (const auto &root : roots)
+    {
+        if (path.size() > root.size() + 1 && path[root.size()] == L'\\' &&
+            _wcsnicmp(path.data(), root.c_str(), root.size()) == 0)
+        {
+            std::wstring_view relative = path.substr(root.size() + 1);
+            size_t slash = relative.find_last_of(L'\\');
+            return slash != std::wstring_view::npos && IsSharedArea(relative.substr(0, slash));
+        }
+    }
+    return false;
+}
+
+// Give a file that has other names its own copy; true if it has none (any more)
+inline bool BreakLink(LPCWSTR path)
+{
+    HANDLE file = CreateFileW(path, FILE_READ_ATTRIBUTES, kShareAll, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return true;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    bool linked = GetFileInformationByHandle(file, &info) && info.nNumberOfLinks > 1;
+    CloseHandle(file);
+    if (!linked)
+        return true;
+
+    std::wstring copy = std::wstring(path) + kCopySuffix;
+    if (CopyFileW(path, copy.c_str(), FALSE) && MoveFileExW(copy.c_str(), path, MOVEFILE_REPLACE_EXISTING))
+        return true;
+
+    DWORD error = GetLastError();
+    DeleteFileW(copy.c_str());
+    WarningLog(L"Dedup: could not copy %s before writing: %d", path, error);
+    return false;
+}
+
+typedef HANDLE(WINAPI *pCreateFileW)(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                     LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+                                     DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+
+inline pCreateFileW RawCreateFileW = nullptr;
+
+// Writing or truncating a hard link changes every name of the file; if the
+// copy fails the open fails, rather than changing the other profiles
+inline bool PrepareOpen(LPCWSTR path, DWORD access, DWORD disposition, DWORD flags)
+{
+    bool writes = (access & (GENERIC_WRITE | GENERIC_ALL | FILE_WRITE_DATA | FILE_APPEND_DATA)) ||
+                  disposition == CREATE_ALWAYS || disposition == TRUNCATE_EXISTING;
+    if (!writes || !path || (flags & FILE_FLAG_BACKUP_SEMANTICS) || !IsSharedPath(path) || BreakLink(path))
+        return true;
+
+    SetLastError(ERROR_SHARING_VIOLATION);
+    return false;
+}
+
+inline HANDLE WINAPI MyCreateFileW(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                   LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+                                   DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
+{
+    HOOK_STATS_SCOPE(kCreateFileWCopyOnWrite);
+    if (!PrepareOpen(lpFileName, dwDesiredAccess, dwCreationDisposition, dwFlagsAndAttributes))
+        return INVALID_HANDLE_VALUE;
+    return RawCreateFileW(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition,
+                          dwFlagsAndAttributes, hTemplateFile);
+}
+
+typedef HANDLE(WINAPI *pCreateFile2)(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                     DWORD dwCreationDisposition,
+                                     LPCREATEFILE2_EXTENDED_PARAMETERS pCreateExParams);
+
+inline pCreateFile2 RawCreateFile2 = nullptr;
+
+inline HANDLE WINAPI MyCreateFile2(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                   DWORD dwCreationDisposition, LPCREATEFILE2_EXTENDED_PARAMETERS pCreateExParams)
+{
+    HOOK_STATS_SCOPE(kCreateFile2CopyOnWrite);
+    DWORD flags = pCreateExParams ? pCreateExParams->dwFileFlags : 0;
+    if (!PrepareOpen(lpFileName, dwDesiredAccess, dwCreationDisposition, flags))
+        return INVALID_HANDLE_VALUE;
+    return RawCreateFile2(lpFileName, dwDesiredAccess, dwShareMode, dwCreationDisposition, pCreateExParams);
+}
+
+// Copying over an existing file writes into it from inside kernelbase, where
+// the CreateFileW hook does not see it
+inline bool PrepareCopy(LPCWSTR destination, bool fail_if_exists)
+{
+    if (fail_if_exists || !destination || !IsSharedPath(destination) || BreakLink(destination))
+        return true;
+
+    SetLastError(ERROR_SHARING_VIOLATION);
+    return false;
+}
+
+typedef BOOL(WINAPI *pCopyFileW)(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, BOOL bFailIfExists);
+
+inline pCopyFileW RawCopyFileW = nullptr;
+
+inline BOOL WINAPI MyCopyFileW(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, BOOL bFailIfExists)
+{
+    HOOK_STATS_SCOPE(kCopyFileCopyOnWrite);
+    if (!PrepareCopy(lpNewFileName, bFailIfExists))
+        return FALSE;
+    return RawCopyFileW(lpExistingFileName, lpNewFileName, bFailIfExists);
+}
+
+typedef BOOL(WINAPI *pCopyFileExW)(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName,
+                                   LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel,
+                                   DWORD dwCopyFlags);
+
+inline pCopyFileExW RawCopyFileExW = nullptr;
+
+inline BOOL WINAPI MyCopyFileExW(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName,
+                                 LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel,
+                                 DWORD dwCopyFlags)
+{
+    HOOK_STATS_SCOPE(kCopyFileCopyOnWrite);
+    if (!PrepareCopy(lpNewFileName, dwCopyFlags & COPY_FILE_FAIL_IF_EXISTS))
+        return FALSE;
+    return RawCopyFileExW(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags);
+}
+
+// Browser process, before the hooks are installed
+// `data_dir` is the directory the browser opens: only its lockfile is ours
+inline void Start(const std::wstring &data_dir)
+{
+    protecting = IsEnabled() || HasStore();
+    if (!protecting)
+        return;
+
+    data_root = ResolvePath(data_dir);
+    roots.push_back(data_root);
+    for (const auto &dir : GetConfig().GetDedupDirs())
+    {
+        std::wstring root = ResolvePath(dir);
+        if (!root.empty() && _wcsicmp(root.c_str(), data_root.c_str()) != 0)
+            roots.push_back(std::move(root));
+    }
+}
+
+// Deferred startup task
+inline void OnStartupDone()
+{
+    executor::GetExecutor().PostDelayed(executor::Priority::kIdleIo, kFirstPassDelayMs, RunPass, cancel);
+}
+
+// Process exit (process_exit.h): stop a running pass at the next file
+inline void OnExit()
+{
+    cancel.Cancel();
+}
+
+inline bool IsProtecting()
+{
+    return protecting;
+}
+
+// Not switchable in [hooks]: without them, writes would reach every linked copy
+inline void AddDedupHooks(hook::Registry &registry)
+{
+    registry.Add({nullptr, L"kernel32.dll", "CreateFileW", nullptr, reinterpret_cast<void **>(&RawCreateFileW),
+                  reinterpret_cast<void *>(MyCreateFileW), IsProtecting, hook::kBrowserImporters});
+    registry.Add({nullptr, L"kernel32.dll", "CreateFile2", nullptr, reinterpret_cast<void **>(&RawCreateFile2),
+                  reinterpret_cast<void *>(MyCreateFile2), IsProtecting, hook::kBrowserImporters});
+    registry.Add({nullptr, L"kernel32.dll", "CopyFileW", nullptr, reinterpret_cast<void **>(&RawCopyFileW),
+                  reinterpret_cast<void *>(MyCopyFileW), IsProtecting, hook::kBrowserImporters});
+    registry.Add({nullptr, L"kernel32.dll", "CopyFileExW", nullptr, reinterpret_cast<void **>(&RawCopyFileExW),
+                  reinterpret_cast<void *>(MyCopyFileExW), IsProtecting, hook::kBrowserImporters});
+}
+
+}  // namespace dedup
+
+#endif  // VIVALDI_PLUS_DEDUP_H_
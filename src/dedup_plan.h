@@ -0,0 +1,452 @@
+#ifndef VIVALDI_PLUS_DEDUP_PLAN_H_
+#define VIVALDI_PLUS_DEDUP_PLAN_H_
+
+// Platform-neutral part of the cross-profile deduplication (dedup.h).
+// Several data directories on one volume hold the same extensions, component
+// downloads and dictionaries. Files in those write-once areas that have not
+// changed for a day are walked with a few parallel workers, grouped by size,
+// hashed, and byte-identical copies are replaced with hard links to one file
+// in a content-addressed store (<store>\<2 hex>\<hash>-<size>). A store file
+// nothing links to any more is removed. Writes to a linked file break the link
+// first (copy-on-write in dedup.h).
+// The file system is reached through a table of operations, Win32 on Windows.
+//
+// Report record layout (little endian), version kReportVersion:
+//   0  time of the last pass, FILETIME units
+//   8  files scanned, files linked, bytes reclaimed, store files removed,
+//      bytes freed by removing them (8 bytes each)
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wctype.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "executor.h"
+#include "path_compare.h"
+#include "shadow_manifest.h"
+#include "state_format.h"
+
+namespace dedup
+{
+
+constexpr uint16_t kReportVersion = 1;
+
+constexpr uint64_t kFileTimeDay = 24ull * 60 * 60 * 10000000;
+constexpr uint64_t kPassInterval = 7 * kFileTimeDay;
+constexpr uint64_t kMinAge = kFileTimeDay;  // Unchanged this long = read-mostly
+constexpr uint64_t kMinFileBytes = 16 << 10;
+constexpr size_t kMaxWorkers = 4;
+
+constexpr wchar_t kLinkSuffix[] = L".vivaldi_plus_link";
+
+// Top-level directories the component updater fills with versioned, write-once files
+constexpr std::wstring_view kSharedDirectories[] = {
+    L"AutofillStates",   L"CertificateRevocation", L"Crowd Deny",  L"Dictionaries",
+    L"FileTypePolicies", L"FirstPartySetsPreloaded", L"hyphen-data", L"MEIPreload",
+    L"OnDeviceHeadSuggestModel", L"OriginTrials", L"PKIMetadata", L"SafetyTips",
+    L"SSLErrorAssistant", L"TrustTokenKeyCommitments", L"WidevineCdm", L"ZxcvbnData",
+};
+
+// Profile subdirectory holding one directory per installed extension version
+constexpr std::wstring_view kExtensionsDirectory = L"Extensions";
+
+// One directory entry; junctions and symbolic links are not reported
+struct Entry
+{
+    std::wstring name;
+    bool directory;
+    uint64_t size;
+    uint64_t mtime;  // Last write time, FILETIME units
+};
+
+struct Identity
+{
+    uint64_t volume;
+    uint64_t file;  // Same volume and file = hard links of one file
+    uint32_t links;
+    uint64_t size;
+    uint64_t mtime;
+};
+
+// File system operations, paths are absolute and backslash separated
+struct FileSystem
+{
+    bool (*list)(const std::wstring &dir, std::vector<Entry> *entries);
+    bool (*identify)(const std::wstring &path, Identity *identity);
+    bool (*read)(const std::wstring &path, const std::function<void(const uint8_t *, size_t)> &sink);
+    bool (*same_contents)(const std::wstring &a, const std::wstring &b);
+    bool (*link)(const std::wstring &existing, const std::wstring &path);  // New hard link
+    bool (*replace)(const std::wstring &from, const std::wstring &to);     // Atomic rename over `to`
+    bool (*remove)(const std::wstring &path);
+    bool (*make_directory)(const std::wstring &path);
+    void (*enter_worker)();  // Optional, runs first on every extra worker thread
+};
+
+struct Report
+{
+    uint64_t last_pass = 0;
+    uint64_t files_scanned = 0;
+    uint64_t files_linked = 0;
+    uint64_t bytes_reclaimed = 0;
+    uint64_t store_removed = 0;
+    uint64_t bytes_freed = 0;
+};
+
+struct File
+{
+    std::wstring path;
+    uint64_t size;
+    uint64_t mtime;
+};
+
+inline std::wstring_view NextComponent(std::wstring_view *path)
+{
+    size_t slash = path->find(L'\\');
+    std::wstring_view component = path->substr(0, slash);
+    *path = slash == std::wstring_view::npos ? std::wstring_view() : path->substr(slash + 1);
+    return component;
+}
+
+// Directory relative to a data directory lies in a write-once area
+inline bool IsSharedArea(std::wstring_view relative)
+{
+    std::wstring_view top = NextComponent(&relative);
+    for (std::wstring_view shared : kSharedDirectories)
+    {
+        if (path_compare::EqualsIgnoreCase(top, shared))
+            return true;
+    }
+    return !relative.empty() && path_compare::EqualsIgnoreCase(NextComponent(&relative), kExtensionsDirectory);
+}
+
+// Profiles and shared directories are all at the top, below that only shared areas are walked
+inline bool ShouldDescend(std::wstring_view relative)
+{
+    return relative.find(L'\\') == std::wstring_view::npos || IsSharedArea(relative);
+}
+
+// Store file name of a content, also the grouping key
+inline std::wstring StoreKey(uint64_t hash, uint64_t size)
+{
+    static constexpr wchar_t kHex[] = L"0123456789abcdef";
+    std::wstring key(16, L'0');
+    for (int i = 15; i >= 0; i--, hash >>= 4)
+    {
+        key[i] = kHex[hash & 0xf];
+    }
+    return key + L"-" + std::to_wstring(size);
+}
+
+// Run `fn(i)` for i in [0, count) on up to `workers` threads
+inline void ParallelFor(const FileSystem &fs, size_t count, size_t workers, const std::function<void(size_t)> &fn)
+{
+    std::mutex mutex;
+    size_t next = 0;
+    auto work = [&]() {
+        for (;;)
+        {
+            size_t i;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (next == count)
+                    return;
+                i = next++;
+            }
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(workers, count); i++)
+    {
+        threads.emplace_back([&fs, &work]() {
+            if (fs.enter_worker)
+                fs.enter_worker();
+            work();
+        });
+    }
+    work();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// Files of the shared areas below `roots`, listed by parallel workers
+// that share one stack of pending directories
+inline std::vector<File> Walk(const FileSystem &fs, const std::vector<std::wstring> &roots, size_t workers,
+                              uint64_t now, const executor::CancellationToken &cancel)
+{
+    struct Pending
+    {
+        size_t root;
+        std::wstring relative;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Pending> pending;
+    size_t busy = 0;
+    std::vector<File> files;
+    for (size_t i = 0; i < roots.size(); i++)
+    {
+        pending.push_back({i, L""});
+    }
+
+    auto work = [&]() {
+        std::vector<Entry> entries;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [&]() { return !pending.empty() || busy == 0; });
+            if (pending.empty() || cancel.IsCancelled())
+            {
+                pending.clear();
+                wake.notify_all();
+                return;
+            }
+
+            Pending dir = std::move(pending.back());
+            pending.pop_back();
+            busy++;
+            lock.unlock();
+
+            std::vector<Pending> subdirs;
+            std::vector<File> found;
+            std::wstring base = roots[dir.root] + (dir.relative.empty() ? L"" : L"\\" + dir.relative);
+            entries.clear();
+            fs.list(base, &entries);
+            for (const auto &entry : entries)
+            {
+                std::wstring relative = dir.relative.empty() ? entry.name : dir.relative + L"\\" + entry.name;
+                if (entry.directory)
+                {
+                    if (ShouldDescend(relative))
+                        subdirs.push_back({dir.root, std::move(relative)});
+                }
+                else if (std::wstring_view(entry.name).ends_with(kLinkSuffix))
+                {
+                    // Left over by an interrupted pass
+                    fs.remove(base + L"\\" + entry.name);
+                }
+                else if (!dir.relative.empty() && IsSharedArea(dir.relative) && entry.size >= kMinFileBytes &&
+                         now - entry.mtime >= kMinAge)
+                {
+                    found.push_back({base + L"\\" + entry.name, entry.size, entry.mtime});
+                }
+            }
+
+            lock.lock();
+            busy--;
+            for (auto &subdir : subdirs)
+            {
+                pending.push_back(std::move(subdir));
+            }
+            for (auto &file : found)
+            {
+                files.push_back(std::move(file));
+            }
+            wake.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; i++)
+    {
+        threads.emplace_back([&fs, &work]() {
+            if (fs.enter_worker)
+                fs.enter_worker();
+            work();
+        });
+    }
+    work();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return files;
+}
+
+inline bool HashFile(const FileSystem &fs, const std::wstring &path, uint64_t *hash)
+{
+    shadow::Hasher hasher;
+    if (!fs.read(path, [&hasher](const uint8_t *data, size_t size) { hasher.Update(data, size); }))
+        return false;
+    *hash = hasher.value();
+    return true;
+}
+
+// One deduplication pass over `roots` into `store`, which must be on the same volume
+inline Report Deduplicate(const FileSystem &fs, const std::vector<std::wstring> &roots, const std::wstring &store,
+                          uint64_t now, size_t workers, const executor::CancellationToken &cancel)
+{
+    Report report;
+    report.last_pass = now;
+    Identity store_identity;
+    if (!fs.make_directory(store) || !fs.identify(store, &store_identity))
+        return report;
+
+    // Existing store files; those only the store still links to are released
+    std::unordered_map<std::wstring, std::pair<std::wstring, Identity>> stored;
+    std::vector<Entry> buckets, entries;
+    fs.list(store, &buckets);
+    for (const auto &bucket : buckets)
+    {
+        if (!bucket.directory)
+            continue;
+
+        std::wstring dir = store + L"\\" + bucket.name;
+        entries.clear();
+        fs.list(dir, &entries);
+        for (const auto &entry : entries)
+        {
+            std::wstring path = dir + L"\\" + entry.name;
+            Identity identity;
+            if (entry.directory || !fs.identify(path, &identity))
+                continue;
+
+            if (identity.links <= 1)
+            {
+                if (fs.remove(path))
+                {
+                    report.store_removed++;
+                    report.bytes_freed += identity.size;
+                }
+                continue;
+            }
+            stored.emplace(entry.name, std::make_pair(std::move(path), identity));
+        }
+    }
+
+    std::vector<File> files = Walk(fs, roots, workers, now, cancel);
+    report.files_scanned = files.size();
+
+    // Only sizes that occur twice or are in the store can have a twin
+    std::unordered_map<uint64_t, size_t> sizes;
+    for (const auto &file : files)
+    {
+        sizes[file.size]++;
+    }
+    for (const auto &[key, value] : stored)
+    {
+        sizes[value.second.size] += 2;
+    }
+    std::erase_if(files, [&sizes](const File &file) { return sizes[file.size] < 2; });
+
+    struct Hashed
+    {
+        Identity identity;
+        uint64_t hash;
+        bool ok;
+    };
+    std::vector<Hashed> hashed(files.size());
+    ParallelFor(fs, files.size(), workers, [&](size_t i) {
+        Hashed &result = hashed[i];
+        result.ok = !cancel.IsCancelled() && fs.identify(files[i].path, &result.identity) &&
+                    result.identity.volume == store_identity.volume && HashFile(fs, files[i].path, &result.hash);
+    });
+
+    // Group by content; the first copy becomes the store file if there is none yet
+    std::unordered_map<std::wstring, std::vector<size_t>> groups;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (hashed[i].ok)
+            groups[StoreKey(hashed[i].hash, files[i].size)].push_back(i);
+    }
+
+    for (auto &[key, members] : groups)
+    {
+        if (cancel.IsCancelled())
+            break;
+
+        auto it = stored.find(key);
+        if (it == stored.end())
+        {
+            // A single copy, or copies that are already one file, gain nothing
+            const Identity &first = hashed[members.front()].identity;
+            bool twins = std::any_of(members.begin(), members.end(),
+                                     [&](size_t i) { return hashed[i].identity.file != first.file; });
+            if (!twins)
+                continue;
+
+            std::wstring dir = store + L"\\" + key.substr(0, 2);
+            std::wstring path = dir + L"\\" + key;
+            if (!fs.make_directory(dir) || !fs.link(files[members.front()].path, path))
+                continue;
+            it = stored.emplace(key, std::make_pair(std::move(path), first)).first;
+        }
+
+        const std::wstring &store_path = it->second.first;
+        uint64_t store_file = it->second.second.file;
+        for (size_t i : members)
+        {
+            const File &file = files[i];
+            const Identity &identity = hashed[i].identity;
+            if (identity.file == store_file)
+                continue;
+
+            // Equal hashes are only a hint; the file must also be unchanged since it was hashed
+            Identity current;
+            if (!fs.same_contents(store_path, file.path) || !fs.identify(file.path, &current) ||
+                current.file != identity.file || current.size != file.size || current.mtime != file.mtime)
+                continue;
+
+            std::wstring temporary = file.path + kLinkSuffix;
+            if (!fs.link(store_path, temporary))
+                continue;
+            if (!fs.replace(temporary, file.path))
+            {
+                fs.remove(temporary);
+                continue;
+            }
+
+            // Space comes back only when the replaced file had no other name
+            report.files_linked++;
+            if (current.links == 1)
+                report.bytes_reclaimed += file.size;
+        }
+    }
+    return report;
+}
+
+inline std::vector<uint8_t> EncodeReport(const Report &report)
+{
+    std::vector<uint8_t> bytes(48);
+    state_format::StoreLE64(bytes.data(), report.last_pass);
+    state_format::StoreLE64(bytes.data() + 8, report.files_scanned);
+    state_format::StoreLE64(bytes.data() + 16, report.files_linked);
+    state_format::StoreLE64(bytes.data() + 24, report.bytes_reclaimed);
+    state_format::StoreLE64(bytes.data() + 32, report.store_removed);
+    state_format::StoreLE64(bytes.data() + 40, report.bytes_freed);
+    return bytes;
+}
+
+inline bool DecodeReport(const uint8_t *data, size_t size, Report *report)
+{
+    *report = Report();
+    if (size != 48)
+        return false;
+
+    report->last_pass = state_format::LoadLE64(data);
+    report->files_scanned = state_format::LoadLE64(data + 8);
+    report->files_linked = state_format::LoadLE64(data + 16);
+    report->bytes_reclaimed = state_format::LoadLE64(data + 24);
+    report->store_removed = state_format::LoadLE64(data + 32);
+    report->bytes_freed = state_format::LoadLE64(data + 40);
+    return true;
+}
+
+}  // namespace dedup
+
+#endif  // VIVALDI_PLUS_DEDUP_PLAN_H_
@@ -0,0 +1,118 @@
+#ifndef VIVALDI_PLUS_DPAPI_BLOB_H_
+#define VIVALDI_PLUS_DPAPI_BLOB_H_
+
+// Platform-neutral codec for data "protected" in portable mode.
+// Portable profiles must stay readable on any machine, so CryptProtectData is
+// replaced by a plain copy. The copy is wrapped in a small tagged envelope so
+// CryptUnprotectData can tell it apart from a real DPAPI blob without calling
+// DPAPI, which fails slowly for blobs made on another machine.
+//
+// Layout (little endian):
+//   0  magic   "VPDB"
+//   4  version kVersion
+//   5  reserved, 3 zero bytes
+//   8  payload size
+//  12  payload
+//  ..  FNV-1a 32 of the payload
+//
+// Real DPAPI blobs start with version 1 and the provider GUID
+// (01 00 00 00 D0 8C 9D DF), so they never carry the magic.
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace dpapi_blob
+{
+
+constexpr uint8_t kMagic[4] = {'V', 'P', 'D', 'B'};
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 12;
+constexpr size_t kTrailerSize = 4;
+
+enum class DecodeResult
+{
+    kOk,
+    kNotTagged,           // Legacy blob: real DPAPI data or an untagged copy
+    kUnsupportedVersion,  // Written by a newer build
+    kCorrupt,             // Tagged, but truncated or checksum mismatch
+};
+
+inline uint32_t Checksum(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline void StoreLE32(uint8_t *out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline uint32_t LoadLE32(const uint8_t *in)
+{
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+}
+
+// Size of the tagged blob for a payload, 0 if the payload is too large
+inline size_t EncodedSize(size_t payload_size)
+{
+    if (payload_size > UINT32_MAX - kHeaderSize - kTrailerSize)
+        return 0;
+    return kHeaderSize + payload_size + kTrailerSize;
+}
+
+// Write the tagged blob to `out`, which must hold EncodedSize(payload_size) bytes
+inline bool Encode(const uint8_t *payload, size_t payload_size, uint8_t *out, size_t out_size)
+{
+    size_t encoded_size = EncodedSize(payload_size);
+    if (encoded_size == 0 || out_size < encoded_size || (!payload && payload_size))
+        return false;
+
+    memcpy(out, kMagic, sizeof(kMagic));
+    out[4] = kVersion;
+    out[5] = out[6] = out[7] = 0;
+    StoreLE32(out + 8, static_cast<uint32_t>(payload_size));
+    if (payload_size)
+    {
+        memcpy(out + kHeaderSize, payload, payload_size);
+    }
+    StoreLE32(out + kHeaderSize + payload_size, Checksum(payload, payload_size));
+    return true;
+}
+
+// On kOk, `payload` points into `blob`; nothing is copied
+inline DecodeResult Decode(const uint8_t *blob, size_t size, const uint8_t **payload, size_t *payload_size)
+{
+    if (!blob || size < sizeof(kMagic) || memcmp(blob, kMagic, sizeof(kMagic)) != 0)
+        return DecodeResult::kNotTagged;
+    if (size < kHeaderSize + kTrailerSize)
+        return DecodeResult::kCorrupt;
+    if (blob[4] != kVersion)
+        return DecodeResult::kUnsupportedVersion;
+
+    size_t length = LoadLE32(blob + 8);
+    if (length != size - kHeaderSize - kTrailerSize)
+        return DecodeResult::kCorrupt;
+
+    const uint8_t *data = blob + kHeaderSize;
+    if (LoadLE32(data + length) != Checksum(data, length))
+        return DecodeResult::kCorrupt;
+
+    *payload = data;
+    *payload_size = length;
+    return DecodeResult::kOk;
+}
+
+}  // namespace dpapi_blob
+
+#endif  // VIVALDI_PLUS_DPAPI_BLOB_H_
@@ -0,0 +1,405 @@
+#include "executor.h"
+
+#include <windows.h>
+
+#include <algorithm>
+
+namespace executor
+{
+
+namespace
+{
+
+constexpr size_t kNoWorker = static_cast<size_t>(-1);
+
+// Pool index of the calling thread, kNoWorker outside the pool
+thread_local size_t current_worker = kNoWorker;
+thread_local int current_priority = THREAD_PRIORITY_NORMAL;
+
+size_t Index(Priority priority)
+{
+    return static_cast<size_t>(priority);
+}
+
+void EnterPriority(Priority priority)
+{
+    if (priority == Priority::kIdleIo)
+    {
+        // Lowers CPU, I/O and memory priority of this thread until THREAD_MODE_BACKGROUND_END
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        return;
+    }
+
+    int wanted = priority == Priority::kInteractive ? THREAD_PRIORITY_NORMAL : THREAD_PRIORITY_BELOW_NORMAL;
+    if (wanted != current_priority && SetThreadPriority(GetCurrentThread(), wanted))
+        current_priority = wanted;
+}
+
+void LeavePriority(Priority priority)
+{
+    if (priority == Priority::kIdleIo)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
+
+}  // namespace
+
+TaskId Executor::Post(Priority priority, std::function<void()> task, CancellationToken token)
+{
+    return Enqueue(priority, Clock::time_point(), std::move(task), std::move(token));
+}
+
+TaskId Executor::PostDelayed(Priority priority, uint32_t delay_ms, std::function<void()> task,
+                             CancellationToken token)
+{
+    return Enqueue(priority, Clock::now() + std::chrono::milliseconds(delay_ms), std::move(task), std::move(token));
+}
+
+bool Executor::Cancel(TaskId id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = controls_.find(id);
+    if (it == controls_.end())
+        return false;
+
+    std::shared_ptr<Control> control = it->second;
+    int expected = kPending;
+    if (control->state.compare_exchange_strong(expected, kFinished))
+    {
+        // Ready tasks are skipped when popped, delayed ones can go right away
+        controls_.erase(it);
+        for (auto delayed = delayed_.begin(); delayed != delayed_.end(); ++delayed)
+        {
+            if (delayed->second.id == id)
+            {
+                delayed_.erase(delayed);
+                break;
+            }
+        }
+        return true;
+    }
+
+    if (control->runner != std::this_thread::get_id())
+        finished_.wait(lock, [&]() { return control->state.load() == kFinished; });
+    return false;
+}
+
+void Executor::Shutdown()
+{
+    // Workers hold the lock only briefly; a crashed thread may never let go of it
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    for (int i = 0; i < 100 && !lock.owns_lock(); i++)
+    {
+        Sleep(1);
+        lock.try_lock();
+    }
+    if (!lock.owns_lock())
+        return;
+
+    stopping_ = true;
+    wake_.notify_all();
+}
+
+void Executor::StartWorkers()
+{
+    size_t count = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, kMinWorkers, kMaxWorkers);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto worker = std::make_unique<Worker>();
+        if (i == 0)
+            worker->lowest = Priority::kInteractive;
+        else if (i == 1)
+            worker->lowest = Priority::kBackground;
+        workers_.push_back(std::move(worker));
+    }
+
+    // Detached: threads leave on Shutdown or die with the process, nobody joins them
+    for (size_t i = 0; i < count; i++)
+    {
+        std::thread([this, i]() { WorkerMain(i); }).detach();
+    }
+}
+
+TaskId Executor::Enqueue(Priority priority, Clock::time_point due, std::function<void()> run,
+                         CancellationToken token)
+{
+    std::call_once(start_once_, [this]() { StartWorkers(); });
+
+    Task task;
+    task.priority = priority;
+    task.run = std::move(run);
+    task.token = std::move(token);
+    task.control = std::make_shared<Control>();
+
+    TaskId id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+            return 0;
+
+        id = task.id = next_id_++;
+        controls_.emplace(id, task.control);
+        if (due > Clock::now())
+        {
+            // Sleeping workers recompute their deadline
+            delayed_.emplace(due, std::move(task));
+            wake_.notify_all();
+            return id;
+        }
+    }
+
+    PushReady(std::move(task));
+    return id;
+}
+
+void Executor::PushReady(Task task)
+{
+    size_t priority = Index(task.priority);
+
+    // Work posted from a pool thread stays local and can be stolen by idle workers
+    if (current_worker < workers_.size() && CanRun(current_worker, priority))
+    {
+        Worker &worker = *workers_[current_worker];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queues[priority].push_back(std::move(task));
+        }
+        queued_[priority].fetch_add(1);
+
+        // Taking the lock orders the counter update before a sleeper's predicate check
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_all();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    injected_[priority].push_back(std::move(task));
+    queued_[priority].fetch_add(1);
+    wake_.notify_all();
+}
+
+bool Executor::CanRun(size_t worker, size_t priority) const
+{
+    return priority <= Index(workers_[worker]->lowest);
+}
+
+bool Executor::HasWork(size_t worker) const
+{
+    for (size_t priority = 0; priority < kPriorityCount; priority++)
+    {
+        if (!CanRun(worker, priority) || queued_[priority].load() == 0)
+            continue;
+        if (priority == Index(Priority::kIdleIo) && idle_io_running_.load() != 0)
+            continue;
+        return true;
+    }
+    return false;
+}
+
+bool Executor::TakeTask(size_t worker, Task &task)
+{
+    for (size_t priority = 0; priority < kPriorityCount; priority++)
+    {
+        if (!CanRun(worker, priority) || queued_[priority].load() == 0)
+            continue;
+
+        bool idle_io = priority == Index(Priority::kIdleIo);
+        int expected = 0;
+        if (idle_io && !idle_io_running_.compare_exchange_strong(expected, 1))
+            continue;
+
+        auto pop = [&](std::deque<Task> &queue, bool front) {
+            if (queue.empty())
+                return false;
+            task = std::move(front ? queue.front() : queue.back());
+            if (front)
+                queue.pop_front();
+            else
+                queue.pop_back();
+            return true;
+        };
+
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+            found = pop(workers_[worker]->queues[priority], true);
+        }
+        if (!found)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            found = pop(injected_[priority], true);
+        }
+        for (size_t i = 1; !found && i < workers_.size(); i++)
+        {
+            Worker &victim = *workers_[(worker + i) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            found = pop(victim.queues[priority], false);
+        }
+
+        if (found)
+        {
+            queued_[priority].fetch_sub(1);
+            return true;
+        }
+        if (idle_io)
+            idle_io_running_.store(0);
+    }
+    return false;
+}
+
+void Executor::PromoteDueLocked(Clock::time_point now)
+{
+    bool promoted = false;
+    while (!delayed_.empty() && delayed_.begin()->first <= now)
+    {
+        Task task = std::move(delayed_.begin()->second);
+        delayed_.erase(delayed_.begin());
+
+        size_t priority = Index(task.priority);
+        injected_[priority].push_back(std::move(task));
+        queued_[priority].fetch_add(1);
+        promoted = true;
+    }
+    if (promoted)
+        wake_.notify_all();
+}
+
+void Executor::WorkerMain(size_t index)
+{
+    current_worker = index;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;)
+            {
+                if (stopping_)
+                    return;
+
+                PromoteDueLocked(Clock::now());
+                if (HasWork(index))
+                    break;
+
+                if (delayed_.empty())
+                    wake_.wait(lock);
+                else
+                    wake_.wait_until(lock, delayed_.begin()->first);
+            }
+        }
+
+        Task task;
+        if (TakeTask(index, task))
+            Run(task);
+    }
+}
+
+void Executor::Run(Task &task)
+{
+    Control &control = *task.control;
+    control.runner = std::this_thread::get_id();
+
+    int expected = kPending;
+    bool run = !task.token.IsCancelled() && control.state.compare_exchange_strong(expected, kRunning);
+    if (run)
+    {
+        EnterPriority(task.priority);
+        task.run();
+        LeavePriority(task.priority);
+    }
+    task.run = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (task.priority == Priority::kIdleIo)
+    {
+        // Hand the idle I/O slot to a waiting worker
+        idle_io_running_.store(0);
+        wake_.notify_all();
+    }
+    control.state.store(kFinished);
+    controls_.erase(task.id);
+    finished_.notify_all();
+}
+
+Executor &GetExecutor()
+{
+    static Executor *executor = new Executor();
+    return *executor;
+}
+
+void Sequence::Post(std::function<void()> task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    PushLocked({0, std::move(task)});
+}
+
+TaskId Sequence::PostDelayed(uint32_t delay_ms, std::function<void()> task)
+{
+    // The timer only queues the task and hands over its id, which stays valid
+    // until the task has run. Holding the lock keeps an early timer from
+    // reading the id before it is stored.
+    auto shared = std::make_shared<std::function<void()>>(std::move(task));
+    auto id = std::make_shared<TaskId>(0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    *id = GetExecutor().PostDelayed(priority_, delay_ms, [this, shared, id]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        PushLocked({*id, std::move(*shared)});
+    });
+    return *id;
+}
+
+bool Sequence::Cancel(TaskId id)
+{
+    // Still on its timer; a timer that is firing is waited for, so the task is queued afterwards
+    if (GetExecutor().Cancel(id))
+        return true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = std::find_if(queue_.begin(), queue_.end(), [id](const Item &item) { return item.id == id; });
+    if (it != queue_.end())
+    {
+        queue_.erase(it);
+        return true;
+    }
+
+    if (runner_ != std::this_thread::get_id())
+        finished_.wait(lock, [&]() { return running_ != id; });
+    return false;
+}
+
+void Sequence::PushLocked(Item item)
+{
+    queue_.push_back(std::move(item));
+    if (scheduled_)
+        return;
+
+    scheduled_ = GetExecutor().Post(priority_, [this]() { RunNext(); }) != 0;
+}
+
+void Sequence::RunNext()
+{
+    Item item;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty())
+        {
+            scheduled_ = false;
+            return;
+        }
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        running_ = item.id;
+        runner_ = std::this_thread::get_id();
+    }
+
+    item.run();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = 0;
+    runner_ = std::thread::id();
+    finished_.notify_all();
+
+    // One task per pool task, so other work on this priority is not starved
+    if (queue_.empty() || !GetExecutor().Post(priority_, [this]() { RunNext(); }))
+        scheduled_ = false;
+}
+
+}  // namespace executor
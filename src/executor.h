@@ -0,0 +1,196 @@
+#ifndef VIVALDI_PLUS_EXECUTOR_H_
+#define VIVALDI_PLUS_EXECUTOR_H_
+
+//
+// Process-wide background executor of the extension.
+// A small work-stealing pool (3 to 4 threads, started on first use) runs
+// one-shot and delayed tasks at three priorities. Worker 0 only runs
+// interactive tasks, so hotkey work is never queued behind maintenance, and
+// worker 1 never takes idle I/O, so a long disk pass cannot hold up
+// background work. At most one idle I/O task runs at a time, in Windows
+// background mode. A Sequence runs its tasks one at a time, in order.
+// Threads with a message loop of their own (hotkey registration, first
+// window detection) stay dedicated threads.
+//
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace executor
+{
+
+enum class Priority
+{
+    kInteractive,  // User-visible reaction to input: boss key, mute
+    kBackground,   // Startup and housekeeping work, below normal CPU priority
+    kIdleIo,       // Disk maintenance, low CPU/I/O/memory priority, one at a time
+};
+
+using TaskId = uint64_t;  // 0 means invalid
+
+// Shared flag checked before a task starts; long tasks may poll it too
+// A default-constructed token is never cancelled
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+
+    static CancellationToken Create()
+    {
+        CancellationToken token;
+        token.flag_ = std::make_shared<std::atomic<bool>>(false);
+        return token;
+    }
+
+    void Cancel() const
+    {
+        if (flag_)
+            flag_->store(true, std::memory_order_release);
+    }
+
+    bool IsCancelled() const
+    {
+        return flag_ && flag_->load(std::memory_order_acquire);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+class Executor
+{
+public:
+    static constexpr size_t kMinWorkers = 3;
+    static constexpr size_t kMaxWorkers = 4;
+
+    Executor() = default;
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    // Returns 0 after Shutdown
+    TaskId Post(Priority priority, std::function<void()> task, CancellationToken token = {});
+    TaskId PostDelayed(Priority priority, uint32_t delay_ms, std::function<void()> task,
+                       CancellationToken token = {});
+
+    // Drop a task that has not started yet. A task already running on another
+    // thread is waited for; cancelling the running task from inside returns at once.
+    // Returns true if the task will not run (again)
+    bool Cancel(TaskId id);
+
+    // Stop accepting tasks and drop the queued ones without joining any thread
+    // Called at process exit (process_exit.h), waits at most 100 ms for the lock
+    void Shutdown();
+
+private:
+    static constexpr size_t kPriorityCount = 3;
+
+    enum State
+    {
+        kPending,
+        kRunning,
+        kFinished,
+    };
+
+    struct Control
+    {
+        std::atomic<int> state{kPending};
+        std::thread::id runner;
+    };
+
+    struct Task
+    {
+        TaskId id = 0;
+        Priority priority = Priority::kBackground;
+        std::function<void()> run;
+        CancellationToken token;
+        std::shared_ptr<Control> control;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> queues[kPriorityCount];  // Owner pops the front, thieves the back
+        Priority lowest = Priority::kIdleIo;       // Lowest priority this worker takes
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    void StartWorkers();
+    void WorkerMain(size_t index);
+    TaskId Enqueue(Priority priority, Clock::time_point due, std::function<void()> run, CancellationToken token);
+    void PushReady(Task task);
+    bool CanRun(size_t worker, size_t priority) const;
+    bool HasWork(size_t worker) const;
+    bool TakeTask(size_t worker, Task &task);
+    void PromoteDueLocked(Clock::time_point now);
+    void Run(Task &task);
+
+    std::once_flag start_once_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // Guards the injection queues, delayed tasks and task controls
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    std::deque<Task> injected_[kPriorityCount];
+    std::multimap<Clock::time_point, Task> delayed_;
+    std::unordered_map<TaskId, std::shared_ptr<Control>> controls_;
+    TaskId next_id_ = 1;
+    bool stopping_ = false;
+
+    std::atomic<size_t> queued_[kPriorityCount] = {};
+    std::atomic<int> idle_io_running_{0};
+};
+
+// Never destroyed: no destructor may join threads during DLL unload
+Executor &GetExecutor();
+
+// Tasks posted to one sequence run on the shared pool in posting order and
+// never overlap, delayed ones join the queue when they are due
+// Must outlive its tasks
+class Sequence
+{
+public:
+    explicit Sequence(Priority priority) : priority_(priority) {}
+    Sequence(const Sequence &) = delete;
+    Sequence &operator=(const Sequence &) = delete;
+
+    void Post(std::function<void()> task);
+    TaskId PostDelayed(uint32_t delay_ms, std::function<void()> task);
+
+    // Same contract as Executor::Cancel
+    bool Cancel(TaskId id);
+
+private:
+    struct Item
+    {
+        TaskId id = 0;  // 0 for tasks posted without a delay
+        std::function<void()> run;
+    };
+
+    void PushLocked(Item item);
+    void RunNext();
+
+    Priority priority_;
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    std::deque<Item> queue_;
+    bool scheduled_ = false;  // A RunNext task is posted or running
+    TaskId running_ = 0;
+    std::thread::id runner_;
+};
+
+}  // namespace executor
+
+#endif  // VIVALDI_PLUS_EXECUTOR_H_
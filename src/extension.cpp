@@ -0,0 +1,240 @@
+//
+// Extension module (vivaldi_plus_ext.dll), loaded by the core version.dll in
+// the main browser process only. Holds everything child processes never need:
+// config, API hooks, portable mode and the boss key.
+//
+
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include "extension.h"
+#include "hook.h"
+#include "executor.h"
+#include "hook_stats.h"
+#include "logger.h"
+#include "utils.h"
+#include "patch.h"
+#include "portable.h"
+#include "appid.h"
+#include "cache_budget.h"
+#include "dedup.h"
+#include "green.h"
+#include "process_exit.h"
+#include "process_policy.h"
+#include "hotkey.h"
+#include "prefetch.h"
+#include "startup_tasks.h"
+#include "state_store.h"
+#include "startup_trace.h"
+
+// Startup overhead counters of the core DLL in this process
+static const startup_overhead::Counters *core_overhead = nullptr;
+
+// Children are sampled once the browser has settled after startup
+static constexpr DWORD kChildOverheadDelayMs = 60000;
+
+// Deferred tasks start at the latest this long after the extension loads,
+// even if no browser window ever shows (e.g. started in the background)
+static constexpr DWORD kFirstWindowTimeoutMs = 15000;
+
+// Debug log the core's overhead in the live child processes of the browser
+static void LogChildOverhead()
+{
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return;
+
+    LONG64 count = 0, unreadable = 0, frequency = 0;
+    LONG64 attach_total = 0, attach_max = 0, resolve_count = 0, resolve_total = 0;
+    DWORD self_pid = GetCurrentProcessId();
+    PROCESSENTRY32W entry = {sizeof(entry)};
+    for (BOOL more = Process32FirstW(snapshot, &entry); more; more = Process32NextW(snapshot, &entry))
+    {
+        if (entry.th32ParentProcessID != self_pid || entry.th32ProcessID == self_pid)
+            continue;
+
+        startup_overhead::Counters counters;
+        HANDLE process = OpenProcess(PROCESS_VM_READ, FALSE, entry.th32ProcessID);
+        bool read = process && startup_overhead::ReadProcess(process, core_overhead, &counters);
+        if (process)
+            CloseHandle(process);
+        if (!read)
+        {
+            unreadable++;
+            continue;
+        }
+
+        count++;
+        frequency = counters.frequency;
+        attach_total += counters.attach_ticks;
+        if (counters.attach_ticks > attach_max)
+            attach_max = counters.attach_ticks;
+        resolve_count += counters.resolve_count;
+        resolve_total += counters.resolve_ticks;
+    }
+    CloseHandle(snapshot);
+
+    if (count == 0)
+    {
+        DebugLog(L"Child startup overhead: no readable child (%lld skipped)", unreadable);
+        return;
+    }
+
+    DebugLog(L"Child startup overhead: %lld processes (%lld skipped), attach avg %lld us max %lld us, "
+             L"%lld exports resolved in %lld us total",
+             count, unreadable, attach_total * 1000000 / frequency / count, attach_max * 1000000 / frequency,
+             resolve_count, resolve_total * 1000000 / frequency);
+}
+
+// Apply Vivaldi Plus enhancements
+// API hooks are already installed by VivaldiPlusMain at this point
+void VivaldiPlus()
+{
+    startup::Scheduler &scheduler = startup::GetScheduler();
+
+    // Register the boss key hotkeys (if configured in config.ini) once the browser is up
+    scheduler.Add(L"hotkeys", startup::Phase::kDeferred, {}, bosskey::Initialize);
+
+    // Disk cache budget and trash cleanup, low priority after startup
+    if (cache_budget::IsEnabled())
+    {
+        scheduler.Add(L"cache_budget", startup::Phase::kDeferred, {}, cache_budget::OnStartupDone);
+    }
+
+    // Weekly deduplication of read-mostly files across data directories
+    if (dedup::IsEnabled())
+    {
+        scheduler.Add(L"dedup", startup::Phase::kDeferred, {}, dedup::OnStartupDone);
+    }
+
+    // Sample what the core cost the child processes started so far
+    // Checked up front: sampling reads the memory of every child process
+    if (core_overhead && GetConfig().IsDebugLogEnabled())
+    {
+        scheduler.Add(L"child_overhead", startup::Phase::kDeferred, {}, []() {
+            executor::GetExecutor().PostDelayed(executor::Priority::kBackground, kChildOverheadDelayMs,
+                                                LogChildOverhead);
+        });
+    }
+
+    // Write the startup timeline once the rest of the deferred work is done
+    if (startup_trace::IsEnabled())
+    {
+        scheduler.Add(L"startup_trace", startup::Phase::kDeferred, {L"hotkeys"}, startup_trace::Write);
+    }
+}
+
+// Handle command line and decide whether to restart in portable mode
+void VivaldiPlusCommand(LPWSTR param)
+{
+    if (!param)
+        return;
+
+    // Check if already running in portable mode (--gopher flag present)
+    if (!wcsstr(param, L"--gopher"))
+    {
+        // Not in portable mode yet, restart with portable parameters
+        Portable(param);
+    }
+    else
+    {
+        // Already in portable mode, apply enhancements
+        VivaldiPlus();
+    }
+}
+
+// Exit work, from the process exit hooks while the loader lock is still free
+static void OnProcessExit()
+{
+    // Stops delayed tasks from starting, never waits for the workers
+    executor::GetExecutor().Shutdown();
+    cache_budget::OnExit();
+    dedup::OnExit();
+    startup_trace::Write();
+    logger::Flush();
+}
+
+// Called by the core once, before the browser's own entry point runs
+extern "C" __declspec(dllexport) void VivaldiPlusMain(const CoreInfo *core)
+{
+    LONG64 loader_ticks = 0;
+    if (core && core->size >= sizeof(CoreInfo))
+    {
+        core_overhead = core->overhead;
+        loader_ticks = core->loader_ticks;
+    }
+
+    // Log and state files live in the data directory, nothing is read or written yet
+    std::wstring data_dir = GetUserDataDir();
+    logger::Start(data_dir);
+    state_store::Initialize(data_dir);
+    startup_trace::Initialize(loader_ticks);
+
+    LPWSTR param = GetCommandLineW();
+    bool relaunched = param && wcsstr(param, L"--gopher");
+
+    // The profile the browser actually opens: the stub passes the local copy
+    // when [dir_setting] shadow is on, the user may pass a directory too
+    std::wstring profile_dir = GetSwitchValue(L"--user-data-dir");
+    profile_dir = profile_dir.empty() ? data_dir : ResolvePath(profile_dir);
+
+    // Read ahead what the browser read during the last start, the stub already
+    // overlaps this with its relaunch; the browser also records this start
+    prefetch::Start(profile_dir, relaunched);
+
+    hook::Registry &registry = hook::GetRegistry();
+    startup::Scheduler &scheduler = startup::GetScheduler();
+
+    // Both the stub and the relaunched browser flush their log and trace at exit
+    process_exit::AddExitHooks(registry, OnProcessExit);
+
+    // Portable mode hooks are only needed by the relaunched main process
+    if (relaunched)
+    {
+        // Counters must be in place before the first detour runs
+        hook_stats::Publish();
+
+        // Set custom AppUserModelID for Windows taskbar
+        AddAppIdHooks(registry);
+
+        // Apply portable mode registry patches
+        AddGreenHooks(registry);
+
+        // Spawn-time priority, QoS and CPU placement of child processes
+        process_policy::AddProcessPolicyHooks(registry);
+
+        // Learn the startup read set for the next launch
+        prefetch::AddPrefetchHooks(registry);
+
+        // Copy-on-write for hard-linked files, chained after the prefetch recorder
+        dedup::Start(profile_dir);
+        dedup::AddDedupHooks(registry);
+
+        // Before the browser opens its disk cache
+        cache_budget::Start(profile_dir);
+    }
+
+    // Install all hooks in a single Detours transaction
+    // Hooks into modules that are not loaded yet are attached when they load
+    scheduler.Add(L"hooks", startup::Phase::kCritical, {}, [&registry]() { registry.InstallAll(); });
+
+    // Main process: handle portable mode, may relaunch and never return
+    scheduler.Add(L"portable", startup::Phase::kCritical, {L"hooks"}, [param]() { VivaldiPlusCommand(param); });
+
+    scheduler.RunCritical();
+    scheduler.StartDeferred(kFirstWindowTimeoutMs);
+}
+
+// DLL entry point
+extern "C" BOOL WINAPI DllMain(HINSTANCE hModule, DWORD dwReason, LPVOID pv)
+{
+    switch (dwReason)
+    {
+    case DLL_PROCESS_DETACH:
+        // No cleanup needed for Detours
+        // Exit work already ran from OnProcessExit, nothing may block under the loader lock
+        break;
+    }
+
+    return TRUE;
+}
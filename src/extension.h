@@ -0,0 +1,31 @@
+#ifndef VIVALDI_PLUS_EXTENSION_H_
+#define VIVALDI_PLUS_EXTENSION_H_
+
+//
+// Interface between the core version.dll and the extension module.
+// The core only forwards exports and classifies processes; everything else
+// (config, hooks, portable mode, boss key) lives in the extension, which the
+// core loads in the main browser process only.
+//
+
+#include <windows.h>
+
+#include "startup_overhead.h"
+
+// Extension module file name, loaded from the directory of the core DLL
+#define VIVALDI_PLUS_EXTENSION_DLL L"vivaldi_plus_ext.dll"
+
+// Exported by the extension, called once before the browser's entry point runs
+#define VIVALDI_PLUS_EXTENSION_MAIN "VivaldiPlusMain"
+
+struct CoreInfo
+{
+    DWORD size;  // sizeof(CoreInfo), for forward compatibility
+    HMODULE core_module;
+    const startup_overhead::Counters *overhead;  // This process, same address in every child
+    LONG64 loader_ticks;  // QueryPerformanceCounter when Loader took over the entry point
+};
+
+typedef void (*pVivaldiPlusMain)(const CoreInfo *core);
+
+#endif  // VIVALDI_PLUS_EXTENSION_H_
@@ -2,8 +2,10 @@
 #define VIVALDI_PLUS_GREEN_H_
 
 #include <lmaccess.h>
-#include "detours.h"
 #include "config.h"
+#include "dpapi_blob.h"
+#include "hook.h"
+#include "hook_stats.h"
 
 // Anonymous namespace to prevent ODR violations if this header is included in multiple TUs
 namespace {
@@ -12,9 +14,16 @@ inline BOOL WINAPI FakeGetComputerName(
     _Out_ LPTSTR lpBuffer,
     _Inout_ LPDWORD lpnSize)
 {
+    HOOK_STATS_SCOPE(kGetComputerNameW);
     return 0;
 }
 
+typedef BOOL(WINAPI *pGetComputerNameW)(
+    _Out_ LPWSTR lpBuffer,
+    _Inout_ LPDWORD lpnSize);
+
+inline pGetComputerNameW RawGetComputerNameW = nullptr;
+
 // Fixed: Use LPCWSTR instead of LPCTSTR for consistency with GetVolumeInformationW
 typedef BOOL(WINAPI *pGetVolumeInformationW)(
     _In_opt_ LPCWSTR lpRootPathName,
@@ -38,6 +47,7 @@ inline BOOL WINAPI FakeGetVolumeInformation(
     _Out_opt_ LPWSTR lpFileSystemNameBuffer,
     _In_ DWORD nFileSystemNameSize)
 {
+    HOOK_STATS_SCOPE(kGetVolumeInformationW);
     // Fixed: Check for null pointer before calling
     if (!RawGetVolumeInformationW)
     {
@@ -65,9 +75,20 @@ inline BOOL WINAPI MyCryptProtectData(
     _In_ DWORD dwFlags,
     _Out_ DATA_BLOB *pDataOut)
 {
-    pDataOut->cbData = pDataIn->cbData;
-    pDataOut->pbData = (BYTE *)LocalAlloc(LMEM_FIXED, pDataOut->cbData);
-    memcpy(pDataOut->pbData, pDataIn->pbData, pDataOut->cbData);
+    HOOK_STATS_SCOPE(kCryptProtectData);
+    // Keep the data readable on any machine, tagged so unprotect can skip DPAPI
+    size_t size = dpapi_blob::EncodedSize(pDataIn->cbData);
+    BYTE *blob = size ? (BYTE *)LocalAlloc(LMEM_FIXED, size) : nullptr;
+    if (!blob || !dpapi_blob::Encode(pDataIn->pbData, pDataIn->cbData, blob, size))
+    {
+        if (blob)
+            LocalFree(blob);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+
+    pDataOut->cbData = static_cast<DWORD>(size);
+    pDataOut->pbData = blob;
     return true;
 }
 
@@ -93,6 +114,9 @@ typedef BOOL(WINAPI *pCryptUnprotectData)(
 
 inline pCryptUnprotectData RawCryptUnprotectData = nullptr;
 
+// Blobs that were not in the tagged format and went through the real DPAPI
+inline volatile LONG legacy_dpapi_blobs = 0;
+
 inline BOOL WINAPI MyCryptUnprotectData(
     _In_ DATA_BLOB *pDataIn,
     _Out_opt_ LPWSTR *ppszDataDescr,
@@ -102,14 +126,45 @@ inline BOOL WINAPI MyCryptUnprotectData(
     _In_ DWORD dwFlags,
     _Out_ DATA_BLOB *pDataOut)
 {
-    if (RawCryptUnprotectData && RawCryptUnprotectData(pDataIn, ppszDataDescr, pOptionalEntropy, pvReserved, pPromptStruct, dwFlags, pDataOut))
+    HOOK_STATS_SCOPE(kCryptUnprotectData);
+    const BYTE *data = pDataIn->pbData;
+    size_t size = pDataIn->cbData;
+
+    switch (dpapi_blob::Decode(pDataIn->pbData, pDataIn->cbData, &data, &size))
     {
-        return true;
+    case dpapi_blob::DecodeResult::kOk:
+        // Written by MyCryptProtectData, DPAPI is not involved at all
+        if (ppszDataDescr)
+            *ppszDataDescr = nullptr;
+        break;
+
+    case dpapi_blob::DecodeResult::kNotTagged:
+        {
+            // Legacy blob: real DPAPI data from before portable mode, or an untagged
+            // copy made by older builds. Try DPAPI once, fall back to a plain copy
+            LONG count = InterlockedIncrement(&legacy_dpapi_blobs);
+            DebugLog(L"Legacy DPAPI blob #%ld (%lu bytes)", count, pDataIn->cbData);
+
+            if (RawCryptUnprotectData && RawCryptUnprotectData(pDataIn, ppszDataDescr, pOptionalEntropy, pvReserved, pPromptStruct, dwFlags, pDataOut))
+            {
+                return true;
+            }
+        }
+        break;
+
+    default:
+        SetLastError(ERROR_INVALID_DATA);
+        return false;
     }
 
-    pDataOut->cbData = pDataIn->cbData;
-    pDataOut->pbData = (BYTE *)LocalAlloc(LMEM_FIXED, pDataOut->cbData);
-    memcpy(pDataOut->pbData, pDataIn->pbData, pDataOut->cbData);
+    pDataOut->cbData = static_cast<DWORD>(size);
+    pDataOut->pbData = (BYTE *)LocalAlloc(LMEM_FIXED, size ? size : 1);
+    if (!pDataOut->pbData)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+    memcpy(pDataOut->pbData, data, size);
     return true;
 }
 
@@ -131,6 +186,7 @@ inline BOOL WINAPI MyLogonUserW(
     DWORD dwLogonProvider,
     PHANDLE phToken)
 {
+    HOOK_STATS_SCOPE(kLogonUserW);
     BOOL ret = RawLogonUserW(lpszUsername, lpszDomain, lpszPassword, dwLogonType, dwLogonProvider, phToken);
 
     SetLastError(ERROR_ACCOUNT_RESTRICTION);
@@ -144,6 +200,7 @@ inline pIsOS RawIsOS = nullptr;
 inline BOOL WINAPI MyIsOS(
     DWORD dwOS)
 {
+    HOOK_STATS_SCOPE(kIsOS);
     DWORD ret = RawIsOS(dwOS);
     if (dwOS == OS_DOMAINMEMBER)
     {
@@ -167,6 +224,7 @@ inline NET_API_STATUS WINAPI MyNetUserGetInfo(
     DWORD level,
     LPBYTE *bufptr)
 {
+    HOOK_STATS_SCOPE(kNetUserGetInfo);
     // DebugLog(L"MyNetUserGetInfo %s", username);
 
     NET_API_STATUS ret = RawNetUserGetInfo(servername, username, level, bufptr);
@@ -215,6 +273,7 @@ inline BOOL WINAPI MyUpdateProcThreadAttribute(
     __out_bcount_opt(cbSize) PVOID lpPreviousValue,
     __in_opt PSIZE_T lpReturnSize)
 {
+    HOOK_STATS_SCOPE(kUpdateProcThreadAttribute);
     if (Attribute == PROC_THREAD_ATTRIBUTE_MITIGATION_POLICY && cbSize >= sizeof(DWORD64))
     {
         // https://source.chromium.org/chromium/chromium/src/+/main:sandbox/win/src/process_mitigations.cc;l=362;drc=4c2fec5f6699ffeefd93137d2bf8c03504c6664c
@@ -240,41 +299,29 @@ inline BOOL WINAPI MyUpdateProcThreadAttribute(
     return RawUpdateProcThreadAttribute(lpAttributeList, dwFlags, Attribute, lpValue, cbSize, lpPreviousValue, lpReturnSize);
 }
 
-inline void MakeGreen()
+// Register hooks for portable mode support
+// GetComputerNameW and GetVolumeInformationW only redirect calls made by
+// vivaldi.exe/vivaldi.dll; other modules in the browser process see the real values
+inline void AddGreenHooks(hook::Registry &registry)
 {
-    // Initialize function pointers with original API addresses
-    auto RawGetComputerNameW = GetComputerNameW;
-    RawGetVolumeInformationW = GetVolumeInformationW;
-    RawUpdateProcThreadAttribute = UpdateProcThreadAttribute;
-    RawCryptProtectData = CryptProtectData;
-    RawCryptUnprotectData = CryptUnprotectData;
-    RawLogonUserW = LogonUserW;
-    RawIsOS = IsOS;
-    RawNetUserGetInfo = NetUserGetInfo;
-
-    // Begin Detours transaction to install all hooks atomically
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-
-    // Attach hooks for portable mode support
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawGetComputerNameW), reinterpret_cast<void*>(FakeGetComputerName));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawGetVolumeInformationW), reinterpret_cast<void*>(FakeGetVolumeInformation));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawUpdateProcThreadAttribute), reinterpret_cast<void*>(MyUpdateProcThreadAttribute));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawCryptProtectData), reinterpret_cast<void*>(MyCryptProtectData));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawCryptUnprotectData), reinterpret_cast<void*>(MyCryptUnprotectData));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawLogonUserW), reinterpret_cast<void*>(MyLogonUserW));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawIsOS), reinterpret_cast<void*>(MyIsOS));
-    DetourAttach(reinterpret_cast<LPVOID*>(&RawNetUserGetInfo), reinterpret_cast<void*>(MyNetUserGetInfo));
-
-    // Commit all hooks in one transaction
-    LONG status = DetourTransactionCommit();
-    if (status != NO_ERROR)
-    {
-        if (GetConfig().IsDebugLogEnabled())
-        {
-            DebugLog(L"MakeGreen DetourTransactionCommit failed: %d", status);
-        }
-    }
+    registry.Add({L"GetComputerNameW", L"kernel32.dll", "GetComputerNameW", nullptr,
+                  reinterpret_cast<void **>(&RawGetComputerNameW), reinterpret_cast<void *>(FakeGetComputerName), nullptr,
+                  hook::kBrowserImporters});
+    registry.Add({L"GetVolumeInformationW", L"kernel32.dll", "GetVolumeInformationW", nullptr,
+                  reinterpret_cast<void **>(&RawGetVolumeInformationW), reinterpret_cast<void *>(FakeGetVolumeInformation), nullptr,
+                  hook::kBrowserImporters});
+    registry.Add({L"UpdateProcThreadAttribute", L"kernel32.dll", "UpdateProcThreadAttribute", nullptr,
+                  reinterpret_cast<void **>(&RawUpdateProcThreadAttribute), reinterpret_cast<void *>(MyUpdateProcThreadAttribute), nullptr});
+    registry.Add({L"CryptProtectData", L"crypt32.dll", "CryptProtectData", nullptr,
+                  reinterpret_cast<void **>(&RawCryptProtectData), reinterpret_cast<void *>(MyCryptProtectData), nullptr});
+    registry.Add({L"CryptUnprotectData", L"crypt32.dll", "CryptUnprotectData", nullptr,
+                  reinterpret_cast<void **>(&RawCryptUnprotectData), reinterpret_cast<void *>(MyCryptUnprotectData), nullptr});
+    registry.Add({L"LogonUserW", L"advapi32.dll", "LogonUserW", nullptr,
+                  reinterpret_cast<void **>(&RawLogonUserW), reinterpret_cast<void *>(MyLogonUserW), nullptr});
+    registry.Add({L"IsOS", L"shlwapi.dll", "IsOS", nullptr,
+                  reinterpret_cast<void **>(&RawIsOS), reinterpret_cast<void *>(MyIsOS), nullptr});
+    registry.Add({L"NetUserGetInfo", L"netapi32.dll", "NetUserGetInfo", nullptr,
+                  reinterpret_cast<void **>(&RawNetUserGetInfo), reinterpret_cast<void *>(MyNetUserGetInfo), nullptr});
 }
 
 }  // anonymous namespace
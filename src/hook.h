@@ -0,0 +1,502 @@
+#ifndef VIVALDI_PLUS_HOOK_H_
+#define VIVALDI_PLUS_HOOK_H_
+
+#include <windows.h>
+
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "detours.h"
+#include "config.h"
+#include "utils.h"
+
+namespace hook
+{
+
+// Declarative description of one API hook
+struct HookSpec
+{
+    const wchar_t *name;    // Switch name in the [hooks] config section, nullptr = not switchable
+    const wchar_t *module;  // Module owning the target function
+    const char *proc;       // Export resolved once `module` is loaded, used when target is nullptr
+    void *target;           // Function to hook, nullptr = resolve `proc` lazily
+    void **original;        // Receives the trampoline used to call the original function
+    void *detour;           // Replacement function
+    bool (*condition)();    // Optional extra enable condition, nullptr = always
+
+    // IAT backend: nullptr-terminated list of importing modules whose import
+    // address table entry for `proc` is patched, nullptr = Detours backend
+    const wchar_t *const *importers = nullptr;
+};
+
+// Browser modules, for hooks that only need to see calls made by browser code
+inline constexpr const wchar_t *kBrowserImporters[] = {L"vivaldi.exe", L"vivaldi.dll", nullptr};
+
+// Collects hooks from all features and installs them in a single Detours transaction,
+// so threads are suspended and code pages re-protected only once on the startup path.
+// Hooks whose module is not loaded yet stay pending and are attached from a loader
+// notification when the module shows up, so we never load a DLL just to hook it.
+//
+// Hooks with `importers` use the IAT backend instead: only calls made by those
+// modules are redirected, at the cost of one pointer write per import and no
+// thread suspension or trampoline. Importers loaded later are patched from the
+// same loader notification. Delay-load imports are not covered. Several IAT
+// hooks on one import are chained in the order they were added.
+//
+// Lock order: the loader lock, then mutex_. The loader notification already
+// holds the loader lock when it takes mutex_, so InstallAll takes the loader
+// lock first: resolving targets may enter the loader with mutex_ held.
+class Registry
+{
+public:
+    void Add(const HookSpec &spec)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (spec.importers)
+        {
+            iat_hooks_.push_back(spec);
+        }
+        else
+        {
+            pending_.push_back(spec);
+        }
+    }
+
+    // Install all enabled hooks whose module is already loaded, atomically
+    // Returns the DetourTransactionCommit status
+    LONG InstallAll()
+    {
+        LoaderLock loader_lock;
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        // Drop disabled IAT hooks once, they are kept for later importers
+        std::erase_if(iat_hooks_, [this](const HookSpec &hook) { return !IsEnabled(hook); });
+
+        // Start watching before the first pass, so a module loaded by another
+        // thread in between is not missed (the callback waits for mutex_)
+        bool watch = !iat_hooks_.empty();
+        for (const auto &hook : pending_)
+        {
+            watch = watch || !hook.target;
+        }
+        if (watch)
+        {
+            WatchModuleLoads();
+        }
+
+        PatchImportsLocked(nullptr, nullptr);
+        return AttachPendingLocked(nullptr, nullptr);
+    }
+
+private:
+    // Mirrors LDR_DLL_NOTIFICATION_DATA (loaded and unloaded variants share the layout)
+    struct NtUnicodeString
+    {
+        USHORT Length;
+        USHORT MaximumLength;
+        PWSTR Buffer;
+    };
+
+    struct DllNotificationData
+    {
+        ULONG Flags;
+        const NtUnicodeString *FullDllName;
+        const NtUnicodeString *BaseDllName;
+        PVOID DllBase;
+        ULONG SizeOfImage;
+    };
+
+    typedef VOID(CALLBACK *pDllNotification)(ULONG reason, const DllNotificationData *data, PVOID context);
+    typedef LONG(NTAPI *pLdrRegisterDllNotification)(ULONG flags, pDllNotification callback, PVOID context,
+                                                       PVOID *cookie);
+
+    typedef LONG(NTAPI *pLdrLockLoaderLock)(ULONG flags, PULONG state, PULONG_PTR cookie);
+    typedef LONG(NTAPI *pLdrUnlockLoaderLock)(ULONG flags, ULONG_PTR cookie);
+
+    static constexpr ULONG kDllNotificationLoaded = 1;
+
+    // Holds the loader lock for the lifetime of the object (recursive, so it is
+    // also fine on a thread that already owns it)
+    class LoaderLock
+    {
+    public:
+        LoaderLock()
+        {
+            HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+            auto lock = reinterpret_cast<pLdrLockLoaderLock>(GetProcAddress(ntdll, "LdrLockLoaderLock"));
+            unlock_ = reinterpret_cast<pLdrUnlockLoaderLock>(GetProcAddress(ntdll, "LdrUnlockLoaderLock"));
+            ULONG state = 0;
+            if (!lock || !unlock_ || lock(0, &state, &cookie_) < 0)
+            {
+                unlock_ = nullptr;
+            }
+        }
+
+        LoaderLock(const LoaderLock &) = delete;
+        LoaderLock &operator=(const LoaderLock &) = delete;
+
+        ~LoaderLock()
+        {
+            if (unlock_)
+            {
+                unlock_(0, cookie_);
+            }
+        }
+
+    private:
+        pLdrUnlockLoaderLock unlock_ = nullptr;
+        ULONG_PTR cookie_ = 0;
+    };
+
+    bool IsEnabled(const HookSpec &hook) const
+    {
+        if ((!hook.target && !hook.proc) || !hook.original || !hook.detour)
+            return false;
+        if (hook.importers && !hook.proc)
+            return false;
+        if (hook.name && !GetConfig().IsHookEnabled(hook.name))
+            return false;
+        return !hook.condition || hook.condition();
+    }
+
+    static bool IsModule(const wchar_t *module, const NtUnicodeString *name)
+    {
+        size_t length = name->Length / sizeof(wchar_t);
+        return module && wcslen(module) == length && _wcsnicmp(module, name->Buffer, length) == 0;
+    }
+
+    static bool IsModule(const HookSpec &hook, const NtUnicodeString *name)
+    {
+        return IsModule(hook.module, name);
+    }
+
+    // API set contracts (api-ms-*, ext-ms-*) resolve to some host module at load time
+    static bool IsApiSet(const char *import_name)
+    {
+        return _strnicmp(import_name, "api-ms-", 7) == 0 || _strnicmp(import_name, "ext-ms-", 7) == 0;
+    }
+
+    // Import descriptor names are ANSI, `module` is ASCII
+    static bool IsImportOf(const char *import_name, const wchar_t *module)
+    {
+        for (; *import_name && *module; import_name++, module++)
+        {
+            if (towlower(static_cast<unsigned char>(*import_name)) != towlower(*module))
+                return false;
+        }
+        return *import_name == 0 && *module == 0;
+    }
+
+    // Position of the IAT hook on `proc` whose detour is `address`, SIZE_MAX if none
+    size_t FindDetour(const char *proc, const void *address) const
+    {
+        for (size_t i = 0; i < iat_hooks_.size(); i++)
+        {
+            if (iat_hooks_[i].detour == address && strcmp(iat_hooks_[i].proc, proc) == 0)
+                return i;
+        }
+        return SIZE_MAX;
+    }
+
+    // Point the IAT entries of `base` that import hook.proc at the detour
+    // Returns the number of entries written
+    size_t PatchImport(const HookSpec &hook, PBYTE base)
+    {
+        auto dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(base);
+        auto nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS>(base + dos_header->e_lfanew);
+        if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || nt_headers->Signature != IMAGE_NT_SIGNATURE)
+            return 0;
+
+        const IMAGE_DATA_DIRECTORY &directory = nt_headers->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+        if (directory.VirtualAddress == 0)
+            return 0;
+
+        // What hook.module exports under hook.proc, forwarders followed
+        HMODULE owner = GetModuleHandleW(hook.module);
+        void *target = owner ? reinterpret_cast<void *>(GetProcAddress(owner, hook.proc)) : nullptr;
+
+        size_t patched = 0;
+        auto descriptor = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(base + directory.VirtualAddress);
+        for (; descriptor->Name; descriptor++)
+        {
+            // Without the name table there is nothing to match against
+            if (!descriptor->OriginalFirstThunk)
+                continue;
+
+            // An API set import is only ours if it was bound to the same function
+            const char *import_name = reinterpret_cast<const char *>(base + descriptor->Name);
+            bool api_set = IsApiSet(import_name);
+            if (!api_set && !IsImportOf(import_name, hook.module))
+                continue;
+            if (api_set && !target)
+                continue;
+
+            auto names = reinterpret_cast<PIMAGE_THUNK_DATA>(base + descriptor->OriginalFirstThunk);
+            auto slots = reinterpret_cast<PIMAGE_THUNK_DATA>(base + descriptor->FirstThunk);
+            for (; names->u1.AddressOfData; names++, slots++)
+            {
+                if (IMAGE_SNAP_BY_ORDINAL(names->u1.Ordinal))
+                    continue;
+
+                auto by_name = reinterpret_cast<PIMAGE_IMPORT_BY_NAME>(base + names->u1.AddressOfData);
+                if (strcmp(reinterpret_cast<const char *>(by_name->Name), hook.proc) != 0)
+                    continue;
+
+                // Skip entries already leading to this hook, directly or through one chained after it
+                void **slot = reinterpret_cast<void **>(&slots->u1.Function);
+                size_t current = FindDetour(hook.proc, *slot);
+                if (current != SIZE_MAX && current >= FindDetour(hook.proc, hook.detour))
+                    continue;
+
+                // Same name from another API set host (e.g. kernelbase for a
+                // function kernel32 implements itself) is a different function
+                if (api_set && current == SIZE_MAX && *slot != target)
+                    continue;
+
+                // The loader snaps imports before reporting the module; an entry
+                // still holding its name RVA would be overwritten afterwards
+                if (slots->u1.Function == names->u1.AddressOfData)
+                {
+                    DebugLog(L"Import %S not bound yet, skipped", hook.proc);
+                    continue;
+                }
+
+                // Callers through the detour need the original before the first redirected call
+                // An import already redirected by an earlier hook is chained through its detour
+                if (!*hook.original)
+                {
+                    *hook.original = target && current == SIZE_MAX ? target : *slot;
+                }
+
+                DWORD protect = 0;
+                if (!VirtualProtect(slot, sizeof(void *), PAGE_READWRITE, &protect))
+                    continue;
+                InterlockedExchangePointer(slot, hook.detour);
+                VirtualProtect(slot, sizeof(void *), protect, &protect);
+                patched++;
+            }
+        }
+        return patched;
+    }
+
+    // Patch every IAT hook into its importers that are loaded
+    // loaded_name/loaded_base limit the pass to a module reported by the loader notification
+    // Caller holds mutex_
+    void PatchImportsLocked(const NtUnicodeString *loaded_name, PVOID loaded_base)
+    {
+        if (iat_hooks_.empty())
+            return;
+
+        LARGE_INTEGER start, end, frequency;
+        QueryPerformanceCounter(&start);
+
+        size_t patched = 0;
+        for (const auto &hook : iat_hooks_)
+        {
+            for (const wchar_t *const *importer = hook.importers; *importer; importer++)
+            {
+                PVOID base = nullptr;
+                if (!loaded_name)
+                {
+                    base = GetModuleHandleW(*importer);
+                }
+                else if (IsModule(*importer, loaded_name))
+                {
+                    base = loaded_base;
+                }
+
+                if (base)
+                {
+                    patched += PatchImport(hook, static_cast<PBYTE>(base));
+                }
+            }
+        }
+
+        QueryPerformanceCounter(&end);
+        QueryPerformanceFrequency(&frequency);
+        if (patched)
+        {
+            std::wstring_view trigger = loaded_name ? std::wstring_view(loaded_name->Buffer,
+                                                                        loaded_name->Length / sizeof(wchar_t))
+                                                    : std::wstring_view(L"startup");
+            DebugLog(L"Hook registry IAT (%s): %zu imports patched, %lld us", trigger, patched,
+                     (end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart);
+        }
+    }
+
+    // Find the address to hook, nullptr if the owning module is not loaded yet
+    // loaded_name/loaded_base describe a module reported by the loader notification
+    static void *ResolveTarget(const HookSpec &hook, const NtUnicodeString *loaded_name, PVOID loaded_base)
+    {
+        if (hook.target)
+            return hook.target;
+
+        HMODULE module = nullptr;
+        if (loaded_name && IsModule(hook, loaded_name))
+        {
+            module = static_cast<HMODULE>(loaded_base);
+        }
+        else if (!loaded_name)
+        {
+            module = GetModuleHandleW(hook.module);
+        }
+        return module ? reinterpret_cast<void *>(GetProcAddress(module, hook.proc)) : nullptr;
+    }
+
+    // Attach every pending hook whose target can be resolved in one transaction
+    // Caller holds mutex_
+    LONG AttachPendingLocked(const NtUnicodeString *loaded_name, PVOID loaded_base)
+    {
+        LARGE_INTEGER start, end, frequency;
+        QueryPerformanceCounter(&start);
+
+        std::vector<std::pair<HookSpec, void *>> ready;
+        size_t skipped = 0;
+        const NtUnicodeString *name = loaded_name;
+        PVOID base = loaded_base;
+        for (;;)
+        {
+            // Work on a private copy: resolving a forwarded export may load another
+            // module and re-enter OnDllNotification on this thread
+            uint64_t loads = module_loads_;
+            std::vector<HookSpec> candidates;
+            candidates.swap(pending_);
+
+            for (const auto &hook : candidates)
+            {
+                if (!IsEnabled(hook))
+                {
+                    skipped++;
+                    continue;
+                }
+
+                void *target = ResolveTarget(hook, name, base);
+                if (target)
+                {
+                    ready.emplace_back(hook, target);
+                }
+                else if (name ? IsModule(hook, name) : GetModuleHandleW(hook.module) != nullptr)
+                {
+                    // Module is loaded but does not export the target
+                    DebugLog(L"Hook target %s!%S not found", hook.module, hook.proc);
+                    skipped++;
+                }
+                else
+                {
+                    // Wait for the module to be loaded
+                    pending_.push_back(hook);
+                }
+            }
+
+            // A module loaded during this pass was announced while the hooks
+            // waiting for it were still in `candidates`, so the notification
+            // found nothing to do. Look the re-queued hooks up by name again
+            if (module_loads_ == loads || pending_.empty())
+                break;
+            name = nullptr;
+            base = nullptr;
+        }
+
+        if (ready.empty())
+            return NO_ERROR;
+
+        DetourTransactionBegin();
+        DetourUpdateThread(GetCurrentThread());
+
+        size_t attached = 0;
+        for (const auto &[hook, target] : ready)
+        {
+            *hook.original = target;
+            LONG status = DetourAttach(hook.original, hook.detour);
+            if (status != NO_ERROR)
+            {
+                WarningLog(L"DetourAttach %s!%s failed: %d", hook.module, hook.name ? hook.name : L"?", status);
+                continue;
+            }
+            attached++;
+        }
+
+        LONG status = DetourTransactionCommit();
+
+        QueryPerformanceCounter(&end);
+        QueryPerformanceFrequency(&frequency);
+        std::wstring_view trigger = loaded_name ? std::wstring_view(loaded_name->Buffer,
+                                                                    loaded_name->Length / sizeof(wchar_t))
+                                                : std::wstring_view(L"startup");
+        DebugLog(L"Hook registry (%s): %zu/%zu hooks, %zu skipped, %zu pending, commit status %d, %lld us", trigger,
+                 attached, ready.size(), skipped, pending_.size(), status,
+                 (end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart);
+        return status;
+    }
+
+    // Attach the remaining hooks when their modules get loaded
+    // The notification stays registered for the lifetime of the process
+    void WatchModuleLoads()
+    {
+        if (cookie_)
+            return;
+
+        auto ldr_register = reinterpret_cast<pLdrRegisterDllNotification>(
+            GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "LdrRegisterDllNotification"));
+        if (!ldr_register)
+            return;
+
+        LONG status = ldr_register(0, OnDllNotification, this, &cookie_);
+        if (status < 0)
+        {
+            WarningLog(L"LdrRegisterDllNotification failed: 0x%08X", status);
+        }
+    }
+
+    // Runs under the loader lock, before the new module's DllMain
+    static VOID CALLBACK OnDllNotification(ULONG reason, const DllNotificationData *data, PVOID context)
+    {
+        if (reason != kDllNotificationLoaded || !data || !data->BaseDllName)
+            return;
+
+        auto *registry = static_cast<Registry *>(context);
+        std::lock_guard<std::recursive_mutex> lock(registry->mutex_);
+        registry->module_loads_++;
+        for (const auto &hook : registry->iat_hooks_)
+        {
+            bool importer = false;
+            for (const wchar_t *const *name = hook.importers; *name && !importer; name++)
+            {
+                importer = IsModule(*name, data->BaseDllName);
+            }
+            if (importer)
+            {
+                registry->PatchImportsLocked(data->BaseDllName, data->DllBase);
+                break;
+            }
+        }
+
+        for (const auto &hook : registry->pending_)
+        {
+            if (!hook.target && IsModule(hook, data->BaseDllName))
+            {
+                registry->AttachPendingLocked(data->BaseDllName, data->DllBase);
+                return;
+            }
+        }
+    }
+
+    std::recursive_mutex mutex_;
+    std::vector<HookSpec> pending_;
+    std::vector<HookSpec> iat_hooks_;  // Kept for the lifetime of the process
+    uint64_t module_loads_ = 0;        // Load notifications seen, under mutex_
+    PVOID cookie_ = nullptr;
+};
+
+// Process-wide registry, pending hooks must outlive Loader
+inline Registry &GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+}  // namespace hook
+
+#endif  // VIVALDI_PLUS_HOOK_H_
@@ -0,0 +1,190 @@
+#ifndef VIVALDI_PLUS_HOOK_STATS_H_
+#define VIVALDI_PLUS_HOOK_STATS_H_
+
+//
+// Per-hook call counters and latency histograms.
+// The main browser process publishes them in a named shared memory section,
+// tools/hookstats dumps it as text. Counters are relaxed atomics, recording is
+// compiled out unless VIVALDI_PLUS_HOOK_STATS is defined (xmake option hook_stats).
+// The section layout is shared with the reader. New ids are appended and
+// the reader sizes the section by its count field; bump kVersion when
+// existing ids move or Counters changes.
+//
+
+#include <windows.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <bit>
+
+namespace hook_stats
+{
+
+enum Id : uint32_t
+{
+    kGetComputerNameW,
+    kGetVolumeInformationW,
+    kUpdateProcThreadAttribute,
+    kCryptProtectData,
+    kCryptUnprotectData,
+    kLogonUserW,
+    kIsOS,
+    kNetUserGetInfo,
+    kPSStringFromPropertyKey,
+    kCreateProcessW,
+    kCreateProcessAsUserW,
+    kCreateFileW,
+    kCreateFileWCopyOnWrite,
+    kCreateFile2CopyOnWrite,
+    kCopyFileCopyOnWrite,
+    kCount,
+};
+
+inline constexpr const char *kNames[kCount] = {
+    "GetComputerNameW",
+    "GetVolumeInformationW",
+    "UpdateProcThreadAttribute",
+    "CryptProtectData",
+    "CryptUnprotectData",
+    "LogonUserW",
+    "IsOS",
+    "NetUserGetInfo",
+    "PSStringFromPropertyKey",
+    "CreateProcessW",
+    "CreateProcessAsUserW",
+    "CreateFileW",
+    "CreateFileW (copy-on-write)",
+    "CreateFile2 (copy-on-write)",
+    "CopyFile (copy-on-write)",
+};
+
+constexpr uint32_t kMagic = 0x53485056;  // "VPHS"
+constexpr uint32_t kVersion = 2;  // 2: reader sizes the section by count
+
+// Bucket 0 holds 0 ns, bucket i holds [2^(i-1), 2^i) ns, the last one everything above
+constexpr int kBuckets = 32;
+
+struct Counters
+{
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> buckets[kBuckets];
+};
+
+struct Section
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;  // Number of entries in hooks, kCount of the writer
+    uint32_t reserved;
+    Counters hooks[kCount];
+};
+
+// Bytes of a section holding `count` entries
+constexpr size_t SectionSize(uint32_t count)
+{
+    return offsetof(Section, hooks) + static_cast<size_t>(count) * sizeof(Counters);
+}
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "counters live in shared memory");
+
+// One section per browser instance, named after the main process id
+inline void SectionName(wchar_t *buffer, size_t size, DWORD pid)
+{
+    swprintf(buffer, size, L"Local\\VivaldiPlusHookStats.%lu", pid);
+}
+
+inline int BucketOf(uint64_t ns)
+{
+    int bucket = std::bit_width(ns);
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+#if defined(VIVALDI_PLUS_HOOK_STATS)
+
+// Published section, nullptr until Publish() succeeds
+inline Section *section = nullptr;
+
+// Create the shared section for this process; call once before hooks are installed
+inline void Publish()
+{
+    wchar_t name[64];
+    SectionName(name, ARRAYSIZE(name), GetCurrentProcessId());
+
+    // The mapping handle is kept open for the lifetime of the process
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Section), name);
+    if (!mapping)
+        return;
+
+    // Pages of a new mapping are zeroed, which is a valid state for every counter
+    auto *view = static_cast<Section *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(Section)));
+    if (!view)
+    {
+        CloseHandle(mapping);
+        return;
+    }
+    view->version = kVersion;
+    view->count = kCount;
+    view->magic = kMagic;
+    section = view;
+}
+
+inline uint64_t NowNs()
+{
+    static const LONG64 frequency = []() {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }();
+
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return static_cast<uint64_t>(ticks.QuadPart / frequency * 1000000000 +
+                                 ticks.QuadPart % frequency * 1000000000 / frequency);
+}
+
+// Times the enclosing detour, original call included
+class Scope
+{
+public:
+    explicit Scope(Id id) : id_(id), start_(section ? NowNs() : 0)
+    {
+    }
+
+    ~Scope()
+    {
+        if (!section)
+            return;
+
+        uint64_t elapsed = NowNs() - start_;
+        Counters &counters = section->hooks[id_];
+        counters.calls.fetch_add(1, std::memory_order_relaxed);
+        counters.total_ns.fetch_add(elapsed, std::memory_order_relaxed);
+        counters.buckets[BucketOf(elapsed)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    Id id_;
+    uint64_t start_;
+};
+
+#define HOOK_STATS_SCOPE(id) hook_stats::Scope hook_stats_scope(hook_stats::id)
+
+#else
+
+inline void Publish()
+{
+}
+
+#define HOOK_STATS_SCOPE(id) ((void)0)
+
+#endif  // VIVALDI_PLUS_HOOK_STATS
+
+}  // namespace hook_stats
+
+#endif  // VIVALDI_PLUS_HOOK_STATS_H_
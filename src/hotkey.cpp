@@ -4,18 +4,20 @@
 #include <audiopolicy.h>
 #include <endpointvolume.h>
 #include <mmdeviceapi.h>
+#include <psapi.h>
 #include <tlhelp32.h>
 #include <wrl/client.h>
 
-#include <algorithm>
-#include <atomic>
-#include <mutex>
+#include <iterator>
+#include <memory>
 #include <thread>
-#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "bosskey.h"
 #include "config.h"
+#include "executor.h"
+#include "process_util.h"
 #include "utils.h"
 
 using Microsoft::WRL::ComPtr;
@@ -24,72 +26,20 @@ namespace bosskey {
 
 namespace {
 
-using HotkeyAction = void (*)();
+using HotkeyAction = void (BossKey::*)();
 
-// Delayed unmute retry configuration
-constexpr UINT UNMUTE_RETRY_DELAY_MS = 500;
+// ====================================================================================
+// Win32 window backend
+// ====================================================================================
 
-// PID cache to avoid frequent process enumeration
-constexpr ULONGLONG PID_CACHE_DURATION_MS = 5000;  // 5 seconds
-
-// Lazy-initialized state variables (only created when bosskey is actually used)
-struct BossKeyState {
-    std::atomic<bool> is_hide{false};
-    std::vector<HWND> hwnd_list;
-    std::unordered_map<std::wstring, bool> original_mute_states;
-    std::atomic<bool> has_unmuted_sessions{false};
-    std::mutex audio_state_mutex;
-    HANDLE unmute_retry_timer{nullptr};
-    std::mutex timer_mutex;
-};
-
-// Get singleton state instance (lazy initialization)
-BossKeyState& GetState() {
-    static BossKeyState state;
-    return state;
-}
-
-class ProcessCache {
-public:
-    std::vector<DWORD> GetPids() {
-        ULONGLONG current_time = GetTickCount64();
-
-        // Use lock to ensure thread-safe access
-        std::lock_guard<std::mutex> lock(cache_mutex_);
-
-        // Update cache if expired or empty
-        if (cached_pids_.empty() ||
-            (current_time - last_update_time_) > PID_CACHE_DURATION_MS) {
-            cached_pids_ = GetAppPidsInternal();
-            last_update_time_ = current_time;
-        }
-
-        return cached_pids_;
-    }
-
-    // Force refresh cache (call when process state might have changed)
-    void InvalidateCache() {
-        std::lock_guard<std::mutex> lock(cache_mutex_);
-        cached_pids_.clear();
-        last_update_time_ = 0;
-    }
-
-private:
-    std::vector<DWORD> GetAppPidsInternal();
-
-    std::vector<DWORD> cached_pids_;
-    ULONGLONG last_update_time_ = 0;
-    std::mutex cache_mutex_;
+struct WindowSearch {
+  DWORD owner;
+  std::vector<WindowHandle> windows;
 };
 
-// Get PID cache instance (lazy initialization)
-ProcessCache& GetProcessCache() {
-    static ProcessCache cache;
-    return cache;
-}
-
 // Search for Vivaldi browser windows
 BOOL CALLBACK SearchVivaldiWindow(HWND hwnd, LPARAM lparam) {
+  auto* search = reinterpret_cast<WindowSearch*>(lparam);
   if (IsWindowVisible(hwnd)) {
     wchar_t class_name[256];
     GetClassNameW(hwnd, class_name, 255);
@@ -98,52 +48,178 @@ BOOL CALLBACK SearchVivaldiWindow(HWND hwnd, LPARAM lparam) {
     if (wcscmp(class_name, L"Chrome_WidgetWin_1") == 0) {
       DWORD pid;
       GetWindowThreadProcessId(hwnd, &pid);
-      if (pid == GetCurrentProcessId()) {
+      if (pid == search->owner) {
         ShowWindow(hwnd, SW_HIDE);
-        GetState().hwnd_list.emplace_back(hwnd);
+        search->windows.emplace_back(reinterpret_cast<WindowHandle>(hwnd));
       }
     }
   }
   return true;
 }
 
-// Internal implementation for getting all PIDs of current application
-std::vector<DWORD> ProcessCache::GetAppPidsInternal() {
-  std::vector<DWORD> pids;
-  wchar_t current_exe_path[MAX_PATH];
-  GetModuleFileNameW(nullptr, current_exe_path, MAX_PATH);
-
-  wchar_t* exe_name = wcsrchr(current_exe_path, L'\\');
-  if (exe_name) {
-    ++exe_name;
-  } else {
-    exe_name = current_exe_path;
+class Win32WindowBackend : public WindowBackend {
+ public:
+  std::vector<WindowHandle> HideBrowserWindows(ProcessId owner) override {
+    WindowSearch search{owner, {}};
+    EnumWindows(SearchVivaldiWindow, reinterpret_cast<LPARAM>(&search));
+    return std::move(search.windows);
   }
 
-  HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-  if (snapshot == INVALID_HANDLE_VALUE) {
-    return pids;
+  void RestoreWindow(WindowHandle window) override {
+    HWND hwnd = reinterpret_cast<HWND>(window);
+    ShowWindow(hwnd, SW_SHOW);
+    SetWindowPos(hwnd, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
+    SetForegroundWindow(hwnd);
+    SetWindowPos(hwnd, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
+    SetActiveWindow(hwnd);
   }
+};
 
-  PROCESSENTRY32W pe32;
-  pe32.dwSize = sizeof(PROCESSENTRY32W);
+// ====================================================================================
+// Win32 process backend
+// ====================================================================================
+
+typedef LONG(NTAPI *pNtSuspendProcess)(HANDLE ProcessHandle);
+typedef LONG(NTAPI *pNtResumeProcess)(HANDLE ProcessHandle);
+typedef BOOL(WINAPI *pSetProcessInformation)(HANDLE hProcess,
+                                             PROCESS_INFORMATION_CLASS ProcessInformationClass,
+                                             LPVOID ProcessInformation,
+                                             DWORD ProcessInformationSize);
+
+// Resolved dynamically: not exported on every supported Windows version
+pNtSuspendProcess GetNtSuspendProcess() {
+  static const auto fn = reinterpret_cast<pNtSuspendProcess>(
+      GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSuspendProcess"));
+  return fn;
+}
 
-  if (Process32FirstW(snapshot, &pe32)) {
-    do {
-      if (_wcsicmp(pe32.szExeFile, exe_name) == 0) {
-        pids.emplace_back(pe32.th32ProcessID);
-      }
-    } while (Process32NextW(snapshot, &pe32));
+pNtResumeProcess GetNtResumeProcess() {
+  static const auto fn = reinterpret_cast<pNtResumeProcess>(
+      GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtResumeProcess"));
+  return fn;
+}
+
+// Enable or reset EcoQoS (execution speed power throttling) for a process
+bool SetPowerThrottling(HANDLE process, bool enable) {
+  static const auto set_info = reinterpret_cast<pSetProcessInformation>(
+      GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetProcessInformation"));
+  if (!set_info) {
+    return false;
   }
 
-  CloseHandle(snapshot);
-  return pids;
+  // ControlMask = 0 hands the decision back to the system
+  PROCESS_POWER_THROTTLING_STATE throttling = {};
+  throttling.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+  throttling.ControlMask = enable ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+  throttling.StateMask = enable ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+  return set_info(process, ProcessPowerThrottling, &throttling, sizeof(throttling)) != FALSE;
 }
 
-// Get all PIDs of current application (using cache)
-std::vector<DWORD> GetAppPids() {
-  return GetProcessCache().GetPids();
+HANDLE ToHandle(ProcessHandle process) {
+  return reinterpret_cast<HANDLE>(process);
 }
+
+class Win32ProcessBackend : public ProcessBackend {
+ public:
+  // Internal implementation for getting all PIDs of current application
+  std::vector<ProcessId> EnumerateAppProcesses() override {
+    std::vector<ProcessId> pids;
+    wchar_t current_exe_path[MAX_PATH];
+    GetModuleFileNameW(nullptr, current_exe_path, MAX_PATH);
+
+    wchar_t* exe_name = wcsrchr(current_exe_path, L'\\');
+    if (exe_name) {
+      ++exe_name;
+    } else {
+      exe_name = current_exe_path;
+    }
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+      return pids;
+    }
+
+    PROCESSENTRY32W pe32;
+    pe32.dwSize = sizeof(PROCESSENTRY32W);
+
+    if (Process32FirstW(snapshot, &pe32)) {
+      do {
+        if (_wcsicmp(pe32.szExeFile, exe_name) == 0) {
+          pids.emplace_back(pe32.th32ProcessID);
+        }
+      } while (Process32NextW(snapshot, &pe32));
+    }
+
+    CloseHandle(snapshot);
+    return pids;
+  }
+
+  ProcessId GetCurrentProcessId() override {
+    return ::GetCurrentProcessId();
+  }
+
+  ProcessHandle Open(ProcessId pid) override {
+    constexpr DWORD kFullAccess = PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SUSPEND_RESUME |
+                                  PROCESS_SET_INFORMATION | PROCESS_SET_QUOTA;
+    HANDLE process = OpenProcess(kFullAccess, FALSE, pid);
+    if (!process) {
+      // Fall back to query access; modifying operations then fail individually
+      process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    }
+    return reinterpret_cast<ProcessHandle>(process);
+  }
+
+  void Close(ProcessHandle process) override {
+    CloseHandle(ToHandle(process));
+  }
+
+  std::wstring GetType(ProcessHandle process) override {
+    return GetProcessType(QueryProcessCommandLine(ToHandle(process)));
+  }
+
+  bool Suspend(ProcessHandle process) override {
+    auto suspend = GetNtSuspendProcess();
+    return suspend && suspend(ToHandle(process)) >= 0;
+  }
+
+  bool Resume(ProcessHandle process) override {
+    auto resume = GetNtResumeProcess();
+    return resume && resume(ToHandle(process)) >= 0;
+  }
+
+  uint32_t EnterEcoMode(ProcessHandle process) override {
+    // Saved state is the original priority class (never 0 on success)
+    DWORD priority = GetPriorityClass(ToHandle(process));
+    if (priority == 0 || !SetPriorityClass(ToHandle(process), IDLE_PRIORITY_CLASS)) {
+      return 0;
+    }
+    SetPowerThrottling(ToHandle(process), true);
+    return priority;
+  }
+
+  void LeaveEcoMode(ProcessHandle process, uint32_t saved_state) override {
+    SetPowerThrottling(ToHandle(process), false);
+    SetPriorityClass(ToHandle(process), saved_state);
+  }
+
+  bool GetWorkingSetSize(ProcessHandle process, uint64_t* bytes) override {
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(ToHandle(process), &counters, sizeof(counters))) {
+      return false;
+    }
+    *bytes = counters.WorkingSetSize;
+    return true;
+  }
+
+  bool TrimWorkingSet(ProcessHandle process) override {
+    return EmptyWorkingSet(ToHandle(process)) != FALSE;
+  }
+};
+
+// ====================================================================================
+// Win32 audio backend (Core Audio session API)
+// ====================================================================================
+
 // Collect all active audio devices (default + all active devices)
 std::vector<ComPtr<IMMDevice>> CollectAudioDevices(IMMDeviceEnumerator* enumerator) {
   std::vector<ComPtr<IMMDevice>> devices;
@@ -191,42 +267,45 @@ std::vector<ComPtr<IMMDevice>> CollectAudioDevices(IMMDeviceEnumerator* enumerat
   return devices;
 }
 
-// Mute or unmute process audio sessions
-// Returns true if any session was found
-bool MuteProcess(const std::vector<DWORD>& pids,
-                 bool set_mute,
-                 bool save_mute_state = false) {
-  bool found_any_session = false;
+class Win32AudioBackend : public AudioBackend {
+ public:
+  // Mute or unmute process audio sessions
+  // Returns true if any session was found
+  bool UpdateSessions(const std::vector<ProcessId>& pids, const MuteDecision& decide) override {
+    bool found_any_session = false;
 
-  // Convert PIDs to unordered_set for O(1) lookup
-  std::unordered_set<DWORD> pid_set(pids.begin(), pids.end());
+    // Convert PIDs to unordered_set for O(1) lookup
+    std::unordered_set<DWORD> pid_set(pids.begin(), pids.end());
 
-  HRESULT hr = CoInitialize(nullptr);
-  const bool should_uninit = (hr == S_OK || hr == S_FALSE);
-  if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-    return false;
-  }
+    HRESULT hr = CoInitialize(nullptr);
+    const bool should_uninit = (hr == S_OK || hr == S_FALSE);
+    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
+      return false;
+    }
 
-  ComPtr<IMMDeviceEnumerator> enumerator;
-  if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL,
-                              IID_PPV_ARGS(&enumerator))) || !enumerator) {
-    if (should_uninit) CoUninitialize();
-    return false;
-  }
+    ComPtr<IMMDeviceEnumerator> enumerator;
+    if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL,
+                                IID_PPV_ARGS(&enumerator))) || !enumerator) {
+      if (should_uninit) CoUninitialize();
+      return false;
+    }
 
-  // Collect all audio devices
-  auto devices = CollectAudioDevices(enumerator.Get());
+    // Collect all audio devices
+    auto devices = CollectAudioDevices(enumerator.Get());
 
-  // Process each device
-  for (const auto& device : devices) {
-    ComPtr<IAudioSessionManager2> manager;
-    if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
-                                nullptr, IID_PPV_ARGS_Helper(&manager))) || !manager) {
-      continue;
-    }
+    // Process each device
+    for (const auto& device : devices) {
+      ComPtr<IAudioSessionManager2> manager;
+      if (FAILED(device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL,
+                                  nullptr, IID_PPV_ARGS_Helper(&manager))) || !manager) {
+        continue;
+      }
+
+      ComPtr<IAudioSessionEnumerator> session_enumerator;
+      if (FAILED(manager->GetSessionEnumerator(&session_enumerator))) {
+        continue;
+      }
 
-    ComPtr<IAudioSessionEnumerator> session_enumerator;
-    if (SUCCEEDED(manager->GetSessionEnumerator(&session_enumerator))) {
       int session_count = 0;
       session_enumerator->GetCount(&session_count);
 
@@ -237,204 +316,143 @@ bool MuteProcess(const std::vector<DWORD>& pids,
         }
 
         ComPtr<IAudioSessionControl2> session2;
-        if (SUCCEEDED(session.As(&session2))) {
-          DWORD session_pid = 0;
-          session2->GetProcessId(&session_pid);
-
-          // Check if this session belongs to our process (O(1) lookup with unordered_set)
-          bool is_our_process = pid_set.find(session_pid) != pid_set.end();
-
-          if (is_our_process) {
-            found_any_session = true;
-
-            // Get unique session instance ID (GUID)
-            LPWSTR session_id = nullptr;
-            if (SUCCEEDED(session2->GetSessionInstanceIdentifier(&session_id)) && session_id) {
-              ComPtr<ISimpleAudioVolume> volume;
-              if (SUCCEEDED(session2.As(&volume))) {
-                BOOL is_muted = FALSE;
-                volume->GetMute(&is_muted);
-
-                if (save_mute_state) {
-                  // Save the current mute state for this specific session (thread-safe)
-                  auto& state = GetState();
-                  std::lock_guard<std::mutex> lock(state.audio_state_mutex);
-                  state.original_mute_states[session_id] = (is_muted == TRUE);
-                  if (is_muted == FALSE) {
-                    state.has_unmuted_sessions.store(true, std::memory_order_release);
-                  }
-                }
-
-                if (set_mute) {
-                  // Mute all sessions
-                  volume->SetMute(TRUE, nullptr);
-                } else {
-                  // Restore original mute state for this session
-                  auto& state = GetState();
-                  std::lock_guard<std::mutex> lock(state.audio_state_mutex);
-                  auto it = state.original_mute_states.find(session_id);
-                  if (it != state.original_mute_states.end()) {
-                    // Restore to the original state (muted or unmuted)
-                    volume->SetMute(it->second ? TRUE : FALSE, nullptr);
-                  } else {
-                    // Session not found in saved states (might be newly created)
-                    // Unmute if we had any unmuted sessions originally
-                    if (state.has_unmuted_sessions.load(std::memory_order_acquire)) {
-                      volume->SetMute(FALSE, nullptr);
-                    }
-                  }
-                }
-              }
-              CoTaskMemFree(session_id);
+        if (FAILED(session.As(&session2))) {
+          continue;
+        }
+
+        DWORD session_pid = 0;
+        session2->GetProcessId(&session_pid);
+
+        // Check if this session belongs to our process (O(1) lookup with unordered_set)
+        if (pid_set.find(session_pid) == pid_set.end()) {
+          continue;
+        }
+        found_any_session = true;
+
+        // Get unique session instance ID (GUID)
+        LPWSTR session_id = nullptr;
+        if (SUCCEEDED(session2->GetSessionInstanceIdentifier(&session_id)) && session_id) {
+          ComPtr<ISimpleAudioVolume> volume;
+          if (SUCCEEDED(session2.As(&volume))) {
+            BOOL is_muted = FALSE;
+            volume->GetMute(&is_muted);
+
+            if (auto mute = decide(session_id, is_muted == TRUE)) {
+              volume->SetMute(*mute ? TRUE : FALSE, nullptr);
             }
           }
+          CoTaskMemFree(session_id);
         }
       }
     }
-  }
 
-  if (should_uninit) {
-    CoUninitialize();
+    if (should_uninit) {
+      CoUninitialize();
+    }
+
+    return found_any_session;
   }
+};
 
-  return found_any_session;
-}
+// ====================================================================================
+// Win32 task runner (shared executor, interactive lane)
+// ====================================================================================
 
-// Delayed unmute retry handler (runs in timer thread)
-VOID CALLBACK HandleUnmuteRetry(PVOID lpParam, BOOLEAN TimerOrWaitFired) {
-  auto& state = GetState();
+// One sequence for all boss key work, so the unmute posted on show never
+// overtakes the mute still running from the hide before it
+class Win32TaskRunner : public TaskRunner {
+ public:
+  void PostTask(std::function<void()> task) override {
+    sequence_.Post(std::move(task));
+  }
 
-  // Stop and cleanup timer
-  {
-    std::lock_guard<std::mutex> lock(state.timer_mutex);
-    if (state.unmute_retry_timer) {
-      DeleteTimerQueueTimer(nullptr, state.unmute_retry_timer, nullptr);
-      state.unmute_retry_timer = nullptr;
-    }
+  TaskId PostDelayedTask(uint32_t delay_ms, std::function<void()> task) override {
+    return sequence_.PostDelayed(delay_ms, std::move(task));
   }
 
-  if (state.is_hide.load(std::memory_order_acquire)) {
-    // Still hidden, don't retry
-    return;
+  void CancelDelayedTask(TaskId id) override {
+    // Waits for a task that is already running
+    sequence_.Cancel(id);
   }
 
-  // Run unmute in a separate thread to avoid blocking timer thread
-  std::thread([=]() {
-    auto vivaldi_pids = GetAppPids();
-    MuteProcess(vivaldi_pids, false, false);
+  uint64_t NowMs() override {
+    return GetTickCount64();
+  }
 
-    // Clean up saved states after retry (thread-safe)
-    auto& state = GetState();
-    {
-      std::lock_guard<std::mutex> lock(state.audio_state_mutex);
-      state.original_mute_states.clear();
-    }
-    state.has_unmuted_sessions.store(false, std::memory_order_release);
-  }).detach();
-}
+ private:
+  executor::Sequence sequence_{executor::Priority::kInteractive};
+};
 
-// Toggle hide/show windows and mute/unmute audio
-void HideAndShow() {
-  // Get PIDs from cache (fast: ~0.1ms if cached, ~15ms on first call)
-  auto vivaldi_pids = GetAppPids();
-
-  auto& state = GetState();
-  bool current_hide_state = state.is_hide.load(std::memory_order_acquire);
-
-  if (!current_hide_state) {
-    // ===== HIDE MODE =====
-    // 1. Stop any pending retry timer
-    {
-      std::lock_guard<std::mutex> lock(state.timer_mutex);
-      if (state.unmute_retry_timer) {
-        DeleteTimerQueueTimer(nullptr, state.unmute_retry_timer, INVALID_HANDLE_VALUE);
-        state.unmute_retry_timer = nullptr;
-      }
-    }
+Win32TaskRunner& GetTaskRunner() {
+  static Win32TaskRunner runner;
+  return runner;
+}
 
-    // 2. Clear saved audio states (thread-safe)
-    {
-      std::lock_guard<std::mutex> lock(state.audio_state_mutex);
-      state.original_mute_states.clear();
-    }
-    state.has_unmuted_sessions.store(false, std::memory_order_release);
-
-    // 3. Hide windows immediately (this must be synchronous for user experience)
-    EnumWindows(SearchVivaldiWindow, 0);
-
-    // 4. Update hide state before async audio processing
-    state.is_hide.store(true, std::memory_order_release);
-
-    // 5. Mute audio asynchronously (don't block window hiding)
-    std::thread([vivaldi_pids]() {
-      MuteProcess(vivaldi_pids, true, true);
-    }).detach();
-
-  } else {
-    // ===== SHOW MODE =====
-    // 1. Update hide state first
-    state.is_hide.store(false, std::memory_order_release);
-
-    // 2. Restore windows immediately (synchronous for smooth UX)
-    for (auto r_iter = state.hwnd_list.rbegin(); r_iter != state.hwnd_list.rend(); ++r_iter) {
-      ShowWindow(*r_iter, SW_SHOW);
-      SetWindowPos(*r_iter, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
-      SetForegroundWindow(*r_iter);
-      SetWindowPos(*r_iter, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
-      SetActiveWindow(*r_iter);
-    }
-    state.hwnd_list.clear();
-
-    // 3. Unmute audio asynchronously (don't block window showing)
-    std::thread([vivaldi_pids]() {
-      bool found_sessions = MuteProcess(vivaldi_pids, false);
-
-      auto& state = GetState();
-      // If we found sessions and had unmuted ones, set up a retry timer
-      // to handle late-loading audio sessions
-      if (found_sessions && state.has_unmuted_sessions.load(std::memory_order_acquire)) {
-        std::lock_guard<std::mutex> lock(state.timer_mutex);
-        CreateTimerQueueTimer(
-          &state.unmute_retry_timer,
-          nullptr,
-          HandleUnmuteRetry,
-          nullptr,
-          UNMUTE_RETRY_DELAY_MS,
-          0,  // One-shot timer
-          WT_EXECUTEINTIMERTHREAD
-        );
-      } else {
-        // No need to retry, clean up now
-        {
-          std::lock_guard<std::mutex> lock(state.audio_state_mutex);
-          state.original_mute_states.clear();
-        }
-        state.has_unmuted_sessions.store(false, std::memory_order_release);
-      }
-    }).detach();
+// ====================================================================================
+// Hotkey registration
+// ====================================================================================
+
+ProcessPolicy ToProcessPolicy(HiddenPolicy policy) {
+  switch (policy) {
+    case HiddenPolicy::kEco:
+      return ProcessPolicy::kEco;
+    case HiddenPolicy::kFreeze:
+      return ProcessPolicy::kFreeze;
+    default:
+      return ProcessPolicy::kNone;
   }
 }
 
-// Handle hotkey message
-void OnHotkey(HotkeyAction action) {
-  action();
+// Get singleton boss key instance (lazy initialization, only created when a hotkey is used)
+BossKey& GetBossKeyInstance() {
+  static Win32WindowBackend windows;
+  static Win32ProcessBackend processes;
+  static Win32AudioBackend audio;
+  static BossKey instance(
+      Platform{&windows, &processes, &audio, &GetTaskRunner()},
+      Options{ToProcessPolicy(GetConfig().GetHiddenPolicy()),
+              GetConfig().IsTrimOnHideEnabled(),
+              static_cast<uint64_t>(GetConfig().GetTrimThresholdMb()) * 1024 * 1024,
+              GetConfig().IsDebugLogEnabled() ? DebugLogV : nullptr});
+  return instance;
 }
 
-// Register hotkey and start message loop in a separate thread
-void RegisterHotkeyThread(std::wstring_view keys, HotkeyAction action) {
-  if (keys.empty()) {
-    return;
-  }
+// Hotkey action table, indexed by RegisterHotKey id
+struct HotkeyBinding {
+  const wchar_t* name;
+  const std::wstring& (Config::*keys)() const;
+  HotkeyAction action;
+};
 
-  UINT flag = ParseHotkeys(keys);
+constexpr HotkeyBinding kHotkeyBindings[] = {
+    {L"boss_key", &Config::GetBossKey, &BossKey::HideAndShow},
+    {L"mute_toggle", &Config::GetMuteToggleKey, &BossKey::MuteToggle},
+    {L"freeze_toggle", &Config::GetFreezeToggleKey, &BossKey::FreezeToggle},
+    {L"trim_memory", &Config::GetTrimMemoryKey, &BossKey::TrimMemory},
+};
 
-  std::thread th([flag, action]() {
-    RegisterHotKey(nullptr, 0, LOWORD(flag), HIWORD(flag));
+// Handle hotkey message
+void OnHotkey(WPARAM id) {
+  if (id < std::size(kHotkeyBindings)) {
+    (GetBossKeyInstance().*kHotkeyBindings[id].action)();
+  }
+}
+
+// Register all configured hotkeys on one thread and dispatch them by id
+void RegisterHotkeyThread(std::vector<std::pair<int, UINT>> hotkeys) {
+  std::thread th([hotkeys = std::move(hotkeys)]() {
+    // RegisterHotKey binds WM_HOTKEY to the calling thread's message queue
+    for (const auto& [id, flag] : hotkeys) {
+      if (!RegisterHotKey(nullptr, id, LOWORD(flag), HIWORD(flag))) {
+        DebugLog(L"RegisterHotKey %s=%s failed: %d", kHotkeyBindings[id].name,
+                 FormatHotkey(flag).c_str(), GetLastError());
+      }
+    }
 
     MSG msg;
     while (GetMessage(&msg, nullptr, 0, 0)) {
       if (msg.message == WM_HOTKEY) {
-        OnHotkey(action);
+        OnHotkey(msg.wParam);
       }
       TranslateMessage(&msg);
       DispatchMessage(&msg);
@@ -448,15 +466,22 @@ void RegisterHotkeyThread(std::wstring_view keys, HotkeyAction action) {
 
 // Public interface
 void Initialize() {
-  // Early return if boss key is not configured
+  std::vector<std::pair<int, UINT>> hotkeys;
+  for (size_t i = 0; i < std::size(kHotkeyBindings); ++i) {
+    const auto& keys = (GetConfig().*kHotkeyBindings[i].keys)();
+    if (!keys.empty()) {
+      hotkeys.emplace_back(static_cast<int>(i), ParseHotkeys(keys));
+    }
+  }
+
+  // Early return if no hotkey is configured
   // This ensures zero performance impact when feature is disabled
-  const auto& boss_key = GetConfig().GetBossKey();
-  if (boss_key.empty()) {
-    return;  // No bosskey configured, no initialization needed
+  if (hotkeys.empty()) {
+    return;
   }
 
-  // Only register hotkey if bosskey is actually configured
-  RegisterHotkeyThread(boss_key, HideAndShow);
+  // One thread serves every binding, regardless of how many are configured
+  RegisterHotkeyThread(std::move(hotkeys));
 }
 
 }  // namespace bosskey
@@ -5,7 +5,7 @@
 
 namespace bosskey {
 
-// Initialize and register boss key hotkey from config
+// Initialize and register all hotkeys from the [hotkey] config section
 // This should be called once during application startup
 void Initialize();
 
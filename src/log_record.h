@@ -0,0 +1,438 @@
+#ifndef VIVALDI_PLUS_LOG_RECORD_H_
+#define VIVALDI_PLUS_LOG_RECORD_H_
+
+// Platform-neutral core of the asynchronous logger (logger.h).
+// Producers capture the format string pointer and typed arguments into a
+// fixed-size binary record and push it into a bounded MPSC ring; formatting
+// happens later in the logger's drain task. Strings are copied into the
+// record, those that do not fit spill into one heap buffer per record;
+// everything else is stored as 64-bit values. This header must not include
+// <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace logger
+{
+
+enum class Level : uint8_t
+{
+    kError,
+    kWarning,
+    kInfo,
+    kDebug,
+};
+
+enum class ArgType : uint8_t
+{
+    kSigned,
+    kUnsigned,
+    kDouble,
+    kPointer,
+    kText,       // In Record::text
+    kSpillText,  // In Record::spill
+};
+
+struct Arg
+{
+    ArgType type;
+    uint16_t offset;  // kText/kSpillText: position in Record::text or Record::spill
+    uint16_t length;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+};
+
+struct Record
+{
+    static constexpr size_t kMaxArgs = 8;
+    static constexpr size_t kTextCapacity = 160;
+    static constexpr size_t kSpillCapacity = UINT16_MAX;  // Longer text is truncated
+
+    uint64_t timestamp;      // Caller-defined clock, formatted by the consumer
+    uint32_t thread_id;
+    Level level;
+    uint8_t arg_count;
+    uint16_t text_used;
+    const wchar_t *format;   // Must outlive the record: string literals only
+    wchar_t *spill;          // malloc'ed, owned by the record until Release
+    uint16_t spill_used;
+    Arg args[kMaxArgs];
+    wchar_t text[kTextCapacity];
+};
+
+// Free the spilled text once the record is formatted or dropped
+inline void Release(Record &record)
+{
+    free(record.spill);
+    record.spill = nullptr;
+    record.spill_used = 0;
+}
+
+// Room for `length` characters of a text argument, inline while it fits and
+// spilled to the heap otherwise; arg.length is what was granted
+inline wchar_t *ReserveText(Record &record, Arg &arg, size_t length)
+{
+    if (length <= Record::kTextCapacity - record.text_used)
+    {
+        arg.type = ArgType::kText;
+        arg.offset = record.text_used;
+        arg.length = static_cast<uint16_t>(length);
+        record.text_used = static_cast<uint16_t>(record.text_used + length);
+        return record.text + arg.offset;
+    }
+
+    size_t room = Record::kSpillCapacity - record.spill_used;
+    if (length > room)
+        length = room;
+    auto *spill = static_cast<wchar_t *>(realloc(record.spill, (record.spill_used + length) * sizeof(wchar_t)));
+    if (!spill)
+    {
+        // Out of memory: keep what still fits inline
+        length = Record::kTextCapacity - record.text_used;
+        return ReserveText(record, arg, length);
+    }
+
+    record.spill = spill;
+    arg.type = ArgType::kSpillText;
+    arg.offset = record.spill_used;
+    arg.length = static_cast<uint16_t>(length);
+    record.spill_used = static_cast<uint16_t>(record.spill_used + length);
+    return record.spill + arg.offset;
+}
+
+inline void AppendText(Record &record, const wchar_t *text, size_t length)
+{
+    Arg &arg = record.args[record.arg_count++];
+    wchar_t *out = ReserveText(record, arg, length);
+    memcpy(out, text, arg.length * sizeof(wchar_t));
+}
+
+inline void AppendNarrowText(Record &record, const char *text)
+{
+    Arg &arg = record.args[record.arg_count++];
+    wchar_t *out = ReserveText(record, arg, strlen(text));
+    for (size_t i = 0; i < arg.length; i++)
+    {
+        out[i] = static_cast<unsigned char>(text[i]);
+    }
+}
+
+// Text of a kText/kSpillText argument
+inline std::wstring_view TextOf(const Record &record, const Arg &arg)
+{
+    const wchar_t *base = arg.type == ArgType::kSpillText ? record.spill : record.text;
+    return std::wstring_view(base + arg.offset, arg.length);
+}
+
+template <typename T>
+inline constexpr bool kUnsupportedArg = false;
+
+template <typename T>
+inline void CaptureArg(Record &record, const T &value)
+{
+    if (record.arg_count >= Record::kMaxArgs)
+        return;
+
+    if constexpr (std::is_convertible_v<const T &, const wchar_t *>)
+    {
+        const wchar_t *text = value;
+        if (!text)
+            text = L"(null)";
+        AppendText(record, text, wcslen(text));
+    }
+    else if constexpr (std::is_convertible_v<const T &, const char *>)
+    {
+        const char *text = value;
+        AppendNarrowText(record, text ? text : "(null)");
+    }
+    else if constexpr (std::is_convertible_v<const T &, std::wstring_view>)
+    {
+        std::wstring_view text = value;
+        AppendText(record, text.data(), text.size());
+    }
+    else
+    {
+        Arg &arg = record.args[record.arg_count++];
+        if constexpr (std::is_enum_v<T>)
+        {
+            arg.type = ArgType::kSigned;
+            arg.i = static_cast<int64_t>(value);
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            arg.type = ArgType::kSigned;
+            arg.i = value;
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            arg.type = ArgType::kUnsigned;
+            arg.u = value;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            arg.type = ArgType::kDouble;
+            arg.d = value;
+        }
+        else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+        {
+            arg.type = ArgType::kPointer;
+            arg.u = reinterpret_cast<uintptr_t>(value);
+        }
+        else
+        {
+            static_assert(kUnsupportedArg<T>, "unsupported log argument type");
+        }
+    }
+}
+
+template <typename... Args>
+inline void Capture(Record &record, const wchar_t *format, const Args &...args)
+{
+    static_assert(sizeof...(Args) <= Record::kMaxArgs, "too many log arguments");
+    record.format = format;
+    record.arg_count = 0;
+    record.text_used = 0;
+    record.spill = nullptr;
+    record.spill_used = 0;
+    (CaptureArg(record, args), ...);
+}
+
+// Expand the record with printf semantics of the MSVC wide functions:
+// %s and %S both print the captured text, numbers honour flags, width and
+// precision, a missing size modifier means 32-bit like on Windows
+inline std::wstring FormatRecord(const Record &record)
+{
+    std::wstring out;
+    size_t next = 0;
+    auto take = [&]() -> const Arg * { return next < record.arg_count ? &record.args[next++] : nullptr; };
+    auto is_text = [](const Arg *arg) { return arg->type == ArgType::kText || arg->type == ArgType::kSpillText; };
+    auto take_int = [&]() -> int {
+        const Arg *arg = take();
+        return arg && !is_text(arg) && arg->type != ArgType::kDouble ? static_cast<int>(arg->i) : 0;
+    };
+
+    for (const wchar_t *p = record.format; p && *p; p++)
+    {
+        if (*p != L'%')
+        {
+            out += *p;
+            continue;
+        }
+        if (*++p == L'%')
+        {
+            out += L'%';
+            continue;
+        }
+
+        // %[flags][width][.precision][size]conversion
+        wchar_t spec[32] = L"%";
+        size_t spec_length = 1;
+        auto push = [&](wchar_t ch) {
+            if (spec_length < 24)
+                spec[spec_length++] = ch;
+        };
+
+        while (*p && wcschr(L"-+ #0", *p))
+            push(*p++);
+
+        int width = -1;
+        if (*p == L'*')
+        {
+            width = take_int();
+            p++;
+        }
+        else
+        {
+            for (width = 0; *p >= L'0' && *p <= L'9'; p++)
+                width = width * 10 + (*p - L'0');
+        }
+
+        int precision = -1;
+        if (*p == L'.')
+        {
+            p++;
+            if (*p == L'*')
+            {
+                precision = take_int();
+                p++;
+            }
+            else
+            {
+                for (precision = 0; *p >= L'0' && *p <= L'9'; p++)
+                    precision = precision * 10 + (*p - L'0');
+            }
+        }
+
+        bool wide = false;
+        while (*p && wcschr(L"hlLzjtI", *p))
+        {
+            if (*p == L'z' || *p == L'j' || *p == L't' || (*p == L'l' && p[1] == L'l'))
+                wide = true;
+            if (*p == L'I' && p[1] == L'6' && p[2] == L'4')
+            {
+                wide = true;
+                p += 2;
+            }
+            p++;
+        }
+
+        wchar_t conversion = *p;
+        if (!conversion)
+            break;
+
+        const Arg *arg = take();
+        if (conversion == L's' || conversion == L'S')
+        {
+            std::wstring_view text = arg && is_text(arg) ? TextOf(record, *arg) : std::wstring_view(L"?");
+            if (precision >= 0 && static_cast<size_t>(precision) < text.size())
+                text = text.substr(0, precision);
+
+            bool left = wcschr(spec, L'-') != nullptr;
+            size_t pad = width > 0 && static_cast<size_t>(width) > text.size() ? width - text.size() : 0;
+            if (!left)
+                out.append(pad, L' ');
+            out += text;
+            if (left)
+                out.append(pad, L' ');
+            continue;
+        }
+
+        if (width > 0)
+            spec_length += swprintf(spec + spec_length, 8, L"%d", width);
+        if (precision >= 0)
+            spec_length += swprintf(spec + spec_length, 8, L".%d", precision);
+
+        wchar_t buffer[64];
+        buffer[0] = 0;
+        uint64_t bits = arg && !is_text(arg) ? arg->u : 0;
+        switch (conversion)
+        {
+        case L'd':
+        case L'i':
+            push(L'l');
+            push(L'l');
+            push(L'd');
+            spec[spec_length] = 0;
+            swprintf(buffer, 64, spec, wide ? static_cast<long long>(bits) : static_cast<long long>(static_cast<int32_t>(bits)));
+            break;
+        case L'u':
+        case L'x':
+        case L'X':
+        case L'o':
+            push(L'l');
+            push(L'l');
+            push(conversion);
+            spec[spec_length] = 0;
+            swprintf(buffer, 64, spec, wide ? static_cast<unsigned long long>(bits) : static_cast<unsigned long long>(static_cast<uint32_t>(bits)));
+            break;
+        case L'p':
+            swprintf(buffer, 64, L"%0*llX", static_cast<int>(sizeof(void *) * 2), static_cast<unsigned long long>(bits));
+            break;
+        case L'c':
+        case L'C':
+            buffer[0] = static_cast<wchar_t>(bits);
+            buffer[1] = 0;
+            break;
+        case L'f':
+        case L'F':
+        case L'e':
+        case L'E':
+        case L'g':
+        case L'G':
+            push(conversion);
+            spec[spec_length] = 0;
+            swprintf(buffer, 64, spec, arg && arg->type == ArgType::kDouble ? arg->d : 0.0);
+            break;
+        default:
+            buffer[0] = L'%';
+            buffer[1] = conversion;
+            buffer[2] = 0;
+            break;
+        }
+        out += buffer;
+    }
+    return out;
+}
+
+// Bounded multi-producer single-consumer queue (Vyukov); full means drop
+template <typename T, size_t N>
+class MpscRing
+{
+    static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    MpscRing()
+    {
+        for (size_t i = 0; i < N; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool TryPush(const T &value)
+    {
+        size_t position = enqueue_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[position & (N - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Single consumer only
+    bool TryPop(T &value)
+    {
+        Cell &cell = cells_[dequeue_ & (N - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(dequeue_ + 1) < 0)
+            return false;
+
+        value = cell.value;
+        cell.sequence.store(dequeue_ + N, std::memory_order_release);
+        dequeue_++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell cells_[N];
+    alignas(64) std::atomic<size_t> enqueue_{0};
+    alignas(64) size_t dequeue_ = 0;
+};
+
+}  // namespace logger
+
+#endif  // VIVALDI_PLUS_LOG_RECORD_H_
@@ -0,0 +1,209 @@
+#include "logger.h"
+
+#include <mutex>
+#include <string>
+
+#include "config.h"
+#include "executor.h"
+
+namespace logger
+{
+
+namespace
+{
+
+constexpr size_t kRingCapacity = 512;
+constexpr LONGLONG kMaxFileSize = 1 << 20;
+constexpr int kKeptFiles = 2;  // vivaldi_plus.log.1, vivaldi_plus.log.2
+constexpr DWORD kFlushIntervalMs = 250;
+constexpr int kFlushWaitMs = 100;
+constexpr wchar_t kFileName[] = L"vivaldi_plus.log";
+constexpr wchar_t kLevelLetters[] = L"EWID";
+
+std::atomic<uint64_t> dropped{0};
+std::atomic<bool> started{false};
+std::atomic<bool> drain_scheduled{false};
+
+// Everything below belongs to the single consumer: the drain task or Flush
+std::mutex consumer_mutex;
+std::wstring directory_path;
+std::wstring log_path;
+HANDLE file = INVALID_HANDLE_VALUE;
+LONGLONG file_size = 0;
+bool open_failed = false;
+bool debug_output = false;
+
+MpscRing<Record, kRingCapacity> &GetRing()
+{
+    static MpscRing<Record, kRingCapacity> ring;
+    return ring;
+}
+
+std::string ToUtf8(const std::wstring &text)
+{
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr,
+                                   nullptr);
+    std::string result(size > 0 ? size : 0, '\0');
+    if (size > 0)
+        WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), size, nullptr,
+                            nullptr);
+    return result;
+}
+
+// The file is only created once there is something to write
+bool OpenFile()
+{
+    if (file != INVALID_HANDLE_VALUE)
+        return true;
+    if (log_path.empty() || open_failed)
+        return false;
+
+    CreateDirectoryW(directory_path.c_str(), nullptr);
+    file = CreateFileW(log_path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        open_failed = true;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    file_size = GetFileSizeEx(file, &size) ? size.QuadPart : 0;
+    return true;
+}
+
+void Rotate()
+{
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+
+    for (int i = kKeptFiles; i > 0; i--)
+    {
+        std::wstring from = i == 1 ? log_path : log_path + L"." + std::to_wstring(i - 1);
+        std::wstring to = log_path + L"." + std::to_wstring(i);
+        MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING);
+    }
+    OpenFile();
+}
+
+std::wstring FormatPrefix(const Record &record)
+{
+    ULARGE_INTEGER value;
+    value.QuadPart = record.timestamp;
+    FILETIME utc = {value.LowPart, value.HighPart};
+    FILETIME local;
+    SYSTEMTIME time = {};
+    FileTimeToLocalFileTime(&utc, &local);
+    FileTimeToSystemTime(&local, &time);
+
+    wchar_t prefix[64];
+    swprintf_s(prefix, L"%04u-%02u-%02u %02u:%02u:%02u.%03u %5lu %c ", time.wYear, time.wMonth, time.wDay,
+               time.wHour, time.wMinute, time.wSecond, time.wMilliseconds, record.thread_id,
+               kLevelLetters[static_cast<int>(record.level)]);
+    return prefix;
+}
+
+// Format and write everything queued, caller holds consumer_mutex
+void Drain()
+{
+    std::string batch;
+    Record record;
+    while (GetRing().TryPop(record))
+    {
+        std::wstring message = FormatRecord(record);
+        Release(record);
+        if (debug_output)
+        {
+            OutputDebugStringW((L"[vivaldi++]" + message + L"\n").c_str());
+        }
+        batch += ToUtf8(FormatPrefix(record) + message + L"\r\n");
+    }
+
+    if (uint64_t lost = dropped.exchange(0, std::memory_order_relaxed))
+    {
+        batch += "Log ring full, " + std::to_string(lost) + " records dropped\r\n";
+    }
+
+    if (batch.empty() || !OpenFile())
+        return;
+
+    if (file_size > 0 && file_size + static_cast<LONGLONG>(batch.size()) > kMaxFileSize)
+    {
+        Rotate();
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+    }
+
+    DWORD written = 0;
+    WriteFile(file, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr);
+    file_size += written;
+}
+
+// One drain task at a time: warnings are written at once, debug records batched
+void ScheduleDrain(bool urgent)
+{
+    if (!started.load(std::memory_order_acquire) || drain_scheduled.exchange(true))
+        return;
+
+    executor::GetExecutor().PostDelayed(executor::Priority::kBackground, urgent ? 0 : kFlushIntervalMs, []() {
+        // Cleared first so records queued while draining schedule the next run
+        drain_scheduled.store(false);
+        std::lock_guard<std::mutex> lock(consumer_mutex);
+        Drain();
+    });
+}
+
+}  // namespace
+
+void Start(const std::wstring &directory)
+{
+    if (started.load())
+        return;
+
+    debug_output = GetConfig().IsDebugLogEnabled();
+    threshold.store(debug_output ? Level::kDebug : Level::kWarning, std::memory_order_relaxed);
+
+    if (!directory.empty())
+    {
+        directory_path = directory;
+        log_path = directory + L"\\" + kFileName;
+    }
+
+    // Write whatever was logged before the logger started
+    started.store(true, std::memory_order_release);
+    ScheduleDrain(true);
+}
+
+void Flush()
+{
+    // A drain task may still be writing; a crashed thread may never let go of the lock
+    std::unique_lock<std::mutex> lock(consumer_mutex, std::try_to_lock);
+    for (int i = 0; i < kFlushWaitMs && !lock.owns_lock(); i++)
+    {
+        Sleep(1);
+        lock.try_lock();
+    }
+    if (lock.owns_lock())
+    {
+        Drain();
+    }
+}
+
+void Submit(Record &record)
+{
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    record.timestamp = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    record.thread_id = GetCurrentThreadId();
+
+    if (!GetRing().TryPush(record))
+    {
+        Release(record);
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ScheduleDrain(record.level <= Level::kWarning);
+}
+
+}  // namespace logger
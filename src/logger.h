@@ -0,0 +1,56 @@
+#ifndef VIVALDI_PLUS_LOGGER_H_
+#define VIVALDI_PLUS_LOGGER_H_
+
+//
+// Asynchronous logger behind DebugLog/WarningLog (utils.h).
+// Callers filter by level, then copy the format pointer and arguments into a
+// binary record (log_record.h); no formatting or I/O happens on the calling
+// thread. A drain task on the shared executor, posted at most once per flush
+// interval, formats the records and appends them to
+// <data dir>\vivaldi_plus.log (rotated at 1 MiB, two old copies kept),
+// plus OutputDebugString when debug_log=1. Without debug_log only warnings
+// and errors are recorded and the file is created on the first one.
+//
+
+#include <windows.h>
+
+#include <atomic>
+#include <string>
+
+#include "log_record.h"
+
+namespace logger
+{
+
+// Most verbose level that is recorded, set by Start from debug_log
+inline std::atomic<Level> threshold{Level::kWarning};
+
+inline bool IsEnabled(Level level)
+{
+    return level <= threshold.load(std::memory_order_relaxed);
+}
+
+// Start writing; records logged earlier are kept and written then
+void Start(const std::wstring &directory);
+
+// Write everything queued so far on the calling thread (process exit)
+void Flush();
+
+// Stamp the record and queue it, dropped (and counted) when the ring is full
+void Submit(Record &record);
+
+template <typename... Args>
+inline void Log(Level level, const wchar_t *format, const Args &...args)
+{
+    if (!IsEnabled(level))
+        return;
+
+    Record record;
+    record.level = level;
+    Capture(record, format, args...);
+    Submit(record);
+}
+
+}  // namespace logger
+
+#endif  // VIVALDI_PLUS_LOGGER_H_
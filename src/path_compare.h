@@ -0,0 +1,32 @@
+#ifndef VIVALDI_PLUS_PATH_COMPARE_H_
+#define VIVALDI_PLUS_PATH_COMPARE_H_
+
+// Case-insensitive comparison of path text for the platform-neutral plans
+// (shadow_manifest.h, dedup_plan.h, storage_plan.h). Folds with towlower,
+// which matches NTFS for the names that occur in a profile.
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <wctype.h>
+
+#include <string_view>
+
+namespace path_compare
+{
+
+inline bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (towlower(a[i]) != towlower(b[i]))
+            return false;
+    }
+    return true;
+}
+
+}  // namespace path_compare
+
+#endif  // VIVALDI_PLUS_PATH_COMPARE_H_
@@ -10,6 +10,10 @@
 #include <utility>
 
 #include "config.h"
+#include "shadow.h"
+#include "sqlite_maintenance.h"
+#include "startup_trace.h"
+#include "storage_layout.h"
 #include "utils.h"
 
 namespace {
@@ -330,11 +334,13 @@ inline ProcessedArgs ProcessAndMergeArgs(const std::vector<std::wstring> &args)
 }
 
 // Inject additional arguments based on config settings.
-inline void InjectConfigPaths(std::vector<std::wstring> &args, bool has_user_data_dir, bool has_disk_cache_dir)
+// `user_data_dir` replaces the configured data directory (profile shadow) if not empty.
+inline void InjectConfigPaths(std::vector<std::wstring> &args, bool has_user_data_dir, bool has_disk_cache_dir,
+                              const std::wstring &user_data_dir)
 {
     if (!has_user_data_dir)
     {
-        auto userdata = GetUserDataDir();
+        auto userdata = user_data_dir.empty() ? GetUserDataDir() : user_data_dir;
         if (!userdata.empty())
         {
             args.push_back(L"--user-data-dir=" + userdata);
@@ -378,9 +384,10 @@ inline std::wstring ReassembleCommandLine(const std::vector<std::wstring> &args,
 // argument will be appended verbatim at the end.
 //
 // param: The command line passed to the application.
+// user_data_dir: Data directory to use instead of the configured one, empty = configured.
 //
 // Returns: The modified command line with additional args.
-inline std::wstring GetCommand(LPWSTR param)
+inline std::wstring GetCommand(LPWSTR param, const std::wstring &user_data_dir = L"")
 {
     if (!param)
     {
@@ -404,7 +411,7 @@ inline std::wstring GetCommand(LPWSTR param)
     ProcessedArgs processed = ProcessAndMergeArgs(main_args);
 
     // Inject custom directories if not already specified by user
-    InjectConfigPaths(processed.final_args, processed.has_user_data_dir, processed.has_disk_cache_dir);
+    InjectConfigPaths(processed.final_args, processed.has_user_data_dir, processed.has_disk_cache_dir, user_data_dir);
 
     // Append trailing arguments (after `--` sentinel)
     processed.final_args.insert(processed.final_args.end(), trailing_args.begin(), trailing_args.end());
@@ -418,20 +425,41 @@ inline void Portable(LPWSTR param)
     wchar_t path[MAX_PATH];
     if (!::GetModuleFileName(nullptr, path, MAX_PATH))
     {
-        if (GetConfig().IsDebugLogEnabled())
-        {
-            DebugLog(L"GetModuleFileName failed: %d", GetLastError());
-        }
+        DebugLog(L"GetModuleFileName failed: %d", GetLastError());
         return;
     }
 
-    std::wstring args = GetCommand(param);
+    // Profile shadow: copy the data directory to the local disk first, unless
+    // the command line names its own data directory
+    std::wstring shadow_dir;
+    if (shadow::IsEnabled() && !wcsstr(param, L"--user-data-dir="))
+    {
+        startup_trace::Scope trace("ShadowPrepare");
+        shadow_dir = shadow::Prepare(GetUserDataDir());
+    }
+
+    // Link the [storage] sub-directories of the data directory the browser is about to use
+    if (!wcsstr(param, L"--user-data-dir="))
+    {
+        startup_trace::Scope trace("StorageLayout");
+        storage_layout::Apply(shadow_dir.empty() ? GetUserDataDir() : shadow_dir);
+    }
+
+    // Compact the profile databases the browser is about to open, unless they are in use
+    if (sqlite_maintenance::IsEnabled() && !wcsstr(param, L"--user-data-dir="))
+    {
+        startup_trace::Scope trace("SqliteMaintenance");
+        sqlite_maintenance::Maintain(shadow_dir.empty() ? GetUserDataDir() : shadow_dir);
+    }
 
-    if (GetConfig().IsDebugLogEnabled())
+    std::wstring args;
     {
-        DebugLog(L"Portable mode: path=%s, args=%s", path, args.c_str());
+        startup_trace::Scope trace("GetCommand");
+        args = GetCommand(param, shadow_dir);
     }
 
+    DebugLog(L"Portable mode: path=%s, args=%s", path, args.c_str());
+
     SHELLEXECUTEINFO sei = {0};
     sei.cbSize = sizeof(SHELLEXECUTEINFO);
     sei.fMask = SEE_MASK_NOCLOSEPROCESS | SEE_MASK_FLAG_NO_UI;
@@ -440,16 +468,18 @@ inline void Portable(LPWSTR param)
     sei.nShow = SW_SHOWNORMAL;
     sei.lpParameters = args.c_str();
 
+    // The relaunched browser picks up our timeline and ends the relaunch span
+    startup_trace::ExportForRelaunch();
+
     if (ShellExecuteEx(&sei))
     {
+        // With a shadow, stay in the background and sync it back when the browser exits
+        shadow::RunSession(sei.hProcess);
         ExitProcess(0);
     }
     else
     {
-        if (GetConfig().IsDebugLogEnabled())
-        {
-            DebugLog(L"ShellExecuteEx failed: %d", GetLastError());
-        }
+        WarningLog(L"ShellExecuteEx failed: %d", GetLastError());
     }
 }
 
@@ -0,0 +1,301 @@
+#ifndef VIVALDI_PLUS_PREFETCH_H_
+#define VIVALDI_PLUS_PREFETCH_H_
+
+//
+// Learned startup prefetch ([general] startup_prefetch), for portable
+// installs on slow USB or network drives.
+// The browser records which files under the app and data directories it
+// opens (CreateFileW from browser code) plus the modules it loaded during the
+// first seconds, and stores that read set in the state file. The next launch
+// maps the set in batches and issues PrefetchVirtualMemory on each batch from
+// an idle I/O executor task, so the reads run in parallel at low I/O priority
+// while the stub relaunches and the browser starts.
+//
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "executor.h"
+#include "hook.h"
+#include "hook_stats.h"
+#include "prefetch_list.h"
+#include "state_store.h"
+#include "utils.h"
+
+namespace prefetch
+{
+
+// Recording and prefetching both stop this long after the extension loads
+constexpr DWORD kStartupWindowMs = 20000;
+constexpr size_t kBatchFiles = 32;
+constexpr uint64_t kBatchBytes = 32ull << 20;
+
+inline std::wstring app_root;
+inline std::wstring data_root;
+inline Recorder recorder;
+inline std::atomic<bool> recording{false};
+
+inline bool IsEnabled()
+{
+    return GetConfig().IsStartupPrefetchEnabled();
+}
+
+inline const std::wstring &RootPath(Root root)
+{
+    return root == Root::kData ? data_root : app_root;
+}
+
+// Split an absolute path into root and relative part, false if outside both roots
+// The data root is tried first, it may live inside the app directory
+inline bool Relativize(std::wstring_view path, Root *root, std::wstring_view *relative)
+{
+    if (path.starts_with(L"\\\\?\\"))
+        path.remove_prefix(4);
+
+    for (Root candidate : {Root::kData, Root::kApp})
+    {
+        const std::wstring &dir = RootPath(candidate);
+        if (!dir.empty() && path.size() > dir.size() + 1 && path[dir.size()] == L'\\' &&
+            _wcsnicmp(path.data(), dir.c_str(), dir.size()) == 0)
+        {
+            *root = candidate;
+            *relative = path.substr(dir.size() + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void Observe(LPCWSTR path, DWORD access, DWORD disposition, DWORD flags)
+{
+    // Reads of existing files only; directory handles carry backup semantics
+    if (!path || !(access & (GENERIC_READ | GENERIC_ALL | FILE_READ_DATA)))
+        return;
+    if (disposition == CREATE_NEW || disposition == CREATE_ALWAYS || disposition == TRUNCATE_EXISTING)
+        return;
+    if (flags & FILE_FLAG_BACKUP_SEMANTICS)
+        return;
+
+    Root root;
+    std::wstring_view relative;
+    if (Relativize(path, &root, &relative))
+        recorder.Add(root, relative);
+}
+
+typedef HANDLE(WINAPI *pCreateFileW)(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                     LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+                                     DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+
+inline pCreateFileW RawCreateFileW = nullptr;
+
+// Only records while the startup window is open, a relaxed load afterwards
+inline HANDLE WINAPI MyCreateFileW(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+                                   LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition,
+                                   DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
+{
+    HOOK_STATS_SCOPE(kCreateFileW);
+    HANDLE file = RawCreateFileW(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition,
+                                 dwFlagsAndAttributes, hTemplateFile);
+    if (file != INVALID_HANDLE_VALUE && recording.load(std::memory_order_relaxed))
+    {
+        DWORD error = GetLastError();
+        Observe(lpFileName, dwDesiredAccess, dwCreationDisposition, dwFlagsAndAttributes);
+        SetLastError(error);
+    }
+    return file;
+}
+
+// Loaded modules under the roots; the loader maps them without CreateFileW
+inline void AddLoadedModules(Recorder &ordered)
+{
+    HMODULE modules[512];
+    DWORD needed = 0;
+    if (!EnumProcessModules(GetCurrentProcess(), modules, sizeof(modules), &needed))
+        return;
+
+    size_t count = needed / sizeof(HMODULE) < ARRAYSIZE(modules) ? needed / sizeof(HMODULE) : ARRAYSIZE(modules);
+    for (size_t i = 0; i < count; i++)
+    {
+        wchar_t path[MAX_PATH];
+        DWORD length = GetModuleFileNameW(modules[i], path, MAX_PATH);
+        Root root;
+        std::wstring_view relative;
+        if (length > 0 && length < MAX_PATH && Relativize(std::wstring_view(path, length), &root, &relative))
+            ordered.Add(root, relative);
+    }
+}
+
+// End of the startup window: size the read set and store it for the next launch
+inline void SaveReadSet()
+{
+    recording.store(false, std::memory_order_relaxed);
+
+    // Modules are needed first, then files in the order the browser opened them
+    Recorder ordered;
+    AddLoadedModules(ordered);
+    for (auto &entry : recorder.Take())
+    {
+        ordered.Add(entry.root, entry.path);
+    }
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    for (auto &entry : ordered.Take())
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        std::wstring path = RootPath(entry.root) + L"\\" + entry.path;
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) ||
+            (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            continue;
+
+        uint64_t size = static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+        entry.length = static_cast<uint32_t>(size < kMaxFileBytes ? size : kMaxFileBytes);
+        if (entry.length == 0)
+            continue;
+
+        total += entry.length;
+        entries.push_back(std::move(entry));
+    }
+
+    std::vector<uint8_t> bytes = Encode(entries);
+    bool saved = state_store::Update([&bytes](state_format::Builder &builder) {
+        builder.Set(state_store::kPrefetchList, kListVersion, bytes.data(), bytes.size());
+    });
+
+    DebugLog(L"Startup prefetch: recorded %zu files, %llu KB%s", entries.size(), total / 1024,
+             saved ? L"" : L" (not saved)");
+}
+
+typedef BOOL(WINAPI *pPrefetchVirtualMemory)(HANDLE hProcess, ULONG_PTR NumberOfEntries,
+                                             PWIN32_MEMORY_RANGE_ENTRY VirtualAddresses, ULONG Flags);
+
+// Map the files of one batch, let the memory manager read them concurrently,
+// then wait for the pages by touching them and unmap
+inline void PrefetchBatch(const std::vector<Entry> &entries, const Batch &batch)
+{
+    static const auto prefetch_memory = reinterpret_cast<pPrefetchVirtualMemory>(
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory"));
+
+    std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges;
+    for (size_t i = batch.begin; i < batch.end; i++)
+    {
+        const Entry &entry = entries[i];
+        if (entry.length == 0)
+            continue;
+
+        std::wstring path = RootPath(entry.root) + L"\\" + entry.path;
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            continue;
+
+        LARGE_INTEGER size;
+        size_t length = 0;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            length = static_cast<size_t>(size.QuadPart < entry.length ? size.QuadPart : entry.length);
+
+        void *view = nullptr;
+        if (length)
+        {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping)
+            {
+                view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, length);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+
+        if (view)
+            ranges.push_back({view, length});
+    }
+
+    if (prefetch_memory && !ranges.empty())
+        prefetch_memory(GetCurrentProcess(), ranges.size(), ranges.data(), 0);
+
+    for (const auto &range : ranges)
+    {
+        const volatile uint8_t *bytes = static_cast<const volatile uint8_t *>(range.VirtualAddress);
+        for (size_t offset = 0; offset < range.NumberOfBytes; offset += 4096)
+        {
+            (void)bytes[offset];
+        }
+        UnmapViewOfFile(range.VirtualAddress);
+    }
+}
+
+inline void PrefetchReadSet()
+{
+    ULONGLONG start = GetTickCount64();
+    std::vector<Entry> entries;
+    {
+        state_store::Snapshot snapshot;
+        state_format::Record record;
+        if (!snapshot.Find(state_store::kPrefetchList, &record) || record.version != kListVersion ||
+            !Decode(record.data, record.size, &entries))
+            return;
+    }
+
+    size_t done = 0;
+    uint64_t bytes = 0;
+    for (const Batch &batch : Plan(entries, kBatchFiles, kBatchBytes))
+    {
+        // Past the startup window the browser has read what it needs by itself
+        if (GetTickCount64() - start > kStartupWindowMs)
+            break;
+
+        PrefetchBatch(entries, batch);
+        done += batch.end - batch.begin;
+        bytes += batch.bytes;
+    }
+
+    DebugLog(L"Startup prefetch: %zu/%zu files, %llu KB in %llu ms", done, entries.size(), bytes / 1024,
+             GetTickCount64() - start);
+}
+
+// Opened paths are absolute and normalized, the configured data dir may contain ".."
+inline std::wstring FullPath(const std::wstring &path)
+{
+    wchar_t buffer[MAX_PATH];
+    DWORD length = GetFullPathNameW(path.c_str(), MAX_PATH, buffer, nullptr);
+    if (length == 0 || length >= MAX_PATH)
+        return path;
+    if (length > 3 && buffer[length - 1] == L'\\')
+        length--;
+    return std::wstring(buffer, length);
+}
+
+// Prefetch the stored read set; `record` also learns this launch's read set (browser process)
+inline void Start(const std::wstring &data_dir, bool record)
+{
+    if (!IsEnabled())
+        return;
+
+    app_root = GetAppDir();
+    data_root = FullPath(data_dir);
+
+    executor::Executor &executor = executor::GetExecutor();
+    executor.Post(executor::Priority::kIdleIo, PrefetchReadSet);
+    if (record)
+    {
+        recording.store(true, std::memory_order_relaxed);
+        executor.PostDelayed(executor::Priority::kIdleIo, kStartupWindowMs, SaveReadSet);
+    }
+}
+
+// Observe file opens of browser code, only installed when startup_prefetch is enabled
+inline void AddPrefetchHooks(hook::Registry &registry)
+{
+    registry.Add({L"CreateFileW", L"kernel32.dll", "CreateFileW", nullptr, reinterpret_cast<void **>(&RawCreateFileW),
+                  reinterpret_cast<void *>(MyCreateFileW), IsEnabled, hook::kBrowserImporters});
+}
+
+}  // namespace prefetch
+
+#endif  // VIVALDI_PLUS_PREFETCH_H_
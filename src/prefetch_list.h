@@ -0,0 +1,191 @@
+#ifndef VIVALDI_PLUS_PREFETCH_LIST_H_
+#define VIVALDI_PLUS_PREFETCH_LIST_H_
+
+// Platform-neutral part of the startup prefetch (prefetch.h).
+// The recorder collects the files the browser opens early, relative to the
+// application or data directory so the list survives a changed drive letter;
+// the list is stored as one state record (state_store.h) and split into
+// batches that are prefetched with low-priority parallel I/O on the next start.
+//
+// Record layout (little endian), version kListVersion:
+//   0  entry count
+//   4  entries: root (1 byte), reserved (1 byte), path length in UTF-16 units (2 bytes),
+//      bytes to prefetch (4 bytes), path (UTF-16)
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wctype.h>
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "state_format.h"
+
+namespace prefetch
+{
+
+enum class Root : uint8_t
+{
+    kApp,   // Directory of the browser executable
+    kData,  // User data directory
+};
+
+struct Entry
+{
+    Root root;
+    uint32_t length;    // Leading bytes to prefetch
+    std::wstring path;  // Relative to the root
+};
+
+constexpr uint16_t kListVersion = 1;
+constexpr size_t kMaxEntries = 1024;
+constexpr uint32_t kMaxFileBytes = 8u << 20;
+constexpr uint64_t kMaxTotalBytes = 256ull << 20;
+
+// Collects first opens in order, case-insensitive, safe to call from any thread
+class Recorder
+{
+public:
+    // False once the list is full or the file was seen before
+    bool Add(Root root, std::wstring_view path)
+    {
+        if (path.empty())
+            return false;
+
+        std::wstring key(1, static_cast<wchar_t>(root));
+        for (wchar_t ch : path)
+        {
+            key += static_cast<wchar_t>(towlower(ch));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.size() >= kMaxEntries || !seen_.insert(std::move(key)).second)
+            return false;
+
+        entries_.push_back({root, 0, std::wstring(path)});
+        return true;
+    }
+
+    std::vector<Entry> Take()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seen_.clear();
+        return std::move(entries_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_set<std::wstring> seen_;
+    std::vector<Entry> entries_;
+};
+
+inline std::vector<uint8_t> Encode(const std::vector<Entry> &entries)
+{
+    std::vector<uint8_t> bytes(4);
+    state_format::StoreLE32(bytes.data(), static_cast<uint32_t>(entries.size()));
+    for (const auto &entry : entries)
+    {
+        size_t length = entry.path.size() < UINT16_MAX ? entry.path.size() : UINT16_MAX;
+        size_t offset = bytes.size();
+        bytes.resize(offset + 8 + length * 2);
+
+        uint8_t *out = bytes.data() + offset;
+        out[0] = static_cast<uint8_t>(entry.root);
+        out[1] = 0;
+        state_format::StoreLE16(out + 2, static_cast<uint16_t>(length));
+        state_format::StoreLE32(out + 4, entry.length);
+        for (size_t i = 0; i < length; i++)
+        {
+            state_format::StoreLE16(out + 8 + i * 2, static_cast<uint16_t>(entry.path[i]));
+        }
+    }
+    return bytes;
+}
+
+// False (and nothing decoded) if the record is malformed
+inline bool Decode(const uint8_t *data, size_t size, std::vector<Entry> *entries)
+{
+    entries->clear();
+    if (size < 4)
+        return false;
+
+    size_t count = state_format::LoadLE32(data);
+    if (count > kMaxEntries)
+        return false;
+
+    size_t offset = 4;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (size - offset < 8)
+            break;
+
+        const uint8_t *in = data + offset;
+        size_t length = state_format::LoadLE16(in + 2);
+        if (in[0] > static_cast<uint8_t>(Root::kData) || size - offset - 8 < length * 2)
+            break;
+
+        Entry entry{static_cast<Root>(in[0]), state_format::LoadLE32(in + 4), {}};
+        entry.path.resize(length);
+        for (size_t j = 0; j < length; j++)
+        {
+            entry.path[j] = static_cast<wchar_t>(state_format::LoadLE16(in + 8 + j * 2));
+        }
+        entries->push_back(std::move(entry));
+        offset += 8 + length * 2;
+    }
+
+    if (entries->size() != count || offset != size)
+    {
+        entries->clear();
+        return false;
+    }
+    return true;
+}
+
+struct Batch
+{
+    size_t begin;  // Entry range [begin, end)
+    size_t end;
+    uint64_t bytes;
+};
+
+// Split the list, in recorded order, into batches of at most max_files files
+// and max_bytes bytes; entries beyond kMaxTotalBytes are left out. Every batch
+// is issued at once, so its files are read in parallel.
+inline std::vector<Batch> Plan(const std::vector<Entry> &entries, size_t max_files, uint64_t max_bytes)
+{
+    std::vector<Batch> batches;
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        uint64_t length = entries[i].length < kMaxFileBytes ? entries[i].length : kMaxFileBytes;
+        if (length == 0)
+            continue;
+        if (total + length > kMaxTotalBytes)
+            break;
+        total += length;
+
+        // Skipped empty entries may stay inside a batch, the prefetcher ignores them
+        bool fits = !batches.empty() && batches.back().end - batches.back().begin < max_files &&
+                    batches.back().bytes + length <= max_bytes;
+        if (fits)
+        {
+            batches.back().end = i + 1;
+            batches.back().bytes += length;
+        }
+        else
+        {
+            batches.push_back({i, i + 1, length});
+        }
+    }
+    return batches;
+}
+
+}  // namespace prefetch
+
+#endif  // VIVALDI_PLUS_PREFETCH_LIST_H_
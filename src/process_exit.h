@@ -0,0 +1,72 @@
+#ifndef VIVALDI_PLUS_PROCESS_EXIT_H_
+#define VIVALDI_PLUS_PROCESS_EXIT_H_
+
+//
+// Work that has to happen when the process exits (cache rename, trace and log
+// flush) runs from hooks on ExitProcess and on TerminateProcess of the own
+// process, before Windows takes the loader lock for DLL_PROCESS_DETACH. Other
+// threads are still alive at that point, so the handler may wait for them;
+// it runs once, on the first thread that gets there. The browser leaves
+// through TerminateProcess once it has shut down, the portable stub through
+// ExitProcess. A crash reporter terminating the process runs it too, so the
+// handler only takes locks with try_lock.
+//
+
+#include <windows.h>
+
+#include <atomic>
+
+#include "hook.h"
+
+namespace process_exit
+{
+
+inline void (*handler)() = nullptr;
+inline std::atomic<bool> ran{false};
+
+inline void Run()
+{
+    if (handler && !ran.exchange(true))
+    {
+        DWORD error = GetLastError();
+        handler();
+        SetLastError(error);
+    }
+}
+
+typedef VOID(WINAPI *pExitProcess)(UINT uExitCode);
+
+inline pExitProcess RawExitProcess = nullptr;
+
+inline VOID WINAPI MyExitProcess(UINT uExitCode)
+{
+    Run();
+    RawExitProcess(uExitCode);
+}
+
+typedef BOOL(WINAPI *pTerminateProcess)(HANDLE hProcess, UINT uExitCode);
+
+inline pTerminateProcess RawTerminateProcess = nullptr;
+
+// The sandbox terminates children through here as well, those are not us
+inline BOOL WINAPI MyTerminateProcess(HANDLE hProcess, UINT uExitCode)
+{
+    if (hProcess == GetCurrentProcess() || GetProcessId(hProcess) == GetCurrentProcessId())
+        Run();
+    return RawTerminateProcess(hProcess, uExitCode);
+}
+
+// Not switchable in [hooks]: without them nothing is flushed at exit
+inline void AddExitHooks(hook::Registry &registry, void (*on_exit)())
+{
+    handler = on_exit;
+    registry.Add({nullptr, L"kernel32.dll", "ExitProcess", nullptr, reinterpret_cast<void **>(&RawExitProcess),
+                  reinterpret_cast<void *>(MyExitProcess), nullptr});
+    registry.Add({nullptr, L"kernel32.dll", "TerminateProcess", nullptr,
+                  reinterpret_cast<void **>(&RawTerminateProcess), reinterpret_cast<void *>(MyTerminateProcess),
+                  nullptr});
+}
+
+}  // namespace process_exit
+
+#endif  // VIVALDI_PLUS_PROCESS_EXIT_H_
@@ -0,0 +1,231 @@
+#ifndef VIVALDI_PLUS_PROCESS_POLICY_H_
+#define VIVALDI_PLUS_PROCESS_POLICY_H_
+
+//
+// Spawn-time resource policy for Chromium child processes ([process_policy]).
+// The browser creates every child through CreateProcessW or CreateProcessAsUserW
+// (sandboxed ones suspended), so the policy is applied to the new process handle
+// before it runs any code. UpdateProcThreadAttribute sees the attribute list only,
+// not the process, so it cannot do this.
+//
+
+#include <windows.h>
+
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "hook.h"
+#include "hook_stats.h"
+#include "process_util.h"
+#include "utils.h"
+
+namespace process_policy
+{
+
+typedef BOOL(WINAPI *pSetProcessInformation)(HANDLE hProcess, PROCESS_INFORMATION_CLASS ProcessInformationClass,
+                                             LPVOID ProcessInformation, DWORD ProcessInformationSize);
+typedef BOOL(WINAPI *pGetSystemCpuSetInformation)(PSYSTEM_CPU_SET_INFORMATION Information, ULONG BufferLength,
+                                                  PULONG ReturnedLength, HANDLE Process, ULONG Flags);
+typedef BOOL(WINAPI *pSetProcessDefaultCpuSets)(HANDLE Process, const ULONG *CpuSetIds, ULONG CpuSetIdCount);
+
+// Resolved dynamically: Windows 8 / Windows 10 only
+template <typename T>
+inline T GetKernel32Proc(const char *name)
+{
+    return reinterpret_cast<T>(GetProcAddress(GetModuleHandleW(L"kernel32.dll"), name));
+}
+
+// Value of --utility-sub-type= up to the first dot ("network" for network.mojom.NetworkService)
+inline std::wstring_view FindUtilitySubType(std::wstring_view command_line)
+{
+    constexpr std::wstring_view kSubTypeSwitch = L"--utility-sub-type=";
+    size_t pos = command_line.find(kSubTypeSwitch);
+    if (pos == std::wstring_view::npos)
+        return {};
+
+    std::wstring_view value = command_line.substr(pos + kSubTypeSwitch.size());
+    return value.substr(0, value.find_first_of(L". \t\""));
+}
+
+// Most specific policy for a child command line, nullptr if none applies
+inline const ProcessPolicy *FindPolicy(std::wstring_view command_line)
+{
+    std::wstring_view type = FindProcessType(command_line);
+    if (type.empty())
+        return nullptr;
+
+    std::wstring_view sub_type = FindUtilitySubType(command_line);
+    if (!sub_type.empty())
+    {
+        std::wstring qualified(type);
+        qualified += L'.';
+        qualified += sub_type;
+        if (const ProcessPolicy *policy = GetConfig().GetProcessPolicy(qualified))
+            return policy;
+    }
+    return GetConfig().GetProcessPolicy(type);
+}
+
+// Prefer the given logical processors of group 0 without hard-pinning the process
+inline bool SetCpuSets(HANDLE process, DWORD64 mask)
+{
+    static const auto get_info = GetKernel32Proc<pGetSystemCpuSetInformation>("GetSystemCpuSetInformation");
+    static const auto set_default = GetKernel32Proc<pSetProcessDefaultCpuSets>("SetProcessDefaultCpuSets");
+    if (!get_info || !set_default)
+        return false;
+
+    ULONG length = 0;
+    get_info(nullptr, 0, &length, GetCurrentProcess(), 0);
+    if (length == 0)
+        return false;
+
+    std::vector<BYTE> buffer(length);
+    if (!get_info(reinterpret_cast<PSYSTEM_CPU_SET_INFORMATION>(buffer.data()), length, &length, GetCurrentProcess(), 0))
+        return false;
+
+    std::vector<ULONG> ids;
+    for (ULONG offset = 0; offset < length;)
+    {
+        auto info = reinterpret_cast<PSYSTEM_CPU_SET_INFORMATION>(buffer.data() + offset);
+        if (info->Size == 0)
+            break;
+        if (info->Type == CpuSetInformation && info->CpuSet.Group == 0 && info->CpuSet.LogicalProcessorIndex < 64 &&
+            (mask & (1ull << info->CpuSet.LogicalProcessorIndex)))
+        {
+            ids.push_back(info->CpuSet.Id);
+        }
+        offset += info->Size;
+    }
+    return !ids.empty() && set_default(process, ids.data(), static_cast<ULONG>(ids.size()));
+}
+
+inline void Apply(HANDLE process, const ProcessPolicy &policy)
+{
+    static const auto set_info = GetKernel32Proc<pSetProcessInformation>("SetProcessInformation");
+    bool ok = true;
+
+    if (policy.priority_class)
+    {
+        ok &= SetPriorityClass(process, policy.priority_class) != FALSE;
+    }
+    if (policy.memory_priority >= 0 && set_info)
+    {
+        MEMORY_PRIORITY_INFORMATION memory = {static_cast<ULONG>(policy.memory_priority)};
+        ok &= set_info(process, ProcessMemoryPriority, &memory, sizeof(memory)) != FALSE;
+    }
+    if (policy.eco_qos >= 0 && set_info)
+    {
+        // Control without state opts out of throttling, control with state forces EcoQoS
+        PROCESS_POWER_THROTTLING_STATE throttling = {};
+        throttling.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+        throttling.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+        throttling.StateMask = policy.eco_qos ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+        ok &= set_info(process, ProcessPowerThrottling, &throttling, sizeof(throttling)) != FALSE;
+    }
+    if (policy.cpu_sets)
+    {
+        ok &= SetCpuSets(process, policy.cpu_sets);
+    }
+    if (policy.affinity)
+    {
+        DWORD_PTR process_mask = 0, system_mask = 0;
+        DWORD_PTR mask = static_cast<DWORD_PTR>(policy.affinity);
+        ok &= GetProcessAffinityMask(process, &process_mask, &system_mask) && (mask & system_mask) &&
+              SetProcessAffinityMask(process, mask & system_mask);
+    }
+    if (policy.working_set_mb)
+    {
+        SIZE_T maximum = static_cast<SIZE_T>(policy.working_set_mb) * 1024 * 1024;
+        ok &= SetProcessWorkingSetSizeEx(process, maximum / 4, maximum,
+                                         QUOTA_LIMITS_HARDWS_MIN_DISABLE | QUOTA_LIMITS_HARDWS_MAX_ENABLE) != FALSE;
+    }
+
+    DebugLog(L"Process policy %s applied to pid %lu%s", policy.type.c_str(), GetProcessId(process),
+             ok ? L"" : L" (partially)");
+}
+
+inline void ApplyToChild(LPCWSTR command_line, const PROCESS_INFORMATION *info)
+{
+    if (!command_line || !info || !info->hProcess)
+        return;
+
+    if (const ProcessPolicy *policy = FindPolicy(command_line))
+    {
+        Apply(info->hProcess, *policy);
+    }
+}
+
+typedef BOOL(WINAPI *pCreateProcessW)(LPCWSTR lpApplicationName, LPWSTR lpCommandLine,
+                                      LPSECURITY_ATTRIBUTES lpProcessAttributes, LPSECURITY_ATTRIBUTES lpThreadAttributes,
+                                      BOOL bInheritHandles, DWORD dwCreationFlags, LPVOID lpEnvironment,
+                                      LPCWSTR lpCurrentDirectory, LPSTARTUPINFOW lpStartupInfo,
+                                      LPPROCESS_INFORMATION lpProcessInformation);
+
+inline pCreateProcessW RawCreateProcessW = nullptr;
+
+inline BOOL WINAPI MyCreateProcessW(LPCWSTR lpApplicationName, LPWSTR lpCommandLine,
+                                    LPSECURITY_ATTRIBUTES lpProcessAttributes, LPSECURITY_ATTRIBUTES lpThreadAttributes,
+                                    BOOL bInheritHandles, DWORD dwCreationFlags, LPVOID lpEnvironment,
+                                    LPCWSTR lpCurrentDirectory, LPSTARTUPINFOW lpStartupInfo,
+                                    LPPROCESS_INFORMATION lpProcessInformation)
+{
+    HOOK_STATS_SCOPE(kCreateProcessW);
+    BOOL result = RawCreateProcessW(lpApplicationName, lpCommandLine, lpProcessAttributes, lpThreadAttributes,
+                                    bInheritHandles, dwCreationFlags, lpEnvironment, lpCurrentDirectory,
+                                    lpStartupInfo, lpProcessInformation);
+    if (result)
+    {
+        DWORD error = GetLastError();
+        ApplyToChild(lpCommandLine, lpProcessInformation);
+        SetLastError(error);
+    }
+    return result;
+}
+
+typedef BOOL(WINAPI *pCreateProcessAsUserW)(HANDLE hToken, LPCWSTR lpApplicationName, LPWSTR lpCommandLine,
+                                            LPSECURITY_ATTRIBUTES lpProcessAttributes,
+                                            LPSECURITY_ATTRIBUTES lpThreadAttributes, BOOL bInheritHandles,
+                                            DWORD dwCreationFlags, LPVOID lpEnvironment, LPCWSTR lpCurrentDirectory,
+                                            LPSTARTUPINFOW lpStartupInfo, LPPROCESS_INFORMATION lpProcessInformation);
+
+inline pCreateProcessAsUserW RawCreateProcessAsUserW = nullptr;
+
+// Used by the sandbox for renderers and most utilities
+inline BOOL WINAPI MyCreateProcessAsUserW(HANDLE hToken, LPCWSTR lpApplicationName, LPWSTR lpCommandLine,
+                                          LPSECURITY_ATTRIBUTES lpProcessAttributes,
+                                          LPSECURITY_ATTRIBUTES lpThreadAttributes, BOOL bInheritHandles,
+                                          DWORD dwCreationFlags, LPVOID lpEnvironment, LPCWSTR lpCurrentDirectory,
+                                          LPSTARTUPINFOW lpStartupInfo, LPPROCESS_INFORMATION lpProcessInformation)
+{
+    HOOK_STATS_SCOPE(kCreateProcessAsUserW);
+    BOOL result = RawCreateProcessAsUserW(hToken, lpApplicationName, lpCommandLine, lpProcessAttributes,
+                                          lpThreadAttributes, bInheritHandles, dwCreationFlags, lpEnvironment,
+                                          lpCurrentDirectory, lpStartupInfo, lpProcessInformation);
+    if (result)
+    {
+        DWORD error = GetLastError();
+        ApplyToChild(lpCommandLine, lpProcessInformation);
+        SetLastError(error);
+    }
+    return result;
+}
+
+inline bool HasPolicies()
+{
+    return GetConfig().HasProcessPolicies();
+}
+
+// Register process creation hooks, only installed when [process_policy] is configured
+inline void AddProcessPolicyHooks(hook::Registry &registry)
+{
+    registry.Add({L"CreateProcessW", L"kernel32.dll", "CreateProcessW", nullptr,
+                  reinterpret_cast<void **>(&RawCreateProcessW), reinterpret_cast<void *>(MyCreateProcessW), HasPolicies});
+    registry.Add({L"CreateProcessAsUserW", L"advapi32.dll", "CreateProcessAsUserW", nullptr,
+                  reinterpret_cast<void **>(&RawCreateProcessAsUserW), reinterpret_cast<void *>(MyCreateProcessAsUserW),
+                  HasPolicies});
+}
+
+}  // namespace process_policy
+
+#endif  // VIVALDI_PLUS_PROCESS_POLICY_H_
@@ -0,0 +1,67 @@
+#include "process_util.h"
+
+#include <vector>
+
+namespace {
+
+// NtQueryInformationProcess information class for the process command line (Windows 8.1+)
+constexpr ULONG kProcessCommandLineInformation = 60;
+
+typedef LONG(NTAPI *pNtQueryInformationProcess)(
+    HANDLE ProcessHandle,
+    ULONG ProcessInformationClass,
+    PVOID ProcessInformation,
+    ULONG ProcessInformationLength,
+    PULONG ReturnLength);
+
+// Layout of UNICODE_STRING as returned by ntdll
+struct NtUnicodeString
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PWSTR Buffer;
+};
+
+}  // namespace
+
+// Extract Chromium process type from a command line (value of --type=)
+std::wstring GetProcessType(std::wstring_view command_line)
+{
+    return std::wstring(FindProcessType(command_line));
+}
+
+// Read the command line of another process
+std::wstring QueryProcessCommandLine(HANDLE process)
+{
+    static const auto query = reinterpret_cast<pNtQueryInformationProcess>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationProcess"));
+    if (!query || !process)
+        return L"";
+
+    ULONG size = 0;
+    query(process, kProcessCommandLineInformation, nullptr, 0, &size);
+    if (size < sizeof(NtUnicodeString))
+        return L"";
+
+    std::vector<BYTE> buffer(size);
+    if (query(process, kProcessCommandLineInformation, buffer.data(), size, &size) < 0)
+        return L"";
+
+    const auto *str = reinterpret_cast<const NtUnicodeString *>(buffer.data());
+    if (!str->Buffer || str->Length == 0)
+        return L"";
+
+    return std::wstring(str->Buffer, str->Length / sizeof(wchar_t));
+}
+
+// Convenience wrapper: open the process and return its Chromium process type
+std::wstring QueryProcessType(DWORD pid)
+{
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process)
+        return L"";
+
+    std::wstring type = GetProcessType(QueryProcessCommandLine(process));
+    CloseHandle(process);
+    return type;
+}
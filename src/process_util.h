@@ -0,0 +1,47 @@
+#ifndef VIVALDI_PLUS_PROCESS_UTIL_H_
+#define VIVALDI_PLUS_PROCESS_UTIL_H_
+
+#include <windows.h>
+
+#include <string>
+#include <string_view>
+
+// Extract Chromium process type from a command line (value of --type=)
+// Returns empty string for the browser process itself
+std::wstring GetProcessType(std::wstring_view command_line);
+
+// Same as GetProcessType without allocating, safe to call from DllMain
+// The returned view points into `command_line`
+// Header-only so the core DLL can use it without the rest of this module
+inline std::wstring_view FindProcessType(std::wstring_view command_line)
+{
+    constexpr std::wstring_view kTypeSwitch = L"--type=";
+    auto is_boundary = [](wchar_t ch) { return ch == L' ' || ch == L'\t' || ch == L'"'; };
+
+    size_t pos = command_line.find(kTypeSwitch);
+    while (pos != std::wstring_view::npos)
+    {
+        // Only accept the switch at a token boundary (ignore e.g. "--foo-type=")
+        if (pos == 0 || is_boundary(command_line[pos - 1]))
+        {
+            size_t begin = pos + kTypeSwitch.size();
+            size_t end = begin;
+            while (end < command_line.size() && !is_boundary(command_line[end]))
+            {
+                ++end;
+            }
+            return command_line.substr(begin, end - begin);
+        }
+        pos = command_line.find(kTypeSwitch, pos + kTypeSwitch.size());
+    }
+    return {};
+}
+
+// Read the command line of another process
+// Requires PROCESS_QUERY_LIMITED_INFORMATION access, returns empty string on failure
+std::wstring QueryProcessCommandLine(HANDLE process);
+
+// Convenience wrapper: open the process and return its Chromium process type
+std::wstring QueryProcessType(DWORD pid);
+
+#endif  // VIVALDI_PLUS_PROCESS_UTIL_H_
@@ -0,0 +1,102 @@
+#ifndef VIVALDI_PLUS_PROXY_H_
+#define VIVALDI_PLUS_PROXY_H_
+
+//
+// Runtime side of the lazy export forwarding stubs in src/proxy/.
+// Stubs and tables there are generated by tools/proxygen from the system DLL.
+// Each stub jumps through a slot that initially points at a resolver thunk;
+// Resolve() loads the real system DLL on first use, patches the slot with the
+// real function and every later call jumps there directly.
+// x86 and x64 only; ARM64 builds forward the exports at load time.
+//
+
+#include <windows.h>
+#include <stdio.h>
+
+#include "startup_overhead.h"
+
+namespace proxy
+{
+
+struct ExportEntry
+{
+    const char *name;  // nullptr for ordinal-only exports
+    WORD ordinal;
+};
+
+struct Module
+{
+    const wchar_t *file_name;  // DLL in the system directory
+    const ExportEntry *exports;
+    size_t count;
+    void **slots;
+    void *volatile handle;
+};
+
+// Part of the core DLL, so it logs without the config machinery
+inline void LogFailure(const wchar_t *format, const wchar_t *file_name, unsigned int value)
+{
+    wchar_t message[MAX_PATH + 64];
+    swprintf_s(message, format, file_name, value);
+    OutputDebugStringW(message);
+}
+
+// Returned for exports missing from the system DLL, mirrors the old NOP stubs
+inline int __cdecl MissingExport()
+{
+    return 0;
+}
+
+inline HMODULE LoadSystemModule(const wchar_t *file_name)
+{
+    wchar_t path[MAX_PATH + 1];
+    UINT length = GetSystemDirectoryW(path, MAX_PATH);
+    if (length == 0 || length + 1 + lstrlenW(file_name) > MAX_PATH)
+        return nullptr;
+
+    lstrcatW(path, L"\\");
+    lstrcatW(path, file_name);
+    return LoadLibraryW(path);
+}
+
+// Resolve one export and patch its slot
+// Racing first calls may both resolve, they store the same address
+inline void *ResolveSlot(Module &module, unsigned int index)
+{
+    HMODULE handle = static_cast<HMODULE>(module.handle);
+    if (!handle)
+    {
+        handle = LoadSystemModule(module.file_name);
+        if (!handle)
+        {
+            LogFailure(L"[vivaldi++]Failed to load system %s: %u\n", module.file_name, GetLastError());
+            return reinterpret_cast<void *>(MissingExport);
+        }
+        // Keep the first handle; a duplicate LoadLibrary only bumps the refcount
+        InterlockedCompareExchangePointer(&module.handle, handle, nullptr);
+    }
+
+    const ExportEntry &entry = module.exports[index];
+    FARPROC target = GetProcAddress(handle, entry.name ? entry.name : MAKEINTRESOURCEA(entry.ordinal));
+    if (!target)
+    {
+        LogFailure(L"[vivaldi++]%s has no export #%u\n", module.file_name, entry.ordinal);
+        return reinterpret_cast<void *>(MissingExport);
+    }
+
+    InterlockedExchangePointer(&module.slots[index], reinterpret_cast<void *>(target));
+    return reinterpret_cast<void *>(target);
+}
+
+// Called by the stubs; the first call also pays for loading the system DLL
+inline void *Resolve(Module &module, unsigned int index)
+{
+    LONG64 start_ticks = startup_overhead::Now();
+    void *target = ResolveSlot(module, index);
+    startup_overhead::RecordResolve(start_ticks);
+    return target;
+}
+
+}  // namespace proxy
+
+#endif  // VIVALDI_PLUS_PROXY_H_
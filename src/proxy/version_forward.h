@@ -0,0 +1,26 @@
+// Generated by tools/proxygen from version.dll, do not edit
+// Must only be included in ONE translation unit (vivaldi++.cpp)
+// Exports are forwarded to the system DLL when the loader binds them
+
+#ifndef VIVALDI_PLUS_PROXY_VERSION_FORWARD_H_
+#define VIVALDI_PLUS_PROXY_VERSION_FORWARD_H_
+
+#pragma comment(linker, "/export:GetFileVersionInfoA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoA,@1")
+#pragma comment(linker, "/export:GetFileVersionInfoByHandle=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoByHandle,@2")
+#pragma comment(linker, "/export:GetFileVersionInfoExA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoExA,@3")
+#pragma comment(linker, "/export:GetFileVersionInfoExW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoExW,@4")
+#pragma comment(linker, "/export:GetFileVersionInfoSizeA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoSizeA,@5")
+#pragma comment(linker, "/export:GetFileVersionInfoSizeExA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoSizeExA,@6")
+#pragma comment(linker, "/export:GetFileVersionInfoSizeExW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoSizeExW,@7")
+#pragma comment(linker, "/export:GetFileVersionInfoSizeW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoSizeW,@8")
+#pragma comment(linker, "/export:GetFileVersionInfoW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.GetFileVersionInfoW,@9")
+#pragma comment(linker, "/export:VerFindFileA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerFindFileA,@10")
+#pragma comment(linker, "/export:VerFindFileW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerFindFileW,@11")
+#pragma comment(linker, "/export:VerInstallFileA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerInstallFileA,@12")
+#pragma comment(linker, "/export:VerInstallFileW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerInstallFileW,@13")
+#pragma comment(linker, "/export:VerLanguageNameA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerLanguageNameA,@14")
+#pragma comment(linker, "/export:VerLanguageNameW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerLanguageNameW,@15")
+#pragma comment(linker, "/export:VerQueryValueA=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerQueryValueA,@16")
+#pragma comment(linker, "/export:VerQueryValueW=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\version.VerQueryValueW,@17")
+
+#endif  // VIVALDI_PLUS_PROXY_VERSION_FORWARD_H_
@@ -0,0 +1,45 @@
+// Generated by tools/proxygen from version.dll, do not edit
+// Must only be included in ONE translation unit (vivaldi++.cpp)
+
+#ifndef VIVALDI_PLUS_PROXY_VERSION_PROXY_H_
+#define VIVALDI_PLUS_PROXY_VERSION_PROXY_H_
+
+#include "../proxy.h"
+
+// Jump slots defined by version_x86.asm / version_x64.asm
+extern "C" void *version_proxy_slots[];
+
+namespace proxy
+{
+
+static const ExportEntry k_version_exports[] = {
+    {"GetFileVersionInfoA", 1},
+    {"GetFileVersionInfoByHandle", 2},
+    {"GetFileVersionInfoExA", 3},
+    {"GetFileVersionInfoExW", 4},
+    {"GetFileVersionInfoSizeA", 5},
+    {"GetFileVersionInfoSizeExA", 6},
+    {"GetFileVersionInfoSizeExW", 7},
+    {"GetFileVersionInfoSizeW", 8},
+    {"GetFileVersionInfoW", 9},
+    {"VerFindFileA", 10},
+    {"VerFindFileW", 11},
+    {"VerInstallFileA", 12},
+    {"VerInstallFileW", 13},
+    {"VerLanguageNameA", 14},
+    {"VerLanguageNameW", 15},
+    {"VerQueryValueA", 16},
+    {"VerQueryValueW", 17},
+};
+
+static Module g_version_module = {L"version.dll", k_version_exports, 17, version_proxy_slots, nullptr};
+
+}  // namespace proxy
+
+// Called by the stubs on the first call of each export
+extern "C" void *version_proxy_resolve(unsigned int index)
+{
+    return proxy::Resolve(proxy::g_version_module, index);
+}
+
+#endif  // VIVALDI_PLUS_PROXY_VERSION_PROXY_H_
@@ -0,0 +1,228 @@
+; Generated by tools/proxygen from version.dll, do not edit
+
+EXTERN version_proxy_resolve:PROC
+PUBLIC version_proxy_slots
+
+.DATA
+ALIGN 8
+version_proxy_slots    DQ version_proxy_thunk_0
+    DQ version_proxy_thunk_1
+    DQ version_proxy_thunk_2
+    DQ version_proxy_thunk_3
+    DQ version_proxy_thunk_4
+    DQ version_proxy_thunk_5
+    DQ version_proxy_thunk_6
+    DQ version_proxy_thunk_7
+    DQ version_proxy_thunk_8
+    DQ version_proxy_thunk_9
+    DQ version_proxy_thunk_10
+    DQ version_proxy_thunk_11
+    DQ version_proxy_thunk_12
+    DQ version_proxy_thunk_13
+    DQ version_proxy_thunk_14
+    DQ version_proxy_thunk_15
+    DQ version_proxy_thunk_16
+
+.CODE
+
+version_proxy_0 PROC  ; GetFileVersionInfoA
+    mov rax, QWORD PTR [version_proxy_slots + 0]
+    jmp rax
+version_proxy_0 ENDP
+
+version_proxy_thunk_0 PROC
+    mov eax, 0
+    jmp version_proxy_resolve_common
+version_proxy_thunk_0 ENDP
+
+version_proxy_1 PROC  ; GetFileVersionInfoByHandle
+    mov rax, QWORD PTR [version_proxy_slots + 8]
+    jmp rax
+version_proxy_1 ENDP
+
+version_proxy_thunk_1 PROC
+    mov eax, 1
+    jmp version_proxy_resolve_common
+version_proxy_thunk_1 ENDP
+
+version_proxy_2 PROC  ; GetFileVersionInfoExA
+    mov rax, QWORD PTR [version_proxy_slots + 16]
+    jmp rax
+version_proxy_2 ENDP
+
+version_proxy_thunk_2 PROC
+    mov eax, 2
+    jmp version_proxy_resolve_common
+version_proxy_thunk_2 ENDP
+
+version_proxy_3 PROC  ; GetFileVersionInfoExW
+    mov rax, QWORD PTR [version_proxy_slots + 24]
+    jmp rax
+version_proxy_3 ENDP
+
+version_proxy_thunk_3 PROC
+    mov eax, 3
+    jmp version_proxy_resolve_common
+version_proxy_thunk_3 ENDP
+
+version_proxy_4 PROC  ; GetFileVersionInfoSizeA
+    mov rax, QWORD PTR [version_proxy_slots + 32]
+    jmp rax
+version_proxy_4 ENDP
+
+version_proxy_thunk_4 PROC
+    mov eax, 4
+    jmp version_proxy_resolve_common
+version_proxy_thunk_4 ENDP
+
+version_proxy_5 PROC  ; GetFileVersionInfoSizeExA
+    mov rax, QWORD PTR [version_proxy_slots + 40]
+    jmp rax
+version_proxy_5 ENDP
+
+version_proxy_thunk_5 PROC
+    mov eax, 5
+    jmp version_proxy_resolve_common
+version_proxy_thunk_5 ENDP
+
+version_proxy_6 PROC  ; GetFileVersionInfoSizeExW
+    mov rax, QWORD PTR [version_proxy_slots + 48]
+    jmp rax
+version_proxy_6 ENDP
+
+version_proxy_thunk_6 PROC
+    mov eax, 6
+    jmp version_proxy_resolve_common
+version_proxy_thunk_6 ENDP
+
+version_proxy_7 PROC  ; GetFileVersionInfoSizeW
+    mov rax, QWORD PTR [version_proxy_slots + 56]
+    jmp rax
+version_proxy_7 ENDP
+
+version_proxy_thunk_7 PROC
+    mov eax, 7
+    jmp version_proxy_resolve_common
+version_proxy_thunk_7 ENDP
+
+version_proxy_8 PROC  ; GetFileVersionInfoW
+    mov rax, QWORD PTR [version_proxy_slots + 64]
+    jmp rax
+version_proxy_8 ENDP
+
+version_proxy_thunk_8 PROC
+    mov eax, 8
+    jmp version_proxy_resolve_common
+version_proxy_thunk_8 ENDP
+
+version_proxy_9 PROC  ; VerFindFileA
+    mov rax, QWORD PTR [version_proxy_slots + 72]
+    jmp rax
+version_proxy_9 ENDP
+
+version_proxy_thunk_9 PROC
+    mov eax, 9
+    jmp version_proxy_resolve_common
+version_proxy_thunk_9 ENDP
+
+version_proxy_10 PROC  ; VerFindFileW
+    mov rax, QWORD PTR [version_proxy_slots + 80]
+    jmp rax
+version_proxy_10 ENDP
+
+version_proxy_thunk_10 PROC
+    mov eax, 10
+    jmp version_proxy_resolve_common
+version_proxy_thunk_10 ENDP
+
+version_proxy_11 PROC  ; VerInstallFileA
+    mov rax, QWORD PTR [version_proxy_slots + 88]
+    jmp rax
+version_proxy_11 ENDP
+
+version_proxy_thunk_11 PROC
+    mov eax, 11
+    jmp version_proxy_resolve_common
+version_proxy_thunk_11 ENDP
+
+version_proxy_12 PROC  ; VerInstallFileW
+    mov rax, QWORD PTR [version_proxy_slots + 96]
+    jmp rax
+version_proxy_12 ENDP
+
+version_proxy_thunk_12 PROC
+    mov eax, 12
+    jmp version_proxy_resolve_common
+version_proxy_thunk_12 ENDP
+
+version_proxy_13 PROC  ; VerLanguageNameA
+    mov rax, QWORD PTR [version_proxy_slots + 104]
+    jmp rax
+version_proxy_13 ENDP
+
+version_proxy_thunk_13 PROC
+    mov eax, 13
+    jmp version_proxy_resolve_common
+version_proxy_thunk_13 ENDP
+
+version_proxy_14 PROC  ; VerLanguageNameW
+    mov rax, QWORD PTR [version_proxy_slots + 112]
+    jmp rax
+version_proxy_14 ENDP
+
+version_proxy_thunk_14 PROC
+    mov eax, 14
+    jmp version_proxy_resolve_common
+version_proxy_thunk_14 ENDP
+
+version_proxy_15 PROC  ; VerQueryValueA
+    mov rax, QWORD PTR [version_proxy_slots + 120]
+    jmp rax
+version_proxy_15 ENDP
+
+version_proxy_thunk_15 PROC
+    mov eax, 15
+    jmp version_proxy_resolve_common
+version_proxy_thunk_15 ENDP
+
+version_proxy_16 PROC  ; VerQueryValueW
+    mov rax, QWORD PTR [version_proxy_slots + 128]
+    jmp rax
+version_proxy_16 ENDP
+
+version_proxy_thunk_16 PROC
+    mov eax, 16
+    jmp version_proxy_resolve_common
+version_proxy_thunk_16 ENDP
+
+version_proxy_resolve_common PROC FRAME
+    push rcx
+    .pushreg rcx
+    push rdx
+    .pushreg rdx
+    push r8
+    .pushreg r8
+    push r9
+    .pushreg r9
+    sub rsp, 68h
+    .allocstack 68h
+    .endprolog
+    movups XMMWORD PTR [rsp + 20h], xmm0
+    movups XMMWORD PTR [rsp + 30h], xmm1
+    movups XMMWORD PTR [rsp + 40h], xmm2
+    movups XMMWORD PTR [rsp + 50h], xmm3
+    mov ecx, eax
+    call version_proxy_resolve
+    movups xmm0, XMMWORD PTR [rsp + 20h]
+    movups xmm1, XMMWORD PTR [rsp + 30h]
+    movups xmm2, XMMWORD PTR [rsp + 40h]
+    movups xmm3, XMMWORD PTR [rsp + 50h]
+    add rsp, 68h
+    pop r9
+    pop r8
+    pop rdx
+    pop rcx
+    jmp rax
+version_proxy_resolve_common ENDP
+
+END
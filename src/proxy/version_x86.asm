@@ -0,0 +1,212 @@
+; Generated by tools/proxygen from version.dll, do not edit
+
+.686P
+.MODEL FLAT
+
+EXTERN _version_proxy_resolve:PROC
+PUBLIC _version_proxy_slots
+
+.DATA
+ALIGN 4
+_version_proxy_slots    DD _version_proxy_thunk_0
+    DD _version_proxy_thunk_1
+    DD _version_proxy_thunk_2
+    DD _version_proxy_thunk_3
+    DD _version_proxy_thunk_4
+    DD _version_proxy_thunk_5
+    DD _version_proxy_thunk_6
+    DD _version_proxy_thunk_7
+    DD _version_proxy_thunk_8
+    DD _version_proxy_thunk_9
+    DD _version_proxy_thunk_10
+    DD _version_proxy_thunk_11
+    DD _version_proxy_thunk_12
+    DD _version_proxy_thunk_13
+    DD _version_proxy_thunk_14
+    DD _version_proxy_thunk_15
+    DD _version_proxy_thunk_16
+
+.CODE
+
+_version_proxy_0 PROC  ; GetFileVersionInfoA
+    mov eax, DWORD PTR [_version_proxy_slots + 0]
+    jmp eax
+_version_proxy_0 ENDP
+
+_version_proxy_thunk_0 PROC
+    mov eax, 0
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_0 ENDP
+
+_version_proxy_1 PROC  ; GetFileVersionInfoByHandle
+    mov eax, DWORD PTR [_version_proxy_slots + 4]
+    jmp eax
+_version_proxy_1 ENDP
+
+_version_proxy_thunk_1 PROC
+    mov eax, 1
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_1 ENDP
+
+_version_proxy_2 PROC  ; GetFileVersionInfoExA
+    mov eax, DWORD PTR [_version_proxy_slots + 8]
+    jmp eax
+_version_proxy_2 ENDP
+
+_version_proxy_thunk_2 PROC
+    mov eax, 2
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_2 ENDP
+
+_version_proxy_3 PROC  ; GetFileVersionInfoExW
+    mov eax, DWORD PTR [_version_proxy_slots + 12]
+    jmp eax
+_version_proxy_3 ENDP
+
+_version_proxy_thunk_3 PROC
+    mov eax, 3
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_3 ENDP
+
+_version_proxy_4 PROC  ; GetFileVersionInfoSizeA
+    mov eax, DWORD PTR [_version_proxy_slots + 16]
+    jmp eax
+_version_proxy_4 ENDP
+
+_version_proxy_thunk_4 PROC
+    mov eax, 4
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_4 ENDP
+
+_version_proxy_5 PROC  ; GetFileVersionInfoSizeExA
+    mov eax, DWORD PTR [_version_proxy_slots + 20]
+    jmp eax
+_version_proxy_5 ENDP
+
+_version_proxy_thunk_5 PROC
+    mov eax, 5
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_5 ENDP
+
+_version_proxy_6 PROC  ; GetFileVersionInfoSizeExW
+    mov eax, DWORD PTR [_version_proxy_slots + 24]
+    jmp eax
+_version_proxy_6 ENDP
+
+_version_proxy_thunk_6 PROC
+    mov eax, 6
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_6 ENDP
+
+_version_proxy_7 PROC  ; GetFileVersionInfoSizeW
+    mov eax, DWORD PTR [_version_proxy_slots + 28]
+    jmp eax
+_version_proxy_7 ENDP
+
+_version_proxy_thunk_7 PROC
+    mov eax, 7
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_7 ENDP
+
+_version_proxy_8 PROC  ; GetFileVersionInfoW
+    mov eax, DWORD PTR [_version_proxy_slots + 32]
+    jmp eax
+_version_proxy_8 ENDP
+
+_version_proxy_thunk_8 PROC
+    mov eax, 8
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_8 ENDP
+
+_version_proxy_9 PROC  ; VerFindFileA
+    mov eax, DWORD PTR [_version_proxy_slots + 36]
+    jmp eax
+_version_proxy_9 ENDP
+
+_version_proxy_thunk_9 PROC
+    mov eax, 9
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_9 ENDP
+
+_version_proxy_10 PROC  ; VerFindFileW
+    mov eax, DWORD PTR [_version_proxy_slots + 40]
+    jmp eax
+_version_proxy_10 ENDP
+
+_version_proxy_thunk_10 PROC
+    mov eax, 10
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_10 ENDP
+
+_version_proxy_11 PROC  ; VerInstallFileA
+    mov eax, DWORD PTR [_version_proxy_slots + 44]
+    jmp eax
+_version_proxy_11 ENDP
+
+_version_proxy_thunk_11 PROC
+    mov eax, 11
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_11 ENDP
+
+_version_proxy_12 PROC  ; VerInstallFileW
+    mov eax, DWORD PTR [_version_proxy_slots + 48]
+    jmp eax
+_version_proxy_12 ENDP
+
+_version_proxy_thunk_12 PROC
+    mov eax, 12
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_12 ENDP
+
+_version_proxy_13 PROC  ; VerLanguageNameA
+    mov eax, DWORD PTR [_version_proxy_slots + 52]
+    jmp eax
+_version_proxy_13 ENDP
+
+_version_proxy_thunk_13 PROC
+    mov eax, 13
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_13 ENDP
+
+_version_proxy_14 PROC  ; VerLanguageNameW
+    mov eax, DWORD PTR [_version_proxy_slots + 56]
+    jmp eax
+_version_proxy_14 ENDP
+
+_version_proxy_thunk_14 PROC
+    mov eax, 14
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_14 ENDP
+
+_version_proxy_15 PROC  ; VerQueryValueA
+    mov eax, DWORD PTR [_version_proxy_slots + 60]
+    jmp eax
+_version_proxy_15 ENDP
+
+_version_proxy_thunk_15 PROC
+    mov eax, 15
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_15 ENDP
+
+_version_proxy_16 PROC  ; VerQueryValueW
+    mov eax, DWORD PTR [_version_proxy_slots + 64]
+    jmp eax
+_version_proxy_16 ENDP
+
+_version_proxy_thunk_16 PROC
+    mov eax, 16
+    jmp _version_proxy_resolve_common
+_version_proxy_thunk_16 ENDP
+
+_version_proxy_resolve_common PROC
+    push ecx
+    push edx
+    push eax
+    call _version_proxy_resolve
+    add esp, 4
+    pop edx
+    pop ecx
+    jmp eax
+_version_proxy_resolve_common ENDP
+
+END
@@ -0,0 +1,787 @@
+#include "shadow.h"
+
+#include <shlobj.h>
+
+#include <unordered_set>
+#include <vector>
+
+#include "config.h"
+#include "shadow_manifest.h"
+#include "state_store.h"
+#include "utils.h"
+
+namespace shadow
+{
+
+namespace
+{
+
+constexpr wchar_t kLocalRoot[] = L"%LOCALAPPDATA%\\VivaldiPlus\\Shadow";
+constexpr wchar_t kStagingName[] = L"vivaldi_plus.sync";  // In the data directory
+constexpr wchar_t kMarkerName[] = L"vivaldi_plus.shadow";  // In the local copy
+constexpr DWORD kLockTimeoutMs = 120000;
+constexpr DWORD kPollMs = 2000;
+constexpr int kStartupPolls = 30;
+constexpr DWORD kCopyChunk = 1 << 20;
+
+std::wstring portable_dir;  // Data directory on the portable media
+std::wstring local_dir;     // Copy the browser runs from
+bool session_started = false;
+
+// State file the manifest was loaded from; older builds kept it in the main one
+const wchar_t *manifest_file = state_store::kShadowFile;
+
+uint64_t ToUint64(const FILETIME &time)
+{
+    return static_cast<uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+}
+
+FILETIME ToFileTime(uint64_t time)
+{
+    return {static_cast<DWORD>(time), static_cast<DWORD>(time >> 32)};
+}
+
+uint64_t HashText(std::wstring_view text)
+{
+    std::wstring key = PathKey(text);
+    Hasher hasher;
+    hasher.Update(reinterpret_cast<const uint8_t *>(key.data()), key.size() * sizeof(wchar_t));
+    return hasher.value();
+}
+
+// Keyed by volume serial and path, so a changed drive letter finds the same copy
+std::wstring LocalDirFor(const std::wstring &data_dir)
+{
+    wchar_t volume[MAX_PATH];
+    DWORD serial = 0;
+    std::wstring_view relative = data_dir;
+    if (GetVolumePathNameW(data_dir.c_str(), volume, MAX_PATH) &&
+        GetVolumeInformationW(volume, nullptr, 0, &serial, nullptr, nullptr, nullptr, 0))
+    {
+        relative.remove_prefix(wcslen(volume) < relative.size() ? wcslen(volume) : relative.size());
+    }
+
+    wchar_t name[32];
+    swprintf_s(name, L"%08lX-%016llX", serial, HashText(relative));
+    return ExpandEnvironmentPath(kLocalRoot) + L"\\" + name;
+}
+
+// Serializes preparing and syncing of one data directory across launches
+class SyncLock
+{
+public:
+    SyncLock()
+    {
+        wchar_t name[64];
+        swprintf_s(name, L"Local\\VivaldiPlusShadow.%016llX", HashText(portable_dir));
+        mutex_ = CreateMutexW(nullptr, FALSE, name);
+        if (!mutex_)
+            return;
+
+        // An abandoned lock is fine: the journal finishes what its owner committed
+        DWORD wait = WaitForSingleObject(mutex_, kLockTimeoutMs);
+        if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+        {
+            CloseHandle(mutex_);
+            mutex_ = nullptr;
+        }
+    }
+
+    ~SyncLock()
+    {
+        if (mutex_)
+        {
+            ReleaseMutex(mutex_);
+            CloseHandle(mutex_);
+        }
+    }
+
+    SyncLock(const SyncLock &) = delete;
+    SyncLock &operator=(const SyncLock &) = delete;
+
+    bool held() const
+    {
+        return mutex_ != nullptr;
+    }
+
+private:
+    HANDLE mutex_ = nullptr;
+};
+
+void CreateParentDirectory(const std::wstring &path)
+{
+    size_t slash = path.find_last_of(L'\\');
+    if (slash != std::wstring::npos)
+        SHCreateDirectoryExW(nullptr, path.substr(0, slash).c_str(), nullptr);
+}
+
+uint8_t *CopyBuffer()
+{
+    static std::vector<uint8_t> buffer(kCopyChunk);
+    return buffer.data();
+}
+
+// Files of `root`, relative paths without excluded ones; false if unreadable or too many
+bool Scan(const std::wstring &root, std::vector<FileState> *files)
+{
+    files->clear();
+    std::vector<std::wstring> pending(1);
+    while (!pending.empty())
+    {
+        std::wstring relative = std::move(pending.back());
+        pending.pop_back();
+
+        std::wstring pattern = root + L"\\" + (relative.empty() ? L"*" : relative + L"\\*");
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                       FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            // A missing root is an empty profile, anything else is an error
+            DWORD error = GetLastError();
+            if (relative.empty() && error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND)
+                return false;
+            continue;
+        }
+
+        do
+        {
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+                continue;
+
+            // Junctions and symbolic links are neither followed nor copied
+            std::wstring path = relative.empty() ? data.cFileName : relative + L"\\" + data.cFileName;
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) || IsExcluded(path))
+                continue;
+
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                pending.push_back(std::move(path));
+            }
+            else if (files->size() < kMaxFiles)
+            {
+                uint64_t size = static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+                files->push_back({std::move(path), size, ToUint64(data.ftLastWriteTime), 0});
+            }
+            else
+            {
+                FindClose(find);
+                return false;
+            }
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+    return true;
+}
+
+bool HashFile(const std::wstring &path, uint64_t *hash)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, kShareAll, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    uint8_t *buffer = CopyBuffer();
+    Hasher hasher;
+    DWORD read = 0;
+    bool ok;
+    while ((ok = ReadFile(file, buffer, kCopyChunk, &read, nullptr) != FALSE) && read > 0)
+    {
+        hasher.Update(buffer, read);
+    }
+    CloseHandle(file);
+
+    *hash = hasher.value();
+    return ok;
+}
+
+// Copy and hash in one pass; the target gets `mtime`, so both sides compare equal by metadata
+bool CopyHashed(const std::wstring &from, const std::wstring &to, uint64_t mtime, bool flush, uint64_t *size,
+                uint64_t *hash)
+{
+    HANDLE source = CreateFileW(from.c_str(), GENERIC_READ, kShareAll, nullptr, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (source == INVALID_HANDLE_VALUE)
+        return false;
+
+    CreateParentDirectory(to);
+    HANDLE target = CreateFileW(to.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (target == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source);
+        return false;
+    }
+
+    uint8_t *buffer = CopyBuffer();
+    Hasher hasher;
+    uint64_t total = 0;
+    DWORD read = 0;
+    bool ok;
+    while ((ok = ReadFile(source, buffer, kCopyChunk, &read, nullptr) != FALSE) && read > 0)
+    {
+        DWORD written = 0;
+        if (!WriteFile(target, buffer, read, &written, nullptr) || written != read)
+        {
+            ok = false;
+            break;
+        }
+        hasher.Update(buffer, read);
+        total += read;
+    }
+
+    FILETIME time = ToFileTime(mtime);
+    ok = ok && SetFileTime(target, nullptr, nullptr, &time) && (!flush || FlushFileBuffers(target));
+    CloseHandle(target);
+    CloseHandle(source);
+    if (!ok)
+    {
+        DeleteFileW(to.c_str());
+        return false;
+    }
+
+    *size = total;
+    *hash = hasher.value();
+    return true;
+}
+
+bool SetModifiedTime(const std::wstring &path, uint64_t mtime)
+{
+    HANDLE file = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, kShareAll, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    FILETIME time = ToFileTime(mtime);
+    bool ok = SetFileTime(file, nullptr, nullptr, &time) != FALSE;
+    CloseHandle(file);
+    return ok;
+}
+
+// Never 0 and never the previous id
+uint64_t NewId(uint64_t previous)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    uint64_t id = static_cast<uint64_t>(counter.QuadPart) ^ static_cast<uint64_t>(GetCurrentProcessId()) << 40;
+    id = (id ^ (id >> 30)) * 0xBF58476D1CE4E5B9ull;
+    id = (id ^ (id >> 27)) * 0x94D049BB133111EBull;
+    id ^= id >> 31;
+    return id == 0 || id == previous ? id + 2 : id;
+}
+
+// Id of the manifest the local copy was last synced with, 0 = none
+uint64_t ReadMarker()
+{
+    std::wstring path = local_dir + L"\\" + kMarkerName;
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    uint8_t bytes[8];
+    DWORD read = 0;
+    bool ok = ReadFile(file, bytes, sizeof(bytes), &read, nullptr) && read == sizeof(bytes);
+    CloseHandle(file);
+    return ok ? state_format::LoadLE64(bytes) : 0;
+}
+
+void WriteMarker(uint64_t id)
+{
+    std::wstring path = local_dir + L"\\" + kMarkerName;
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    uint8_t bytes[8];
+    state_format::StoreLE64(bytes, id);
+    DWORD written = 0;
+    WriteFile(file, bytes, sizeof(bytes), &written, nullptr);
+    CloseHandle(file);
+}
+
+void LoadState(Manifest *manifest, std::vector<Op> *journal)
+{
+    for (const wchar_t *name : {state_store::kShadowFile, state_store::kStateFile})
+    {
+        state_store::Snapshot snapshot(name);
+        state_format::Record record;
+        bool found = false;
+        if (snapshot.Find(state_store::kShadowManifest, &record) && record.version == kManifestVersion)
+            found = DecodeManifest(record.data, record.size, manifest);
+        if (snapshot.Find(state_store::kShadowJournal, &record) && record.version == kJournalVersion)
+            found = DecodeJournal(record.data, record.size, journal) || found;
+        if (found)
+        {
+            manifest_file = name;
+            return;
+        }
+    }
+}
+
+std::wstring StagingDir()
+{
+    return portable_dir + L"\\" + kStagingName;
+}
+
+std::wstring StagedPath(uint32_t staged)
+{
+    return StagingDir() + L"\\" + std::to_wstring(staged);
+}
+
+void RemoveStaging()
+{
+    std::wstring directory = StagingDir();
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((directory + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                   nullptr, 0);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            DeleteFileW((directory + L"\\" + data.cFileName).c_str());
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    RemoveDirectoryW(directory.c_str());
+}
+
+// Idempotent, so it can be repeated after an interruption at any point
+bool Apply(const std::vector<Op> &ops)
+{
+    bool ok = true;
+    for (const Op &op : ops)
+    {
+        std::wstring target = portable_dir + L"\\" + op.path;
+        switch (op.kind)
+        {
+        case OpKind::kMove:
+        {
+            // A missing staged file was moved before the interruption
+            std::wstring staged = StagedPath(op.staged);
+            if (GetFileAttributesW(staged.c_str()) == INVALID_FILE_ATTRIBUTES)
+                break;
+
+            CreateParentDirectory(target);
+            if (!MoveFileExW(staged.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+                ok = false;
+            break;
+        }
+        case OpKind::kDelete:
+            if (!DeleteFileW(target.c_str()) && GetLastError() != ERROR_FILE_NOT_FOUND &&
+                GetLastError() != ERROR_PATH_NOT_FOUND)
+                ok = false;
+            break;
+        case OpKind::kTouch:
+            if (!SetModifiedTime(target, op.mtime))
+                ok = false;
+            break;
+        }
+    }
+    return ok;
+}
+
+// Apply a committed journal and drop it, or drop staged files nobody committed
+// False if the journal could not be applied, it is kept for the next attempt
+bool Recover(const std::vector<Op> &journal)
+{
+    if (!journal.empty())
+    {
+        if (!Apply(journal))
+        {
+            WarningLog(L"Shadow: cannot complete the last sync into %s: %lu", portable_dir.c_str(), GetLastError());
+            return false;
+        }
+        state_store::Update([](state_format::Builder &builder) { builder.Remove(state_store::kShadowJournal); },
+                            manifest_file);
+    }
+    RemoveStaging();
+    return true;
+}
+
+bool CopyIn(const FileState &file, FileState *copied)
+{
+    copied->path = file.path;
+    copied->mtime = file.mtime;
+    return CopyHashed(portable_dir + L"\\" + file.path, local_dir + L"\\" + file.path, file.mtime, false,
+                      &copied->size, &copied->hash);
+}
+
+// Cheap check first: copies made by CopyHashed carry the same size and time
+bool LocalMatches(const FileState &entry)
+{
+    std::wstring path = local_dir + L"\\" + entry.path;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        return false;
+
+    uint64_t size = static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+    if (size != entry.size)
+        return false;
+    if (ToUint64(data.ftLastWriteTime) == entry.mtime)
+        return true;
+
+    uint64_t hash;
+    return HashFile(path, &hash) && hash == entry.hash && SetModifiedTime(path, entry.mtime);
+}
+
+// Local files the data directory does not have, only for a copy of unknown age
+void RemoveLocalExtras(const std::vector<FileState> &portable)
+{
+    std::vector<FileState> local;
+    if (!Scan(local_dir, &local))
+        return;
+
+    Delta delta = Compare(portable, local);
+    for (size_t i : delta.changed)
+    {
+        if (delta.base_index[i] == SIZE_MAX)
+            DeleteFileW((local_dir + L"\\" + local[i].path).c_str());
+    }
+}
+
+// With a journal this is the commit point of a sync: both are written in one replace
+// The manifest has a file of its own, so the main state file stays small
+bool SaveManifest(const Manifest &manifest, const std::vector<Op> *journal)
+{
+    std::vector<uint8_t> manifest_bytes = EncodeManifest(manifest);
+    std::vector<uint8_t> journal_bytes = journal ? EncodeJournal(*journal) : std::vector<uint8_t>();
+    bool saved = state_store::Update(
+        [&](state_format::Builder &builder) {
+            builder.Set(state_store::kShadowManifest, kManifestVersion, manifest_bytes.data(), manifest_bytes.size());
+            if (journal)
+                builder.Set(state_store::kShadowJournal, kJournalVersion, journal_bytes.data(), journal_bytes.size());
+            else
+                builder.Remove(state_store::kShadowJournal);
+        },
+        state_store::kShadowFile);
+    if (!saved)
+        return false;
+
+    // Moved out of the main state file, any journal there has been applied by now
+    if (manifest_file != state_store::kShadowFile)
+    {
+        state_store::Update([](state_format::Builder &builder) {
+            builder.Remove(state_store::kShadowManifest);
+            builder.Remove(state_store::kShadowJournal);
+        });
+        manifest_file = state_store::kShadowFile;
+    }
+    return true;
+}
+
+// SQLite writes the database while its journal has contents, and keeps a
+// WAL file while any connection has the database open in WAL mode
+bool IsDatabaseBusy(std::wstring_view unit)
+{
+    std::wstring path = local_dir + L"\\" + std::wstring(unit);
+    if (GetFileAttributesW((path + std::wstring(kWalSuffix)).c_str()) != INVALID_FILE_ATTRIBUTES)
+        return true;
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    return GetFileAttributesExW((path + std::wstring(kJournalSuffix)).c_str(), GetFileExInfoStandard, &data) &&
+           (data.nFileSizeLow != 0 || data.nFileSizeHigh != 0);
+}
+
+// Write changes of the local copy back to the data directory
+// While the browser runs, databases it is writing wait for a later sync
+void Sync(bool browser_running)
+{
+    SyncLock lock;
+    if (!lock.held())
+        return;
+
+    Manifest base;
+    std::vector<Op> journal;
+    LoadState(&base, &journal);
+    std::vector<FileState> local;
+    if (!Recover(journal) || !Scan(local_dir, &local))
+    {
+        WarningLog(L"Shadow: cannot sync %s", local_dir.c_str());
+        return;
+    }
+
+    Delta delta = Compare(base.files, local);
+    Manifest next;
+    next.id = NewId(base.id);
+    next.files.reserve(local.size());
+    for (size_t i : delta.unchanged)
+    {
+        next.files.push_back(base.files[delta.base_index[i]]);
+    }
+
+    std::vector<Op> ops;
+    uint32_t staged = 0;
+    uint64_t written = 0;
+    size_t deferred = 0;
+    for (const auto &unit : GroupByUnit(local, delta.changed))
+    {
+        // The data directory keeps the last consistent version of a busy database
+        std::wstring_view unit_path = UnitOf(local[unit.front()].path);
+        bool busy = browser_running && IsDatabaseBusy(unit_path);
+        size_t first_op = ops.size();
+        size_t first_file = next.files.size();
+        for (size_t i : unit)
+        {
+            if (busy)
+                break;
+
+            const FileState &file = local[i];
+            const FileState *entry = delta.base_index[i] == SIZE_MAX ? nullptr : &base.files[delta.base_index[i]];
+            std::wstring path = local_dir + L"\\" + file.path;
+
+            // Rewritten with the same contents, only the time has to follow
+            uint64_t hash;
+            if (entry && entry->size == file.size && HashFile(path, &hash) && hash == entry->hash)
+            {
+                ops.push_back({OpKind::kTouch, 0, file.mtime, file.path});
+                next.files.push_back({file.path, file.size, file.mtime, hash});
+                continue;
+            }
+
+            // A file written during the copy keeps a newer time than recorded here and goes again next sync
+            FileState copy{file.path, 0, file.mtime, 0};
+            if (!CopyHashed(path, StagedPath(staged), file.mtime, true, &copy.size, &copy.hash))
+            {
+                // Gone or locked since the scan, the data directory keeps its version for now
+                if (entry)
+                    next.files.push_back(*entry);
+                continue;
+            }
+            ops.push_back({OpKind::kMove, staged++, file.mtime, file.path});
+            written += copy.size;
+            next.files.push_back(std::move(copy));
+        }
+
+        // A transaction that started during the copy may have torn it: drop the whole unit
+        if (!busy && browser_running && IsDatabaseBusy(unit_path))
+            busy = true;
+        if (busy)
+        {
+            for (size_t op = first_op; op < ops.size(); op++)
+            {
+                if (ops[op].kind == OpKind::kMove)
+                    DeleteFileW(StagedPath(ops[op].staged).c_str());
+            }
+            ops.resize(first_op);
+            next.files.resize(first_file);
+            for (size_t i : unit)
+            {
+                if (delta.base_index[i] != SIZE_MAX)
+                    next.files.push_back(base.files[delta.base_index[i]]);
+            }
+            deferred++;
+        }
+    }
+    for (size_t i : delta.removed)
+    {
+        // A side file that disappeared belongs to a database that may be busy again
+        const FileState &entry = base.files[i];
+        if (browser_running && IsDatabaseBusy(UnitOf(entry.path)))
+        {
+            next.files.push_back(entry);
+            continue;
+        }
+        ops.push_back({OpKind::kDelete, 0, 0, entry.path});
+    }
+
+    if (deferred)
+        DebugLog(L"Shadow: %zu databases in use, synced later", deferred);
+    if (ops.empty())
+        return;
+
+    if (!SaveManifest(next, &ops))
+    {
+        RemoveStaging();
+        return;
+    }
+
+    // The local copy matches the new manifest even if applying stops halfway
+    WriteMarker(next.id);
+    Recover(ops);
+
+    DebugLog(L"Shadow: synced %zu changes (%u files, %llu KB) into %s", ops.size(), staged, written / 1024,
+             portable_dir.c_str());
+}
+
+}  // namespace
+
+bool IsEnabled()
+{
+    return GetConfig().IsShadowEnabled();
+}
+
+std::wstring Prepare(const std::wstring &data_dir)
+{
+    portable_dir = GetAbsolutePath(data_dir);
+    while (portable_dir.size() > 3 && portable_dir.back() == L'\\')
+    {
+        portable_dir.pop_back();
+    }
+    local_dir = LocalDirFor(portable_dir);
+
+    // This launch hands over to the running browser, which keeps its session
+    if (IsProfileInUse(local_dir))
+        return local_dir;
+
+    SyncLock lock;
+    if (!lock.held())
+    {
+        WarningLog(L"Shadow: %s is busy, running from it directly", portable_dir.c_str());
+        return L"";
+    }
+
+    Manifest base;
+    std::vector<Op> journal;
+    LoadState(&base, &journal);
+    std::vector<FileState> portable;
+    if (!Recover(journal) || !Scan(portable_dir, &portable))
+    {
+        WarningLog(L"Shadow: cannot read %s, running from it directly", portable_dir.c_str());
+        return L"";
+    }
+
+    // A copy made from the current manifest is at least as new as the data
+    // directory for every file the data directory did not change since
+    SHCreateDirectoryExW(nullptr, local_dir.c_str(), nullptr);
+    bool linked = base.id != 0 && ReadMarker() == base.id;
+    Delta delta = Compare(base.files, portable);
+
+    // A database and its side files are replaced together: a side file left
+    // over from the other version would be replayed into the wrong database
+    std::unordered_set<std::wstring> replaced;
+    AddUnitKeys(portable, delta.changed, &replaced);
+    AddUnitKeys(base.files, delta.removed, &replaced);
+
+    // Changes the last session could not sync back are overwritten, say so
+    std::vector<FileState> local;
+    if (linked && !replaced.empty() && Scan(local_dir, &local))
+    {
+        Delta local_delta = Compare(base.files, local);
+        std::unordered_set<std::wstring> local_changed;
+        AddUnitKeys(local, local_delta.changed, &local_changed);
+        AddUnitKeys(base.files, local_delta.removed, &local_changed);
+        for (const auto &unit : local_changed)
+        {
+            if (replaced.count(unit))
+                WarningLog(L"Shadow: %s changed both in %s and in the local copy, keeping the data directory version",
+                           unit.c_str(), portable_dir.c_str());
+        }
+    }
+
+    Manifest next;
+    next.id = base.id ? base.id : NewId(0);
+    next.files.reserve(portable.size());
+    size_t copied = 0;
+    for (size_t i : delta.unchanged)
+    {
+        const FileState &entry = base.files[delta.base_index[i]];
+        FileState file = entry;
+        bool verify = !linked || replaced.count(PathKey(UnitOf(entry.path)));
+        if (verify && !LocalMatches(entry))
+        {
+            if (!CopyIn(entry, &file))
+            {
+                WarningLog(L"Shadow: cannot copy %s, running from the data directory", entry.path.c_str());
+                return L"";
+            }
+            copied++;
+        }
+        next.files.push_back(std::move(file));
+    }
+
+    // Changed on the portable media since the last sync (another computer or a
+    // run without shadow): the data directory wins
+    for (size_t i : delta.changed)
+    {
+        FileState file;
+        if (!CopyIn(portable[i], &file))
+        {
+            WarningLog(L"Shadow: cannot copy %s, running from the data directory", portable[i].path.c_str());
+            return L"";
+        }
+        next.files.push_back(std::move(file));
+        copied++;
+    }
+    for (size_t i : delta.removed)
+    {
+        DeleteFileW((local_dir + L"\\" + base.files[i].path).c_str());
+    }
+
+    // Local members of a replaced unit the data directory does not have, such as a WAL
+    std::unordered_set<std::wstring> present;
+    for (const auto &file : portable)
+    {
+        present.insert(PathKey(file.path));
+    }
+    for (const auto &file : local)
+    {
+        if (replaced.count(PathKey(UnitOf(file.path))) && !present.count(PathKey(file.path)))
+            DeleteFileW((local_dir + L"\\" + file.path).c_str());
+    }
+    if (!linked)
+        RemoveLocalExtras(portable);
+
+    if (base.id == 0 || !delta.changed.empty() || !delta.removed.empty())
+    {
+        if (!SaveManifest(next, nullptr))
+            return L"";
+    }
+    WriteMarker(next.id);
+    session_started = true;
+
+    DebugLog(L"Shadow: %s -> %s, copied %zu of %zu files%s", portable_dir.c_str(), local_dir.c_str(), copied,
+             portable.size(), linked ? L"" : L" (new copy)");
+    return local_dir;
+}
+
+void RunSession(HANDLE browser)
+{
+    if (!session_started)
+    {
+        if (browser)
+            CloseHandle(browser);
+        return;
+    }
+
+    // Waiting and syncing must not compete with the browser
+    SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN);
+
+    // Without a process handle the session is tracked by the profile lock alone
+    for (int i = 0; !browser && i < kStartupPolls && !IsProfileInUse(local_dir); i++)
+    {
+        Sleep(kPollMs);
+    }
+
+    // A browser restart starts a new process on the same profile: follow the lock
+    ULONGLONG interval = GetConfig().GetShadowSyncMinutes() * 60000ull;
+    ULONGLONG next_sync = GetTickCount64() + interval;
+    for (;;)
+    {
+        if (browser)
+        {
+            if (WaitForSingleObject(browser, kPollMs) == WAIT_OBJECT_0)
+            {
+                CloseHandle(browser);
+                browser = nullptr;
+            }
+        }
+        else if (IsProfileInUse(local_dir))
+        {
+            Sleep(kPollMs);
+        }
+        else
+        {
+            break;
+        }
+
+        if (interval && GetTickCount64() >= next_sync)
+        {
+            Sync(true);
+            next_sync = GetTickCount64() + interval;
+        }
+    }
+
+    // The browser is gone, every database is closed
+    Sync(false);
+}
+
+}  // namespace shadow
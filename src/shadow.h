@@ -0,0 +1,37 @@
+#ifndef VIVALDI_PLUS_SHADOW_H_
+#define VIVALDI_PLUS_SHADOW_H_
+
+//
+// Profile shadow ([dir_setting] shadow): run the browser from a copy of the
+// data directory on the local disk and sync changes back to the portable
+// media, so SQLite syncs and cache writes never wait for slow flash.
+// The portable stub prepares the copy before the relaunch, then stays in the
+// background, syncs periodically and once more after the browser has exited.
+// Syncs only write files whose content hash changed; they are staged on the
+// portable media and committed through a journal next to the manifest in
+// vivaldi_plus.shadow.state, so an interrupted sync is completed on the next
+// launch. While the browser runs, a database with an open WAL or a hot
+// journal is left for a later sync; the last sync after exit takes all.
+//
+
+#include <windows.h>
+
+#include <string>
+
+namespace shadow
+{
+
+bool IsEnabled();
+
+// Bring the local copy up to date with `data_dir`
+// Returns the directory to pass as --user-data-dir, empty = use data_dir directly
+std::wstring Prepare(const std::wstring &data_dir);
+
+// Stub after the relaunch: sync until the browser session ends, then sync back
+// Takes ownership of `browser` (may be nullptr); returns at once unless Prepare
+// started a session
+void RunSession(HANDLE browser);
+
+}  // namespace shadow
+
+#endif  // VIVALDI_PLUS_SHADOW_H_
@@ -0,0 +1,360 @@
+#ifndef VIVALDI_PLUS_SHADOW_MANIFEST_H_
+#define VIVALDI_PLUS_SHADOW_MANIFEST_H_
+
+// Platform-neutral part of the profile shadow (shadow.h).
+// The manifest describes the data directory on the portable media as of the
+// last sync: size, modification time and content hash of every file. A scan
+// is compared against it by size and time only; contents are hashed just for
+// files whose metadata changed, and only files whose hash changed are copied.
+// The journal lists the operations of one sync so an interrupted sync can be
+// finished on the next launch. A SQLite database and its side files form one
+// unit that is copied, skipped or replaced as a whole.
+//
+// Manifest record layout (little endian), version kManifestVersion:
+//   0  id, changes with every sync back
+//   8  file count
+//  12  files: size (8 bytes), modification time (8 bytes), hash (8 bytes),
+//      path length in UTF-16 units (2 bytes), path (UTF-16)
+//
+// Journal record layout, version kJournalVersion:
+//   0  operation count
+//   4  operations: kind (1 byte), reserved (1 byte), path length (2 bytes),
+//      staged file number (4 bytes), modification time (8 bytes), path (UTF-16)
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wctype.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "path_compare.h"
+#include "state_format.h"
+
+namespace shadow
+{
+
+constexpr uint16_t kManifestVersion = 1;
+constexpr uint16_t kJournalVersion = 1;
+constexpr size_t kMaxFiles = 65536;
+
+// Regenerable caches and crash dumps stay on the disk they were written to
+// Matched against any path component
+constexpr std::wstring_view kSkippedDirectories[] = {
+    L"Code Cache", L"GPUCache",          L"GrShaderCache",    L"ShaderCache",
+    L"DawnCache",  L"DawnGraphiteCache", L"DawnWebGPUCache", L"Crashpad",
+};
+
+// Top-level names owned by the browser session or by us (log, state, staging)
+constexpr std::wstring_view kLockFile = L"lockfile";
+constexpr std::wstring_view kOwnPrefix = L"vivaldi_plus.";
+
+// SQLite side files, next to the database they belong to
+constexpr std::wstring_view kWalSuffix = L"-wal";
+constexpr std::wstring_view kJournalSuffix = L"-journal";
+constexpr std::wstring_view kDatabaseSideSuffixes[] = {kWalSuffix, kJournalSuffix, L"-shm"};
+
+struct FileState
+{
+    std::wstring path;  // Relative to the data directory
+    uint64_t size;
+    uint64_t mtime;  // Last write time, FILETIME units
+    uint64_t hash;
+};
+
+struct Manifest
+{
+    uint64_t id = 0;  // 0 = no manifest yet
+    std::vector<FileState> files;
+};
+
+enum class OpKind : uint8_t
+{
+    kMove,    // Replace the file with staged file `staged`
+    kDelete,  // Delete the file
+    kTouch,   // Contents are current, only set the modification time
+};
+
+struct Op
+{
+    OpKind kind;
+    uint32_t staged;
+    uint64_t mtime;
+    std::wstring path;
+};
+
+// FNV-1a 64, fed in chunks while a file is read or copied
+class Hasher
+{
+public:
+    void Update(const uint8_t *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash_ = (hash_ ^ data[i]) * 1099511628211ull;
+        }
+    }
+
+    uint64_t value() const
+    {
+        return hash_;
+    }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+// Relative paths as separated by the scanner: single backslashes, no leading one
+inline bool IsExcluded(std::wstring_view path)
+{
+    size_t slash = path.find(L'\\');
+    std::wstring_view top = path.substr(0, slash);
+    if (slash == std::wstring_view::npos && path_compare::EqualsIgnoreCase(top, kLockFile))
+        return true;
+    if (path_compare::EqualsIgnoreCase(top.substr(0, kOwnPrefix.size()), kOwnPrefix))
+        return true;
+
+    while (!path.empty())
+    {
+        slash = path.find(L'\\');
+        std::wstring_view component = path.substr(0, slash);
+        for (std::wstring_view skipped : kSkippedDirectories)
+        {
+            if (path_compare::EqualsIgnoreCase(component, skipped))
+                return true;
+        }
+        path = slash == std::wstring_view::npos ? std::wstring_view() : path.substr(slash + 1);
+    }
+    return false;
+}
+
+inline std::wstring PathKey(std::wstring_view path)
+{
+    std::wstring key(path);
+    for (wchar_t &ch : key)
+    {
+        ch = static_cast<wchar_t>(towlower(ch));
+    }
+    return key;
+}
+
+// The database a side file belongs to, the path itself for any other file
+inline std::wstring_view UnitOf(std::wstring_view path)
+{
+    for (std::wstring_view suffix : kDatabaseSideSuffixes)
+    {
+        if (path.size() > suffix.size() &&
+            path_compare::EqualsIgnoreCase(path.substr(path.size() - suffix.size()), suffix))
+            return path.substr(0, path.size() - suffix.size());
+    }
+    return path;
+}
+
+// `indices` into `files` grouped by unit, in order of first appearance
+inline std::vector<std::vector<size_t>> GroupByUnit(const std::vector<FileState> &files,
+                                                    const std::vector<size_t> &indices)
+{
+    std::vector<std::vector<size_t>> groups;
+    std::unordered_map<std::wstring, size_t> group_of;
+    for (size_t i : indices)
+    {
+        auto [it, added] = group_of.emplace(PathKey(UnitOf(files[i].path)), groups.size());
+        if (added)
+            groups.emplace_back();
+        groups[it->second].push_back(i);
+    }
+    return groups;
+}
+
+// Unit keys (PathKey of UnitOf) of `indices` into `files`
+inline void AddUnitKeys(const std::vector<FileState> &files, const std::vector<size_t> &indices,
+                        std::unordered_set<std::wstring> *keys)
+{
+    for (size_t i : indices)
+    {
+        keys->insert(PathKey(UnitOf(files[i].path)));
+    }
+}
+
+// Result of comparing a scan with a manifest by size and modification time
+struct Delta
+{
+    std::vector<size_t> unchanged;   // Scan indices matching their manifest entry
+    std::vector<size_t> changed;     // Scan indices that are new or differ
+    std::vector<size_t> removed;     // Manifest indices missing from the scan
+    std::vector<size_t> base_index;  // Manifest index per scan index, SIZE_MAX = new file
+};
+
+inline Delta Compare(const std::vector<FileState> &base, const std::vector<FileState> &scan)
+{
+    std::unordered_map<std::wstring, size_t> index;
+    index.reserve(base.size());
+    for (size_t i = 0; i < base.size(); i++)
+    {
+        index.emplace(PathKey(base[i].path), i);
+    }
+
+    Delta delta;
+    std::vector<bool> seen(base.size(), false);
+    delta.base_index.resize(scan.size(), SIZE_MAX);
+    for (size_t i = 0; i < scan.size(); i++)
+    {
+        auto it = index.find(PathKey(scan[i].path));
+        if (it == index.end())
+        {
+            delta.changed.push_back(i);
+            continue;
+        }
+
+        const FileState &entry = base[it->second];
+        seen[it->second] = true;
+        delta.base_index[i] = it->second;
+        if (entry.size == scan[i].size && entry.mtime == scan[i].mtime)
+        {
+            delta.unchanged.push_back(i);
+        }
+        else
+        {
+            delta.changed.push_back(i);
+        }
+    }
+
+    for (size_t i = 0; i < base.size(); i++)
+    {
+        if (!seen[i])
+            delta.removed.push_back(i);
+    }
+    return delta;
+}
+
+inline std::vector<uint8_t> EncodeManifest(const Manifest &manifest)
+{
+    std::vector<uint8_t> bytes(12);
+    state_format::StoreLE64(bytes.data(), manifest.id);
+    state_format::StoreLE32(bytes.data() + 8, static_cast<uint32_t>(manifest.files.size()));
+    for (const auto &file : manifest.files)
+    {
+        size_t length = file.path.size() < UINT16_MAX ? file.path.size() : UINT16_MAX;
+        size_t offset = bytes.size();
+        bytes.resize(offset + 26 + length * 2);
+
+        uint8_t *out = bytes.data() + offset;
+        state_format::StoreLE64(out, file.size);
+        state_format::StoreLE64(out + 8, file.mtime);
+        state_format::StoreLE64(out + 16, file.hash);
+        state_format::StoreLE16(out + 24, static_cast<uint16_t>(length));
+        for (size_t i = 0; i < length; i++)
+        {
+            state_format::StoreLE16(out + 26 + i * 2, static_cast<uint16_t>(file.path[i]));
+        }
+    }
+    return bytes;
+}
+
+// False (and an empty manifest) if the record is malformed
+inline bool DecodeManifest(const uint8_t *data, size_t size, Manifest *manifest)
+{
+    manifest->id = 0;
+    manifest->files.clear();
+    if (size < 12)
+        return false;
+
+    size_t count = state_format::LoadLE32(data + 8);
+    if (count > kMaxFiles)
+        return false;
+
+    size_t offset = 12;
+    for (size_t i = 0; i < count && size - offset >= 26; i++)
+    {
+        const uint8_t *in = data + offset;
+        size_t length = state_format::LoadLE16(in + 24);
+        if (size - offset - 26 < length * 2)
+            break;
+
+        FileState file{{}, state_format::LoadLE64(in), state_format::LoadLE64(in + 8), state_format::LoadLE64(in + 16)};
+        file.path.resize(length);
+        for (size_t j = 0; j < length; j++)
+        {
+            file.path[j] = static_cast<wchar_t>(state_format::LoadLE16(in + 26 + j * 2));
+        }
+        manifest->files.push_back(std::move(file));
+        offset += 26 + length * 2;
+    }
+
+    if (manifest->files.size() != count || offset != size)
+    {
+        manifest->files.clear();
+        return false;
+    }
+    manifest->id = state_format::LoadLE64(data);
+    return true;
+}
+
+inline std::vector<uint8_t> EncodeJournal(const std::vector<Op> &ops)
+{
+    std::vector<uint8_t> bytes(4);
+    state_format::StoreLE32(bytes.data(), static_cast<uint32_t>(ops.size()));
+    for (const auto &op : ops)
+    {
+        size_t length = op.path.size() < UINT16_MAX ? op.path.size() : UINT16_MAX;
+        size_t offset = bytes.size();
+        bytes.resize(offset + 16 + length * 2);
+
+        uint8_t *out = bytes.data() + offset;
+        out[0] = static_cast<uint8_t>(op.kind);
+        out[1] = 0;
+        state_format::StoreLE16(out + 2, static_cast<uint16_t>(length));
+        state_format::StoreLE32(out + 4, op.staged);
+        state_format::StoreLE64(out + 8, op.mtime);
+        for (size_t i = 0; i < length; i++)
+        {
+            state_format::StoreLE16(out + 16 + i * 2, static_cast<uint16_t>(op.path[i]));
+        }
+    }
+    return bytes;
+}
+
+inline bool DecodeJournal(const uint8_t *data, size_t size, std::vector<Op> *ops)
+{
+    ops->clear();
+    if (size < 4)
+        return false;
+
+    size_t count = state_format::LoadLE32(data);
+    if (count > kMaxFiles * 2)
+        return false;
+
+    size_t offset = 4;
+    for (size_t i = 0; i < count && size - offset >= 16; i++)
+    {
+        const uint8_t *in = data + offset;
+        size_t length = state_format::LoadLE16(in + 2);
+        if (in[0] > static_cast<uint8_t>(OpKind::kTouch) || size - offset - 16 < length * 2)
+            break;
+
+        Op op{static_cast<OpKind>(in[0]), state_format::LoadLE32(in + 4), state_format::LoadLE64(in + 8), {}};
+        op.path.resize(length);
+        for (size_t j = 0; j < length; j++)
+        {
+            op.path[j] = static_cast<wchar_t>(state_format::LoadLE16(in + 16 + j * 2));
+        }
+        ops->push_back(std::move(op));
+        offset += 16 + length * 2;
+    }
+
+    if (ops->size() != count || offset != size)
+    {
+        ops->clear();
+        return false;
+    }
+    return true;
+}
+
+}  // namespace shadow
+
+#endif  // VIVALDI_PLUS_SHADOW_MANIFEST_H_
@@ -0,0 +1,249 @@
+#ifndef VIVALDI_PLUS_SQLITE_MAINTENANCE_H_
+#define VIVALDI_PLUS_SQLITE_MAINTENANCE_H_
+
+//
+// SQLite profile maintenance ([maintenance] sqlite): the portable stub
+// compacts the browser databases that bloat the most (History, Favicons,
+// Cookies, ...) before it relaunches the browser, while no browser holds the
+// profile. At most once a day the database headers are inspected; the worst
+// databases get a WAL checkpoint or a VACUUM within the time budget
+// (sqlite_plan.h). Results are kept in the state file and in the debug log.
+// SQLite is the system winsqlite3.dll, without it nothing happens.
+//
+
+#include <windows.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "sqlite_plan.h"
+#include "state_store.h"
+#include "utils.h"
+
+namespace sqlite_maintenance
+{
+
+constexpr wchar_t kLibrary[] = L"winsqlite3.dll";
+
+// Databases that grow with use, relative to a profile directory
+constexpr const wchar_t *kDatabaseNames[] = {
+    L"History",   L"Favicons",  L"Network\\Cookies", L"Cookies",    L"Web Data",
+    L"Top Sites", L"Shortcuts", L"Network Action Predictor", L"Login Data",
+};
+
+inline bool IsEnabled()
+{
+    return GetConfig().IsSqliteMaintenanceEnabled();
+}
+
+inline const wchar_t *ActionName(Action action)
+{
+    switch (action)
+    {
+    case Action::kCheckpoint:
+        return L"checkpoint";
+    case Action::kIncrementalVacuum:
+        return L"incremental vacuum";
+    default:
+        return L"vacuum";
+    }
+}
+
+inline const wchar_t *OutcomeName(Outcome outcome)
+{
+    switch (outcome)
+    {
+    case Outcome::kDone:
+        return L"done";
+    case Outcome::kBusy:
+        return L"busy";
+    case Outcome::kTimeout:
+        return L"timeout";
+    default:
+        return L"failed";
+    }
+}
+
+inline uint64_t FileTimeNow()
+{
+    FILETIME time;
+    GetSystemTimeAsFileTime(&time);
+    return static_cast<uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+}
+
+inline std::string ToUtf8(const std::wstring &text)
+{
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string result(size > 0 ? size - 1 : 0, '\0');
+    if (size > 1)
+        WideCharToMultiByte(CP_UTF8, 0, text.c_str(), -1, result.data(), size, nullptr, nullptr);
+    return result;
+}
+
+inline uint64_t FileSize(const std::wstring &path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    return static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+}
+
+// Reads the header only; false if the file is missing or no SQLite database
+inline bool Inspect(const std::wstring &data_dir, std::wstring relative, std::vector<Database> *databases)
+{
+    std::wstring path = data_dir + L"\\" + relative;
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    uint8_t bytes[100];
+    DWORD read = 0;
+    LARGE_INTEGER size;
+    bool ok = ReadFile(file, bytes, sizeof(bytes), &read, nullptr) && GetFileSizeEx(file, &size);
+    CloseHandle(file);
+
+    Database database{std::move(relative), 0, 0, 0, {}};
+    if (!ok || !ParseHeader(bytes, read, size.QuadPart, &database.header))
+        return false;
+
+    database.size = size.QuadPart;
+    database.wal_size = FileSize(path + L"-wal");
+    database.journal_size = FileSize(path + L"-journal");
+    databases->push_back(std::move(database));
+    return true;
+}
+
+// Known databases of "Default" and every "Profile N"
+inline std::vector<Database> InspectProfiles(const std::wstring &data_dir)
+{
+    std::vector<std::wstring> profiles{L"Default"};
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((data_dir + L"\\Profile *").c_str(), FindExInfoBasic, &data,
+                                   FindExSearchLimitToDirectories, nullptr, 0);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                profiles.push_back(data.cFileName);
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+
+    std::vector<Database> databases;
+    for (const auto &profile : profiles)
+    {
+        for (const wchar_t *name : kDatabaseNames)
+        {
+            Inspect(data_dir, profile + L"\\" + name, &databases);
+        }
+    }
+    return databases;
+}
+
+inline bool LoadApi(HMODULE module, SqliteApi *api)
+{
+    api->open_v2 = reinterpret_cast<decltype(api->open_v2)>(GetProcAddress(module, "sqlite3_open_v2"));
+    api->close = reinterpret_cast<decltype(api->close)>(GetProcAddress(module, "sqlite3_close"));
+    api->exec = reinterpret_cast<decltype(api->exec)>(GetProcAddress(module, "sqlite3_exec"));
+    api->busy_timeout = reinterpret_cast<decltype(api->busy_timeout)>(GetProcAddress(module, "sqlite3_busy_timeout"));
+    api->progress_handler =
+        reinterpret_cast<decltype(api->progress_handler)>(GetProcAddress(module, "sqlite3_progress_handler"));
+    return api->open_v2 && api->close && api->exec && api->busy_timeout && api->progress_handler;
+}
+
+// One maintenance pass over the profiles in `data_dir` (the directory the
+// browser is about to use); blocks for at most the time budget
+inline void Maintain(const std::wstring &data_dir)
+{
+    // One pass per data directory at a time, a second launch waits for it and then finds it done
+    DWORD budget_ms = GetConfig().GetSqliteTimeBudgetSeconds() * 1000;
+    std::wstring key = data_dir;
+    CharLowerBuffW(key.data(), static_cast<DWORD>(key.size()));
+    wchar_t mutex_name[64];
+    swprintf_s(mutex_name, L"Local\\VivaldiPlusSqlite.%08X",
+               state_format::Checksum(reinterpret_cast<const uint8_t *>(key.data()), key.size() * sizeof(wchar_t)));
+    HANDLE mutex = CreateMutexW(nullptr, FALSE, mutex_name);
+    if (!mutex)
+        return;
+    DWORD wait = WaitForSingleObject(mutex, budget_ms + 1000);
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+    {
+        CloseHandle(mutex);
+        return;
+    }
+
+    Results results;
+    {
+        state_store::Snapshot snapshot;
+        state_format::Record record;
+        if (snapshot.Find(state_store::kSqliteMaintenance, &record) && record.version == kResultsVersion)
+            DecodeResults(record.data, record.size, &results);
+    }
+
+    uint64_t now = FileTimeNow();
+    if (now - results.last_pass >= kPassInterval && !IsProfileInUse(data_dir))
+    {
+        auto begin = std::chrono::steady_clock::now();
+        auto deadline = begin + std::chrono::milliseconds(budget_ms);
+        std::vector<Database> databases = InspectProfiles(data_dir);
+        std::vector<Task> tasks = Plan(databases, results, now, budget_ms);
+
+        HMODULE module = nullptr;
+        SqliteApi api;
+        if (!tasks.empty())
+        {
+            module = LoadLibraryExW(kLibrary, nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+            if (!module || !LoadApi(module, &api))
+            {
+                WarningLog(L"SQLite maintenance: %s not available: %d", kLibrary, GetLastError());
+                tasks.clear();
+            }
+        }
+
+        std::vector<Result> fresh;
+        for (const auto &task : tasks)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (start >= deadline)
+                break;
+
+            const Database &database = databases[task.database];
+            uint64_t size_after = 0;
+            Outcome outcome =
+                Run(api, ToUtf8(data_dir + L"\\" + database.path).c_str(), task.action, deadline, &size_after);
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            fresh.push_back({database.path, FileTimeNow(), database.size, size_after,
+                             static_cast<uint32_t>(duration.count()), task.action, outcome});
+
+            DebugLog(L"SQLite maintenance: %s %s %s, %llu KB -> %llu KB in %lld ms", database.path.c_str(),
+                     ActionName(task.action), OutcomeName(outcome), database.size >> 10, size_after >> 10,
+                     static_cast<long long>(duration.count()));
+        }
+        if (module)
+            FreeLibrary(module);
+
+        auto elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        DebugLog(L"SQLite maintenance: %zu databases inspected, %zu maintained in %lld ms", databases.size(),
+                 fresh.size(), static_cast<long long>(elapsed.count()));
+
+        Merge(&results, std::move(fresh), now);
+        std::vector<uint8_t> bytes = EncodeResults(results);
+        state_store::Update([&bytes](state_format::Builder &builder) {
+            builder.Set(state_store::kSqliteMaintenance, kResultsVersion, bytes.data(), bytes.size());
+        });
+    }
+
+    ReleaseMutex(mutex);
+    CloseHandle(mutex);
+}
+
+}  // namespace sqlite_maintenance
+
+#endif  // VIVALDI_PLUS_SQLITE_MAINTENANCE_H_
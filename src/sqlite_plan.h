@@ -0,0 +1,432 @@
+#ifndef VIVALDI_PLUS_SQLITE_PLAN_H_
+#define VIVALDI_PLUS_SQLITE_PLAN_H_
+
+// Platform-neutral part of the SQLite profile maintenance (sqlite_maintenance.h).
+// Fragmentation is judged from the 100-byte database header (free list pages
+// against all pages) and the size of the write-ahead log, so databases that
+// need nothing are never opened. The worst databases get a WAL checkpoint,
+// an incremental vacuum or a full VACUUM, as long as the estimated time fits
+// the budget; the engine aborts a statement that overruns it, which rolls it
+// back. SQLite is reached through a table of entry points, the system
+// winsqlite3.dll on Windows.
+//
+// Results record layout (little endian), version kResultsVersion:
+//   0  time of the last pass, FILETIME units
+//   8  result count
+//  12  results: time (8 bytes), size before (8 bytes), size after (8 bytes),
+//      duration in ms (4 bytes), action (1 byte), outcome (1 byte),
+//      path length in UTF-16 units (2 bytes), path (UTF-16)
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "state_format.h"
+
+struct sqlite3;
+
+// winsqlite3.dll uses __stdcall for its exports and callbacks
+#if defined(_WIN32) && !defined(_WIN64)
+#define VIVALDI_PLUS_SQLITE_CALL __stdcall
+#else
+#define VIVALDI_PLUS_SQLITE_CALL
+#endif
+
+namespace sqlite_maintenance
+{
+
+constexpr uint16_t kResultsVersion = 1;
+constexpr size_t kMaxResults = 64;
+
+constexpr uint64_t kFileTimeDay = 24ull * 60 * 60 * 10000000;
+constexpr uint64_t kPassInterval = kFileTimeDay;        // Databases are inspected at most once a day
+constexpr uint64_t kVacuumInterval = 7 * kFileTimeDay;  // A database is rebuilt at most once a week
+
+constexpr uint64_t kMinWalBytes = 4ull << 20;
+constexpr uint64_t kMinFreeBytes = 4ull << 20;
+constexpr uint64_t kMinFreePercent = 10;
+constexpr uint64_t kDefaultBytesPerMs = 20ull << 10;  // About 20 MB/s until a VACUUM was timed
+
+enum class Action : uint8_t
+{
+    kCheckpoint,         // Copy the WAL into the database and truncate it
+    kIncrementalVacuum,  // Release free pages of an auto_vacuum=incremental database
+    kVacuum,             // Rebuild the database, then refresh existing statistics
+};
+
+enum class Outcome : uint8_t
+{
+    kDone,
+    kBusy,     // In use by another connection
+    kTimeout,  // Aborted at the deadline and rolled back
+    kFailed,
+};
+
+struct Header
+{
+    uint32_t page_size;
+    uint32_t page_count;
+    uint32_t freelist_count;
+    bool wal;          // journal_mode=WAL
+    bool incremental;  // auto_vacuum=incremental
+};
+
+struct Database
+{
+    std::wstring path;  // Relative to the data directory
+    uint64_t size;
+    uint64_t wal_size;
+    uint64_t journal_size;  // Non-empty rollback journal = interrupted transaction
+    Header header;
+};
+
+struct Task
+{
+    size_t database;  // Index into the inspected databases
+    Action action;
+    uint64_t reclaimable;
+    uint64_t estimate_ms;
+};
+
+struct Result
+{
+    std::wstring path;
+    uint64_t time;
+    uint64_t size_before;
+    uint64_t size_after;
+    uint32_t duration_ms;
+    Action action;
+    Outcome outcome;
+};
+
+struct Results
+{
+    uint64_t last_pass = 0;
+    std::vector<Result> entries;
+};
+
+// SQLite entry points used, see sqlite3.h
+using ExecCallback = int(VIVALDI_PLUS_SQLITE_CALL *)(void *, int, char **, char **);
+using ProgressCallback = int(VIVALDI_PLUS_SQLITE_CALL *)(void *);
+
+struct SqliteApi
+{
+    int(VIVALDI_PLUS_SQLITE_CALL *open_v2)(const char *, sqlite3 **, int, const char *);
+    int(VIVALDI_PLUS_SQLITE_CALL *close)(sqlite3 *);
+    int(VIVALDI_PLUS_SQLITE_CALL *exec)(sqlite3 *, const char *, ExecCallback, void *, char **);
+    int(VIVALDI_PLUS_SQLITE_CALL *busy_timeout)(sqlite3 *, int);
+    void(VIVALDI_PLUS_SQLITE_CALL *progress_handler)(sqlite3 *, int, ProgressCallback, void *);
+};
+
+// Result codes and open flags of sqlite3.h
+constexpr int kSqliteOk = 0;
+constexpr int kSqliteBusy = 5;
+constexpr int kSqliteLocked = 6;
+constexpr int kSqliteInterrupt = 9;
+constexpr int kSqliteOpenReadWrite = 0x00000002;
+
+inline uint32_t LoadBE16(const uint8_t *in)
+{
+    return static_cast<uint32_t>(in[0]) << 8 | in[1];
+}
+
+inline uint32_t LoadBE32(const uint8_t *in)
+{
+    return static_cast<uint32_t>(in[0]) << 24 | static_cast<uint32_t>(in[1]) << 16 |
+           static_cast<uint32_t>(in[2]) << 8 | in[3];
+}
+
+// False if `data` does not start with a valid SQLite 3 header
+inline bool ParseHeader(const uint8_t *data, size_t size, uint64_t file_size, Header *header)
+{
+    static constexpr char kMagic[] = "SQLite format 3";
+    if (size < 100 || !std::equal(kMagic, kMagic + sizeof(kMagic), data))
+        return false;
+
+    // Page size is a power of two from 512 to 65536, which is stored as 1
+    uint32_t page_size = LoadBE16(data + 16);
+    if (page_size == 1)
+        page_size = 65536;
+    if (page_size < 512 || (page_size & (page_size - 1)) != 0)
+        return false;
+
+    header->page_size = page_size;
+    header->wal = data[18] == 2 && data[19] == 2;
+    header->freelist_count = LoadBE32(data + 36);
+    header->incremental = LoadBE32(data + 52) != 0 && LoadBE32(data + 64) != 0;
+
+    // The in-header page count is only valid if the version-valid-for number
+    // matches the change counter, older writers do not maintain it
+    uint32_t page_count = LoadBE32(data + 28);
+    if (page_count == 0 || LoadBE32(data + 24) != LoadBE32(data + 92))
+        page_count = static_cast<uint32_t>(std::min<uint64_t>(file_size / page_size, UINT32_MAX));
+    header->page_count = page_count;
+    return header->freelist_count <= header->page_count;
+}
+
+inline const Result *FindResult(const Results &results, std::wstring_view path)
+{
+    for (const auto &result : results.entries)
+    {
+        if (result.path == path)
+            return &result;
+    }
+    return nullptr;
+}
+
+// VACUUM speed of the last timed rebuild
+inline uint64_t EstimateBytesPerMs(const Results &results)
+{
+    const Result *latest = nullptr;
+    for (const auto &result : results.entries)
+    {
+        if (result.action == Action::kVacuum && result.outcome == Outcome::kDone && result.duration_ms > 0 &&
+            (!latest || result.time > latest->time))
+            latest = &result;
+    }
+    if (!latest)
+        return kDefaultBytesPerMs;
+    return std::max<uint64_t>(latest->size_before / latest->duration_ms, 1);
+}
+
+// Work for the databases worth maintaining, most reclaimable space first,
+// as much as fits `budget_ms`
+inline std::vector<Task> Plan(const std::vector<Database> &databases, const Results &results, uint64_t now,
+                              uint64_t budget_ms)
+{
+    uint64_t bytes_per_ms = EstimateBytesPerMs(results);
+    std::vector<Task> candidates;
+    for (size_t i = 0; i < databases.size(); i++)
+    {
+        const Database &database = databases[i];
+
+        // Leave recovery of an interrupted transaction to the browser
+        if (database.journal_size > 0)
+            continue;
+
+        const Header &header = database.header;
+        uint64_t free_bytes = static_cast<uint64_t>(header.freelist_count) * header.page_size;
+        const Result *last = FindResult(results, database.path);
+        bool rebuilt_recently = last && last->action != Action::kCheckpoint && now - last->time < kVacuumInterval;
+
+        if (free_bytes >= kMinFreeBytes && free_bytes * 100 >= database.size * kMinFreePercent && !rebuilt_recently)
+        {
+            // A VACUUM rewrites the whole database, an incremental vacuum only truncates it
+            Action action = header.incremental ? Action::kIncrementalVacuum : Action::kVacuum;
+            uint64_t bytes = action == Action::kVacuum ? database.size : free_bytes;
+            candidates.push_back({i, action, free_bytes + database.wal_size, bytes / bytes_per_ms + 1});
+        }
+        else if (database.wal_size >= kMinWalBytes)
+        {
+            candidates.push_back({i, Action::kCheckpoint, database.wal_size, database.wal_size / bytes_per_ms + 1});
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Task &a, const Task &b) { return a.reclaimable > b.reclaimable; });
+
+    std::vector<Task> tasks;
+    for (const auto &task : candidates)
+    {
+        if (task.estimate_ms > budget_ms)
+            continue;
+        budget_ms -= task.estimate_ms;
+        tasks.push_back(task);
+    }
+    return tasks;
+}
+
+namespace internal
+{
+
+using Clock = std::chrono::steady_clock;
+
+inline int VIVALDI_PLUS_SQLITE_CALL AbortAtDeadline(void *deadline)
+{
+    return Clock::now() >= *static_cast<Clock::time_point *>(deadline) ? 1 : 0;
+}
+
+inline int VIVALDI_PLUS_SQLITE_CALL ReadFirstColumn(void *value, int columns, char **row, char **)
+{
+    if (columns > 0 && row[0])
+        *static_cast<uint64_t *>(value) = strtoull(row[0], nullptr, 10);
+    return 0;
+}
+
+// First column of the last row of `sql`, `fallback` if there is none
+inline uint64_t QueryNumber(const SqliteApi &api, sqlite3 *db, const char *sql, uint64_t fallback)
+{
+    uint64_t value = fallback;
+    if (api.exec(db, sql, ReadFirstColumn, &value, nullptr) != kSqliteOk)
+        return fallback;
+    return value;
+}
+
+inline Outcome ToOutcome(int code)
+{
+    switch (code & 0xff)
+    {
+    case kSqliteOk:
+        return Outcome::kDone;
+    case kSqliteBusy:
+    case kSqliteLocked:
+        return Outcome::kBusy;
+    case kSqliteInterrupt:
+        return Outcome::kTimeout;
+    default:
+        return Outcome::kFailed;
+    }
+}
+
+}  // namespace internal
+
+// Run `action` on the database at `path` (UTF-8), aborting at `deadline`
+// `size_after` receives the database size as SQLite sees it afterwards
+inline Outcome Run(const SqliteApi &api, const char *path, Action action,
+                   std::chrono::steady_clock::time_point deadline, uint64_t *size_after)
+{
+    sqlite3 *db = nullptr;
+    int code = api.open_v2(path, &db, kSqliteOpenReadWrite, nullptr);
+    if (code != kSqliteOk)
+    {
+        if (db)
+            api.close(db);
+        return internal::ToOutcome(code);
+    }
+
+    // Never wait for the browser, which would hold its locks for much longer
+    api.busy_timeout(db, 0);
+    api.progress_handler(db, 1000, internal::AbortAtDeadline, &deadline);
+
+    Outcome outcome = Outcome::kDone;
+    if (action == Action::kCheckpoint)
+    {
+        // The first result column is 1 if a reader or writer blocked the checkpoint
+        uint64_t busy = 1;
+        code = api.exec(db, "PRAGMA wal_checkpoint(TRUNCATE)", internal::ReadFirstColumn, &busy, nullptr);
+        outcome = code == kSqliteOk && busy ? Outcome::kBusy : internal::ToOutcome(code);
+    }
+    else
+    {
+        const char *sql = action == Action::kVacuum ? "VACUUM" : "PRAGMA incremental_vacuum";
+        code = api.exec(db, sql, nullptr, nullptr, nullptr);
+        outcome = internal::ToOutcome(code);
+
+        // Refresh statistics only where the browser keeps them, bounded per index
+        if (outcome == Outcome::kDone && action == Action::kVacuum &&
+            internal::QueryNumber(api, db, "SELECT count(*) FROM sqlite_master WHERE name = 'sqlite_stat1'", 0))
+        {
+            api.exec(db, "PRAGMA analysis_limit = 1000; ANALYZE", nullptr, nullptr, nullptr);
+        }
+        if (outcome == Outcome::kDone)
+            api.exec(db, "PRAGMA wal_checkpoint(TRUNCATE)", nullptr, nullptr, nullptr);
+    }
+
+    api.progress_handler(db, 0, nullptr, nullptr);
+    *size_after = internal::QueryNumber(api, db, "PRAGMA page_count", 0) *
+                  internal::QueryNumber(api, db, "PRAGMA page_size", 0);
+    api.close(db);
+    return outcome;
+}
+
+// Replace the results of the databases in `fresh`, keeping the newest kMaxResults
+inline void Merge(Results *results, std::vector<Result> fresh, uint64_t now)
+{
+    size_t fresh_count = fresh.size();
+    for (auto &result : results->entries)
+    {
+        auto end = fresh.begin() + fresh_count;
+        if (std::find_if(fresh.begin(), end, [&result](const Result &r) { return r.path == result.path; }) == end)
+            fresh.push_back(std::move(result));
+    }
+    std::stable_sort(fresh.begin(), fresh.end(), [](const Result &a, const Result &b) { return a.time > b.time; });
+    if (fresh.size() > kMaxResults)
+        fresh.resize(kMaxResults);
+    results->entries = std::move(fresh);
+    results->last_pass = now;
+}
+
+inline std::vector<uint8_t> EncodeResults(const Results &results)
+{
+    std::vector<uint8_t> bytes(12);
+    state_format::StoreLE64(bytes.data(), results.last_pass);
+    state_format::StoreLE32(bytes.data() + 8, static_cast<uint32_t>(results.entries.size()));
+    for (const auto &result : results.entries)
+    {
+        size_t length = result.path.size() < UINT16_MAX ? result.path.size() : UINT16_MAX;
+        size_t offset = bytes.size();
+        bytes.resize(offset + 32 + length * 2);
+
+        uint8_t *out = bytes.data() + offset;
+        state_format::StoreLE64(out, result.time);
+        state_format::StoreLE64(out + 8, result.size_before);
+        state_format::StoreLE64(out + 16, result.size_after);
+        state_format::StoreLE32(out + 24, result.duration_ms);
+        out[28] = static_cast<uint8_t>(result.action);
+        out[29] = static_cast<uint8_t>(result.outcome);
+        state_format::StoreLE16(out + 30, static_cast<uint16_t>(length));
+        for (size_t i = 0; i < length; i++)
+        {
+            state_format::StoreLE16(out + 32 + i * 2, static_cast<uint16_t>(result.path[i]));
+        }
+    }
+    return bytes;
+}
+
+// False (and empty results) if the record is malformed
+inline bool DecodeResults(const uint8_t *data, size_t size, Results *results)
+{
+    results->last_pass = 0;
+    results->entries.clear();
+    if (size < 12)
+        return false;
+
+    size_t count = state_format::LoadLE32(data + 8);
+    if (count > kMaxResults)
+        return false;
+
+    size_t offset = 12;
+    for (size_t i = 0; i < count && size - offset >= 32; i++)
+    {
+        const uint8_t *in = data + offset;
+        size_t length = state_format::LoadLE16(in + 30);
+        if (in[28] > static_cast<uint8_t>(Action::kVacuum) || in[29] > static_cast<uint8_t>(Outcome::kFailed) ||
+            size - offset - 32 < length * 2)
+            break;
+
+        Result result{{},
+                      state_format::LoadLE64(in),
+                      state_format::LoadLE64(in + 8),
+                      state_format::LoadLE64(in + 16),
+                      state_format::LoadLE32(in + 24),
+                      static_cast<Action>(in[28]),
+                      static_cast<Outcome>(in[29])};
+        result.path.resize(length);
+        for (size_t j = 0; j < length; j++)
+        {
+            result.path[j] = static_cast<wchar_t>(state_format::LoadLE16(in + 32 + j * 2));
+        }
+        results->entries.push_back(std::move(result));
+        offset += 32 + length * 2;
+    }
+
+    if (results->entries.size() != count || offset != size)
+    {
+        results->entries.clear();
+        return false;
+    }
+    results->last_pass = state_format::LoadLE64(data);
+    return true;
+}
+
+}  // namespace sqlite_maintenance
+
+#endif  // VIVALDI_PLUS_SQLITE_PLAN_H_
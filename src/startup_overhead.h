@@ -0,0 +1,72 @@
+#ifndef VIVALDI_PLUS_STARTUP_OVERHEAD_H_
+#define VIVALDI_PLUS_STARTUP_OVERHEAD_H_
+
+//
+// Per-process startup overhead of the core DLL.
+// Every process keeps its own counters in the core's private data; nothing
+// writable is shared with sandboxed children. The browser reads a child's
+// copy with ReadProcessMemory at the same offset from the core's base, which
+// Windows maps at one address in all processes of a boot session. A child
+// where the core landed elsewhere fails the magic check and is skipped.
+//
+
+#include <windows.h>
+
+namespace startup_overhead
+{
+
+constexpr DWORD kMagic = 0x54535056;  // 'VPST'
+
+struct Counters
+{
+    DWORD magic;  // kMagic once DllMain initialized the counters
+    DWORD size;   // sizeof(Counters)
+    LONG64 frequency;
+    LONG64 attach_ticks;            // Spent in DLL_PROCESS_ATTACH
+    volatile LONG64 resolve_count;  // Exports resolved by the lazy stubs
+    volatile LONG64 resolve_ticks;  // Spent resolving, including loading the system DLL
+};
+
+// Defined by the core DLL, this process only
+extern Counters self;
+
+inline LONG64 Now()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+// Account DLL_PROCESS_ATTACH that started at `start_ticks`
+inline void RecordAttach(LONG64 start_ticks)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    self.frequency = frequency.QuadPart;
+    self.attach_ticks = Now() - start_ticks;
+    self.size = sizeof(Counters);
+    self.magic = kMagic;
+}
+
+// Account one export resolution that started at `start_ticks`
+inline void RecordResolve(LONG64 start_ticks)
+{
+    InterlockedIncrement64(&self.resolve_count);
+    InterlockedAdd64(&self.resolve_ticks, Now() - start_ticks);
+}
+
+// Read the counters of another process that maps the same core DLL
+// `local` is this process's copy, the child's sits at the same address
+inline bool ReadProcess(HANDLE process, const Counters *local, Counters *counters)
+{
+    SIZE_T read = 0;
+    if (!ReadProcessMemory(process, local, counters, sizeof(Counters), &read) || read != sizeof(Counters))
+        return false;
+
+    // A core mapped at another base leaves other bytes at this address
+    return counters->magic == kMagic && counters->size == sizeof(Counters) && counters->frequency != 0;
+}
+
+}  // namespace startup_overhead
+
+#endif  // VIVALDI_PLUS_STARTUP_OVERHEAD_H_
@@ -0,0 +1,244 @@
+#include "startup_tasks.h"
+
+#include <thread>
+
+#include "config.h"
+#include "executor.h"
+#include "startup_trace.h"
+#include "utils.h"
+
+namespace startup
+{
+
+static LONG64 QueryTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+}
+
+Scheduler::Scheduler()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    frequency_ = frequency.QuadPart;
+    start_ticks_ = QueryTicks();
+}
+
+void Scheduler::Add(const wchar_t *name, Phase phase, std::initializer_list<const wchar_t *> deps,
+                    std::function<void()> run)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (deferred_started_)
+    {
+        DebugLog(L"Startup task %s added after startup, dropped", name);
+        return;
+    }
+
+    Task &task = tasks_.emplace_back();
+    task.name = name;
+    task.phase = phase;
+    task.deps.assign(deps.begin(), deps.end());
+    task.run = std::move(run);
+}
+
+Scheduler::Task *Scheduler::Find(const std::wstring &name)
+{
+    for (auto &task : tasks_)
+    {
+        if (task.name == name)
+            return &task;
+    }
+    return nullptr;
+}
+
+bool Scheduler::DependenciesDone(const Task &task)
+{
+    for (const auto &dep : task.deps)
+    {
+        Task *other = Find(dep);
+        if (!other || !other->done)
+            return false;
+    }
+    return true;
+}
+
+void Scheduler::Run(Task &task)
+{
+    LONG64 begin = QueryTicks();
+    task.run();
+    LONG64 end = QueryTicks();
+
+    if (startup_trace::IsEnabled())
+    {
+        // Task names are ASCII
+        std::string name(task.name.size(), ' ');
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            name[i] = static_cast<char>(task.name[i]);
+        }
+        startup_trace::Record(name.c_str(), startup_trace::TicksToUs(begin), startup_trace::TicksToUs(end));
+    }
+
+    DebugLog(L"Startup task %s: %lld us, done at +%lld ms", task.name.c_str(),
+             (end - begin) * 1000000 / frequency_, (end - start_ticks_) * 1000 / frequency_);
+}
+
+void Scheduler::RunCritical()
+{
+    // Repeat passes until nothing more can run, tasks added by a running task
+    // are picked up by the next pass
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (size_t i = 0; i < tasks_.size(); i++)
+        {
+            Task &task = tasks_[i];
+            if (task.phase != Phase::kCritical || task.done || !DependenciesDone(task))
+                continue;
+
+            Run(task);
+            task.done = true;
+            progress = true;
+        }
+    }
+
+    for (const auto &task : tasks_)
+    {
+        if (task.phase == Phase::kCritical && !task.done)
+            DebugLog(L"Startup task %s never ran: missing or cyclic dependency", task.name.c_str());
+    }
+}
+
+void Scheduler::Submit(Task &task)
+{
+    // The executor only refuses work after shutdown, run inline then
+    if (!executor::GetExecutor().Post(executor::Priority::kBackground, [this, &task]() { RunDeferredTask(task); }))
+        RunDeferredTask(task);
+}
+
+void Scheduler::RunDeferredTask(Task &task)
+{
+    Run(task);
+
+    for (Task *dependent : task.dependents)
+    {
+        if (dependent->pending.fetch_sub(1) == 1)
+            Submit(*dependent);
+    }
+}
+
+void Scheduler::RunDeferred()
+{
+    std::vector<Task *> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deferred_started_ = true;
+
+        // Wire the deferred graph; dependencies on finished critical tasks are
+        // already satisfied, anything else that cannot finish drops the task
+        for (auto &task : tasks_)
+        {
+            if (task.phase != Phase::kDeferred)
+                continue;
+
+            bool runnable = true;
+            int pending = 0;
+            for (const auto &dep : task.deps)
+            {
+                Task *other = Find(dep);
+                if (!other || (other->phase == Phase::kCritical && !other->done) || other == &task)
+                {
+                    runnable = false;
+                    break;
+                }
+                if (other->phase == Phase::kDeferred)
+                {
+                    other->dependents.push_back(&task);
+                    pending++;
+                }
+            }
+
+            if (!runnable)
+            {
+                DebugLog(L"Startup task %s never ran: missing dependency", task.name.c_str());
+                // Never reaches zero, so neither the task nor its dependents run
+                pending++;
+            }
+            task.pending = pending;
+            if (pending == 0)
+                ready.push_back(&task);
+        }
+    }
+
+    for (Task *task : ready)
+        Submit(*task);
+}
+
+// First shown top-level browser window of this process
+static void CALLBACK OnWindowShown(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG object, LONG child,
+                                   DWORD thread, DWORD time)
+{
+    if (object != OBJID_WINDOW || child != CHILDID_SELF || !hwnd)
+        return;
+    if (GetAncestor(hwnd, GA_ROOT) != hwnd || GetWindow(hwnd, GW_OWNER))
+        return;
+
+    wchar_t class_name[32];
+    if (GetClassNameW(hwnd, class_name, ARRAYSIZE(class_name)) && wcscmp(class_name, L"Chrome_WidgetWin_1") == 0)
+        PostQuitMessage(0);
+}
+
+void Scheduler::StartDeferred(DWORD timeout_ms)
+{
+    std::thread([this, timeout_ms]() {
+        // Out-of-context events are delivered to this thread's message loop
+        HWINEVENTHOOK hook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW, nullptr, OnWindowShown,
+                                             GetCurrentProcessId(), 0, WINEVENT_OUTOFCONTEXT);
+        if (!hook)
+        {
+            // No window notifications: fall back to the timeout alone instead of
+            // running the deferred work in the middle of startup
+            WarningLog(L"SetWinEventHook failed: %lu, deferring startup tasks by %lu ms", GetLastError(), timeout_ms);
+            Sleep(timeout_ms);
+        }
+        UINT_PTR timer = hook ? SetTimer(nullptr, 0, timeout_ms, nullptr) : 0;
+
+        bool shown = false;
+        MSG msg;
+        while (hook)
+        {
+            BOOL result = GetMessageW(&msg, nullptr, 0, 0);
+            if (result == 0)
+            {
+                shown = true;
+                break;
+            }
+            if (result < 0 || (msg.message == WM_TIMER && msg.wParam == timer))
+                break;
+            DispatchMessageW(&msg);
+        }
+
+        if (timer)
+            KillTimer(nullptr, timer);
+        if (hook)
+            UnhookWinEvent(hook);
+
+        if (shown)
+        {
+            startup_trace::RecordSinceLoader("first browser window");
+        }
+        DebugLog(shown ? L"First browser window at +%lld ms" : L"No browser window by +%lld ms, starting anyway",
+                 (QueryTicks() - start_ticks_) * 1000 / frequency_);
+        RunDeferred();
+    }).detach();
+}
+
+Scheduler &GetScheduler()
+{
+    static Scheduler scheduler;
+    return scheduler;
+}
+
+}  // namespace startup
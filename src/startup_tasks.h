@@ -0,0 +1,75 @@
+#ifndef VIVALDI_PLUS_STARTUP_TASKS_H_
+#define VIVALDI_PLUS_STARTUP_TASKS_H_
+
+#include <windows.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace startup
+{
+
+enum class Phase
+{
+    kCritical,  // Runs synchronously before the browser entry point
+    kDeferred,  // Runs on the shared executor after the first browser window shows
+};
+
+// Startup task graph of the extension.
+// Only work the browser depends on before its entry point (hooks, portable
+// relaunch) is critical; everything else is deferred past the first window so
+// it does not compete with the browser for the startup critical path.
+// Tasks name their dependencies; a deferred task may depend on critical tasks
+// and on other deferred tasks, a critical task only on critical tasks.
+class Scheduler
+{
+public:
+    Scheduler();
+
+    // Tasks may be added from inside a running critical task
+    void Add(const wchar_t *name, Phase phase, std::initializer_list<const wchar_t *> deps,
+             std::function<void()> run);
+
+    // Run all critical tasks in dependency order on the calling thread
+    void RunCritical();
+
+    // Wait for the first browser window on a background thread (at most
+    // timeout_ms), then run the deferred tasks; tasks added later are dropped
+    void StartDeferred(DWORD timeout_ms);
+
+private:
+    struct Task
+    {
+        std::wstring name;
+        Phase phase;
+        std::vector<std::wstring> deps;
+        std::function<void()> run;
+        bool done = false;
+        std::atomic<int> pending{0};  // Unfinished deferred dependencies
+        std::vector<Task *> dependents;
+    };
+
+    Task *Find(const std::wstring &name);
+    bool DependenciesDone(const Task &task);
+    void Run(Task &task);
+    void RunDeferred();
+    void Submit(Task &task);
+    void RunDeferredTask(Task &task);
+
+    std::mutex mutex_;  // Guards tasks_ while it can still grow
+    std::deque<Task> tasks_;  // deque keeps Task addresses stable on growth
+    bool deferred_started_ = false;
+    LONG64 start_ticks_;
+    LONG64 frequency_;
+};
+
+Scheduler &GetScheduler();
+
+}  // namespace startup
+
+#endif  // VIVALDI_PLUS_STARTUP_TASKS_H_
@@ -0,0 +1,176 @@
+#include "startup_trace.h"
+
+#include <mutex>
+#include <string>
+
+#include "config.h"
+#include "timeline.h"
+#include "utils.h"
+
+namespace startup_trace
+{
+
+namespace
+{
+
+// Carries the stub's timeline to the relaunched browser, removed once imported
+constexpr wchar_t kEnvironmentVariable[] = L"VIVALDI_PLUS_TIMELINE";
+
+bool enabled = false;
+int64_t loader_us = 0;
+std::wstring output_path;
+
+timeline::Recorder &GetRecorder()
+{
+    static timeline::Recorder recorder;
+    return recorder;
+}
+
+LONG64 GetFrequency()
+{
+    static const LONG64 frequency = []() {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }();
+    return frequency;
+}
+
+std::string ToUtf8(const wchar_t *text, int length)
+{
+    int size = WideCharToMultiByte(CP_UTF8, 0, text, length, nullptr, 0, nullptr, nullptr);
+    std::string result(size > 0 ? size : 0, '\0');
+    if (size > 0)
+        WideCharToMultiByte(CP_UTF8, 0, text, length, result.data(), size, nullptr, nullptr);
+    return result;
+}
+
+std::wstring FromUtf8(const std::string &text)
+{
+    int size = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring result(size > 0 ? size : 0, L'\0');
+    if (size > 0)
+        MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), size);
+    return result;
+}
+
+// Same expansion as the data and cache directories, relative paths are relative to the app dir
+std::wstring ResolveOutputPath(const std::wstring &configured)
+{
+    std::wstring path = ExpandEnvironmentPath(configured);
+    ReplaceStringInPlace(path, L"%app%", GetAppDir());
+
+    bool absolute = path.size() >= 2 && (path[1] == L':' || (path[0] == L'\\' && path[1] == L'\\'));
+    if (!absolute)
+        path = GetAppDir() + L"\\" + path;
+    return GetAbsolutePath(path);
+}
+
+void ImportRelaunchedTimeline()
+{
+    DWORD length = GetEnvironmentVariableW(kEnvironmentVariable, nullptr, 0);
+    if (length == 0)
+        return;
+
+    std::wstring text(length, L'\0');
+    length = GetEnvironmentVariableW(kEnvironmentVariable, text.data(), length);
+    text.resize(length);
+
+    // Children of the browser must not inherit it
+    SetEnvironmentVariableW(kEnvironmentVariable, nullptr);
+
+    timeline::Recorder &recorder = GetRecorder();
+    size_t imported = recorder.Deserialize(ToUtf8(text.c_str(), static_cast<int>(text.size())));
+    recorder.CloseOpen(loader_us);
+
+    DebugLog(L"Startup trace: imported %zu spans from the portable stub", imported);
+}
+
+}  // namespace
+
+void Initialize(LONG64 loader_ticks)
+{
+    const std::wstring &configured = GetConfig().GetStartupTracePath();
+    if (configured.empty())
+        return;
+
+    output_path = ResolveOutputPath(configured);
+    loader_us = loader_ticks ? TicksToUs(loader_ticks) : NowUs();
+    enabled = true;
+
+    LPCWSTR command_line = GetCommandLineW();
+    bool relaunched = command_line && wcsstr(command_line, L"--gopher");
+    GetRecorder().SetProcessName(GetCurrentProcessId(), relaunched ? "browser" : "portable stub");
+    if (relaunched)
+    {
+        ImportRelaunchedTimeline();
+    }
+
+    RecordSinceLoader("Loader");
+}
+
+bool IsEnabled()
+{
+    return enabled;
+}
+
+int64_t TicksToUs(LONG64 ticks)
+{
+    LONG64 frequency = GetFrequency();
+    return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+int64_t NowUs()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return TicksToUs(ticks.QuadPart);
+}
+
+void Record(const char *name, int64_t begin_us, int64_t end_us)
+{
+    if (enabled)
+        GetRecorder().Add(name, GetCurrentProcessId(), GetCurrentThreadId(), begin_us, end_us);
+}
+
+void RecordSinceLoader(const char *name)
+{
+    Record(name, loader_us, NowUs());
+}
+
+void ExportForRelaunch()
+{
+    if (!enabled)
+        return;
+
+    timeline::Recorder &recorder = GetRecorder();
+    recorder.Begin("ShellExecuteEx relaunch", GetCurrentProcessId(), GetCurrentThreadId(), NowUs());
+    SetEnvironmentVariableW(kEnvironmentVariable, FromUtf8(recorder.Serialize()).c_str());
+}
+
+void Write()
+{
+    if (!enabled)
+        return;
+
+    // Written from a deferred task and on exit; a crashed thread may hold the lock at exit
+    static std::mutex write_mutex;
+    std::unique_lock<std::mutex> lock(write_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    std::string json = GetRecorder().ToTraceJson();
+    HANDLE file = CreateFileW(output_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Startup trace: cannot create %s: %lu", output_path.c_str(), GetLastError());
+        return;
+    }
+
+    DWORD written = 0;
+    WriteFile(file, json.data(), static_cast<DWORD>(json.size()), &written, nullptr);
+    CloseHandle(file);
+}
+
+}  // namespace startup_trace
@@ -0,0 +1,66 @@
+#ifndef VIVALDI_PLUS_STARTUP_TRACE_H_
+#define VIVALDI_PLUS_STARTUP_TRACE_H_
+
+//
+// Cross-process startup timeline ([general] startup_trace).
+// The portable stub records its spans and hands them to the relaunched
+// browser through an environment variable; the browser adds its own and
+// writes Chrome trace-event JSON once the first window is up and again on exit.
+// Recording costs nothing when startup_trace is not configured.
+//
+
+#include <windows.h>
+
+#include <stdint.h>
+
+namespace startup_trace
+{
+
+// Read the config and import the stub's spans; loader_ticks is when the
+// core's Loader started (QueryPerformanceCounter, 0 if unknown)
+void Initialize(LONG64 loader_ticks);
+
+bool IsEnabled();
+
+// Microseconds on the QueryPerformanceCounter clock, shared by all processes
+int64_t NowUs();
+int64_t TicksToUs(LONG64 ticks);
+
+// Record a finished span on the current thread
+void Record(const char *name, int64_t begin_us, int64_t end_us);
+
+// Record a span from the core's Loader until now
+void RecordSinceLoader(const char *name);
+
+// Hand the timeline to the process about to be started by the portable relaunch
+// Opens a span that the relaunched process ends when its Loader runs
+void ExportForRelaunch();
+
+// Write the trace JSON to the configured file
+void Write();
+
+// Times the enclosing scope
+class Scope
+{
+public:
+    explicit Scope(const char *name) : name_(name), begin_us_(IsEnabled() ? NowUs() : 0)
+    {
+    }
+
+    ~Scope()
+    {
+        if (begin_us_)
+            Record(name_, begin_us_, NowUs());
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *name_;
+    int64_t begin_us_;
+};
+
+}  // namespace startup_trace
+
+#endif  // VIVALDI_PLUS_STARTUP_TRACE_H_
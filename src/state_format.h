@@ -0,0 +1,289 @@
+#ifndef VIVALDI_PLUS_STATE_FORMAT_H_
+#define VIVALDI_PLUS_STATE_FORMAT_H_
+
+// Platform-neutral codec of the persistent state file (state_store.h).
+// A small header and an index of typed, versioned records are followed by
+// the record payloads. Readers work directly on the mapped file: Open checks
+// the header and index once, Find hands out pointers into the buffer and only
+// verifies the checksum of the record it returns. A damaged record reads as
+// missing without affecting the others.
+//
+// Layout (little endian):
+//   0  magic     "VPST"
+//   4  version   kVersion
+//   5  reserved  zero
+//   6  record count
+//   8  file size
+//  12  FNV-1a 32 of bytes 0..11 and the index
+//  16  index, kIndexEntrySize bytes per record:
+//        0 type, 4 record version, 6 reserved, 8 offset, 12 size, 16 FNV-1a 32 of the payload
+//  ..  payloads, each starting 8-byte aligned
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace state_format
+{
+
+constexpr uint8_t kMagic[4] = {'V', 'P', 'S', 'T'};
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kIndexEntrySize = 20;
+constexpr size_t kMaxRecords = 1024;
+constexpr size_t kMaxFileSize = 16 << 20;
+
+enum class Status
+{
+    kOk,
+    kEmpty,               // No file yet
+    kBadMagic,            // Not a state file
+    kUnsupportedVersion,  // Written by a newer build
+    kCorrupt,             // Truncated, or header/index checksum mismatch
+};
+
+// Payload of one record, points into the buffer given to Reader::Open
+struct Record
+{
+    uint16_t version;
+    const uint8_t *data;
+    size_t size;
+};
+
+inline uint32_t Checksum(const uint8_t *data, size_t size, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline void StoreLE16(uint8_t *out, uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline void StoreLE32(uint8_t *out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline void StoreLE64(uint8_t *out, uint64_t value)
+{
+    StoreLE32(out, static_cast<uint32_t>(value));
+    StoreLE32(out + 4, static_cast<uint32_t>(value >> 32));
+}
+
+inline uint16_t LoadLE16(const uint8_t *in)
+{
+    return static_cast<uint16_t>(in[0] | in[1] << 8);
+}
+
+inline uint32_t LoadLE32(const uint8_t *in)
+{
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+}
+
+inline uint64_t LoadLE64(const uint8_t *in)
+{
+    return static_cast<uint64_t>(LoadLE32(in)) | static_cast<uint64_t>(LoadLE32(in + 4)) << 32;
+}
+
+class Reader
+{
+public:
+    // The buffer must stay valid (mapped) while records are in use
+    Status Open(const uint8_t *data, size_t size)
+    {
+        data_ = nullptr;
+        count_ = 0;
+        if (!data || size == 0)
+            return Status::kEmpty;
+        if (size < sizeof(kMagic) || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+            return Status::kBadMagic;
+        if (size < kHeaderSize)
+            return Status::kCorrupt;
+        if (data[4] != kVersion)
+            return Status::kUnsupportedVersion;
+
+        size_t count = LoadLE16(data + 6);
+        size_t index_size = count * kIndexEntrySize;
+        if (count > kMaxRecords || LoadLE32(data + 8) != size || size < kHeaderSize + index_size)
+            return Status::kCorrupt;
+
+        uint32_t checksum = Checksum(data + kHeaderSize, index_size, Checksum(data, 12));
+        if (LoadLE32(data + 12) != checksum)
+            return Status::kCorrupt;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *entry = data + kHeaderSize + i * kIndexEntrySize;
+            size_t offset = LoadLE32(entry + 8);
+            size_t length = LoadLE32(entry + 12);
+            if (offset < kHeaderSize + index_size || offset > size || length > size - offset)
+                return Status::kCorrupt;
+        }
+
+        data_ = data;
+        count_ = count;
+        return Status::kOk;
+    }
+
+    size_t Count() const
+    {
+        return count_;
+    }
+
+    uint32_t TypeAt(size_t i) const
+    {
+        return LoadLE32(Entry(i));
+    }
+
+    // False if the record is missing or its payload fails the checksum
+    bool Find(uint32_t type, Record *record) const
+    {
+        for (size_t i = 0; i < count_; i++)
+        {
+            if (TypeAt(i) == type)
+                return RecordAt(i, record);
+        }
+        return false;
+    }
+
+    bool RecordAt(size_t i, Record *record) const
+    {
+        const uint8_t *entry = Entry(i);
+        const uint8_t *payload = data_ + LoadLE32(entry + 8);
+        size_t length = LoadLE32(entry + 12);
+        if (Checksum(payload, length) != LoadLE32(entry + 16))
+            return false;
+
+        record->version = LoadLE16(entry + 4);
+        record->data = payload;
+        record->size = length;
+        return true;
+    }
+
+private:
+    const uint8_t *Entry(size_t i) const
+    {
+        return data_ + kHeaderSize + i * kIndexEntrySize;
+    }
+
+    const uint8_t *data_ = nullptr;
+    size_t count_ = 0;
+};
+
+// Collects records and serializes a complete file
+class Builder
+{
+public:
+    // Keep every intact record of an existing file, damaged ones are dropped
+    void CopyFrom(const Reader &reader)
+    {
+        Record record;
+        for (size_t i = 0; i < reader.Count(); i++)
+        {
+            if (reader.RecordAt(i, &record))
+                Set(reader.TypeAt(i), record.version, record.data, record.size);
+        }
+    }
+
+    void Set(uint32_t type, uint16_t version, const void *data, size_t size)
+    {
+        Entry &entry = records_[type];
+        entry.version = version;
+        entry.bytes.assign(static_cast<const char *>(data), size);
+    }
+
+    void Remove(uint32_t type)
+    {
+        records_.erase(type);
+    }
+
+    bool Find(uint32_t type, Record *record) const
+    {
+        auto it = records_.find(type);
+        if (it == records_.end())
+            return false;
+
+        record->version = it->second.version;
+        record->data = reinterpret_cast<const uint8_t *>(it->second.bytes.data());
+        record->size = it->second.bytes.size();
+        return true;
+    }
+
+    // Empty if the records exceed kMaxRecords or kMaxFileSize
+    std::vector<uint8_t> Build() const
+    {
+        size_t count = records_.size();
+        if (count > kMaxRecords)
+            return {};
+
+        size_t size = kHeaderSize + count * kIndexEntrySize;
+        for (const auto &[type, entry] : records_)
+        {
+            size = Align(size) + entry.bytes.size();
+            if (size > kMaxFileSize)
+                return {};
+        }
+
+        std::vector<uint8_t> file(size, 0);
+        uint8_t *data = file.data();
+        memcpy(data, kMagic, sizeof(kMagic));
+        data[4] = kVersion;
+        StoreLE16(data + 6, static_cast<uint16_t>(count));
+        StoreLE32(data + 8, static_cast<uint32_t>(size));
+
+        size_t offset = kHeaderSize + count * kIndexEntrySize;
+        uint8_t *entry = data + kHeaderSize;
+        for (const auto &[type, record] : records_)
+        {
+            offset = Align(offset);
+            const uint8_t *payload = reinterpret_cast<const uint8_t *>(record.bytes.data());
+            StoreLE32(entry, type);
+            StoreLE16(entry + 4, record.version);
+            StoreLE32(entry + 8, static_cast<uint32_t>(offset));
+            StoreLE32(entry + 12, static_cast<uint32_t>(record.bytes.size()));
+            StoreLE32(entry + 16, Checksum(payload, record.bytes.size()));
+            if (!record.bytes.empty())
+                memcpy(data + offset, payload, record.bytes.size());
+
+            offset += record.bytes.size();
+            entry += kIndexEntrySize;
+        }
+
+        StoreLE32(data + 12, Checksum(data + kHeaderSize, count * kIndexEntrySize, Checksum(data, 12)));
+        return file;
+    }
+
+private:
+    struct Entry
+    {
+        uint16_t version = 0;
+        std::string bytes;
+    };
+
+    static size_t Align(size_t offset)
+    {
+        return (offset + 7) & ~static_cast<size_t>(7);
+    }
+
+    std::map<uint32_t, Entry> records_;
+};
+
+}  // namespace state_format
+
+#endif  // VIVALDI_PLUS_STATE_FORMAT_H_
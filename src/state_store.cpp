@@ -0,0 +1,176 @@
+#include "state_store.h"
+
+#include <cwctype>
+
+#include "config.h"
+#include "utils.h"
+
+namespace state_store
+{
+
+namespace
+{
+
+constexpr DWORD kLockTimeoutMs = 5000;
+constexpr int kReplaceAttempts = 5;
+constexpr DWORD kReplaceRetryMs = 20;
+
+std::wstring directory_path;
+
+std::wstring PathOf(const wchar_t *name)
+{
+    return directory_path.empty() ? std::wstring() : directory_path + L"\\" + name;
+}
+
+// One writer at a time per state file, across all processes of the session
+HANDLE AcquireWriterLock(const std::wstring &state_path)
+{
+    uint32_t hash = 2166136261u;
+    for (wchar_t ch : state_path)
+    {
+        hash = (hash ^ static_cast<uint32_t>(towlower(ch))) * 16777619u;
+    }
+
+    wchar_t name[64];
+    swprintf_s(name, L"Local\\VivaldiPlusState.%08X", hash);
+    HANDLE mutex = CreateMutexW(nullptr, FALSE, name);
+    if (!mutex)
+        return nullptr;
+
+    // An abandoned lock is fine: the file is only ever replaced as a whole
+    DWORD wait = WaitForSingleObject(mutex, kLockTimeoutMs);
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+    {
+        CloseHandle(mutex);
+        return nullptr;
+    }
+    return mutex;
+}
+
+void ReleaseWriterLock(HANDLE mutex)
+{
+    ReleaseMutex(mutex);
+    CloseHandle(mutex);
+}
+
+bool WriteFileThrough(const std::wstring &path, const std::vector<uint8_t> &bytes)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD written = 0;
+    bool ok = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) &&
+              written == bytes.size() && FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok;
+}
+
+// Readers holding a mapping of the old file can make the replace fail briefly
+bool ReplaceStateFile(const std::wstring &from, const std::wstring &to)
+{
+    for (int attempt = 0; attempt < kReplaceAttempts; attempt++)
+    {
+        if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            return true;
+        Sleep(kReplaceRetryMs);
+    }
+    return false;
+}
+
+}  // namespace
+
+void Initialize(const std::wstring &directory)
+{
+    if (directory.empty())
+        return;
+
+    directory_path = directory;
+}
+
+Snapshot::Snapshot(const wchar_t *name)
+{
+    std::wstring state_path = PathOf(name);
+    if (state_path.empty())
+        return;
+
+    // Share delete so writers can replace the file while it is mapped
+    HANDLE file = CreateFileW(state_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart <= state_format::kMaxFileSize)
+    {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            view_ = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        status_ = view_ ? reader_.Open(view_, static_cast<size_t>(size.QuadPart)) : state_format::Status::kCorrupt;
+    }
+    else if (size.QuadPart > 0)
+    {
+        status_ = state_format::Status::kCorrupt;
+    }
+    CloseHandle(file);
+}
+
+Snapshot::~Snapshot()
+{
+    if (view_)
+        UnmapViewOfFile(view_);
+}
+
+bool Update(const std::function<void(state_format::Builder &)> &mutate, const wchar_t *name)
+{
+    std::wstring state_path = PathOf(name);
+    if (state_path.empty())
+        return false;
+
+    HANDLE lock = AcquireWriterLock(state_path);
+    if (!lock)
+    {
+        WarningLog(L"State store: writer lock timed out");
+        return false;
+    }
+
+    state_format::Builder builder;
+    {
+        Snapshot current(name);
+        if (current.status() == state_format::Status::kUnsupportedVersion)
+        {
+            // Written by a newer build, leave it alone
+            ReleaseWriterLock(lock);
+            return false;
+        }
+        if (current.status() == state_format::Status::kOk)
+        {
+            builder.CopyFrom(current.reader());
+        }
+        else if (current.status() != state_format::Status::kEmpty)
+        {
+            DebugLog(L"State store: discarding unreadable state file (status %d)", current.status());
+        }
+    }
+
+    mutate(builder);
+    std::vector<uint8_t> bytes = builder.Build();
+
+    // The browser creates the data directory, but the stub may write first
+    CreateDirectoryW(directory_path.c_str(), nullptr);
+    std::wstring temp_path = state_path + L".tmp";
+    bool ok = !bytes.empty() && WriteFileThrough(temp_path, bytes) && ReplaceStateFile(temp_path, state_path);
+    if (!ok)
+    {
+        WarningLog(L"State store: cannot write %s: %lu", state_path.c_str(), GetLastError());
+        DeleteFileW(temp_path.c_str());
+    }
+
+    ReleaseWriterLock(lock);
+    return ok;
+}
+
+}  // namespace state_store
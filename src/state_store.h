@@ -0,0 +1,84 @@
+#ifndef VIVALDI_PLUS_STATE_STORE_H_
+#define VIVALDI_PLUS_STATE_STORE_H_
+
+//
+// Persistent state of the extension: <data dir>\vivaldi_plus.state.
+// Holds what has to survive restarts but is no user setting (learned lists,
+// bookkeeping, metrics) as typed, versioned records (state_format.h).
+// Large records that change together live in a file of their own, so small
+// updates do not rewrite them (kShadowFile).
+// Readers map the file and use records in place; writers rebuild it under a
+// named mutex from the current contents and atomically replace it, so a
+// crash leaves either the old or the new file and concurrent writers from
+// several processes never lose each other's records.
+//
+
+#include <windows.h>
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "state_format.h"
+
+namespace state_store
+{
+
+constexpr wchar_t kStateFile[] = L"vivaldi_plus.state";
+constexpr wchar_t kShadowFile[] = L"vivaldi_plus.shadow.state";
+
+// Record types in use; never reuse a retired number
+enum RecordType : uint32_t
+{
+    kPrefetchList = 1,       // prefetch_list.h
+    kShadowManifest = 2,     // shadow_manifest.h, in kShadowFile
+    kShadowJournal = 3,      // shadow_manifest.h, in kShadowFile
+    kSqliteMaintenance = 4,  // sqlite_plan.h
+    kDedupReport = 5,        // dedup_plan.h
+    kStorageLayout = 6,      // storage_plan.h
+};
+
+// Set where the state files live, no I/O happens here
+void Initialize(const std::wstring &directory);
+
+// Read-only view of a state file as it was when the snapshot was taken
+// Keep it short-lived: the mapping delays replacing the file
+class Snapshot
+{
+public:
+    explicit Snapshot(const wchar_t *name = kStateFile);
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    state_format::Status status() const
+    {
+        return status_;
+    }
+
+    // Record data stays valid while the snapshot lives
+    bool Find(uint32_t type, state_format::Record *record) const
+    {
+        return status_ == state_format::Status::kOk && reader_.Find(type, record);
+    }
+
+    const state_format::Reader &reader() const
+    {
+        return reader_;
+    }
+
+private:
+    const uint8_t *view_ = nullptr;
+    state_format::Reader reader_;
+    state_format::Status status_ = state_format::Status::kEmpty;
+};
+
+// Apply `mutate` to the current records of state file `name` and replace it
+// Blocks on other writers and does file I/O: call from an executor task
+bool Update(const std::function<void(state_format::Builder &)> &mutate, const wchar_t *name = kStateFile);
+
+}  // namespace state_store
+
+#endif  // VIVALDI_PLUS_STATE_STORE_H_
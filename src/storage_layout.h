@@ -0,0 +1,287 @@
+#ifndef VIVALDI_PLUS_STORAGE_LAYOUT_H_
+#define VIVALDI_PLUS_STORAGE_LAYOUT_H_
+
+//
+// Tiered storage layout ([storage]): profile sub-directories with their own
+// I/O pattern, such as the GPU shader and code caches, live on another disk
+// than the rest of the data directory. The portable stub makes each mapped
+// directory a junction to its target before it relaunches the browser, while
+// no browser holds the profile (storage_plan.h). Targets on network shares
+// get a directory symbolic link, which needs developer mode or elevation.
+//
+
+#include <windows.h>
+#include <winioctl.h>
+#include <shlobj.h>
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "state_store.h"
+#include "storage_plan.h"
+#include "utils.h"
+
+namespace storage_layout
+{
+
+constexpr wchar_t kProbeName[] = L"\\vivaldi_plus.probe";
+constexpr wchar_t kNtPrefix[] = L"\\??\\";
+constexpr wchar_t kNtUncPrefix[] = L"\\??\\UNC\\";
+
+#ifndef SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE
+#define SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE 0x2
+#endif
+
+// REPARSE_DATA_BUFFER of the DDK, up to the path buffer
+struct ReparseHeader
+{
+    DWORD tag;
+    WORD data_length;
+    WORD reserved;
+    WORD substitute_offset;
+    WORD substitute_length;
+    WORD print_offset;
+    WORD print_length;
+};
+
+// Target of a junction or directory symbolic link, as a Win32 path
+inline bool ReadLink(const std::wstring &path, std::wstring *target)
+{
+    HANDLE file = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, kShareAll, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::vector<uint8_t> buffer(MAXIMUM_REPARSE_DATA_BUFFER_SIZE);
+    DWORD size = 0;
+    bool ok = DeviceIoControl(file, FSCTL_GET_REPARSE_POINT, nullptr, 0, buffer.data(),
+                              static_cast<DWORD>(buffer.size()), &size, nullptr) != FALSE;
+    CloseHandle(file);
+    if (!ok || size < sizeof(ReparseHeader))
+        return false;
+
+    const auto *header = reinterpret_cast<const ReparseHeader *>(buffer.data());
+    size_t names = sizeof(ReparseHeader);
+    if (header->tag == IO_REPARSE_TAG_SYMLINK)
+        names += sizeof(ULONG);  // Flags
+    else if (header->tag != IO_REPARSE_TAG_MOUNT_POINT)
+        return false;
+    if (names + header->substitute_offset + header->substitute_length > size)
+        return false;
+
+    std::wstring substitute(reinterpret_cast<const wchar_t *>(buffer.data() + names + header->substitute_offset),
+                            header->substitute_length / sizeof(wchar_t));
+    if (substitute.starts_with(kNtUncPrefix))
+        substitute = L"\\\\" + substitute.substr(wcslen(kNtUncPrefix));
+    else if (substitute.starts_with(kNtPrefix))
+        substitute.erase(0, wcslen(kNtPrefix));
+    *target = TrimSeparators(std::move(substitute));
+    return true;
+}
+
+// Win32 file system operations of the layout
+
+inline Kind Inspect(const std::wstring &path, std::wstring *target)
+{
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES)
+    {
+        DWORD error = GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? Kind::kMissing : Kind::kOther;
+    }
+    if (!(attributes & FILE_ATTRIBUTE_DIRECTORY))
+        return Kind::kOther;
+    if (attributes & FILE_ATTRIBUTE_REPARSE_POINT)
+        return ReadLink(path, target) ? Kind::kLink : Kind::kOther;
+    return Kind::kDirectory;
+}
+
+inline bool List(const std::wstring &dir, std::vector<std::wstring> *names)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((dir + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                   FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        if (wcscmp(data.cFileName, L".") != 0 && wcscmp(data.cFileName, L"..") != 0)
+            names->push_back(data.cFileName);
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    return true;
+}
+
+inline bool MakeDirectory(const std::wstring &path)
+{
+    int result = SHCreateDirectoryExW(nullptr, path.c_str(), nullptr);
+    return result == ERROR_SUCCESS || result == ERROR_ALREADY_EXISTS;
+}
+
+// Junctions need no privilege but only reach local volumes
+inline bool MakeLink(const std::wstring &path, const std::wstring &target)
+{
+    if (target.starts_with(L"\\\\"))
+    {
+        return CreateSymbolicLinkW(path.c_str(), target.c_str(),
+                                   SYMBOLIC_LINK_FLAG_DIRECTORY | SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE) !=
+               FALSE;
+    }
+
+    if (!CreateDirectoryW(path.c_str(), nullptr))
+        return false;
+
+    std::wstring substitute = kNtPrefix + target;
+    size_t substitute_bytes = substitute.size() * sizeof(wchar_t);
+    size_t print_bytes = target.size() * sizeof(wchar_t);
+    size_t names_bytes = substitute_bytes + print_bytes + 2 * sizeof(wchar_t);
+    std::vector<uint8_t> buffer(sizeof(ReparseHeader) + names_bytes);
+    if (buffer.size() > MAXIMUM_REPARSE_DATA_BUFFER_SIZE)
+    {
+        RemoveDirectoryW(path.c_str());
+        return false;
+    }
+
+    auto *header = reinterpret_cast<ReparseHeader *>(buffer.data());
+    header->tag = IO_REPARSE_TAG_MOUNT_POINT;
+    header->data_length = static_cast<WORD>(buffer.size() - 8);
+    header->substitute_offset = 0;
+    header->substitute_length = static_cast<WORD>(substitute_bytes);
+    header->print_offset = static_cast<WORD>(substitute_bytes + sizeof(wchar_t));
+    header->print_length = static_cast<WORD>(print_bytes);
+    uint8_t *names = buffer.data() + sizeof(ReparseHeader);
+    memcpy(names, substitute.c_str(), substitute_bytes);
+    memcpy(names + header->print_offset, target.c_str(), print_bytes);
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr);
+    DWORD size = 0;
+    bool ok = file != INVALID_HANDLE_VALUE &&
+              DeviceIoControl(file, FSCTL_SET_REPARSE_POINT, buffer.data(), static_cast<DWORD>(buffer.size()),
+                              nullptr, 0, &size, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    if (!ok)
+        RemoveDirectoryW(path.c_str());
+    return ok;
+}
+
+// Removing a directory link leaves its target alone
+inline bool RemoveLink(const std::wstring &path)
+{
+    return RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
+inline bool RemoveEmptyDirectory(const std::wstring &path)
+{
+    return RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
+// Files may cross volumes, directories only move by rename
+inline bool Move(const std::wstring &from, const std::wstring &to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_COPY_ALLOWED | MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+inline bool Writable(const std::wstring &dir)
+{
+    std::wstring probe = dir + kProbeName;
+    HANDLE file = CreateFileW(probe.c_str(), GENERIC_WRITE, kShareAll, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    CloseHandle(file);
+    return true;
+}
+
+inline const wchar_t *StatusName(Status status)
+{
+    switch (status)
+    {
+    case Status::kKept:
+        return L"kept";
+    case Status::kLinked:
+        return L"linked";
+    case Status::kMoved:
+        return L"moved and linked";
+    case Status::kRetargeted:
+        return L"moved from the previous target and linked";
+    case Status::kFallback:
+        return L"target not usable";
+    case Status::kNoLinks:
+        return L"the data directory's volume cannot hold links";
+    case Status::kSkipped:
+        return L"skipped, not a directory of this profile";
+    case Status::kFailed:
+        return L"contents not moved completely";
+    default:
+        return L"moved back";
+    }
+}
+
+// Bring the links in `data_dir` (the directory the browser is about to use) in
+// line with [storage]; moving contents around may take a while the first time
+inline void Apply(const std::wstring &data_dir)
+{
+    std::vector<Link> links;
+    {
+        state_store::Snapshot snapshot;
+        state_format::Record record;
+        if (snapshot.Find(state_store::kStorageLayout, &record) && record.version == kLayoutVersion)
+            DecodeLinks(record.data, record.size, &links);
+    }
+
+    const auto &configured = GetConfig().GetStorageMappings();
+    if (configured.empty() && links.empty())
+        return;
+    if (IsProfileInUse(data_dir))
+        return;
+
+    std::wstring root = TrimSeparators(GetAbsolutePath(data_dir));
+    std::vector<Mapping> mappings;
+    for (const auto &[relative, target] : configured)
+    {
+        mappings.push_back({relative, target.empty() ? target : ResolvePath(target)});
+    }
+
+    std::vector<Rejected> rejected;
+    mappings = Validate(root, mappings, &rejected);
+    for (const auto &entry : rejected)
+    {
+        WarningLog(L"Storage layout: [storage] %s ignored: %s", entry.relative.c_str(), entry.reason);
+    }
+
+    std::vector<Link> before = links;
+    FileSystem fs{Inspect, List, MakeDirectory, MakeLink, RemoveLink, RemoveEmptyDirectory, Move, Writable};
+    std::vector<Result> results = Apply(fs, root, mappings, &links);
+    bool changed = links.size() != before.size();
+    for (const auto &result : results)
+    {
+        changed = changed || result.status != Status::kKept;
+        if (result.status == Status::kFallback || result.status == Status::kNoLinks ||
+            result.status == Status::kSkipped || result.status == Status::kFailed)
+        {
+            WarningLog(L"Storage layout: %s -> %s: %s", result.path.c_str(), result.target.c_str(),
+                       StatusName(result.status));
+        }
+        else
+        {
+            DebugLog(L"Storage layout: %s -> %s: %s", result.path.c_str(), result.target.c_str(),
+                     StatusName(result.status));
+        }
+    }
+    if (!changed)
+        return;
+
+    std::vector<uint8_t> bytes = EncodeLinks(links);
+    state_store::Update([&bytes](state_format::Builder &builder) {
+        builder.Set(state_store::kStorageLayout, kLayoutVersion, bytes.data(), bytes.size());
+    });
+}
+
+}  // namespace storage_layout
+
+#endif  // VIVALDI_PLUS_STORAGE_LAYOUT_H_
@@ -0,0 +1,480 @@
+#ifndef VIVALDI_PLUS_STORAGE_PLAN_H_
+#define VIVALDI_PLUS_STORAGE_PLAN_H_
+
+// Platform-neutral part of the tiered storage layout (storage_layout.h).
+// [storage] maps profile sub-directories (GPUCache, Code Cache, ...) to
+// directories elsewhere, e.g. a fast local disk. Before the relaunch each
+// mapped directory is made a link to its target: contents already in the
+// profile are moved over first, a changed target gets the contents of the old
+// one, and a mapping that was removed from the config is moved back. Before
+// anything moves, a throwaway link proves the data directory's volume can hold
+// one (FAT32 and exFAT cannot). Links are read back after they are made; if a
+// target cannot be used, or a move or the link fails halfway, the contents go
+// back where they were, the browser gets a plain directory in the profile and
+// the move is retried next time.
+// Links made here are kept as one state record, so links made by the user are
+// never touched. The file system is reached through a table of operations,
+// junctions on Windows.
+//
+// Record layout (little endian), version kLayoutVersion:
+//   0  entry count
+//   4  entries: link path length, target length in UTF-16 units (2 bytes each),
+//      link path (UTF-16), target (UTF-16)
+//
+// This header must not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "path_compare.h"
+#include "state_format.h"
+
+namespace storage_layout
+{
+
+constexpr uint32_t kLayoutVersion = 1;
+constexpr size_t kMaxMappings = 64;
+
+// Made next to a mapped directory and removed again, see CanLink
+constexpr wchar_t kLinkProbeName[] = L"vivaldi_plus.link_probe";
+
+// A [storage] line: directory relative to the data directory, absolute target
+struct Mapping
+{
+    std::wstring relative;
+    std::wstring target;
+};
+
+// A link made by Apply
+struct Link
+{
+    std::wstring path;
+    std::wstring target;
+};
+
+enum class Kind
+{
+    kMissing,
+    kDirectory,
+    kLink,   // Directory link, `target` of inspect() is set
+    kOther,  // A file or something unreadable
+};
+
+struct FileSystem
+{
+    Kind (*inspect)(const std::wstring &path, std::wstring *target);
+    bool (*list)(const std::wstring &dir, std::vector<std::wstring> *names);
+    bool (*make_directory)(const std::wstring &path);  // With missing parents
+    bool (*make_link)(const std::wstring &path, const std::wstring &target);
+    bool (*remove_link)(const std::wstring &path);     // The link only, never the target
+    bool (*remove_directory)(const std::wstring &path);  // Empty directories only
+    bool (*move)(const std::wstring &from, const std::wstring &to);  // Replaces a file at `to`
+    bool (*writable)(const std::wstring &dir);
+};
+
+enum class Status
+{
+    kKept,        // Link was in place
+    kLinked,      // New link, nothing to move
+    kMoved,       // Contents moved to the target, then linked
+    kRetargeted,  // Contents moved from the previous target, then linked
+    kFallback,    // Target not usable, plain directory in the profile
+    kNoLinks,     // The data directory's volume cannot hold links, plain directory
+    kSkipped,     // Not a directory or a link made by someone else
+    kFailed,      // Contents could not be moved completely
+    kReverted,    // Mapping removed, contents moved back
+};
+
+struct Result
+{
+    std::wstring path;
+    std::wstring target;
+    Status status;
+};
+
+struct Rejected
+{
+    std::wstring relative;
+    const wchar_t *reason;
+};
+
+inline bool IsWithin(std::wstring_view path, std::wstring_view dir)
+{
+    if (path.size() < dir.size() || !path_compare::EqualsIgnoreCase(path.substr(0, dir.size()), dir))
+        return false;
+    return path.size() == dir.size() || path[dir.size()] == L'\\' || (!dir.empty() && dir.back() == L'\\');
+}
+
+// Backslashes only, no leading, trailing or repeated ones; empty if the path
+// leaves the data directory or is not relative
+inline std::wstring NormalizeRelative(std::wstring_view relative)
+{
+    std::wstring result;
+    while (!relative.empty())
+    {
+        size_t slash = relative.find_first_of(L"\\/");
+        std::wstring_view component = relative.substr(0, slash);
+        relative = slash == std::wstring_view::npos ? std::wstring_view() : relative.substr(slash + 1);
+        if (component.empty())
+        {
+            if (result.empty())
+                return {};  // Leading separator: rooted path
+            continue;
+        }
+        if (component == L"." || component == L".." || component.find(L':') != std::wstring_view::npos)
+            return {};
+
+        if (!result.empty())
+            result += L'\\';
+        result += component;
+    }
+    return result;
+}
+
+inline std::wstring TrimSeparators(std::wstring path)
+{
+    while (path.size() > 1 && path.back() == L'\\' && path[path.size() - 2] != L':')
+    {
+        path.pop_back();
+    }
+    return path;
+}
+
+// Mappings that can be applied to `data_dir` in config order; a later mapping
+// that overlaps an earlier one is rejected
+inline std::vector<Mapping> Validate(const std::wstring &data_dir, const std::vector<Mapping> &mappings,
+                                     std::vector<Rejected> *rejected)
+{
+    std::vector<Mapping> valid;
+    for (const auto &mapping : mappings)
+    {
+        Mapping normalized{NormalizeRelative(mapping.relative), TrimSeparators(mapping.target)};
+        const wchar_t *reason = nullptr;
+        if (normalized.relative.empty())
+            reason = L"not a directory inside the data directory";
+        else if (normalized.target.empty())
+            reason = L"no target";
+        else if (IsWithin(normalized.target, data_dir) || IsWithin(data_dir, normalized.target))
+            reason = L"target overlaps the data directory";
+        else if (valid.size() >= kMaxMappings)
+            reason = L"too many mappings";
+
+        for (const auto &other : valid)
+        {
+            if (reason)
+                break;
+            if (IsWithin(normalized.relative, other.relative) || IsWithin(other.relative, normalized.relative))
+                reason = L"overlaps another mapping";
+            else if (IsWithin(normalized.target, other.target) || IsWithin(other.target, normalized.target))
+                reason = L"target overlaps another target";
+        }
+
+        if (reason)
+            rejected->push_back({mapping.relative, reason});
+        else
+            valid.push_back(std::move(normalized));
+    }
+    return valid;
+}
+
+// Move the contents of `from` into `to`, merging directories; files moved in
+// replace files of the same name. `from` is removed once it is empty.
+// Returns false if anything was left behind.
+inline bool MoveTree(const FileSystem &fs, const std::wstring &from, const std::wstring &to)
+{
+    std::wstring ignored;
+    Kind kind = fs.inspect(from, &ignored);
+    if (kind == Kind::kMissing)
+        return true;
+    if (kind != Kind::kDirectory)
+        return false;
+
+    // One rename if the destination is free and on the same volume
+    if (fs.inspect(to, &ignored) == Kind::kMissing && fs.move(from, to))
+        return true;
+    if (!fs.make_directory(to))
+        return false;
+
+    std::vector<std::wstring> names;
+    if (!fs.list(from, &names))
+        return false;
+
+    bool ok = true;
+    for (const auto &name : names)
+    {
+        std::wstring source = from + L"\\" + name;
+        std::wstring destination = to + L"\\" + name;
+        if (fs.inspect(source, &ignored) == Kind::kDirectory)
+            ok = MoveTree(fs, source, destination) && ok;
+        else
+            ok = fs.move(source, destination) && ok;
+    }
+    return ok && fs.remove_directory(from);
+}
+
+inline const Link *FindLink(const std::vector<Link> &links, std::wstring_view path)
+{
+    for (const auto &link : links)
+    {
+        if (path_compare::EqualsIgnoreCase(link.path, path))
+            return &link;
+    }
+    return nullptr;
+}
+
+inline std::wstring Parent(const std::wstring &path)
+{
+    size_t slash = path.rfind(L'\\');
+    return slash == std::wstring::npos ? std::wstring() : path.substr(0, slash);
+}
+
+// The browser must find a directory at `path`, even if the link failed
+inline void EnsureDirectory(const FileSystem &fs, const std::wstring &path)
+{
+    std::wstring target;
+    if (fs.inspect(path, &target) == Kind::kLink)
+        fs.remove_link(path);
+    fs.make_directory(path);
+}
+
+// Make and read back a throwaway link to `target` next to `path`
+inline bool CanLink(const FileSystem &fs, const std::wstring &path, const std::wstring &target)
+{
+    std::wstring parent = Parent(path);
+    std::wstring probe = parent + L"\\" + kLinkProbeName;
+    std::wstring made;
+    if (!fs.make_directory(parent))
+        return false;
+    if (fs.inspect(probe, &made) == Kind::kLink)
+        fs.remove_link(probe);  // Left by an interrupted start
+
+    bool ok = fs.make_link(probe, target) && fs.inspect(probe, &made) == Kind::kLink &&
+              path_compare::EqualsIgnoreCase(made, target);
+    if (fs.inspect(probe, &made) == Kind::kLink)
+        fs.remove_link(probe);
+    return ok;
+}
+
+// Bring the links under `data_dir` in line with `mappings` (validated).
+// `links` holds the links made by earlier calls, on return the links in place
+// plus removed mappings whose contents could not be moved back yet.
+inline std::vector<Result> Apply(const FileSystem &fs, const std::wstring &data_dir,
+                                 const std::vector<Mapping> &mappings, std::vector<Link> *links)
+{
+    std::vector<Result> results;
+    std::vector<Link> kept;
+
+    for (const auto &mapping : mappings)
+    {
+        std::wstring path = data_dir + L"\\" + mapping.relative;
+        const Link *previous = FindLink(*links, path);
+
+        std::wstring current;
+        Kind kind = fs.inspect(path, &current);
+        bool at_target = kind == Kind::kLink && path_compare::EqualsIgnoreCase(current, mapping.target);
+        bool ours = at_target ||
+                    (kind == Kind::kLink && previous && path_compare::EqualsIgnoreCase(current, previous->target));
+        if (at_target && fs.writable(mapping.target))
+        {
+            kept.push_back({path, mapping.target});
+            results.push_back({path, mapping.target, Status::kKept});
+            continue;
+        }
+        if (kind == Kind::kOther || (kind == Kind::kLink && !ours))
+        {
+            results.push_back({path, mapping.target, Status::kSkipped});
+            continue;
+        }
+
+        bool usable = fs.make_directory(mapping.target) && fs.writable(mapping.target);
+        if (!usable || !CanLink(fs, path, mapping.target))
+        {
+            // Keep the old target linked if it still works, its contents move later
+            Status status = usable ? Status::kNoLinks : Status::kFallback;
+            if (ours && fs.writable(current))
+            {
+                kept.push_back({path, current});
+                results.push_back({path, current, status});
+                continue;
+            }
+            EnsureDirectory(fs, path);
+            results.push_back({path, mapping.target, status});
+            continue;
+        }
+
+        Status status = Status::kLinked;
+        bool moved = true;
+        if (kind == Kind::kDirectory)
+        {
+            moved = MoveTree(fs, path, mapping.target);
+            status = Status::kMoved;
+        }
+        else if (ours)
+        {
+            // The old target stays reachable until its contents are over
+            moved = MoveTree(fs, current, mapping.target);
+            status = Status::kRetargeted;
+            if (moved)
+                fs.remove_link(path);
+        }
+
+        if (!moved)
+        {
+            // Whatever made it over goes back, so the browser sees one complete directory
+            MoveTree(fs, mapping.target, status == Status::kMoved ? path : current);
+            if (ours)
+                kept.push_back({path, current});
+            results.push_back({path, mapping.target, Status::kFailed});
+            continue;
+        }
+
+        // Read the link back before the browser relies on it
+        std::wstring made;
+        if (fs.make_link(path, mapping.target) && fs.inspect(path, &made) == Kind::kLink &&
+            path_compare::EqualsIgnoreCase(made, mapping.target))
+        {
+            kept.push_back({path, mapping.target});
+            results.push_back({path, mapping.target, status});
+        }
+        else
+        {
+            // The old link is gone after a retarget, the profile takes the contents
+            EnsureDirectory(fs, path);
+            if (status != Status::kLinked)
+                MoveTree(fs, mapping.target, path);
+            results.push_back({path, mapping.target, Status::kFailed});
+        }
+    }
+
+    // Mappings removed from the config: move the contents back into the profile
+    for (const auto &link : *links)
+    {
+        if (FindLink(kept, link.path))
+            continue;
+        bool mapped = false;
+        for (const auto &mapping : mappings)
+        {
+            mapped = mapped || path_compare::EqualsIgnoreCase(link.path, data_dir + L"\\" + mapping.relative);
+        }
+        if (mapped)
+            continue;
+
+        // A target on a drive that is not there now is moved back when it returns
+        std::wstring current;
+        if (fs.inspect(link.target, &current) == Kind::kMissing &&
+            fs.inspect(Parent(link.target), &current) == Kind::kMissing)
+        {
+            kept.push_back(link);
+            results.push_back({link.path, link.target, Status::kFailed});
+            continue;
+        }
+
+        Kind kind = fs.inspect(link.path, &current);
+        if (kind == Kind::kLink)
+        {
+            if (!path_compare::EqualsIgnoreCase(current, link.target))
+                continue;  // Replaced by someone else's link
+            fs.remove_link(link.path);
+        }
+        else if (kind == Kind::kOther)
+        {
+            continue;
+        }
+
+        if (MoveTree(fs, link.target, link.path))
+        {
+            fs.make_directory(link.path);
+            results.push_back({link.path, link.target, Status::kReverted});
+        }
+        else
+        {
+            // Retried on the next start; the browser gets what was moved so far
+            fs.make_directory(link.path);
+            kept.push_back(link);
+            results.push_back({link.path, link.target, Status::kFailed});
+        }
+    }
+
+    *links = std::move(kept);
+    return results;
+}
+
+inline std::vector<uint8_t> EncodeLinks(const std::vector<Link> &links)
+{
+    std::vector<uint8_t> bytes(4);
+    state_format::StoreLE32(bytes.data(), static_cast<uint32_t>(links.size()));
+    for (const auto &link : links)
+    {
+        size_t path_length = link.path.size() < UINT16_MAX ? link.path.size() : UINT16_MAX;
+        size_t target_length = link.target.size() < UINT16_MAX ? link.target.size() : UINT16_MAX;
+        size_t offset = bytes.size();
+        bytes.resize(offset + 4 + (path_length + target_length) * 2);
+
+        uint8_t *out = bytes.data() + offset;
+        state_format::StoreLE16(out, static_cast<uint16_t>(path_length));
+        state_format::StoreLE16(out + 2, static_cast<uint16_t>(target_length));
+        out += 4;
+        for (size_t i = 0; i < path_length; i++, out += 2)
+        {
+            state_format::StoreLE16(out, static_cast<uint16_t>(link.path[i]));
+        }
+        for (size_t i = 0; i < target_length; i++, out += 2)
+        {
+            state_format::StoreLE16(out, static_cast<uint16_t>(link.target[i]));
+        }
+    }
+    return bytes;
+}
+
+// False (and nothing decoded) if the record is malformed
+inline bool DecodeLinks(const uint8_t *data, size_t size, std::vector<Link> *links)
+{
+    links->clear();
+    if (size < 4)
+        return false;
+
+    size_t count = state_format::LoadLE32(data);
+    if (count > kMaxMappings * 2)
+        return false;
+
+    size_t offset = 4;
+    for (size_t i = 0; i < count && size - offset >= 4; i++)
+    {
+        const uint8_t *in = data + offset;
+        size_t path_length = state_format::LoadLE16(in);
+        size_t target_length = state_format::LoadLE16(in + 2);
+        if (size - offset - 4 < (path_length + target_length) * 2)
+            break;
+
+        Link link;
+        link.path.resize(path_length);
+        link.target.resize(target_length);
+        in += 4;
+        for (size_t j = 0; j < path_length; j++, in += 2)
+        {
+            link.path[j] = static_cast<wchar_t>(state_format::LoadLE16(in));
+        }
+        for (size_t j = 0; j < target_length; j++, in += 2)
+        {
+            link.target[j] = static_cast<wchar_t>(state_format::LoadLE16(in));
+        }
+        links->push_back(std::move(link));
+        offset += 4 + (path_length + target_length) * 2;
+    }
+
+    if (links->size() != count || offset != size)
+    {
+        links->clear();
+        return false;
+    }
+    return true;
+}
+
+}  // namespace storage_layout
+
+#endif  // VIVALDI_PLUS_STORAGE_PLAN_H_
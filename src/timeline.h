@@ -0,0 +1,292 @@
+#ifndef VIVALDI_PLUS_TIMELINE_H_
+#define VIVALDI_PLUS_TIMELINE_H_
+
+// Platform-neutral span recorder for the startup timeline.
+// Spans go into a fixed-size buffer (no allocation while recording, lock-free
+// slot reservation), can be carried to another process as compact text and
+// are exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Timestamps are microseconds of a clock shared by all processes involved.
+// startup_trace.cpp provides the Win32 clock and plumbing; this header must
+// not include <windows.h>.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace timeline
+{
+
+struct Span
+{
+    char name[48];
+    uint32_t pid;
+    uint32_t tid;
+    int64_t begin_us;
+    int64_t end_us;  // 0 while the span is still open
+};
+
+struct ProcessName
+{
+    uint32_t pid;
+    char name[32];
+};
+
+class Recorder
+{
+public:
+    static constexpr size_t kCapacity = 256;
+    static constexpr size_t kMaxProcesses = 8;
+    static constexpr size_t kInvalid = kCapacity;
+
+    // Open a span, returns its index or kInvalid when the buffer is full
+    size_t Begin(std::string_view name, uint32_t pid, uint32_t tid, int64_t begin_us)
+    {
+        size_t index = next_span_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= kCapacity)
+            return kInvalid;
+
+        Slot &slot = spans_[index];
+        CopyName(slot.name, sizeof(slot.name), name);
+        slot.pid = pid;
+        slot.tid = tid;
+        slot.begin_us = begin_us;
+        slot.end_us.store(0, std::memory_order_relaxed);
+        slot.ready.store(true, std::memory_order_release);
+        return index;
+    }
+
+    void End(size_t index, int64_t end_us)
+    {
+        if (index < kCapacity)
+            spans_[index].end_us.store(end_us, std::memory_order_release);
+    }
+
+    size_t Add(std::string_view name, uint32_t pid, uint32_t tid, int64_t begin_us, int64_t end_us)
+    {
+        size_t index = Begin(name, pid, tid, begin_us);
+        End(index, end_us);
+        return index;
+    }
+
+    // End every span that is still open, e.g. a relaunch finished by the new process
+    void CloseOpen(int64_t end_us)
+    {
+        for (size_t i = 0; i < Count(); i++)
+        {
+            int64_t open = 0;
+            if (spans_[i].ready.load(std::memory_order_acquire))
+                spans_[i].end_us.compare_exchange_strong(open, end_us, std::memory_order_acq_rel);
+        }
+    }
+
+    void SetProcessName(uint32_t pid, std::string_view name)
+    {
+        size_t index = next_process_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= kMaxProcesses)
+            return;
+
+        ProcessSlot &slot = processes_[index];
+        slot.pid = pid;
+        CopyName(slot.name, sizeof(slot.name), name);
+        slot.ready.store(true, std::memory_order_release);
+    }
+
+    // Spans recorded so far (in slot order), skipping slots still being written
+    std::vector<Span> Spans() const
+    {
+        std::vector<Span> spans;
+        for (size_t i = 0; i < Count(); i++)
+        {
+            const Slot &slot = spans_[i];
+            if (!slot.ready.load(std::memory_order_acquire))
+                continue;
+
+            Span span;
+            memcpy(span.name, slot.name, sizeof(span.name));
+            span.pid = slot.pid;
+            span.tid = slot.tid;
+            span.begin_us = slot.begin_us;
+            span.end_us = slot.end_us.load(std::memory_order_acquire);
+            spans.push_back(span);
+        }
+        return spans;
+    }
+
+    std::vector<ProcessName> Processes() const
+    {
+        std::vector<ProcessName> processes;
+        size_t count = next_process_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count && i < kMaxProcesses; i++)
+        {
+            if (processes_[i].ready.load(std::memory_order_acquire))
+            {
+                ProcessName process;
+                process.pid = processes_[i].pid;
+                memcpy(process.name, processes_[i].name, sizeof(process.name));
+                processes.push_back(process);
+            }
+        }
+        return processes;
+    }
+
+    // Compact text form, one record per line:
+    //   P <pid> <name>
+    //   S <pid> <tid> <begin> <end> <name>
+    std::string Serialize() const
+    {
+        std::string text;
+        char line[128];
+        for (const auto &process : Processes())
+        {
+            snprintf(line, sizeof(line), "P %u %s\n", process.pid, process.name);
+            text += line;
+        }
+        for (const auto &span : Spans())
+        {
+            snprintf(line, sizeof(line), "S %u %u %lld %lld %s\n", span.pid, span.tid,
+                     static_cast<long long>(span.begin_us), static_cast<long long>(span.end_us), span.name);
+            text += line;
+        }
+        return text;
+    }
+
+    // Import records produced by Serialize, malformed lines are skipped
+    // Returns the number of spans imported
+    size_t Deserialize(std::string_view text)
+    {
+        size_t imported = 0;
+        while (!text.empty())
+        {
+            size_t end = text.find('\n');
+            std::string line(text.substr(0, end));
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+            unsigned int pid = 0, tid = 0;
+            long long begin = 0, finish = 0;
+            int name_offset = 0;
+            if (sscanf(line.c_str(), "P %u %n", &pid, &name_offset) == 1 && name_offset > 0)
+            {
+                SetProcessName(pid, std::string_view(line).substr(name_offset));
+            }
+            else if (sscanf(line.c_str(), "S %u %u %lld %lld %n", &pid, &tid, &begin, &finish, &name_offset) == 4 &&
+                     name_offset > 0)
+            {
+                imported += Add(std::string_view(line).substr(name_offset), pid, tid, begin, finish) != kInvalid;
+            }
+        }
+        return imported;
+    }
+
+    // Chrome trace-event JSON; open spans become instant events
+    std::string ToTraceJson() const
+    {
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        char event[192];
+        auto append = [&](const char *text, const std::string &name, const char *suffix) {
+            json += first ? "\n" : ",\n";
+            first = false;
+            json += text;
+            AppendEscaped(json, name);
+            json += suffix;
+        };
+
+        for (const auto &process : Processes())
+        {
+            snprintf(event, sizeof(event), "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"",
+                     process.pid);
+            append(event, process.name, "\"}}");
+        }
+        for (const auto &span : Spans())
+        {
+            if (span.end_us)
+            {
+                snprintf(event, sizeof(event),
+                         "{\"ph\":\"X\",\"cat\":\"startup\",\"pid\":%u,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"name\":\"",
+                         span.pid, span.tid, static_cast<long long>(span.begin_us),
+                         static_cast<long long>(span.end_us - span.begin_us));
+            }
+            else
+            {
+                snprintf(event, sizeof(event),
+                         "{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"startup\",\"pid\":%u,\"tid\":%u,\"ts\":%lld,\"name\":\"",
+                         span.pid, span.tid, static_cast<long long>(span.begin_us));
+            }
+            append(event, span.name, "\"}");
+        }
+        json += "\n]}\n";
+        return json;
+    }
+
+private:
+    struct Slot
+    {
+        char name[48];
+        uint32_t pid;
+        uint32_t tid;
+        int64_t begin_us;
+        std::atomic<int64_t> end_us{0};
+        std::atomic<bool> ready{false};
+    };
+
+    struct ProcessSlot
+    {
+        uint32_t pid;
+        char name[32];
+        std::atomic<bool> ready{false};
+    };
+
+    size_t Count() const
+    {
+        size_t count = next_span_.load(std::memory_order_acquire);
+        return count < kCapacity ? count : kCapacity;
+    }
+
+    // Truncate and keep names on one line, the text form is line based
+    static void CopyName(char *out, size_t size, std::string_view name)
+    {
+        size_t length = name.size() < size - 1 ? name.size() : size - 1;
+        for (size_t i = 0; i < length; i++)
+        {
+            out[i] = (name[i] == '\n' || name[i] == '\r') ? ' ' : name[i];
+        }
+        out[length] = 0;
+    }
+
+    static void AppendEscaped(std::string &json, const std::string &text)
+    {
+        for (char ch : text)
+        {
+            if (ch == '"' || ch == '\\')
+            {
+                json += '\\';
+                json += ch;
+            }
+            else if (static_cast<unsigned char>(ch) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                json += escaped;
+            }
+            else
+            {
+                json += ch;
+            }
+        }
+    }
+
+    Slot spans_[kCapacity];
+    ProcessSlot processes_[kMaxProcesses];
+    std::atomic<size_t> next_span_{0};
+    std::atomic<size_t> next_process_{0};
+};
+
+}  // namespace timeline
+
+#endif  // VIVALDI_PLUS_TIMELINE_H_
@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <shellapi.h>
+
 // String formatting utilities
 std::wstring Format(const wchar_t *format, va_list args)
 {
@@ -33,16 +35,19 @@ std::wstring Format(const wchar_t *format, ...)
     return str;
 }
 
-// Debug logging to OutputDebugString
-void DebugLog(const wchar_t *format, ...)
+// printf-style DebugLog for C callbacks
+void DebugLogV(const wchar_t *format, ...)
 {
+    if (!logger::IsEnabled(logger::Level::kDebug))
+        return;
+
+    wchar_t buffer[1024];
     va_list args;
     va_start(args, format);
-    std::wstring str = Format(format, args);
+    _vsnwprintf_s(buffer, _TRUNCATE, format, args);
     va_end(args);
 
-    std::wstring output = Format(L"[vivaldi++]%s\n", str.c_str());
-    OutputDebugStringW(output.c_str());
+    DebugLog(L"%s", buffer);
 }
 
 // Memory search wrapper
@@ -124,8 +129,14 @@ std::wstring GetAppDir()
         wchar_t path[MAX_PATH];
         if (::GetModuleFileNameW(nullptr, path, MAX_PATH))
         {
-            ::PathRemoveFileSpecW(path);
-            return std::wstring(path);
+            // Strip the file name by hand, shlwapi.dll is delay-loaded
+            std::wstring dir(path);
+            size_t slash = dir.find_last_of(L"\\/");
+            if (slash != std::wstring::npos)
+            {
+                dir.resize(slash);
+            }
+            return dir;
         }
         return std::wstring();
     }();
@@ -199,6 +210,55 @@ void ReplaceStringInPlace(std::wstring &subject, std::wstring_view search, std::
     }
 }
 
+// Config paths may use environment variables and %app%; absolute, without a trailing backslash
+std::wstring ResolvePath(const std::wstring &path)
+{
+    std::wstring expanded = ExpandEnvironmentPath(path);
+    ReplaceStringInPlace(expanded, L"%app%", GetAppDir());
+    expanded = GetAbsolutePath(expanded);
+    while (expanded.size() > 3 && expanded.back() == L'\\')
+    {
+        expanded.pop_back();
+    }
+    return expanded;
+}
+
+// Value of a --name=value switch of this process, empty if absent
+std::wstring GetSwitchValue(std::wstring_view name)
+{
+    int argc = 0;
+    LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv)
+        return L"";
+
+    std::wstring value;
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring_view arg(argv[i]);
+        if (arg == L"--")
+            break;
+        if (arg.size() > name.size() && arg.starts_with(name) && arg[name.size()] == L'=')
+        {
+            value = arg.substr(name.size() + 1);
+            break;
+        }
+    }
+    LocalFree(argv);
+    return value;
+}
+
+// The browser holds the profile lockfile open without write sharing while it runs
+bool IsProfileInUse(const std::wstring &data_dir)
+{
+    std::wstring path = data_dir + L"\\lockfile";
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, kShareAll, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_SHARING_VIOLATION;
+
+    CloseHandle(file);
+    return false;
+}
+
 // Replace all occurrences of 'search' with 'replace' in string (narrow char version)
 bool ReplaceStringInPlace(std::string &subject, std::string_view search, std::string_view replace)
 {
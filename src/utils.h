@@ -19,13 +19,29 @@
 #include <ranges>
 
 #include "fastsearch.h"
+#include "logger.h"
 
 // String formatting utilities
 std::wstring Format(const wchar_t *format, va_list args);
 std::wstring Format(const wchar_t *format, ...);
 
-// Debug logging to OutputDebugString
-void DebugLog(const wchar_t *format, ...);
+// Debug logging, recorded only with debug_log=1 and formatted off-thread (logger.h)
+// `format` must be a string literal, arguments are copied when the call is made
+template <typename... Args>
+inline void DebugLog(const wchar_t *format, const Args &...args)
+{
+    logger::Log(logger::Level::kDebug, format, args...);
+}
+
+// Failures worth keeping in the log file without debug_log
+template <typename... Args>
+inline void WarningLog(const wchar_t *format, const Args &...args)
+{
+    logger::Log(logger::Level::kWarning, format, args...);
+}
+
+// printf-style DebugLog for C callbacks (bosskey::Options::log), formats on the calling thread
+void DebugLogV(const wchar_t *format, ...);
 
 // Memory search wrapper
 uint8_t *memmem(uint8_t *src, int n, const uint8_t *sub, int m);
@@ -51,6 +67,18 @@ std::wstring ExpandEnvironmentPath(std::wstring_view path);
 // Replace all occurrences of 'search' with 'replace' in string (wide char version)
 void ReplaceStringInPlace(std::wstring &subject, std::wstring_view search, std::wstring_view replace);
 
+// Share mode for our own handles, the browser may keep reading, writing and renaming the file
+constexpr DWORD kShareAll = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+
+// Config paths may use environment variables and %app%; absolute, without a trailing backslash
+std::wstring ResolvePath(const std::wstring &path);
+
+// Value of a --name=value switch of this process, empty if absent
+std::wstring GetSwitchValue(std::wstring_view name);
+
+// The browser holds the profile lockfile open without write sharing while it runs
+bool IsProfileInUse(const std::wstring &data_dir);
+
 // Replace all occurrences of 'search' with 'replace' in string (narrow char version)
 bool ReplaceStringInPlace(std::string &subject, std::string_view search, std::string_view replace);
 
@@ -88,6 +116,7 @@ void compression_html(std::string &html);
 // Hotkey parsing utilities
 // ====================================================================================
 
+#include <array>
 #include <optional>
 
 namespace hotkey_impl {
@@ -96,140 +125,315 @@ namespace hotkey_impl {
 // Windows 7+ defines this in winuser.h, but we define it here for compatibility
 constexpr UINT kModNoRepeat = 0x4000;
 
-// Modifier keys mapping
-constexpr std::pair<std::wstring_view, UINT> kModifierKeys[] = {
-    {L"shift", MOD_SHIFT},
-    {L"ctrl", MOD_CONTROL},
-    {L"control", MOD_CONTROL},  // alias
-    {L"alt", MOD_ALT},
-    {L"win", MOD_WIN},
+// Named key: modifier or special virtual key
+// `display` is set on the canonical spelling used by FormatHotkey, aliases leave it empty
+struct KeyName
+{
+    std::wstring_view name;
+    UINT code;
+    bool is_modifier;
+    std::wstring_view display;
 };
 
-// Special virtual keys mapping
-constexpr std::pair<std::wstring_view, UINT> kSpecialKeys[] = {
+// All named keys (names must be lower case ASCII or non-letters)
+constexpr KeyName kKeyNames[] = {
+    // Modifier keys
+    {L"ctrl", MOD_CONTROL, true, L"Ctrl"},
+    {L"control", MOD_CONTROL, true, {}},  // alias
+    {L"alt", MOD_ALT, true, L"Alt"},
+    {L"shift", MOD_SHIFT, true, L"Shift"},
+    {L"win", MOD_WIN, true, L"Win"},
     // Arrow keys
-    {L"left", VK_LEFT},
-    {L"right", VK_RIGHT},
-    {L"up", VK_UP},
-    {L"down", VK_DOWN},
-    {L"←", VK_LEFT},
-    {L"→", VK_RIGHT},
-    {L"↑", VK_UP},
-    {L"↓", VK_DOWN},
+    {L"left", VK_LEFT, false, L"Left"},
+    {L"right", VK_RIGHT, false, L"Right"},
+    {L"up", VK_UP, false, L"Up"},
+    {L"down", VK_DOWN, false, L"Down"},
+    {L"←", VK_LEFT, false, {}},
+    {L"→", VK_RIGHT, false, {}},
+    {L"↑", VK_UP, false, {}},
+    {L"↓", VK_DOWN, false, {}},
     // Control keys
-    {L"esc", VK_ESCAPE},
-    {L"escape", VK_ESCAPE},  // alias
-    {L"tab", VK_TAB},
-    {L"backspace", VK_BACK},
-    {L"enter", VK_RETURN},
-    {L"return", VK_RETURN},  // alias
-    {L"space", VK_SPACE},
+    {L"esc", VK_ESCAPE, false, L"Esc"},
+    {L"escape", VK_ESCAPE, false, {}},  // alias
+    {L"tab", VK_TAB, false, L"Tab"},
+    {L"backspace", VK_BACK, false, L"Backspace"},
+    {L"enter", VK_RETURN, false, L"Enter"},
+    {L"return", VK_RETURN, false, {}},  // alias
+    {L"space", VK_SPACE, false, L"Space"},
     // System keys
-    {L"prtsc", VK_SNAPSHOT},
-    {L"printscreen", VK_SNAPSHOT},  // alias
-    {L"scroll", VK_SCROLL},
-    {L"pause", VK_PAUSE},
+    {L"prtsc", VK_SNAPSHOT, false, L"PrtSc"},
+    {L"printscreen", VK_SNAPSHOT, false, {}},  // alias
+    {L"scroll", VK_SCROLL, false, L"Scroll"},
+    {L"pause", VK_PAUSE, false, L"Pause"},
     // Navigation keys
-    {L"insert", VK_INSERT},
-    {L"delete", VK_DELETE},
-    {L"del", VK_DELETE},  // alias
-    {L"home", VK_HOME},
-    {L"end", VK_END},
-    {L"pageup", VK_PRIOR},
-    {L"pgup", VK_PRIOR},  // alias
-    {L"pagedown", VK_NEXT},
-    {L"pgdn", VK_NEXT},  // alias
+    {L"insert", VK_INSERT, false, L"Insert"},
+    {L"delete", VK_DELETE, false, L"Delete"},
+    {L"del", VK_DELETE, false, {}},  // alias
+    {L"home", VK_HOME, false, L"Home"},
+    {L"end", VK_END, false, L"End"},
+    {L"pageup", VK_PRIOR, false, L"PageUp"},
+    {L"pgup", VK_PRIOR, false, {}},  // alias
+    {L"pagedown", VK_NEXT, false, L"PageDown"},
+    {L"pgdn", VK_NEXT, false, {}},  // alias
 };
 
-constexpr bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b) {
-  if (a.size() != b.size())
-    return false;
-  for (size_t i = 0; i < a.size(); ++i) {
-    if (::towlower(a[i]) != ::towlower(b[i]))  // Use global towlower
-      return false;
-  }
-  return true;
+// ASCII-only case folding, usable in constant expressions
+constexpr wchar_t FoldCase(wchar_t ch)
+{
+    return (ch >= L'A' && ch <= L'Z') ? static_cast<wchar_t>(ch - L'A' + L'a') : ch;
+}
+
+// Seeded FNV-1a over case-folded characters
+constexpr uint32_t HashKeyName(std::wstring_view key, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (wchar_t ch : key)
+    {
+        hash ^= static_cast<uint32_t>(FoldCase(ch));
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+// Perfect hash table over kKeyNames, built at compile time
+constexpr size_t kKeyTableSize = 256;
+constexpr uint8_t kEmptySlot = 0xFF;
+static_assert(std::size(kKeyNames) < kEmptySlot, "kKeyNames does not fit uint8_t slots");
+
+struct KeyTable
+{
+    uint32_t seed;
+    std::array<uint8_t, kKeyTableSize> slots;
+};
+
+constexpr KeyTable BuildKeyTable()
+{
+    for (uint32_t seed = 0;; ++seed)
+    {
+        KeyTable table{seed, {}};
+        table.slots.fill(kEmptySlot);
+        bool collision = false;
+        for (size_t i = 0; i < std::size(kKeyNames) && !collision; ++i)
+        {
+            auto &slot = table.slots[HashKeyName(kKeyNames[i].name, seed) % kKeyTableSize];
+            collision = slot != kEmptySlot;
+            slot = static_cast<uint8_t>(i);
+        }
+        if (!collision)
+            return table;
+    }
+}
+
+constexpr KeyTable kKeyTable = BuildKeyTable();
+
+constexpr bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (FoldCase(a[i]) != FoldCase(b[i]))
+            return false;
+    }
+    return true;
 }
 
-template <size_t N>
-constexpr std::optional<UINT> FindInKeyMap(
-    std::wstring_view key,
-    const std::pair<std::wstring_view, UINT> (&map)[N]) {
-  for (const auto& [name, code] : map) {
-    if (EqualsIgnoreCase(key, name))
-      return code;
-  }
-  return std::nullopt;
+// O(length) lookup: one hash, one probe, one comparison
+constexpr const KeyName *FindKeyName(std::wstring_view key)
+{
+    uint8_t index = kKeyTable.slots[HashKeyName(key, kKeyTable.seed) % kKeyTableSize];
+    if (index == kEmptySlot || !EqualsIgnoreCase(key, kKeyNames[index].name))
+        return nullptr;
+    return &kKeyNames[index];
 }
 
 // Parse function key (F1-F24)
-inline std::optional<UINT> ParseFunctionKey(std::wstring_view key) {
-  if (key.size() < 2 || (key[0] != L'F' && key[0] != L'f'))
+constexpr std::optional<UINT> ParseFunctionKey(std::wstring_view key)
+{
+    if (key.size() < 2 || key.size() > 3 || FoldCase(key[0]) != L'f')
+        return std::nullopt;
+
+    UINT fx = 0;
+    for (wchar_t c : key.substr(1))
+    {
+        if (c < L'0' || c > L'9')
+            return std::nullopt;
+        fx = fx * 10 + (c - L'0');
+    }
+
+    if (fx >= 1 && fx <= 24)
+        return VK_F1 + fx - 1;
     return std::nullopt;
+}
 
-  auto num_part = key.substr(1);
-  if (num_part.empty() || !std::ranges::all_of(num_part, ::iswdigit))
+// Parse ASCII letter or digit, whose virtual key equals its upper-case character
+constexpr std::optional<UINT> ParseAsciiKey(std::wstring_view key)
+{
+    if (key.size() != 1)
+        return std::nullopt;
+
+    wchar_t ch = key[0];
+    if (ch >= L'0' && ch <= L'9')
+        return static_cast<UINT>(ch);
+    if (ch >= L'a' && ch <= L'z')
+        return static_cast<UINT>(ch - L'a' + L'A');
+    if (ch >= L'A' && ch <= L'Z')
+        return static_cast<UINT>(ch);
     return std::nullopt;
+}
 
-  int fx = 0;
-  for (wchar_t c : num_part) {
-    fx = fx * 10 + (c - L'0');
-  }
+// Parse single character key that depends on the keyboard layout (symbols, non-ASCII letters)
+// Looked up in the layout active now, hotkeys are parsed once at config load
+inline std::optional<UINT> ParseCharacterKey(std::wstring_view key)
+{
+    if (key.size() != 1)
+        return std::nullopt;
 
-  if (fx >= 1 && fx <= 24)
-    return VK_F1 + fx - 1;
-  return std::nullopt;
-}
+    wchar_t ch = key[0];
+    if (::iswalnum(ch))
+        return static_cast<UINT>(::towupper(ch));
+
+    SHORT scan = ::VkKeyScanW(ch);
+    if (scan != -1)
+        return LOBYTE(scan);
 
-// Parse single character key (A-Z, 0-9, symbols)
-inline std::optional<UINT> ParseCharacterKey(std::wstring_view key) {
-  if (key.size() != 1)
     return std::nullopt;
+}
 
-  wchar_t ch = key[0];
-  if (::iswalnum(ch))
-    return static_cast<UINT>(::towupper(ch));
+// Apply one token of a hotkey string
+// Returns false if the token needs the keyboard layout (or is unknown)
+constexpr bool ApplyKeyToken(std::wstring_view key, UINT &modifiers, UINT &virtual_key)
+{
+    if (const KeyName *named = FindKeyName(key))
+    {
+        if (named->is_modifier)
+            modifiers |= named->code;
+        else
+            virtual_key = named->code;
+        return true;
+    }
+    if (auto vk = ParseFunctionKey(key))
+    {
+        virtual_key = *vk;
+        return true;
+    }
+    if (auto vk = ParseAsciiKey(key))
+    {
+        virtual_key = *vk;
+        return true;
+    }
+    return false;
+}
 
-  // For other characters, use VkKeyScan
-  SHORT scan = ::VkKeyScanW(ch);
-  if (scan != -1)
-    return LOBYTE(scan);
+// Call `fn` for every non-empty '+'-separated token
+template <typename Fn>
+constexpr void ForEachKeyToken(std::wstring_view keys, Fn &&fn)
+{
+    while (!keys.empty())
+    {
+        size_t plus = keys.find(L'+');
+        std::wstring_view token = keys.substr(0, plus);
+        if (!token.empty())
+            fn(token);
+        if (plus == std::wstring_view::npos)
+            break;
+        keys.remove_prefix(plus + 1);
+    }
+}
 
-  return std::nullopt;
+// Deliberately not constexpr: reaching it during constant evaluation is a compile error
+inline void InvalidHotkeyInConstantExpression()
+{
 }
 
 }  // namespace hotkey_impl
 
 // Parse hotkey string like "Ctrl+Alt+B" into Windows RegisterHotKey format
 // Returns MAKELPARAM(modifiers, virtual_key)
-inline UINT ParseHotkeys(std::wstring_view keys, bool no_repeat = true) {
-  UINT modifiers = 0;
-  UINT virtual_key = 0;
-
-  for (const auto& part : std::views::split(keys, L'+')) {
-    std::wstring_view key(part.begin(), part.end());
-    if (key.empty())
-      continue;
-    if (auto mod = hotkey_impl::FindInKeyMap(key, hotkey_impl::kModifierKeys)) {
-      modifiers |= *mod;
-      continue;
+inline UINT ParseHotkeys(std::wstring_view keys, bool no_repeat = true)
+{
+    UINT modifiers = 0;
+    UINT virtual_key = 0;
+
+    hotkey_impl::ForEachKeyToken(keys, [&](std::wstring_view key) {
+        if (hotkey_impl::ApplyKeyToken(key, modifiers, virtual_key))
+            return;
+        if (auto vk = hotkey_impl::ParseCharacterKey(key))
+            virtual_key = *vk;
+    });
+
+    if (no_repeat)
+        modifiers |= hotkey_impl::kModNoRepeat;
+
+    return MAKELPARAM(modifiers, virtual_key);
+}
+
+// Compile-time variant of ParseHotkeys for hotkeys written in code
+// Unknown tokens and layout-dependent symbols fail to compile
+consteval UINT ParseHotkeysConst(std::wstring_view keys, bool no_repeat = true)
+{
+    UINT modifiers = 0;
+    UINT virtual_key = 0;
+
+    hotkey_impl::ForEachKeyToken(keys, [&](std::wstring_view key) {
+        if (!hotkey_impl::ApplyKeyToken(key, modifiers, virtual_key))
+            hotkey_impl::InvalidHotkeyInConstantExpression();
+    });
+    if (virtual_key == 0)
+        hotkey_impl::InvalidHotkeyInConstantExpression();
+
+    if (no_repeat)
+        modifiers |= hotkey_impl::kModNoRepeat;
+
+    return MAKELPARAM(modifiers, virtual_key);
+}
+
+// Format a modifier / virtual-key pair back into canonical form, e.g. "Ctrl+Alt+B"
+// Modifiers are always written in the order Ctrl, Alt, Shift, Win
+inline std::wstring FormatHotkey(UINT modifiers, UINT virtual_key)
+{
+    std::wstring text;
+    for (const auto &named : hotkey_impl::kKeyNames)
+    {
+        if (named.is_modifier && !named.display.empty() && (modifiers & named.code))
+        {
+            text += named.display;
+            text += L'+';
+        }
     }
-    if (auto vk = hotkey_impl::FindInKeyMap(key, hotkey_impl::kSpecialKeys)) {
-      virtual_key = *vk;
-      continue;
+
+    if (auto it = std::ranges::find_if(hotkey_impl::kKeyNames, [&](const hotkey_impl::KeyName &named) {
+            return !named.is_modifier && !named.display.empty() && named.code == virtual_key;
+        });
+        it != std::end(hotkey_impl::kKeyNames))
+    {
+        text += it->display;
     }
-    if (auto vk = hotkey_impl::ParseFunctionKey(key)) {
-      virtual_key = *vk;
-      continue;
+    else if (virtual_key >= VK_F1 && virtual_key <= VK_F24)
+    {
+        text += L'F';
+        text += std::to_wstring(virtual_key - VK_F1 + 1);
     }
-    if (auto vk = hotkey_impl::ParseCharacterKey(key))
-      virtual_key = *vk;
-  }
-
-  if (no_repeat)
-    modifiers |= hotkey_impl::kModNoRepeat;
+    else if ((virtual_key >= L'0' && virtual_key <= L'9') || (virtual_key >= L'A' && virtual_key <= L'Z'))
+    {
+        text += static_cast<wchar_t>(virtual_key);
+    }
+    else if (UINT ch = ::MapVirtualKeyW(virtual_key, MAPVK_VK_TO_CHAR) & 0x7FFF)
+    {
+        // Layout-dependent symbol keys (VK_OEM_*)
+        text += static_cast<wchar_t>(ch);
+    }
+    else
+    {
+        text += Format(L"0x%02X", virtual_key);
+    }
+    return text;
+}
 
-  return MAKELPARAM(modifiers, virtual_key);
+// Format the packed ParseHotkeys result back into canonical form
+inline std::wstring FormatHotkey(UINT packed)
+{
+    return FormatHotkey(LOWORD(packed), HIWORD(packed));
 }
 
 #endif // VIVALDI_PLUS_UTILS_H_
@@ -1,115 +1,140 @@
-#include <windows.h>
-#include <psapi.h>
+//
+// Core of the hijacked version.dll, mapped into every browser process.
+// Kept deliberately small: export forwarding, child process fast path and
+// loading the extension module (vivaldi_plus_ext.dll) in the main process.
+// No Detours, no config and no feature code may be linked in here.
+//
 
-#include "detours.h"
-#include "version.h"
+#include <windows.h>
+#include <string.h>
 
+#include "extension.h"
 #include "hijack.h"
-#include "utils.h"
-#include "patch.h"
-#include "portable.h"
-#include "appid.h"
-#include "green.h"
-#include "hotkey.h"
+#include "process_util.h"
+#include "startup_overhead.h"
 
 // Global module instance
 HMODULE hInstance = nullptr;
 
+// Chromium child process (renderer, GPU, utility...), decided once in DllMain
+static bool is_child_process = false;
+
+// Startup overhead of this process, read by the browser from its children
+startup_overhead::Counters startup_overhead::self = {};
+
 // Function pointer to original program entry point
 typedef int (*Startup)();
 static Startup ExeMain = nullptr;
 
-// Apply Vivaldi Plus enhancements
-void VivaldiPlus()
+// Bytes of the entry point overwritten by InstallLoader
+#if defined(_M_ARM64)
+static constexpr size_t kEntryPatchSize = 16;
+#elif defined(_M_X64)
+static constexpr size_t kEntryPatchSize = 12;
+#else
+static constexpr size_t kEntryPatchSize = 5;
+#endif
+static BYTE entry_backup[kEntryPatchSize];
+
+static bool WriteCode(void *address, const void *code, size_t size)
 {
-    // Set custom AppUserModelID for Windows taskbar
-    SetAppId();
-
-    // Apply portable mode registry patches
-    MakeGreen();
-
-    // Initialize boss key hotkey (if configured in config.ini)
-    bosskey::Initialize();
+    DWORD protect = 0;
+    if (!VirtualProtect(address, size, PAGE_EXECUTE_READWRITE, &protect))
+        return false;
+
+    memcpy(address, code, size);
+    VirtualProtect(address, size, protect, &protect);
+    FlushInstructionCache(GetCurrentProcess(), address, size);
+    return true;
 }
 
-// Handle command line and decide whether to restart in portable mode
-void VivaldiPlusCommand(LPWSTR param)
+// Load the extension module from our own directory and let it set everything up
+static void LoadExtension(LONG64 loader_ticks)
 {
-    if (!param)
+    wchar_t path[MAX_PATH];
+    DWORD length = GetModuleFileNameW(hInstance, path, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH)
         return;
 
-    // Check if already running in portable mode (--gopher flag present)
-    if (!wcsstr(param, L"--gopher"))
-    {
-        // Not in portable mode yet, restart with portable parameters
-        Portable(param);
-    }
-    else
+    wchar_t *slash = wcsrchr(path, L'\\');
+    if (!slash || (slash - path) + 1 + wcslen(VIVALDI_PLUS_EXTENSION_DLL) >= MAX_PATH)
+        return;
+    wcscpy_s(slash + 1, MAX_PATH - (slash + 1 - path), VIVALDI_PLUS_EXTENSION_DLL);
+
+    HMODULE extension = LoadLibraryW(path);
+    auto extension_main =
+        extension ? reinterpret_cast<pVivaldiPlusMain>(GetProcAddress(extension, VIVALDI_PLUS_EXTENSION_MAIN)) : nullptr;
+    if (!extension_main)
     {
-        // Already in portable mode, apply enhancements
-        VivaldiPlus();
+        OutputDebugStringW(L"[vivaldi++]Failed to load " VIVALDI_PLUS_EXTENSION_DLL L"\n");
+        return;
     }
+
+    CoreInfo core = {sizeof(CoreInfo), hInstance, &startup_overhead::self, loader_ticks};
+    extension_main(&core);
 }
 
 // Main loader function called instead of original entry point
 int Loader()
 {
-    // Load system DLL safely (moved from DllMain to avoid loader lock deadlock)
-    static bool dll_loaded = false;
-    if (!dll_loaded)
-    {
-        LoadSysDll(hInstance);
-        dll_loaded = true;
-    }
+    LONG64 loader_ticks = startup_overhead::Now();
 
-    // Only process main browser process, not child processes
-    LPWSTR param = GetCommandLineW();
-    if (param && !wcsstr(param, L"-type="))
-    {
-        // Main process: handle portable mode
-        VivaldiPlusCommand(param);
-    }
+    // Put the original entry point back before anything else can run it
+    WriteCode(reinterpret_cast<void *>(ExeMain), entry_backup, kEntryPatchSize);
+
+    // Loaded here rather than in DllMain to avoid loader lock deadlock
+    LoadExtension(loader_ticks);
 
     // Jump to original program entry point
     return ExeMain ? ExeMain() : 0;
 }
 
-// Install hook on program entry point
+// Redirect the program entry point to Loader
+// The entry point only runs once, so a plain jump that Loader undoes is enough
 void InstallLoader()
 {
-    // Get current process module information
-    HMODULE hModule = GetModuleHandleW(nullptr);
-    if (!hModule)
-    {
-        DebugLog(L"GetModuleHandle failed: %d", GetLastError());
+    // Read the entry point straight from the PE header of the executable
+    PBYTE base = reinterpret_cast<PBYTE>(GetModuleHandleW(nullptr));
+    if (!base)
         return;
-    }
 
-    MODULEINFO mi = {0};
-    if (!GetModuleInformation(GetCurrentProcess(), hModule, &mi, sizeof(MODULEINFO)))
+    PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(base);
+    PIMAGE_NT_HEADERS nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS>(base + dos_header->e_lfanew);
+    if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || nt_headers->Signature != IMAGE_NT_SIGNATURE ||
+        nt_headers->OptionalHeader.AddressOfEntryPoint == 0)
     {
-        DebugLog(L"GetModuleInformation failed: %d", GetLastError());
+        OutputDebugStringW(L"[vivaldi++]Entry point is null\n");
         return;
     }
 
-    PBYTE entry = (PBYTE)mi.EntryPoint;
-    if (!entry)
-    {
-        DebugLog(L"Entry point is null");
-        return;
-    }
-
-    // Hook the entry point to redirect to our Loader function
+    PBYTE entry = base + nt_headers->OptionalHeader.AddressOfEntryPoint;
+    BYTE code[kEntryPatchSize];
+#if defined(_M_ARM64)
+    // ldr x16, #8; br x16; .quad Loader
+    const DWORD instructions[2] = {0x58000050, 0xD61F0200};
+    ULONG64 target = reinterpret_cast<ULONG64>(&Loader);
+    memcpy(code, instructions, sizeof(instructions));
+    memcpy(code + 8, &target, sizeof(target));
+#elif defined(_M_X64)
+    // mov rax, Loader; jmp rax
+    ULONG64 target = reinterpret_cast<ULONG64>(&Loader);
+    code[0] = 0x48;
+    code[1] = 0xB8;
+    memcpy(code + 2, &target, sizeof(target));
+    code[10] = 0xFF;
+    code[11] = 0xE0;
+#else
+    // jmp Loader
+    LONG offset = static_cast<LONG>(reinterpret_cast<PBYTE>(&Loader) - (entry + 5));
+    code[0] = 0xE9;
+    memcpy(code + 1, &offset, sizeof(offset));
+#endif
+
+    memcpy(entry_backup, entry, kEntryPatchSize);
     ExeMain = reinterpret_cast<Startup>(entry);
-
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    DetourAttach(reinterpret_cast<LPVOID*>(&ExeMain), reinterpret_cast<void*>(Loader));
-    LONG status = DetourTransactionCommit();
-    if (status != NO_ERROR)
+    if (!WriteCode(entry, code, kEntryPatchSize))
     {
-        DebugLog(L"DetourAttach InstallLoader failed: %d", status);
-        return;
+        OutputDebugStringW(L"[vivaldi++]Failed to redirect entry point\n");
     }
 }
 
@@ -127,18 +152,30 @@ extern "C" BOOL WINAPI DllMain(HINSTANCE hModule, DWORD dwReason, LPVOID pv)
     {
     case DLL_PROCESS_ATTACH:
         {
+            LONG64 attach_ticks = startup_overhead::Now();
             DisableThreadLibraryCalls(hModule);
             hInstance = hModule;
 
+            // GetCommandLineW is a plain PEB read, safe under the loader lock
+            LPCWSTR command_line = GetCommandLineW();
+            is_child_process = command_line && !FindProcessType(command_line).empty();
+            if (is_child_process)
+            {
+                // Child fast path: version.dll exports resolve themselves on first call,
+                // nothing else to set up
+                startup_overhead::RecordAttach(attach_ticks);
+                break;
+            }
+
             // Install our loader hook
-            // NOTE: LoadSysDll() is now called in Loader() to avoid DllMain loader lock deadlock
+            // NOTE: The extension is loaded in Loader() to avoid DllMain loader lock deadlock
             // Calling LoadLibrary in DllMain can cause deadlocks with antivirus software
             InstallLoader();
+            startup_overhead::RecordAttach(attach_ticks);
         }
         break;
 
     case DLL_PROCESS_DETACH:
-        // No cleanup needed for Detours
         break;
     }
 
@@ -0,0 +1,96 @@
+// Boss key latency with thousands of windows, renderers and audio sessions:
+// the synchronous part the user waits for on the hotkey thread, and the
+// posted mute/policy work, against the in-memory backends of bosskey_fake.h
+// Not part of ctest, run bosskey_bench from a Release build
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+
+#include "bosskey.h"
+#include "bosskey_fake.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRounds = 50;
+
+double UsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+void HideAndShow(size_t windows, size_t renderers, bosskey::ProcessPolicy policy, const char* policy_name) {
+  bosskey::fake::FakePlatform platform;
+  platform.Populate(renderers, windows);
+  bosskey::Options options;
+  options.hidden_policy = policy;
+  bosskey::BossKey boss(platform.Get(), options);
+
+  double hide_us = 0, hide_task_us = 0, show_us = 0, show_task_us = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    auto start = Clock::now();
+    boss.HideAndShow();
+    hide_us += UsSince(start);
+
+    start = Clock::now();
+    platform.tasks.RunUntilIdle();
+    hide_task_us += UsSince(start);
+
+    start = Clock::now();
+    boss.HideAndShow();
+    show_us += UsSince(start);
+
+    start = Clock::now();
+    platform.tasks.RunUntilIdle();
+    show_task_us += UsSince(start);
+
+    // Let the unmute retry run outside the timed sections
+    platform.tasks.AdvanceTime(1000);
+    platform.tasks.RunUntilIdle();
+    platform.windows.TakeRestoreOrder();
+  }
+  printf("%5zu windows %5zu renderers %-6s hide %8.1f us + %8.1f us task, show %8.1f us + %8.1f us task\n",
+         windows, renderers, policy_name, hide_us / kRounds, hide_task_us / kRounds, show_us / kRounds,
+         show_task_us / kRounds);
+}
+
+// Hotkey press to muted and frozen, with the task on a worker thread
+// Few rounds: each show waits for the unmute retry, 500 ms on the real clock
+void HideToSettled(size_t windows, size_t renderers) {
+  constexpr int kSettledRounds = 5;
+
+  bosskey::fake::FakePlatform platform;
+  platform.Populate(renderers, windows);
+  bosskey::fake::ThreadedTaskRunner runner;
+  bosskey::Options options;
+  options.hidden_policy = bosskey::ProcessPolicy::kFreeze;
+  bosskey::BossKey boss(bosskey::Platform{&platform.windows, &platform.processes, &platform.audio, &runner},
+                        options);
+
+  double hide_us = 0;
+  for (int round = 0; round < kSettledRounds; ++round) {
+    auto start = Clock::now();
+    boss.HideAndShow();
+    runner.WaitUntilIdle();
+    hide_us += UsSince(start);
+
+    boss.HideAndShow();
+    runner.WaitUntilIdle();
+  }
+  printf("%5zu windows %5zu renderers freeze  hide to muted and frozen on a worker thread %8.1f us\n", windows,
+         renderers, hide_us / kSettledRounds);
+}
+
+}  // namespace
+
+int main() {
+  for (size_t count : {100, 1000, 5000}) {
+    HideAndShow(count, count, bosskey::ProcessPolicy::kNone, "none");
+    HideAndShow(count, count, bosskey::ProcessPolicy::kEco, "eco");
+    HideAndShow(count, count, bosskey::ProcessPolicy::kFreeze, "freeze");
+  }
+  HideToSettled(1000, 1000);
+  return 0;
+}
@@ -0,0 +1,435 @@
+// Boss key state machine against the in-memory backends of bosskey_fake.h
+
+#include <atomic>
+#include <cstdarg>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bosskey.h"
+#include "bosskey_fake.h"
+
+namespace bosskey {
+namespace {
+
+using fake::FakePlatform;
+
+constexpr uint64_t kMiB = 1024 * 1024;
+
+std::vector<std::wstring>& LogLines() {
+  static std::vector<std::wstring> lines;
+  return lines;
+}
+
+void CaptureLog(const wchar_t* format, ...) {
+  wchar_t buffer[256];
+  va_list args;
+  va_start(args, format);
+  vswprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), format, args);
+  va_end(args);
+  LogLines().push_back(buffer);
+}
+
+// PIDs in the order the trim log reported them
+std::vector<ProcessId> TrimmedPids() {
+  std::vector<ProcessId> pids;
+  for (const auto& line : LogLines()) {
+    unsigned pid = 0;
+    if (swscanf(line.c_str(), L"Trimmed pid %u:", &pid) == 1) {
+      pids.push_back(pid);
+    }
+  }
+  return pids;
+}
+
+class BossKeyTest : public ::testing::Test {
+ protected:
+  void SetUp() override { LogLines().clear(); }
+
+  ProcessId self() { return platform_.processes.GetCurrentProcessId(); }
+  ProcessId gpu() { return self() + 1; }
+  ProcessId utility() { return self() + 2; }
+  ProcessId renderer(ProcessId i) { return self() + 3 + i; }
+
+  bool IsMuted(ProcessId pid) {
+    for (const auto& session : platform_.audio.Sessions()) {
+      if (session.pid == pid) {
+        return session.muted;
+      }
+    }
+    ADD_FAILURE() << "no session for pid " << pid;
+    return false;
+  }
+
+  FakePlatform platform_;
+};
+
+TEST_F(BossKeyTest, HideMutesAsyncAndShowRestoresInReverseOrder) {
+  platform_.Populate(4, 3);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.HideAndShow();
+  EXPECT_TRUE(boss.IsHidden());
+  EXPECT_EQ(platform_.windows.CountVisible(self()), 0u);
+  // Muting is posted, windows are already gone
+  EXPECT_FALSE(IsMuted(renderer(1)));
+
+  platform_.tasks.RunUntilIdle();
+  for (ProcessId i = 0; i < 4; ++i) {
+    EXPECT_TRUE(IsMuted(renderer(i)));
+  }
+
+  boss.HideAndShow();
+  EXPECT_FALSE(boss.IsHidden());
+  EXPECT_EQ(platform_.windows.CountVisible(self()), 3u);
+  auto order = platform_.windows.TakeRestoreOrder();
+  ASSERT_EQ(order.size(), 3u);
+  EXPECT_GT(order[0], order[1]);
+  EXPECT_GT(order[1], order[2]);
+
+  // Unmute restores each session's own state: renderer 0 was muted before hiding
+  platform_.tasks.RunUntilIdle();
+  EXPECT_TRUE(IsMuted(renderer(0)));
+  EXPECT_FALSE(IsMuted(renderer(1)));
+  EXPECT_FALSE(IsMuted(renderer(3)));
+}
+
+TEST_F(BossKeyTest, UnmuteRetryCatchesLateSessions) {
+  platform_.Populate(2, 1);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_EQ(platform_.tasks.PendingDelayed(), 1u);
+
+  // A session created muted while hidden shows up after the first unmute pass
+  platform_.audio.AddSession(L"late", renderer(1), true);
+  platform_.tasks.AdvanceTime(500);
+  platform_.tasks.RunUntilIdle();
+  for (const auto& session : platform_.audio.Sessions()) {
+    if (session.id == L"late") {
+      EXPECT_FALSE(session.muted);
+    }
+  }
+  EXPECT_EQ(platform_.tasks.PendingDelayed(), 0u);
+}
+
+TEST_F(BossKeyTest, HideCancelsPendingUnmuteRetry) {
+  platform_.Populate(2, 1);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  ASSERT_EQ(platform_.tasks.PendingDelayed(), 1u);
+
+  boss.HideAndShow();
+  EXPECT_EQ(platform_.tasks.PendingDelayed(), 0u);
+  platform_.tasks.RunUntilIdle();
+  EXPECT_TRUE(IsMuted(renderer(1)));
+}
+
+TEST_F(BossKeyTest, HiddenFreezeSuspendsRenderersOnlyAfterMuting) {
+  platform_.Populate(3, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(platform_.Get(), options);
+
+  boss.HideAndShow();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 0);
+
+  platform_.tasks.RunUntilIdle();
+  for (ProcessId i = 0; i < 3; ++i) {
+    EXPECT_EQ(platform_.processes.Get(renderer(i)).suspend_count, 1);
+  }
+  EXPECT_EQ(platform_.processes.Get(gpu()).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.Get(utility()).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.Get(self()).suspend_count, 0);
+
+  // Resumed synchronously on show, before the unmute task runs
+  boss.HideAndShow();
+  for (ProcessId i = 0; i < 3; ++i) {
+    EXPECT_EQ(platform_.processes.Get(renderer(i)).suspend_count, 0);
+  }
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+  platform_.tasks.RunUntilIdle();
+}
+
+TEST_F(BossKeyTest, ShowBeforeHideTaskRunsSkipsPolicy) {
+  platform_.Populate(2, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(platform_.Get(), options);
+
+  boss.HideAndShow();
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, HiddenEcoRestoresPriority) {
+  platform_.Populate(2, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kEco;
+  BossKey boss(platform_.Get(), options);
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_TRUE(platform_.processes.Get(gpu()).eco);
+  EXPECT_TRUE(platform_.processes.Get(renderer(1)).eco);
+  EXPECT_FALSE(platform_.processes.Get(self()).eco);
+
+  boss.HideAndShow();
+  EXPECT_FALSE(platform_.processes.Get(gpu()).eco);
+  EXPECT_EQ(platform_.processes.Get(renderer(1)).priority, 0x20u);
+  platform_.tasks.RunUntilIdle();
+}
+
+TEST_F(BossKeyTest, FreezeToggleAndHideDoNotStack) {
+  platform_.Populate(2, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(platform_.Get(), options);
+
+  boss.FreezeToggle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  // Hiding while frozen must not suspend the renderers a second time
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  // The boss key owns the policy while hidden
+  boss.FreezeToggle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  // Showing leaves the user's freeze alone
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  boss.FreezeToggle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.Get(renderer(1)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, ShowKeepsUserFrozenRenderersSuspended) {
+  platform_.Populate(2, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(platform_.Get(), options);
+
+  boss.FreezeToggle();
+  ASSERT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  // A tab opened after the freeze is suspended by the hidden policy only
+  platform_.processes.AddProcess(renderer(5), L"renderer");
+  boss.InvalidatePidCache();
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+  EXPECT_EQ(platform_.processes.Get(renderer(5)).suspend_count, 1);
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+  EXPECT_EQ(platform_.processes.Get(renderer(1)).suspend_count, 1);
+  EXPECT_EQ(platform_.processes.Get(renderer(5)).suspend_count, 0);
+
+  boss.FreezeToggle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.Get(renderer(1)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, ShowKeepsUserFrozenRenderersUnderEco) {
+  platform_.Populate(2, 1);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kEco;
+  BossKey boss(platform_.Get(), options);
+
+  boss.FreezeToggle();
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_TRUE(platform_.processes.Get(gpu()).eco);
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_FALSE(platform_.processes.Get(gpu()).eco);
+  EXPECT_FALSE(platform_.processes.Get(renderer(0)).eco);
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 1);
+
+  boss.FreezeToggle();
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).suspend_count, 0);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, MuteToggleRestoresOriginalStates) {
+  platform_.Populate(4, 1);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.MuteToggle();
+  platform_.tasks.RunUntilIdle();
+  for (ProcessId i = 0; i < 4; ++i) {
+    EXPECT_TRUE(IsMuted(renderer(i)));
+  }
+
+  boss.MuteToggle();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_TRUE(IsMuted(renderer(0)));
+  EXPECT_FALSE(IsMuted(renderer(1)));
+  EXPECT_FALSE(IsMuted(renderer(2)));
+}
+
+TEST_F(BossKeyTest, MuteToggleYieldsWhileHidden) {
+  platform_.Populate(2, 1);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+
+  // The boss key owns the mute state while hidden
+  boss.MuteToggle();
+  EXPECT_EQ(platform_.tasks.RunUntilIdle(), 0u);
+
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+  EXPECT_FALSE(IsMuted(renderer(1)));
+}
+
+TEST_F(BossKeyTest, TrimRanksRenderersFirstAndBrowserLast) {
+  platform_.Populate(2, 1, 128 * kMiB);
+  platform_.processes.AddProcess(self() + 10, L"gpu-process", 0);  // Below threshold
+  Options options;
+  options.log = CaptureLog;
+  BossKey boss(platform_.Get(), options);
+
+  // The browser itself is populated without a working set
+  platform_.processes.RemoveProcess(self());
+  platform_.processes.AddProcess(self(), L"", 128 * kMiB);
+
+  boss.TrimMemory();
+  EXPECT_TRUE(TrimmedPids().empty());
+  platform_.tasks.RunUntilIdle();
+
+  std::vector<ProcessId> expected = {renderer(0), renderer(1), utility(), gpu(), self()};
+  EXPECT_EQ(TrimmedPids(), expected);
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).working_set, 0u);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, TrimOnHideStopsOnceShown) {
+  platform_.Populate(3, 1, 128 * kMiB);
+  Options options;
+  options.trim_on_hide = true;
+  options.log = CaptureLog;
+  BossKey boss(platform_.Get(), options);
+
+  boss.HideAndShow();
+  boss.HideAndShow();
+  platform_.tasks.RunUntilIdle();
+
+  EXPECT_TRUE(TrimmedPids().empty());
+  EXPECT_EQ(platform_.processes.Get(renderer(0)).working_set, 128 * kMiB);
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, ThousandsOfWindowsAndSessions) {
+  constexpr ProcessId kRenderers = 4000;
+  platform_.Populate(kRenderers, 3000);
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(platform_.Get(), options);
+
+  boss.HideAndShow();
+  EXPECT_EQ(platform_.windows.CountVisible(self()), 0u);
+  platform_.tasks.RunUntilIdle();
+  for (ProcessId i = 0; i < kRenderers; ++i) {
+    ASSERT_TRUE(IsMuted(renderer(i)));
+    ASSERT_EQ(platform_.processes.Get(renderer(i)).suspend_count, 1);
+  }
+
+  boss.HideAndShow();
+  EXPECT_EQ(platform_.windows.CountVisible(self()), 3000u);
+  EXPECT_EQ(platform_.windows.TakeRestoreOrder().size(), 3000u);
+  platform_.tasks.RunUntilIdle();
+  for (ProcessId i = 0; i < kRenderers; ++i) {
+    ASSERT_EQ(IsMuted(renderer(i)), i % 4 == 0);
+    ASSERT_EQ(platform_.processes.Get(renderer(i)).suspend_count, 0);
+  }
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+// Hotkey presses from several threads at once, with the tasks on a worker
+// thread like the executor runs them: every hide is matched by a restore
+TEST_F(BossKeyTest, ConcurrentTogglesStayBalanced) {
+  constexpr ProcessId kRenderers = 16;
+  constexpr int kThreads = 4;
+  constexpr int kTogglesPerThread = 250;  // Even in total, ends shown
+
+  platform_.Populate(kRenderers, 8);
+  fake::ThreadedTaskRunner runner;
+  Options options;
+  options.hidden_policy = ProcessPolicy::kFreeze;
+  BossKey boss(Platform{&platform_.windows, &platform_.processes, &platform_.audio, &runner}, options);
+
+  std::atomic<bool> start{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < kTogglesPerThread; ++i) {
+        boss.HideAndShow();
+      }
+    });
+  }
+  start.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  runner.WaitUntilIdle();
+
+  EXPECT_FALSE(boss.IsHidden());
+  EXPECT_EQ(platform_.windows.CountVisible(self()), 8u);
+  for (const auto& window : platform_.windows.Windows()) {
+    EXPECT_GT(window.hide_count, 0u);
+    EXPECT_EQ(window.hide_count, window.restore_count);
+  }
+  for (ProcessId i = 0; i < kRenderers; ++i) {
+    EXPECT_EQ(platform_.processes.Get(renderer(i)).suspend_count, 0) << "renderer " << i;
+    EXPECT_EQ(IsMuted(renderer(i)), i % 4 == 0) << "renderer " << i;
+  }
+  EXPECT_EQ(platform_.processes.OpenHandleCount(), 0u);
+}
+
+TEST_F(BossKeyTest, PidCacheExpires) {
+  platform_.Populate(1, 1);
+  BossKey boss(platform_.Get(), Options{});
+
+  boss.GetAppPids();
+  boss.GetAppPids();
+  EXPECT_EQ(platform_.processes.enumerate_calls(), 1u);
+
+  platform_.tasks.AdvanceTime(5001);
+  boss.GetAppPids();
+  EXPECT_EQ(platform_.processes.enumerate_calls(), 2u);
+
+  boss.InvalidatePidCache();
+  boss.GetAppPids();
+  EXPECT_EQ(platform_.processes.enumerate_calls(), 3u);
+}
+
+}  // namespace
+}  // namespace bosskey
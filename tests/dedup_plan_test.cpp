@@ -0,0 +1,310 @@
+// Cross-profile deduplication: a pass over data directories in a temp dir
+// through POSIX hard links, with the backslash paths of Windows mapped to '/'
+
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dedup_plan.h"
+
+namespace dedup {
+namespace {
+
+constexpr uint64_t kUnixEpoch = 116444736000000000ull;  // 1970-01-01 in FILETIME units
+
+std::string Native(const std::wstring& path) {
+  std::wstring slashed = path;
+  for (wchar_t& ch : slashed) {
+    if (ch == L'\\') {
+      ch = L'/';
+    }
+  }
+  return std::filesystem::path(slashed).string();
+}
+
+uint64_t FileTime(const struct timespec& time) {
+  return kUnixEpoch + static_cast<uint64_t>(time.tv_sec) * 10000000 + static_cast<uint64_t>(time.tv_nsec) / 100;
+}
+
+bool List(const std::wstring& dir, std::vector<Entry>* entries) {
+  std::string native = Native(dir);
+  DIR* handle = opendir(native.c_str());
+  if (!handle) {
+    return false;
+  }
+  while (dirent* entry = readdir(handle)) {
+    std::string name = entry->d_name;
+    struct stat info;
+    if (name == "." || name == ".." || lstat((native + "/" + name).c_str(), &info) != 0 || S_ISLNK(info.st_mode)) {
+      continue;
+    }
+    entries->push_back({std::filesystem::path(name).wstring(), S_ISDIR(info.st_mode) != 0,
+                        static_cast<uint64_t>(info.st_size), FileTime(info.st_mtim)});
+  }
+  closedir(handle);
+  return true;
+}
+
+bool Identify(const std::wstring& path, Identity* identity) {
+  struct stat info;
+  if (stat(Native(path).c_str(), &info) != 0) {
+    return false;
+  }
+  *identity = {static_cast<uint64_t>(info.st_dev), static_cast<uint64_t>(info.st_ino),
+               static_cast<uint32_t>(info.st_nlink), static_cast<uint64_t>(info.st_size), FileTime(info.st_mtim)};
+  return true;
+}
+
+std::string Contents(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+bool Read(const std::wstring& path, const std::function<void(const uint8_t*, size_t)>& sink) {
+  std::ifstream in(Native(path), std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::vector<char> buffer(4096);
+  while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0) {
+    sink(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(in.gcount()));
+  }
+  return true;
+}
+
+bool SameContents(const std::wstring& a, const std::wstring& b) {
+  return Contents(Native(a)) == Contents(Native(b));
+}
+
+bool Link(const std::wstring& existing, const std::wstring& path) {
+  std::error_code error;
+  std::filesystem::create_hard_link(Native(existing), Native(path), error);
+  return !error;
+}
+
+bool Replace(const std::wstring& from, const std::wstring& to) {
+  return std::rename(Native(from).c_str(), Native(to).c_str()) == 0;
+}
+
+bool Remove(const std::wstring& path) {
+  std::error_code error;
+  return std::filesystem::remove(Native(path), error);
+}
+
+bool MakeDirectory(const std::wstring& path) {
+  std::error_code error;
+  std::filesystem::create_directories(Native(path), error);
+  return !error;
+}
+
+constexpr FileSystem kFileSystem = {List, Identify, Read, SameContents, Link, Replace, Remove, MakeDirectory, nullptr};
+
+class DedupPlanTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = std::filesystem::temp_directory_path() /
+            (std::string("dedup_plan_test_") + testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(root_); }
+
+  // Backslash path below the temp dir, as the Win32 side would pass it
+  std::wstring Path(const std::string& relative) const {
+    std::wstring path = (root_ / relative).wstring();
+    for (wchar_t& ch : path) {
+      if (ch == L'/') {
+        ch = L'\\';
+      }
+    }
+    return path;
+  }
+
+  std::filesystem::path Write(const std::string& relative, const std::string& contents) {
+    std::filesystem::path path = root_ / relative;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+  }
+
+  static std::string Payload(char fill) { return std::string(kMinFileBytes + 100, fill); }
+
+  static struct stat Stat(const std::filesystem::path& path) {
+    struct stat info = {};
+    EXPECT_EQ(stat(path.c_str(), &info), 0) << path;
+    return info;
+  }
+
+  static bool SameFile(const std::filesystem::path& a, const std::filesystem::path& b) {
+    return Stat(a).st_ino == Stat(b).st_ino;
+  }
+
+  // Files written just now count as old enough two days later
+  static uint64_t Later() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return FileTime(now) + 2 * kFileTimeDay;
+  }
+
+  Report Pass(const std::vector<std::string>& roots, const executor::CancellationToken& cancel = {}) {
+    std::vector<std::wstring> paths;
+    for (const auto& root : roots) {
+      paths.push_back(Path(root));
+    }
+    return Deduplicate(kFileSystem, paths, Path("Shared"), Later(), kMaxWorkers, cancel);
+  }
+
+  std::vector<std::filesystem::path> StoreFiles() const {
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::exists(root_ / "Shared")) {
+      for (const auto& entry : std::filesystem::recursive_directory_iterator(root_ / "Shared")) {
+        if (entry.is_regular_file()) {
+          files.push_back(entry.path());
+        }
+      }
+    }
+    return files;
+  }
+
+  std::filesystem::path root_;
+};
+
+TEST_F(DedupPlanTest, LinksIdenticalFilesAcrossDataDirectories) {
+  auto a = Write("A/Default/Extensions/abc/1.0/main.js", Payload('x'));
+  auto b = Write("B/Default/Extensions/abc/1.0/main.js", Payload('x'));
+  auto c = Write("B/Dictionaries/en-US-10-1.bdic", Payload('x'));
+
+  Report report = Pass({"A", "B"});
+  EXPECT_EQ(report.files_scanned, 3u);
+  EXPECT_EQ(report.files_linked, 2u);
+  EXPECT_EQ(report.bytes_reclaimed, 2 * Payload('x').size());
+
+  std::vector<std::filesystem::path> store = StoreFiles();
+  ASSERT_EQ(store.size(), 1u);
+  EXPECT_TRUE(SameFile(store[0], a));
+  EXPECT_TRUE(SameFile(store[0], b));
+  EXPECT_TRUE(SameFile(store[0], c));
+  EXPECT_EQ(Stat(a).st_nlink, 4u);
+  EXPECT_EQ(Contents(b), Payload('x'));
+  EXPECT_FALSE(std::filesystem::exists(b.string() + ".vivaldi_plus_link"));
+}
+
+TEST_F(DedupPlanTest, LeavesOtherFilesAlone) {
+  auto prefs_a = Write("A/Default/Preferences", Payload('p'));
+  auto prefs_b = Write("B/Default/Preferences", Payload('p'));
+  auto small_a = Write("A/Dictionaries/small.txt", "tiny");
+  auto small_b = Write("B/Dictionaries/small.txt", "tiny");
+  auto same_size_a = Write("A/Dictionaries/de.bdic", Payload('d'));
+  auto same_size_b = Write("B/Dictionaries/de.bdic", Payload('e'));
+
+  Report report = Pass({"A", "B"});
+  EXPECT_EQ(report.files_linked, 0u);
+  EXPECT_FALSE(SameFile(prefs_a, prefs_b));
+  EXPECT_FALSE(SameFile(small_a, small_b));
+  EXPECT_FALSE(SameFile(same_size_a, same_size_b));
+  EXPECT_EQ(Contents(same_size_b), Payload('e'));
+  EXPECT_TRUE(StoreFiles().empty());
+}
+
+TEST_F(DedupPlanTest, ReusesTheStoreAndReleasesUnusedEntries) {
+  Write("A/Dictionaries/en.bdic", Payload('x'));
+  auto b = Write("B/Dictionaries/en.bdic", Payload('x'));
+  ASSERT_EQ(Pass({"A", "B"}).files_linked, 1u);
+  std::filesystem::path stored = StoreFiles().at(0);
+
+  // A third directory joins and links to the existing store file
+  auto c = Write("C/Dictionaries/en.bdic", Payload('x'));
+  Report report = Pass({"A", "B", "C"});
+  EXPECT_EQ(report.files_linked, 1u);
+  EXPECT_TRUE(SameFile(stored, c));
+  EXPECT_EQ(StoreFiles().size(), 1u);
+
+  // Once nothing links to it any more the store file goes away
+  std::filesystem::remove_all(root_ / "A");
+  std::filesystem::remove_all(root_ / "B");
+  std::filesystem::remove_all(root_ / "C");
+  report = Pass({});
+  EXPECT_EQ(report.store_removed, 1u);
+  EXPECT_EQ(report.bytes_freed, Payload('x').size());
+  EXPECT_TRUE(StoreFiles().empty());
+}
+
+TEST_F(DedupPlanTest, WritingACopyKeepsTheOthers) {
+  auto a = Write("A/Dictionaries/en.bdic", Payload('x'));
+  auto b = Write("B/Dictionaries/en.bdic", Payload('x'));
+  Pass({"A", "B"});
+  ASSERT_TRUE(SameFile(a, b));
+
+  // What the copy-on-write hook does before an open for writing
+  std::filesystem::copy_file(b, b.string() + ".vivaldi_plus_copy");
+  std::filesystem::rename(b.string() + ".vivaldi_plus_copy", b);
+  std::ofstream(b, std::ios::binary | std::ios::trunc) << Payload('y');
+
+  EXPECT_EQ(Contents(a), Payload('x'));
+  EXPECT_EQ(Contents(StoreFiles().at(0)), Payload('x'));
+  EXPECT_EQ(Contents(b), Payload('y'));
+}
+
+TEST_F(DedupPlanTest, RemovesLeftoversAndSkipsSymlinks) {
+  Write("A/Dictionaries/en.bdic.vivaldi_plus_link", Payload('x'));
+  Write("B/Dictionaries/en.bdic", Payload('x'));
+  std::filesystem::create_directories(root_ / "A" / "Dictionaries");
+  std::filesystem::create_symlink(root_ / "B" / "Dictionaries" / "en.bdic", root_ / "A" / "Dictionaries" / "en.bdic");
+
+  Report report = Pass({"A", "B"});
+  EXPECT_EQ(report.files_scanned, 1u);
+  EXPECT_EQ(report.files_linked, 0u);
+  EXPECT_FALSE(std::filesystem::exists(root_ / "A" / "Dictionaries" / "en.bdic.vivaldi_plus_link"));
+  EXPECT_TRUE(std::filesystem::is_symlink(root_ / "A" / "Dictionaries" / "en.bdic"));
+}
+
+TEST_F(DedupPlanTest, CancelledPassLinksNothing) {
+  auto a = Write("A/Dictionaries/en.bdic", Payload('x'));
+  auto b = Write("B/Dictionaries/en.bdic", Payload('x'));
+  executor::CancellationToken cancel = executor::CancellationToken::Create();
+  cancel.Cancel();
+
+  Report report = Pass({"A", "B"}, cancel);
+  EXPECT_EQ(report.files_linked, 0u);
+  EXPECT_FALSE(SameFile(a, b));
+}
+
+TEST(DedupPlanAreaTest, SharedAreas) {
+  EXPECT_TRUE(IsSharedArea(L"Dictionaries"));
+  EXPECT_TRUE(IsSharedArea(L"widevinecdm\\4.10"));
+  EXPECT_TRUE(IsSharedArea(L"Default\\Extensions\\abc"));
+  EXPECT_TRUE(IsSharedArea(L"Profile 1\\extensions"));
+  EXPECT_FALSE(IsSharedArea(L"Default"));
+  EXPECT_FALSE(IsSharedArea(L"Default\\Local Storage"));
+  EXPECT_TRUE(ShouldDescend(L"Default"));
+  EXPECT_FALSE(ShouldDescend(L"Default\\Cache"));
+}
+
+TEST(DedupPlanAreaTest, ReportRoundTrip) {
+  Report report;
+  report.last_pass = 1;
+  report.files_scanned = 2;
+  report.files_linked = 3;
+  report.bytes_reclaimed = 4;
+  report.store_removed = 5;
+  report.bytes_freed = 6;
+  std::vector<uint8_t> bytes = EncodeReport(report);
+
+  Report decoded;
+  ASSERT_TRUE(DecodeReport(bytes.data(), bytes.size(), &decoded));
+  EXPECT_EQ(decoded.files_linked, 3u);
+  EXPECT_EQ(decoded.bytes_freed, 6u);
+  EXPECT_FALSE(DecodeReport(bytes.data(), bytes.size() - 1, &decoded));
+}
+
+}  // namespace
+}  // namespace dedup
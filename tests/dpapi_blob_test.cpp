@@ -0,0 +1,108 @@
+// Tagged envelope for portable CryptProtectData copies
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dpapi_blob.h"
+
+namespace dpapi_blob {
+namespace {
+
+std::vector<uint8_t> EncodeString(const std::string& text) {
+  std::vector<uint8_t> blob(EncodedSize(text.size()));
+  EXPECT_TRUE(Encode(reinterpret_cast<const uint8_t*>(text.data()), text.size(), blob.data(), blob.size()));
+  return blob;
+}
+
+DecodeResult DecodeBlob(const std::vector<uint8_t>& blob, std::string* text = nullptr) {
+  const uint8_t* payload = nullptr;
+  size_t payload_size = 0;
+  DecodeResult result = Decode(blob.data(), blob.size(), &payload, &payload_size);
+  if (result == DecodeResult::kOk && text) {
+    text->assign(reinterpret_cast<const char*>(payload), payload_size);
+  }
+  return result;
+}
+
+TEST(DpapiBlobTest, RoundTripCarriesTagAndChecksum) {
+  std::vector<uint8_t> blob = EncodeString("v10 portable key");
+  ASSERT_EQ(blob.size(), kHeaderSize + 16 + kTrailerSize);
+  EXPECT_EQ(std::string(blob.begin(), blob.begin() + 4), "VPDB");
+  EXPECT_EQ(blob[4], kVersion);
+  EXPECT_EQ(LoadLE32(&blob[8]), 16u);
+
+  std::string text;
+  ASSERT_EQ(DecodeBlob(blob, &text), DecodeResult::kOk);
+  EXPECT_EQ(text, "v10 portable key");
+}
+
+TEST(DpapiBlobTest, EmptyPayload) {
+  std::vector<uint8_t> blob(EncodedSize(0));
+  ASSERT_TRUE(Encode(nullptr, 0, blob.data(), blob.size()));
+
+  std::string text = "unchanged";
+  ASSERT_EQ(DecodeBlob(blob, &text), DecodeResult::kOk);
+  EXPECT_TRUE(text.empty());
+}
+
+TEST(DpapiBlobTest, EncodeRejectsSmallBufferAndMissingPayload) {
+  const uint8_t payload[8] = {};
+  std::vector<uint8_t> blob(EncodedSize(sizeof(payload)) - 1);
+  EXPECT_FALSE(Encode(payload, sizeof(payload), blob.data(), blob.size()));
+  blob.resize(EncodedSize(sizeof(payload)));
+  EXPECT_FALSE(Encode(nullptr, sizeof(payload), blob.data(), blob.size()));
+  EXPECT_EQ(EncodedSize(SIZE_MAX), 0u);
+}
+
+TEST(DpapiBlobTest, LegacyBlobsAreNotTagged) {
+  // Real DPAPI: version 1 followed by the provider GUID
+  std::vector<uint8_t> dpapi = {0x01, 0x00, 0x00, 0x00, 0xD0, 0x8C, 0x9D, 0xDF, 0x01, 0x15, 0xD1, 0x11,
+                                0x8C, 0x7A, 0x00, 0xC0, 0x4F, 0xC2, 0x97, 0xEB};
+  EXPECT_EQ(DecodeBlob(dpapi), DecodeResult::kNotTagged);
+
+  // Untagged plain copy written by older portable builds
+  std::string legacy = "plain copy";
+  EXPECT_EQ(DecodeBlob(std::vector<uint8_t>(legacy.begin(), legacy.end())), DecodeResult::kNotTagged);
+
+  EXPECT_EQ(DecodeBlob({}), DecodeResult::kNotTagged);
+  EXPECT_EQ(DecodeBlob({'V', 'P', 'D'}), DecodeResult::kNotTagged);
+}
+
+TEST(DpapiBlobTest, NewerVersionIsReported) {
+  std::vector<uint8_t> blob = EncodeString("future");
+  blob[4] = kVersion + 1;
+  EXPECT_EQ(DecodeBlob(blob), DecodeResult::kUnsupportedVersion);
+}
+
+TEST(DpapiBlobTest, CorruptBlobs) {
+  std::vector<uint8_t> blob = EncodeString("payload");
+
+  // Magic only, no room for header and trailer
+  EXPECT_EQ(DecodeBlob({'V', 'P', 'D', 'B', kVersion}), DecodeResult::kCorrupt);
+
+  std::vector<uint8_t> truncated(blob.begin(), blob.end() - 1);
+  EXPECT_EQ(DecodeBlob(truncated), DecodeResult::kCorrupt);
+
+  std::vector<uint8_t> extended = blob;
+  extended.push_back(0);
+  EXPECT_EQ(DecodeBlob(extended), DecodeResult::kCorrupt);
+
+  std::vector<uint8_t> flipped = blob;
+  flipped[kHeaderSize + 2] ^= 0x01;
+  EXPECT_EQ(DecodeBlob(flipped), DecodeResult::kCorrupt);
+
+  std::vector<uint8_t> bad_checksum = blob;
+  bad_checksum.back() ^= 0x80;
+  EXPECT_EQ(DecodeBlob(bad_checksum), DecodeResult::kCorrupt);
+
+  std::vector<uint8_t> huge_length = blob;
+  StoreLE32(&huge_length[8], UINT32_MAX);
+  EXPECT_EQ(DecodeBlob(huge_length), DecodeResult::kCorrupt);
+}
+
+}  // namespace
+}  // namespace dpapi_blob
@@ -0,0 +1,123 @@
+// Cost of the logging hot path: capturing a record into the ring on the
+// calling thread, and formatting it on the drain task
+// Not part of ctest, run log_record_bench from a Release build
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log_record.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kIterations = 1000000;
+
+double NsPerOp(Clock::time_point start, int64_t ops) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+}
+
+const std::wstring kPath = L"C:\\Users\\someone\\AppData\\Local\\Vivaldi\\User Data\\Default\\Cache\\Cache_Data\\f_0001a2";
+const std::wstring kLongPath = kPath + std::wstring(200, L'x');
+
+template <typename... Args>
+void CaptureAndPush(const char* name, const wchar_t* format, const Args&... args) {
+  logger::MpscRing<logger::Record, 512> ring;
+  logger::Record record;
+  auto start = Clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    logger::Capture(record, format, args...);
+    if (!ring.TryPush(record)) {
+      logger::Release(record);
+      logger::Record drained;
+      while (ring.TryPop(drained)) {
+        logger::Release(drained);
+      }
+    }
+  }
+  printf("%-28s %8.1f ns/record\n", name, NsPerOp(start, kIterations));
+  logger::Record drained;
+  while (ring.TryPop(drained)) {
+    logger::Release(drained);
+  }
+}
+
+template <typename... Args>
+void Format(const char* name, const wchar_t* format, const Args&... args) {
+  logger::Record record;
+  logger::Capture(record, format, args...);
+  size_t total = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    total += logger::FormatRecord(record).size();
+  }
+  printf("%-28s %8.1f ns/record (%zu chars)\n", name, NsPerOp(start, kIterations), total / kIterations);
+  logger::Release(record);
+}
+
+void ContendedPush(int producers) {
+  logger::MpscRing<logger::Record, 512> ring;
+  std::atomic<bool> done{false};
+  std::atomic<int64_t> retries{0};
+
+  std::thread consumer([&]() {
+    logger::Record record;
+    while (!done.load(std::memory_order_acquire)) {
+      while (ring.TryPop(record)) {
+        logger::Release(record);
+      }
+      std::this_thread::yield();
+    }
+    while (ring.TryPop(record)) {
+      logger::Release(record);
+    }
+  });
+
+  int per_producer = kIterations / producers;
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p]() {
+      logger::Record record;
+      for (int i = 0; i < per_producer; ++i) {
+        logger::Capture(record, L"worker %d step %d %s", p, i, kPath);
+        // Retry instead of dropping so every record crosses the ring
+        while (!ring.TryPush(record)) {
+          retries.fetch_add(1, std::memory_order_relaxed);
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double ns = NsPerOp(start, static_cast<int64_t>(per_producer) * producers);
+  done.store(true, std::memory_order_release);
+  consumer.join();
+  printf("contended push, %d threads    %8.1f ns/record wall, %.2f retries/record\n", producers, ns,
+         retries.load() / (static_cast<double>(per_producer) * producers));
+}
+
+}  // namespace
+
+int main() {
+  CaptureAndPush("capture+push numbers", L"hook %d installed at %p, %zu bytes", 12, &kIterations, sizeof(logger::Record));
+  CaptureAndPush("capture+push path", L"Move %s failed: %lu", kPath, 5ul);
+  CaptureAndPush("capture+push spilled path", L"Move %s -> %s failed: %lu", kLongPath, kLongPath, 5ul);
+
+  Format("format numbers", L"hook %d installed at %p, %zu bytes", 12, &kIterations, sizeof(logger::Record));
+  Format("format path", L"Move %s failed: %lu", kPath, 5ul);
+  Format("format spilled path", L"Move %s -> %s failed: %lu", kLongPath, kLongPath, 5ul);
+
+  for (int producers : {1, 2, 4}) {
+    ContendedPush(producers);
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+// Binary log records: capture, spilled text, formatting and the MPSC ring
+
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "log_record.h"
+
+namespace logger {
+namespace {
+
+template <typename... Args>
+std::wstring Format(const wchar_t* format, const Args&... args) {
+  Record record;
+  Capture(record, format, args...);
+  std::wstring text = FormatRecord(record);
+  Release(record);
+  return text;
+}
+
+enum class Color { kRed = 2 };
+
+TEST(LogRecordTest, Integers) {
+  EXPECT_EQ(Format(L"%d %i %u", -5, 7, 42u), L"-5 7 42");
+  EXPECT_EQ(Format(L"%lld %llu", -9000000000ll, 18000000000ull), L"-9000000000 18000000000");
+  EXPECT_EQ(Format(L"%zu %I64d", static_cast<size_t>(123), static_cast<int64_t>(-1)), L"123 -1");
+  // Without a size modifier only 32 bits are printed, like the MSVC functions
+  EXPECT_EQ(Format(L"%d %u", int64_t{0x100000001}, uint64_t{0x100000002}), L"1 2");
+  EXPECT_EQ(Format(L"%lu", 4000000000u), L"4000000000");
+  EXPECT_EQ(Format(L"%d", Color::kRed), L"2");
+  EXPECT_EQ(Format(L"%d", true), L"1");
+}
+
+TEST(LogRecordTest, FlagsWidthPrecision) {
+  EXPECT_EQ(Format(L"[%5d|%-5d|%05d|%+d]", 42, 42, 42, 42), L"[   42|42   |00042|+42]");
+  EXPECT_EQ(Format(L"0x%08X %x %#o", 0xBEEFu, 255u, 8u), L"0x0000BEEF ff 010");
+  EXPECT_EQ(Format(L"[%*d]", 4, 7), L"[   7]");
+  EXPECT_EQ(Format(L"%.2f %e", 3.14159, 1500.0), L"3.14 1.500000e+03");
+  EXPECT_EQ(Format(L"%c%c", L'o', L'k'), L"ok");
+  EXPECT_EQ(Format(L"100%% done"), L"100% done");
+}
+
+TEST(LogRecordTest, Strings) {
+  const wchar_t* null_text = nullptr;
+  std::wstring owned = L"owned";
+  EXPECT_EQ(Format(L"%s %S %ls", L"wide", "narrow", std::wstring_view(owned)), L"wide narrow owned");
+  EXPECT_EQ(Format(L"%s %S", null_text, static_cast<const char*>(nullptr)), L"(null) (null)");
+  EXPECT_EQ(Format(L"[%6s|%-6s|%.3s]", L"ab", L"ab", L"abcdef"), L"[    ab|ab    |abc]");
+
+  // A view is copied by length, it does not need a terminator
+  std::wstring_view prefix = std::wstring_view(L"prefix-and-more").substr(0, 6);
+  EXPECT_EQ(Format(L"%s!", prefix), L"prefix!");
+}
+
+TEST(LogRecordTest, MismatchedArguments) {
+  EXPECT_EQ(Format(L"%s", 5), L"?");
+  EXPECT_EQ(Format(L"%d", L"text"), L"0");
+  EXPECT_EQ(Format(L"%d %d", 1), L"1 0");
+  EXPECT_EQ(Format(L"%q", 1), L"%q");
+  EXPECT_EQ(Format(L"trailing %"), L"trailing ");
+}
+
+TEST(LogRecordTest, Pointer) {
+  int value = 0;
+  std::wstring expected(sizeof(void*) * 2, L'0');
+  std::wstring hex = Format(L"%p", static_cast<void*>(&value));
+  EXPECT_EQ(hex.size(), expected.size());
+  EXPECT_EQ(std::stoull(hex, nullptr, 16), reinterpret_cast<uintptr_t>(&value));
+  EXPECT_EQ(Format(L"%p", nullptr), expected);
+}
+
+TEST(LogRecordTest, LongPathsSpillInsteadOfTruncating) {
+  std::wstring from = L"C:\\Users\\someone\\AppData\\Local\\" + std::wstring(200, L'a') + L"\\Cache_Data\\f_000001";
+  std::wstring to = L"D:\\Vivaldi\\Data\\" + std::wstring(220, L'b') + L"\\Cache_Data\\f_000001";
+  std::string narrow(300, 'n');
+
+  Record record;
+  Capture(record, L"Move %s -> %s (%S) failed: %lu", from, to.c_str(), narrow.c_str(), 5ul);
+  EXPECT_NE(record.spill, nullptr);
+  EXPECT_EQ(FormatRecord(record),
+            L"Move " + from + L" -> " + to + L" (" + std::wstring(300, L'n') + L") failed: 5");
+  Release(record);
+  EXPECT_EQ(record.spill, nullptr);
+}
+
+TEST(LogRecordTest, ShortTextStaysInline) {
+  Record record;
+  Capture(record, L"%s %s", L"short", std::wstring(Record::kTextCapacity - 5, L'x'));
+  EXPECT_EQ(record.spill, nullptr);
+  EXPECT_EQ(record.text_used, Record::kTextCapacity);
+
+  // The next string no longer fits inline, even a short one
+  Capture(record, L"%s %s %s", L"short", std::wstring(Record::kTextCapacity - 5, L'x'), L"late");
+  ASSERT_NE(record.spill, nullptr);
+  EXPECT_EQ(record.args[2].type, ArgType::kSpillText);
+  EXPECT_EQ(FormatRecord(record), L"short " + std::wstring(Record::kTextCapacity - 5, L'x') + L" late");
+  Release(record);
+}
+
+TEST(LogRecordTest, SpillIsCapped) {
+  std::wstring huge(Record::kSpillCapacity + 100, L'z');
+  Record record;
+  Capture(record, L"%s|%s|%s", huge, std::wstring(Record::kTextCapacity + 1, L'y'), L"inline");
+  std::wstring text = FormatRecord(record);
+  Release(record);
+  // The spill is full, the next long string is dropped but short ones still fit inline
+  EXPECT_EQ(text, std::wstring(Record::kSpillCapacity, L'z') + L"||inline");
+}
+
+TEST(LogRecordTest, ExtraArgumentsAreIgnored) {
+  EXPECT_EQ(Format(L"%d%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7, 8), L"12345678");
+}
+
+TEST(MpscRingTest, FifoFullAndWrapAround) {
+  MpscRing<int, 4> ring;
+  int value = 0;
+  EXPECT_FALSE(ring.TryPop(value));
+
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(ring.TryPush(round * 10 + i));
+    }
+    EXPECT_FALSE(ring.TryPush(99));
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(ring.TryPop(value));
+      EXPECT_EQ(value, round * 10 + i);
+    }
+    EXPECT_FALSE(ring.TryPop(value));
+  }
+}
+
+TEST(MpscRingTest, ProducersKeepTheirOrder) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 20000;
+  MpscRing<uint64_t, 64> ring;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&ring, p]() {
+      for (uint64_t i = 0; i < kPerProducer; ++i) {
+        while (!ring.TryPush(static_cast<uint64_t>(p) << 32 | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<uint64_t> next(kProducers, 0);
+  for (int received = 0; received < kProducers * kPerProducer;) {
+    uint64_t value = 0;
+    if (!ring.TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    size_t producer = value >> 32;
+    ASSERT_LT(producer, next.size());
+    ASSERT_EQ(value & 0xFFFFFFFF, next[producer]);
+    ++next[producer];
+    ++received;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+}
+
+}  // namespace
+}  // namespace logger
@@ -0,0 +1,232 @@
+// Startup prefetch list: recording, record codec and batch planning
+// The round trip replays prefetch.h against a temp dir: size the recorded
+// files, store the list in a state file, read it back and prefetch by batch
+
+#include <stdint.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "prefetch_list.h"
+
+namespace prefetch {
+namespace {
+
+TEST(PrefetchListTest, RecorderKeepsFirstOpensInOrder) {
+  Recorder recorder;
+  EXPECT_TRUE(recorder.Add(Root::kApp, L"7.0\\vivaldi.dll"));
+  EXPECT_TRUE(recorder.Add(Root::kData, L"Default\\Preferences"));
+  EXPECT_FALSE(recorder.Add(Root::kApp, L"7.0\\VIVALDI.DLL"));
+  EXPECT_TRUE(recorder.Add(Root::kData, L"7.0\\vivaldi.dll"));  // Same name, other root
+  EXPECT_FALSE(recorder.Add(Root::kData, L""));
+
+  std::vector<Entry> entries = recorder.Take();
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries[0].path, L"7.0\\vivaldi.dll");
+  EXPECT_EQ(entries[1].path, L"Default\\Preferences");
+  EXPECT_EQ(entries[2].root, Root::kData);
+
+  // Take starts over
+  EXPECT_TRUE(recorder.Add(Root::kApp, L"7.0\\vivaldi.dll"));
+}
+
+TEST(PrefetchListTest, RecorderIsBoundedAndThreadSafe) {
+  Recorder recorder;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&recorder]() {
+      for (size_t i = 0; i < kMaxEntries; ++i) {
+        recorder.Add(Root::kData, L"file" + std::to_wstring(i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(recorder.Take().size(), kMaxEntries);
+}
+
+TEST(PrefetchListTest, CodecRoundTrip) {
+  std::vector<Entry> entries = {
+      {Root::kApp, 4096, L"7.0\\vivaldi.dll"},
+      {Root::kData, 12, L"Default\\Préférences"},
+      {Root::kData, 1, L""},
+  };
+  std::vector<uint8_t> bytes = Encode(entries);
+
+  std::vector<Entry> decoded;
+  ASSERT_TRUE(Decode(bytes.data(), bytes.size(), &decoded));
+  ASSERT_EQ(decoded.size(), entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(decoded[i].root, entries[i].root);
+    EXPECT_EQ(decoded[i].length, entries[i].length);
+    EXPECT_EQ(decoded[i].path, entries[i].path);
+  }
+}
+
+TEST(PrefetchListTest, MalformedRecordsDecodeToNothing) {
+  std::vector<uint8_t> bytes = Encode({{Root::kApp, 10, L"a.dll"}, {Root::kData, 20, L"b.db"}});
+  std::vector<Entry> decoded;
+
+  for (size_t size = 0; size < bytes.size(); ++size) {
+    EXPECT_FALSE(Decode(bytes.data(), size, &decoded)) << "size " << size;
+    EXPECT_TRUE(decoded.empty());
+  }
+
+  std::vector<uint8_t> trailing = bytes;
+  trailing.push_back(0);
+  EXPECT_FALSE(Decode(trailing.data(), trailing.size(), &decoded));
+
+  std::vector<uint8_t> bad_root = bytes;
+  bad_root[4] = 7;
+  EXPECT_FALSE(Decode(bad_root.data(), bad_root.size(), &decoded));
+
+  std::vector<uint8_t> too_many = bytes;
+  state_format::StoreLE32(too_many.data(), kMaxEntries + 1);
+  EXPECT_FALSE(Decode(too_many.data(), too_many.size(), &decoded));
+}
+
+TEST(PrefetchListTest, PlanSplitsByFilesAndBytes) {
+  std::vector<Entry> entries;
+  for (uint32_t length : {100u, 200u, 0u, 300u, 400u, 500u}) {
+    entries.push_back({Root::kApp, length, L"f"});
+  }
+
+  std::vector<Batch> by_files = Plan(entries, 2, 1 << 20);
+  ASSERT_EQ(by_files.size(), 3u);
+  EXPECT_EQ(by_files[0].begin, 0u);
+  EXPECT_EQ(by_files[0].end, 2u);
+  EXPECT_EQ(by_files[1].begin, 3u);  // The empty entry is skipped
+  EXPECT_EQ(by_files[1].end, 5u);
+  EXPECT_EQ(by_files[2].bytes, 500u);
+
+  std::vector<Batch> by_bytes = Plan(entries, 32, 600);
+  ASSERT_EQ(by_bytes.size(), 3u);
+  EXPECT_EQ(by_bytes[0].bytes, 600u);  // 100 + 200 + 300 fills the batch exactly
+  EXPECT_EQ(by_bytes[0].end, 4u);
+  EXPECT_EQ(by_bytes[1].bytes, 400u);
+  EXPECT_EQ(by_bytes[2].bytes, 500u);
+}
+
+TEST(PrefetchListTest, PlanCapsFilesAndTotal) {
+  std::vector<Entry> entries(40, Entry{Root::kData, UINT32_MAX, L"big"});
+  uint64_t total = 0;
+  for (const Batch& batch : Plan(entries, 4, UINT64_MAX)) {
+    EXPECT_LE(batch.bytes, 4ull * kMaxFileBytes);
+    total += batch.bytes;
+  }
+  EXPECT_EQ(total, kMaxTotalBytes);
+}
+
+class PrefetchListFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = std::filesystem::temp_directory_path() /
+            ("prefetch_list_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_ / "app" / "7.0");
+    std::filesystem::create_directories(root_ / "data" / "Default" / "Cache");
+  }
+
+  void TearDown() override { std::filesystem::remove_all(root_); }
+
+  // Recorded paths use backslashes like on Windows
+  std::filesystem::path Resolve(const Entry& entry) const {
+    std::wstring relative = entry.path;
+    for (wchar_t& ch : relative) {
+      if (ch == L'\\') {
+        ch = L'/';
+      }
+    }
+    return root_ / (entry.root == Root::kApp ? "app" : "data") / relative;
+  }
+
+  void WriteFile(const std::filesystem::path& path, size_t size) {
+    std::ofstream out(root_ / path, std::ios::binary);
+    out << std::string(size, 'v');
+  }
+
+  std::filesystem::path root_;
+};
+
+TEST_F(PrefetchListFileTest, RecordStoreAndPrefetch) {
+  WriteFile("app/7.0/vivaldi.dll", 300000);
+  WriteFile("app/7.0/resources.pak", 12 << 20);  // Larger than kMaxFileBytes
+  WriteFile("data/Default/Preferences", 5000);
+  WriteFile("data/Default/Empty", 0);
+
+  Recorder recorder;
+  recorder.Add(Root::kApp, L"7.0\\vivaldi.dll");
+  recorder.Add(Root::kApp, L"7.0\\resources.pak");
+  recorder.Add(Root::kData, L"Default\\Preferences");
+  recorder.Add(Root::kData, L"Default\\Empty");
+  recorder.Add(Root::kData, L"Default\\Cache");    // Directory
+  recorder.Add(Root::kData, L"Default\\Missing");  // Deleted since
+
+  // SaveReadSet: size what still exists, drop directories and empty files
+  std::vector<Entry> entries;
+  for (auto& entry : recorder.Take()) {
+    std::error_code error;
+    std::filesystem::path path = Resolve(entry);
+    if (!std::filesystem::is_regular_file(path, error)) {
+      continue;
+    }
+    uint64_t size = std::filesystem::file_size(path, error);
+    entry.length = static_cast<uint32_t>(size < kMaxFileBytes ? size : kMaxFileBytes);
+    if (entry.length != 0) {
+      entries.push_back(std::move(entry));
+    }
+  }
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries[1].length, kMaxFileBytes);
+
+  // Store as a state record and load it like the next launch
+  std::vector<uint8_t> bytes = Encode(entries);
+  state_format::Builder builder;
+  builder.Set(1, kListVersion, bytes.data(), bytes.size());
+  std::vector<uint8_t> file = builder.Build();
+  {
+    std::ofstream out(root_ / "vivaldi_plus.state", std::ios::binary);
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+  }
+  std::ifstream in(root_ / "vivaldi_plus.state", std::ios::binary);
+  std::vector<uint8_t> loaded((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  state_format::Reader reader;
+  ASSERT_EQ(reader.Open(loaded.data(), loaded.size()), state_format::Status::kOk);
+  state_format::Record record;
+  ASSERT_TRUE(reader.Find(1, &record));
+  ASSERT_EQ(record.version, kListVersion);
+  std::vector<Entry> stored;
+  ASSERT_TRUE(Decode(record.data, record.size, &stored));
+  ASSERT_EQ(stored.size(), entries.size());
+
+  // A file shrank between launches: read what is there
+  WriteFile("data/Default/Preferences", 1000);
+
+  // PrefetchBatch: read the leading bytes of every file in each batch
+  uint64_t planned = 0;
+  uint64_t read = 0;
+  for (const Batch& batch : Plan(stored, 2, 1 << 20)) {
+    EXPECT_LE(batch.end - batch.begin, 2u);
+    planned += batch.bytes;
+    for (size_t i = batch.begin; i < batch.end; ++i) {
+      std::ifstream file_in(Resolve(stored[i]), std::ios::binary);
+      ASSERT_TRUE(file_in) << i;
+      std::vector<char> buffer(stored[i].length);
+      file_in.read(buffer.data(), buffer.size());
+      read += file_in.gcount();
+    }
+  }
+  EXPECT_EQ(planned, 300000u + kMaxFileBytes + 5000u);
+  EXPECT_EQ(read, 300000u + kMaxFileBytes + 1000u);
+}
+
+}  // namespace
+}  // namespace prefetch
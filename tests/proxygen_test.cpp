@@ -0,0 +1,200 @@
+// tools/proxygen against synthetic PE images: the checked-in src/proxy files
+// must be exactly what the generator writes for version.dll's export table
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+struct PeExport {
+  std::string name;  // Empty for ordinal-only exports
+  bool used = true;  // Unused ordinal slots have a zero RVA
+};
+
+void Put16(std::vector<uint8_t>& data, size_t offset, uint16_t value) {
+  data[offset] = static_cast<uint8_t>(value);
+  data[offset + 1] = static_cast<uint8_t>(value >> 8);
+}
+
+void Put32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+// Minimal PE32 or PE32+ image with one section holding the export directory
+std::vector<uint8_t> BuildPe(bool pe32_plus, uint32_t ordinal_base, const std::vector<PeExport>& exports) {
+  constexpr uint32_t kNtOffset = 0x40;
+  constexpr uint32_t kRawOffset = 0x400;
+  constexpr uint32_t kSectionRva = 0x1000;
+  const uint16_t optional_size = pe32_plus ? 240 : 224;
+
+  // Export directory layout inside the section
+  std::vector<uint32_t> named;
+  for (uint32_t i = 0; i < exports.size(); ++i) {
+    if (!exports[i].name.empty()) {
+      named.push_back(i);
+    }
+  }
+  const uint32_t functions = 40;
+  const uint32_t names = functions + 4 * static_cast<uint32_t>(exports.size());
+  const uint32_t ordinals = names + 4 * static_cast<uint32_t>(named.size());
+  uint32_t strings = ordinals + 2 * static_cast<uint32_t>(named.size());
+  uint32_t size = strings;
+  for (uint32_t index : named) {
+    size += static_cast<uint32_t>(exports[index].name.size()) + 1;
+  }
+  size = (size + 0x1FF) & ~0x1FFu;
+
+  std::vector<uint8_t> data(kRawOffset + size, 0);
+  Put16(data, 0, 0x5A4D);
+  Put32(data, 0x3C, kNtOffset);
+  Put32(data, kNtOffset, 0x00004550);
+
+  const uint32_t file_header = kNtOffset + 4;
+  Put16(data, file_header, pe32_plus ? 0x8664 : 0x14C);
+  Put16(data, file_header + 2, 1);
+  Put16(data, file_header + 16, optional_size);
+  Put16(data, file_header + 18, 0x2102);
+
+  const uint32_t optional_header = file_header + 20;
+  Put16(data, optional_header, pe32_plus ? 0x20B : 0x10B);
+  const uint32_t directories = optional_header + (pe32_plus ? 112 : 96);
+  Put32(data, directories - 4, 16);
+  Put32(data, directories, kSectionRva);
+  Put32(data, directories + 4, size);
+
+  const uint32_t section = optional_header + optional_size;
+  memcpy(&data[section], ".edata", 6);
+  Put32(data, section + 8, size);
+  Put32(data, section + 12, kSectionRva);
+  Put32(data, section + 16, size);
+  Put32(data, section + 20, kRawOffset);
+
+  const uint32_t dir = kRawOffset;
+  Put32(data, dir + 16, ordinal_base);
+  Put32(data, dir + 20, static_cast<uint32_t>(exports.size()));
+  Put32(data, dir + 24, static_cast<uint32_t>(named.size()));
+  Put32(data, dir + 28, kSectionRva + functions);
+  Put32(data, dir + 32, kSectionRva + names);
+  Put32(data, dir + 36, kSectionRva + ordinals);
+  for (uint32_t i = 0; i < exports.size(); ++i) {
+    // Any non-zero RVA will do, nothing ever calls these
+    Put32(data, dir + functions + 4 * i, exports[i].used ? 0x2000 + 16 * i : 0);
+  }
+  for (uint32_t n = 0; n < named.size(); ++n) {
+    const std::string& name = exports[named[n]].name;
+    Put32(data, dir + names + 4 * n, kSectionRva + strings);
+    Put16(data, dir + ordinals + 2 * n, static_cast<uint16_t>(named[n]));
+    memcpy(&data[dir + strings], name.c_str(), name.size() + 1);
+    strings += static_cast<uint32_t>(name.size()) + 1;
+  }
+  return data;
+}
+
+std::string ReadFile(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  EXPECT_TRUE(file) << path;
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+class ProxygenTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() /
+           ("proxygen_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+    fs::remove_all(dir_);
+    fs::create_directories(dir_ / "out");
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  // Write `image` as `file_name` and run the generator on it
+  int Run(const std::string& file_name, const std::vector<uint8_t>& image) {
+    fs::path input = dir_ / file_name;
+    std::ofstream(input, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+    std::string command = std::string(PROXYGEN_PATH) + " '" + input.string() + "' '" + (dir_ / "out").string() +
+                          "' > /dev/null 2>&1";
+    return system(command.c_str());
+  }
+
+  fs::path dir_;
+};
+
+const std::vector<PeExport> kVersionExports = {
+    {"GetFileVersionInfoA"},     {"GetFileVersionInfoByHandle"}, {"GetFileVersionInfoExA"},
+    {"GetFileVersionInfoExW"},   {"GetFileVersionInfoSizeA"},    {"GetFileVersionInfoSizeExA"},
+    {"GetFileVersionInfoSizeExW"}, {"GetFileVersionInfoSizeW"},  {"GetFileVersionInfoW"},
+    {"VerFindFileA"},            {"VerFindFileW"},               {"VerInstallFileA"},
+    {"VerInstallFileW"},         {"VerLanguageNameA"},           {"VerLanguageNameW"},
+    {"VerQueryValueA"},          {"VerQueryValueW"},
+};
+
+TEST_F(ProxygenTest, VersionDllMatchesCheckedInFiles) {
+  ASSERT_EQ(Run("version.dll", BuildPe(true, 1, kVersionExports)), 0);
+
+  const fs::path golden = PROXY_DIR;
+  for (const char* file : {"version.def", "version_x86.asm", "version_x64.asm", "version_proxy.h",
+                           "version_forward.h"}) {
+    SCOPED_TRACE(file);
+    EXPECT_EQ(ReadFile(dir_ / "out" / file), ReadFile(golden / file));
+  }
+}
+
+TEST_F(ProxygenTest, Pe32AndPe32PlusAgree) {
+  ASSERT_EQ(Run("version.dll", BuildPe(false, 1, kVersionExports)), 0);
+  EXPECT_EQ(ReadFile(dir_ / "out" / "version.def"), ReadFile(fs::path(PROXY_DIR) / "version.def"));
+}
+
+TEST_F(ProxygenTest, OrdinalOnlyExportsAndGaps) {
+  // Ordinals 5..8: a named export, an unused slot, an ordinal-only export, a named export
+  std::vector<PeExport> exports = {{"Zeta"}, {"", false}, {""}, {"Alpha"}};
+  ASSERT_EQ(Run("My-Lib.DLL", BuildPe(true, 5, exports)), 0);
+
+  EXPECT_EQ(ReadFile(dir_ / "out" / "my_lib.def"),
+            "; Generated by tools/proxygen from my-lib.dll, do not edit\n"
+            "EXPORTS\n"
+            "    Zeta=my_lib_proxy_0 @5\n"
+            "    my_lib_proxy_1 @7 NONAME\n"
+            "    Alpha=my_lib_proxy_2 @8\n");
+
+  std::string forward = ReadFile(dir_ / "out" / "my_lib_forward.h");
+  EXPECT_NE(forward.find(R"(/export:my_lib_proxy_1=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\my_lib.#7,@7,NONAME")"),
+            std::string::npos)
+      << forward;
+  EXPECT_NE(forward.find(R"(/export:Alpha=\\\\.\\GLOBALROOT\\SystemRoot\\System32\\my_lib.Alpha,@8")"),
+            std::string::npos)
+      << forward;
+
+  std::string header = ReadFile(dir_ / "out" / "my_lib_proxy.h");
+  EXPECT_NE(header.find("    {nullptr, 7},\n"), std::string::npos);
+  EXPECT_NE(header.find("k_my_lib_exports, 3, my_lib_proxy_slots"), std::string::npos);
+
+  std::string x64 = ReadFile(dir_ / "out" / "my_lib_x64.asm");
+  EXPECT_NE(x64.find("my_lib_proxy_2 PROC  ; Alpha\n    mov rax, QWORD PTR [my_lib_proxy_slots + 16]"),
+            std::string::npos);
+  EXPECT_FALSE(fs::exists(dir_ / "out" / "my_lib_arm64.asm"));
+}
+
+TEST_F(ProxygenTest, RejectsMalformedImages) {
+  EXPECT_NE(Run("empty.dll", std::vector<uint8_t>(64, 0)), 0);
+
+  std::vector<uint8_t> truncated = BuildPe(true, 1, kVersionExports);
+  truncated.resize(0x100);
+  EXPECT_NE(Run("truncated.dll", truncated), 0);
+
+  EXPECT_NE(Run("none.dll", BuildPe(true, 1, {})), 0);
+}
+
+}  // namespace
@@ -0,0 +1,109 @@
+// Profile shadow manifest: exclusions, SQLite units, comparison and codecs
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "shadow_manifest.h"
+
+namespace shadow {
+namespace {
+
+TEST(ShadowManifestTest, ExcludesCachesAndOwnFiles) {
+  EXPECT_TRUE(IsExcluded(L"lockfile"));
+  EXPECT_FALSE(IsExcluded(L"Default\\lockfile"));
+  EXPECT_TRUE(IsExcluded(L"vivaldi_plus.shadow.state"));
+  EXPECT_TRUE(IsExcluded(L"Default\\Code Cache\\js\\index"));
+  EXPECT_TRUE(IsExcluded(L"GPUCACHE\\data_0"));
+  EXPECT_FALSE(IsExcluded(L"Default\\History"));
+}
+
+TEST(ShadowManifestTest, SideFilesBelongToTheirDatabase) {
+  EXPECT_EQ(UnitOf(L"Default\\History-wal"), L"Default\\History");
+  EXPECT_EQ(UnitOf(L"Default\\History-JOURNAL"), L"Default\\History");
+  EXPECT_EQ(UnitOf(L"Default\\History-shm"), L"Default\\History");
+  EXPECT_EQ(UnitOf(L"Default\\History"), L"Default\\History");
+  EXPECT_EQ(UnitOf(L"-wal"), L"-wal");  // Nothing left to be the database
+}
+
+TEST(ShadowManifestTest, GroupsByUnitInOrderOfAppearance) {
+  std::vector<FileState> files = {
+      {L"Default\\History-journal", 1, 1, 1},
+      {L"Default\\Preferences", 1, 1, 1},
+      {L"Default\\history", 1, 1, 1},
+      {L"Default\\Cookies-wal", 1, 1, 1},
+  };
+  std::vector<std::vector<size_t>> groups = GroupByUnit(files, {0, 1, 2, 3});
+  ASSERT_EQ(groups.size(), 3u);
+  EXPECT_EQ(groups[0], (std::vector<size_t>{0, 2}));
+  EXPECT_EQ(groups[1], (std::vector<size_t>{1}));
+  EXPECT_EQ(groups[2], (std::vector<size_t>{3}));
+
+  std::unordered_set<std::wstring> keys;
+  AddUnitKeys(files, {0, 3}, &keys);
+  EXPECT_EQ(keys, (std::unordered_set<std::wstring>{L"default\\history", L"default\\cookies"}));
+}
+
+TEST(ShadowManifestTest, ComparesBySizeAndTime) {
+  std::vector<FileState> base = {
+      {L"Default\\History", 100, 10, 7},
+      {L"Default\\Preferences", 20, 10, 8},
+      {L"Default\\Gone", 5, 10, 9},
+  };
+  std::vector<FileState> scan = {
+      {L"Default\\PREFERENCES", 20, 10, 0},
+      {L"Default\\History", 100, 11, 0},
+      {L"Default\\New", 1, 1, 0},
+  };
+  Delta delta = Compare(base, scan);
+  EXPECT_EQ(delta.unchanged, (std::vector<size_t>{0}));
+  EXPECT_EQ(delta.changed, (std::vector<size_t>{1, 2}));
+  EXPECT_EQ(delta.removed, (std::vector<size_t>{2}));
+  EXPECT_EQ(delta.base_index, (std::vector<size_t>{1, 0, SIZE_MAX}));
+}
+
+TEST(ShadowManifestTest, ManifestRoundTrip) {
+  Manifest manifest;
+  manifest.id = 42;
+  manifest.files = {{L"Default\\History", 100, 10, 7}, {L"Local State", 3, 4, 5}};
+  std::vector<uint8_t> bytes = EncodeManifest(manifest);
+
+  Manifest decoded;
+  ASSERT_TRUE(DecodeManifest(bytes.data(), bytes.size(), &decoded));
+  EXPECT_EQ(decoded.id, 42u);
+  ASSERT_EQ(decoded.files.size(), 2u);
+  EXPECT_EQ(decoded.files[1].path, L"Local State");
+  EXPECT_EQ(decoded.files[0].hash, 7u);
+
+  for (size_t size = 0; size < bytes.size(); size++) {
+    EXPECT_FALSE(DecodeManifest(bytes.data(), size, &decoded)) << size;
+  }
+}
+
+TEST(ShadowManifestTest, JournalRoundTrip) {
+  std::vector<Op> ops = {
+      {OpKind::kMove, 3, 99, L"Default\\History"},
+      {OpKind::kMove, 4, 99, L"Default\\History-journal"},
+      {OpKind::kDelete, 0, 0, L"Default\\History-wal"},
+  };
+  std::vector<uint8_t> bytes = EncodeJournal(ops);
+
+  std::vector<Op> decoded;
+  ASSERT_TRUE(DecodeJournal(bytes.data(), bytes.size(), &decoded));
+  ASSERT_EQ(decoded.size(), 3u);
+  EXPECT_EQ(decoded[1].staged, 4u);
+  EXPECT_EQ(decoded[2].kind, OpKind::kDelete);
+  EXPECT_EQ(decoded[2].path, L"Default\\History-wal");
+
+  for (size_t size = 0; size < bytes.size(); size++) {
+    decoded.clear();
+    EXPECT_FALSE(DecodeJournal(bytes.data(), size, &decoded)) << size;
+  }
+}
+
+}  // namespace
+}  // namespace shadow
@@ -0,0 +1,304 @@
+// SQLite profile maintenance: header parsing, planning and the maintenance
+// statements, run against copies of databases built with the system
+// libsqlite3 behind the same SqliteApi table winsqlite3.dll fills on Windows
+
+#include <stdint.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include "sqlite_plan.h"
+
+namespace sqlite_maintenance {
+namespace {
+
+constexpr SqliteApi kApi = {sqlite3_open_v2, sqlite3_close, sqlite3_exec, sqlite3_busy_timeout,
+                            sqlite3_progress_handler};
+
+std::chrono::steady_clock::time_point InOneMinute() {
+  return std::chrono::steady_clock::now() + std::chrono::minutes(1);
+}
+
+Outcome Maintain(const std::filesystem::path& path, Action action, std::chrono::steady_clock::time_point deadline,
+                 uint64_t* size_after) {
+  return Run(kApi, path.c_str(), action, deadline, size_after);
+}
+
+class SqlitePlanTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = std::filesystem::temp_directory_path() /
+            (std::string("sqlite_plan_test_") + testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_ / "fixtures");
+    std::filesystem::create_directories(root_ / "profile");
+  }
+
+  void TearDown() override {
+    for (sqlite3* db : open_) {
+      sqlite3_close(db);
+    }
+    std::filesystem::remove_all(root_);
+  }
+
+  sqlite3* Open(const std::filesystem::path& path) {
+    sqlite3* db = nullptr;
+    EXPECT_EQ(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+    open_.push_back(db);
+    return db;
+  }
+
+  void Close(sqlite3* db) {
+    std::erase(open_, db);
+    sqlite3_close(db);
+  }
+
+  static void Exec(sqlite3* db, const std::string& sql) {
+    char* error = nullptr;
+    ASSERT_EQ(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error), SQLITE_OK) << (error ? error : "");
+  }
+
+  // A database of `rows` 4 KiB rows, of which all but every `keep`th one were
+  // deleted again, leaving their pages on the free list
+  std::filesystem::path Build(const std::string& name, const std::string& pragmas, int rows, int keep) {
+    std::filesystem::path path = root_ / "fixtures" / name;
+    sqlite3* db = Open(path);
+    Exec(db, pragmas);
+    Exec(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, payload BLOB)");
+    Exec(db, "BEGIN; WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " +
+                 std::to_string(rows) + ") INSERT INTO t SELECT i, zeroblob(4096) FROM n; COMMIT");
+    Exec(db, "DELETE FROM t WHERE id % " + std::to_string(keep) + " != 0");
+    Close(db);
+    return path;
+  }
+
+  // The browser works on its own copy of the profile, so does every test
+  std::filesystem::path CopyToProfile(const std::filesystem::path& fixture) {
+    std::filesystem::path copy = root_ / "profile" / fixture.filename();
+    std::filesystem::copy_file(fixture, copy, std::filesystem::copy_options::overwrite_existing);
+    return copy;
+  }
+
+  static Database Inspect(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> bytes(100);
+    in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+    Database database{path.filename().wstring(), std::filesystem::file_size(path), 0, 0, {}};
+    std::filesystem::path wal = path.string() + "-wal";
+    if (std::filesystem::exists(wal)) {
+      database.wal_size = std::filesystem::file_size(wal);
+    }
+    EXPECT_TRUE(ParseHeader(bytes.data(), static_cast<size_t>(in.gcount()), database.size, &database.header));
+    return database;
+  }
+
+  static uint64_t Count(sqlite3* db) {
+    sqlite3_stmt* statement = nullptr;
+    sqlite3_prepare_v2(db, "SELECT count(*) FROM t", -1, &statement, nullptr);
+    uint64_t count = sqlite3_step(statement) == SQLITE_ROW ? sqlite3_column_int64(statement, 0) : UINT64_MAX;
+    sqlite3_finalize(statement);
+    return count;
+  }
+
+  std::filesystem::path root_;
+  std::vector<sqlite3*> open_;
+};
+
+TEST_F(SqlitePlanTest, FragmentedDatabaseIsVacuumed) {
+  std::filesystem::path path = CopyToProfile(Build("History", "", 4000, 10));
+  Database database = Inspect(path);
+  EXPECT_FALSE(database.header.wal);
+  EXPECT_FALSE(database.header.incremental);
+  EXPECT_GT(database.header.freelist_count * 10, database.header.page_count * 8);
+
+  std::vector<Task> tasks = Plan({database}, {}, kVacuumInterval, 60000);
+  ASSERT_EQ(tasks.size(), 1u);
+  EXPECT_EQ(tasks[0].action, Action::kVacuum);
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kVacuum, InOneMinute(), &size_after), Outcome::kDone);
+  EXPECT_EQ(size_after, std::filesystem::file_size(path));
+  EXPECT_LT(size_after * 5, database.size);
+
+  Database after = Inspect(path);
+  EXPECT_EQ(after.header.freelist_count, 0u);
+  EXPECT_EQ(Count(Open(path)), 400u);
+}
+
+TEST_F(SqlitePlanTest, IncrementalDatabaseReleasesFreePages) {
+  std::filesystem::path path = CopyToProfile(Build("Favicons", "PRAGMA auto_vacuum = INCREMENTAL", 4000, 10));
+  Database database = Inspect(path);
+  EXPECT_TRUE(database.header.incremental);
+
+  std::vector<Task> tasks = Plan({database}, {}, kVacuumInterval, 60000);
+  ASSERT_EQ(tasks.size(), 1u);
+  EXPECT_EQ(tasks[0].action, Action::kIncrementalVacuum);
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kIncrementalVacuum, InOneMinute(), &size_after), Outcome::kDone);
+  EXPECT_LT(std::filesystem::file_size(path) * 5, database.size);
+  EXPECT_EQ(Inspect(path).header.freelist_count, 0u);
+  EXPECT_EQ(Count(Open(path)), 400u);
+}
+
+TEST_F(SqlitePlanTest, CompactDatabaseIsLeftAlone) {
+  std::filesystem::path path = CopyToProfile(Build("Cookies", "", 2000, 1));
+  Database database = Inspect(path);
+  EXPECT_EQ(database.header.freelist_count, 0u);
+  EXPECT_TRUE(Plan({database}, {}, kVacuumInterval, 60000).empty());
+}
+
+TEST_F(SqlitePlanTest, LargeWalIsCheckpointed) {
+  std::filesystem::path path = CopyToProfile(Build("Web Data", "PRAGMA journal_mode = WAL", 10, 1));
+
+  // The browser keeps its connection open and the log grows past the threshold
+  sqlite3* browser = Open(path);
+  Exec(browser, "PRAGMA wal_autocheckpoint = 0");
+  Exec(browser, "BEGIN; WITH RECURSIVE n(i) AS (SELECT 11 UNION ALL SELECT i + 1 FROM n WHERE i < 2000) "
+                "INSERT INTO t SELECT i, zeroblob(4096) FROM n; COMMIT");
+
+  Database database = Inspect(path);
+  EXPECT_TRUE(database.header.wal);
+  EXPECT_GE(database.wal_size, kMinWalBytes);
+
+  std::vector<Task> tasks = Plan({database}, {}, kVacuumInterval, 60000);
+  ASSERT_EQ(tasks.size(), 1u);
+  EXPECT_EQ(tasks[0].action, Action::kCheckpoint);
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kCheckpoint, InOneMinute(), &size_after), Outcome::kDone);
+  EXPECT_EQ(std::filesystem::file_size(path.string() + "-wal"), 0u);
+  EXPECT_EQ(Count(browser), 2000u);
+}
+
+TEST_F(SqlitePlanTest, CheckpointBlockedByReaderIsBusy) {
+  std::filesystem::path path = CopyToProfile(Build("Web Data", "PRAGMA journal_mode = WAL", 10, 1));
+  sqlite3* browser = Open(path);
+  Exec(browser, "PRAGMA wal_autocheckpoint = 0");
+  Exec(browser, "INSERT INTO t VALUES (100, zeroblob(4096))");
+
+  // A read transaction pins the log
+  sqlite3* reader = Open(path);
+  Exec(reader, "BEGIN; SELECT count(*) FROM t");
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kCheckpoint, InOneMinute(), &size_after), Outcome::kBusy);
+  Exec(reader, "COMMIT");
+}
+
+TEST_F(SqlitePlanTest, VacuumOfLockedDatabaseIsBusy) {
+  std::filesystem::path path = CopyToProfile(Build("History", "", 400, 10));
+  uint32_t free_pages = Inspect(path).header.freelist_count;
+  sqlite3* browser = Open(path);
+  Exec(browser, "BEGIN EXCLUSIVE");
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kVacuum, InOneMinute(), &size_after), Outcome::kBusy);
+  Exec(browser, "COMMIT");
+  EXPECT_EQ(Inspect(path).header.freelist_count, free_pages);
+}
+
+TEST_F(SqlitePlanTest, VacuumPastDeadlineRollsBack) {
+  std::filesystem::path path = CopyToProfile(Build("History", "", 4000, 10));
+  Database before = Inspect(path);
+
+  uint64_t size_after = 0;
+  Outcome outcome = Maintain(path, Action::kVacuum, std::chrono::steady_clock::now(), &size_after);
+  EXPECT_EQ(outcome, Outcome::kTimeout);
+
+  Database after = Inspect(path);
+  EXPECT_EQ(after.size, before.size);
+  EXPECT_EQ(after.header.freelist_count, before.header.freelist_count);
+  EXPECT_EQ(Count(Open(path)), 400u);
+}
+
+TEST_F(SqlitePlanTest, StatisticsAreRefreshedAfterVacuum) {
+  std::filesystem::path fixture = Build("History", "", 4000, 10);
+  {
+    sqlite3* db = Open(fixture);
+    Exec(db, "CREATE INDEX t_payload ON t (length(payload)); ANALYZE");
+    Exec(db, "DELETE FROM sqlite_stat1");
+    Close(db);
+  }
+  std::filesystem::path path = CopyToProfile(fixture);
+
+  uint64_t size_after = 0;
+  EXPECT_EQ(Maintain(path, Action::kVacuum, InOneMinute(), &size_after), Outcome::kDone);
+
+  sqlite3* db = Open(path);
+  sqlite3_stmt* statement = nullptr;
+  sqlite3_prepare_v2(db, "SELECT count(*) FROM sqlite_stat1", -1, &statement, nullptr);
+  ASSERT_EQ(sqlite3_step(statement), SQLITE_ROW);
+  EXPECT_GT(sqlite3_column_int64(statement, 0), 0);
+  sqlite3_finalize(statement);
+}
+
+TEST_F(SqlitePlanTest, RejectsNonDatabaseHeaders) {
+  std::filesystem::path path = CopyToProfile(Build("History", "", 10, 1));
+  std::ifstream in(path, std::ios::binary);
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  Header header;
+  ASSERT_TRUE(ParseHeader(bytes.data(), bytes.size(), bytes.size(), &header));
+  EXPECT_FALSE(ParseHeader(bytes.data(), 99, bytes.size(), &header));
+
+  std::vector<uint8_t> damaged = bytes;
+  damaged[0] = 's';
+  EXPECT_FALSE(ParseHeader(damaged.data(), damaged.size(), damaged.size(), &header));
+
+  damaged = bytes;
+  damaged[16] = 0x03;  // 768, not a power of two
+  damaged[17] = 0x00;
+  EXPECT_FALSE(ParseHeader(damaged.data(), damaged.size(), damaged.size(), &header));
+}
+
+TEST(SqlitePlanPlanTest, SkipsInterruptedAndRecentlyRebuiltDatabases) {
+  Header fragmented{4096, 4096, 2048, false, false};
+  std::vector<Database> databases = {
+      {L"History", 16u << 20, 0, 512, fragmented},
+      {L"Favicons", 16u << 20, 0, 0, fragmented},
+      {L"Cookies", 16u << 20, 0, 0, fragmented},
+  };
+  Results results;
+  results.entries.push_back({L"Favicons", kVacuumInterval, 16u << 20, 8u << 20, 100, Action::kVacuum, Outcome::kDone});
+
+  std::vector<Task> tasks = Plan(databases, results, kVacuumInterval + 1, 60000);
+  ASSERT_EQ(tasks.size(), 1u);
+  EXPECT_EQ(tasks[0].database, 2u);
+
+  // The timed rebuild sets the speed: 16 MiB in 100 ms
+  EXPECT_EQ(tasks[0].estimate_ms, (16u << 20) / ((16u << 20) / 100) + 1);
+  EXPECT_TRUE(Plan(databases, results, kVacuumInterval + 1, 100).empty());
+}
+
+TEST(SqlitePlanPlanTest, ResultsRoundTrip) {
+  Results results;
+  Merge(&results, {{L"History", 10, 300, 200, 5, Action::kVacuum, Outcome::kDone}}, 10);
+  Merge(&results, {{L"Cookies", 20, 100, 100, 0, Action::kCheckpoint, Outcome::kBusy}}, 20);
+  Merge(&results, {{L"History", 30, 200, 150, 4, Action::kVacuum, Outcome::kTimeout}}, 30);
+  ASSERT_EQ(results.entries.size(), 2u);
+  EXPECT_EQ(results.entries[0].time, 30u);
+  EXPECT_EQ(results.last_pass, 30u);
+
+  std::vector<uint8_t> bytes = EncodeResults(results);
+  Results decoded;
+  ASSERT_TRUE(DecodeResults(bytes.data(), bytes.size(), &decoded));
+  ASSERT_EQ(decoded.entries.size(), 2u);
+  EXPECT_EQ(decoded.entries[0].path, L"History");
+  EXPECT_EQ(decoded.entries[0].outcome, Outcome::kTimeout);
+  EXPECT_EQ(decoded.entries[1].action, Action::kCheckpoint);
+
+  for (size_t size = 0; size < bytes.size(); size++) {
+    EXPECT_FALSE(DecodeResults(bytes.data(), size, &decoded)) << size;
+  }
+}
+
+}  // namespace
+}  // namespace sqlite_maintenance
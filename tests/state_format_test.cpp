@@ -0,0 +1,270 @@
+// State file codec: round trip, corruption and concurrent writers
+// The writer tests replay the state_store.h protocol (rebuild from the
+// current file under a lock, then atomically rename) against a temp dir
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "state_format.h"
+
+namespace state_format {
+namespace {
+
+std::vector<uint8_t> BuildSample() {
+  Builder builder;
+  builder.Set(1, 3, "first", 5);
+  builder.Set(7, 1, "seventh record", 14);
+  builder.Set(9, 2, "", 0);
+  return builder.Build();
+}
+
+std::string Text(const Record& record) {
+  return std::string(reinterpret_cast<const char*>(record.data), record.size);
+}
+
+TEST(StateFormatTest, RoundTrip) {
+  std::vector<uint8_t> file = BuildSample();
+  Reader reader;
+  ASSERT_EQ(reader.Open(file.data(), file.size()), Status::kOk);
+  EXPECT_EQ(reader.Count(), 3u);
+
+  Record record;
+  ASSERT_TRUE(reader.Find(1, &record));
+  EXPECT_EQ(record.version, 3);
+  EXPECT_EQ(Text(record), "first");
+  ASSERT_TRUE(reader.Find(7, &record));
+  EXPECT_EQ(Text(record), "seventh record");
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(record.data) % 8, reinterpret_cast<uintptr_t>(file.data()) % 8);
+  ASSERT_TRUE(reader.Find(9, &record));
+  EXPECT_EQ(record.size, 0u);
+  EXPECT_FALSE(reader.Find(2, &record));
+}
+
+TEST(StateFormatTest, OpenStatus) {
+  Reader reader;
+  EXPECT_EQ(reader.Open(nullptr, 0), Status::kEmpty);
+
+  const uint8_t other[] = "MZ\x90\x00 not a state file";
+  EXPECT_EQ(reader.Open(other, sizeof(other)), Status::kBadMagic);
+
+  std::vector<uint8_t> file = BuildSample();
+  file[4] = kVersion + 1;
+  EXPECT_EQ(reader.Open(file.data(), file.size()), Status::kUnsupportedVersion);
+  EXPECT_EQ(reader.Count(), 0u);
+}
+
+TEST(StateFormatTest, EveryTruncationIsRejected) {
+  std::vector<uint8_t> file = BuildSample();
+  Reader reader;
+  for (size_t size = 1; size < file.size(); ++size) {
+    Status status = reader.Open(file.data(), size);
+    EXPECT_TRUE(status == Status::kCorrupt || status == Status::kBadMagic) << "size " << size;
+  }
+
+  // Trailing garbage changes the size recorded in the header too
+  file.push_back(0);
+  EXPECT_EQ(reader.Open(file.data(), file.size()), Status::kCorrupt);
+}
+
+TEST(StateFormatTest, HeaderAndIndexDamageRejectsTheFile) {
+  const std::vector<uint8_t> file = BuildSample();
+  size_t index_end = kHeaderSize + 3 * kIndexEntrySize;
+  for (size_t i = 0; i < index_end; ++i) {
+    std::vector<uint8_t> damaged = file;
+    damaged[i] ^= 0x40;
+    Reader reader;
+    EXPECT_NE(reader.Open(damaged.data(), damaged.size()), Status::kOk) << "byte " << i;
+  }
+}
+
+TEST(StateFormatTest, PayloadDamageOnlyLosesThatRecord) {
+  std::vector<uint8_t> file = BuildSample();
+  Reader reader;
+  ASSERT_EQ(reader.Open(file.data(), file.size()), Status::kOk);
+  Record record;
+  ASSERT_TRUE(reader.Find(7, &record));
+  size_t offset = record.data - file.data();
+
+  file[offset + 3] ^= 0x01;
+  ASSERT_EQ(reader.Open(file.data(), file.size()), Status::kOk);
+  EXPECT_FALSE(reader.Find(7, &record));
+  ASSERT_TRUE(reader.Find(1, &record));
+  EXPECT_EQ(Text(record), "first");
+
+  // Rewriting from a damaged file keeps the intact records only
+  Builder builder;
+  builder.CopyFrom(reader);
+  EXPECT_TRUE(builder.Find(1, &record));
+  EXPECT_TRUE(builder.Find(9, &record));
+  EXPECT_FALSE(builder.Find(7, &record));
+}
+
+TEST(StateFormatTest, OffsetsOutsideTheFileAreRejected) {
+  std::vector<uint8_t> file = BuildSample();
+  uint8_t* entry = file.data() + kHeaderSize;
+
+  // Valid checksum, but the payload points into the index
+  StoreLE32(entry + 8, kHeaderSize);
+  StoreLE32(file.data() + 12, Checksum(file.data() + kHeaderSize, 3 * kIndexEntrySize, Checksum(file.data(), 12)));
+  Reader reader;
+  EXPECT_EQ(reader.Open(file.data(), file.size()), Status::kCorrupt);
+
+  // And past the end
+  StoreLE32(entry + 8, static_cast<uint32_t>(file.size() - 2));
+  StoreLE32(entry + 12, 5);
+  StoreLE32(file.data() + 12, Checksum(file.data() + kHeaderSize, 3 * kIndexEntrySize, Checksum(file.data(), 12)));
+  EXPECT_EQ(reader.Open(file.data(), file.size()), Status::kCorrupt);
+}
+
+TEST(StateFormatTest, BuildLimits) {
+  Builder builder;
+  for (uint32_t type = 0; type < kMaxRecords; ++type) {
+    builder.Set(type, 1, "", 0);
+  }
+  EXPECT_FALSE(builder.Build().empty());
+  builder.Set(kMaxRecords, 1, "", 0);
+  EXPECT_TRUE(builder.Build().empty());
+
+  Builder large;
+  std::string payload(kMaxFileSize, 'x');
+  large.Set(1, 1, payload.data(), payload.size());
+  EXPECT_TRUE(large.Build().empty());
+}
+
+// state_store::Update on top of a directory: the mutex stands in for the
+// named mutex, rename for MoveFileEx(MOVEFILE_REPLACE_EXISTING)
+class FileStore {
+ public:
+  explicit FileStore(std::filesystem::path directory) : path_(directory / "vivaldi_plus.state") {}
+
+  std::vector<uint8_t> Read() const {
+    std::ifstream in(path_, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  template <typename Mutate>
+  bool Update(Mutate mutate, const std::string& tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint8_t> current = Read();
+    Reader reader;
+    Builder builder;
+    if (reader.Open(current.data(), current.size()) == Status::kOk) {
+      builder.CopyFrom(reader);
+    }
+    mutate(builder);
+    std::vector<uint8_t> file = builder.Build();
+    if (file.empty()) {
+      return false;
+    }
+
+    std::filesystem::path temp = path_;
+    temp += "." + tag + ".tmp";
+    {
+      std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    }
+    std::filesystem::rename(temp, path_);
+    return true;
+  }
+
+ private:
+  std::filesystem::path path_;
+  std::mutex mutex_;
+};
+
+class StateFormatFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = std::filesystem::temp_directory_path() /
+                 ("state_format_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+                  ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(directory_);
+    std::filesystem::create_directories(directory_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  std::filesystem::path directory_;
+};
+
+TEST_F(StateFormatFileTest, ConcurrentWritersKeepEachOthersRecords) {
+  constexpr uint32_t kWriters = 6;
+  constexpr uint32_t kUpdates = 50;
+  FileStore store(directory_);
+  std::atomic<bool> stop_readers{false};
+  std::atomic<int> torn_reads{0};
+
+  // Readers take no lock: the rename must never expose a partial file
+  std::thread reader([&]() {
+    while (!stop_readers.load()) {
+      std::vector<uint8_t> file = store.Read();
+      Reader reader;
+      Status status = reader.Open(file.data(), file.size());
+      if (status != Status::kOk && status != Status::kEmpty) {
+        torn_reads.fetch_add(1);
+      }
+    }
+  });
+
+  std::vector<std::thread> writers;
+  for (uint32_t writer = 0; writer < kWriters; ++writer) {
+    writers.emplace_back([&store, writer]() {
+      for (uint32_t update = 1; update <= kUpdates; ++update) {
+        std::string payload = std::to_string(writer) + ":" + std::to_string(update);
+        bool written = store.Update(
+            [&](Builder& builder) { builder.Set(100 + writer, 1, payload.data(), payload.size()); },
+            std::to_string(writer));
+        ASSERT_TRUE(written);
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  stop_readers.store(true);
+  reader.join();
+  EXPECT_EQ(torn_reads.load(), 0);
+
+  std::vector<uint8_t> file = store.Read();
+  Reader result;
+  ASSERT_EQ(result.Open(file.data(), file.size()), Status::kOk);
+  EXPECT_EQ(result.Count(), kWriters);
+  for (uint32_t writer = 0; writer < kWriters; ++writer) {
+    Record record;
+    ASSERT_TRUE(result.Find(100 + writer, &record));
+    EXPECT_EQ(Text(record), std::to_string(writer) + ":" + std::to_string(kUpdates));
+  }
+}
+
+TEST_F(StateFormatFileTest, WriterRecoversFromADamagedFile) {
+  FileStore store(directory_);
+  ASSERT_TRUE(store.Update([](Builder& builder) { builder.Set(1, 1, "kept", 4); }, "a"));
+
+  {
+    std::ofstream out(directory_ / "vivaldi_plus.state", std::ios::binary | std::ios::trunc);
+    out << "VPST garbage";
+  }
+  ASSERT_TRUE(store.Update([](Builder& builder) { builder.Set(2, 1, "fresh", 5); }, "b"));
+
+  std::vector<uint8_t> file = store.Read();
+  Reader reader;
+  ASSERT_EQ(reader.Open(file.data(), file.size()), Status::kOk);
+  Record record;
+  EXPECT_FALSE(reader.Find(1, &record));
+  ASSERT_TRUE(reader.Find(2, &record));
+  EXPECT_EQ(Text(record), "fresh");
+}
+
+}  // namespace
+}  // namespace state_format
@@ -0,0 +1,296 @@
+// Tiered storage layout: validation, the link record and Apply against a temp
+// dir, with symbolic links standing in for junctions and the backslash paths
+// of Windows mapped to '/'. Directories named "ro" are not writable,
+// directories named "fat" cannot hold links, like a FAT32 stick, and files
+// named "locked..." cannot be moved, like a file the browser has open.
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "storage_plan.h"
+
+namespace storage_layout {
+namespace {
+
+std::filesystem::path Native(std::wstring path) {
+  for (wchar_t& ch : path) {
+    if (ch == L'\\') {
+      ch = L'/';
+    }
+  }
+  return std::filesystem::path(path);
+}
+
+std::wstring Windows(const std::filesystem::path& path) {
+  std::wstring result = path.wstring();
+  for (wchar_t& ch : result) {
+    if (ch == L'/') {
+      ch = L'\\';
+    }
+  }
+  return result;
+}
+
+bool HasComponent(const std::wstring& path, const std::wstring& name) {
+  for (const auto& component : Native(path)) {
+    if (component.wstring() == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Kind Inspect(const std::wstring& path, std::wstring* target) {
+  std::error_code error;
+  std::filesystem::file_status status = std::filesystem::symlink_status(Native(path), error);
+  if (!std::filesystem::exists(status)) {
+    return Kind::kMissing;
+  }
+  if (std::filesystem::is_symlink(status)) {
+    *target = Windows(std::filesystem::read_symlink(Native(path), error));
+    return std::filesystem::is_directory(Native(path), error) ? Kind::kLink : Kind::kOther;
+  }
+  return std::filesystem::is_directory(status) ? Kind::kDirectory : Kind::kOther;
+}
+
+bool List(const std::wstring& dir, std::vector<std::wstring>* names) {
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(Native(dir), error)) {
+    names->push_back(entry.path().filename().wstring());
+  }
+  return !error;
+}
+
+bool MakeDirectory(const std::wstring& path) {
+  std::error_code error;
+  std::filesystem::create_directories(Native(path), error);
+  return !error && std::filesystem::is_directory(Native(path));
+}
+
+bool MakeLink(const std::wstring& path, const std::wstring& target) {
+  if (HasComponent(path, L"fat")) {
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::create_directory_symlink(Native(target), Native(path), error);
+  return !error;
+}
+
+bool RemoveLink(const std::wstring& path) {
+  std::error_code error;
+  return std::filesystem::is_symlink(Native(path), error) && std::filesystem::remove(Native(path), error);
+}
+
+bool RemoveEmptyDirectory(const std::wstring& path) {
+  return rmdir(Native(path).c_str()) == 0;
+}
+
+bool Move(const std::wstring& from, const std::wstring& to) {
+  if (Native(from).filename().string().starts_with("locked")) {
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::rename(Native(from), Native(to), error);
+  return !error;
+}
+
+bool Writable(const std::wstring& dir) {
+  return !HasComponent(dir, L"ro") && access(Native(dir).c_str(), W_OK) == 0;
+}
+
+constexpr FileSystem kFileSystem = {Inspect, List, MakeDirectory, MakeLink, RemoveLink, RemoveEmptyDirectory,
+                                    Move, Writable};
+
+class StoragePlanTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = std::filesystem::temp_directory_path() /
+            (std::string("storage_plan_test_") + testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_ / "Data");
+  }
+
+  void TearDown() override { std::filesystem::remove_all(root_); }
+
+  std::wstring Path(const std::string& relative) const { return Windows(root_ / relative); }
+
+  void Write(const std::string& relative, const std::string& contents) {
+    std::filesystem::path path = root_ / relative;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << contents;
+  }
+
+  std::string Read(const std::string& relative) const {
+    std::ifstream in(root_ / relative, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  bool IsLinkTo(const std::string& relative, const std::string& target) const {
+    std::filesystem::path path = root_ / relative;
+    return std::filesystem::is_symlink(path) && std::filesystem::read_symlink(path) == root_ / target;
+  }
+
+  bool IsPlainDirectory(const std::string& relative) const {
+    std::filesystem::path path = root_ / relative;
+    return !std::filesystem::is_symlink(path) && std::filesystem::is_directory(path);
+  }
+
+  std::vector<Result> Run(const std::string& data, const std::vector<std::pair<std::string, std::string>>& lines) {
+    std::vector<Mapping> mappings;
+    for (const auto& [relative, target] : lines) {
+      mappings.push_back({std::filesystem::path(relative).wstring(), Path(target)});
+    }
+    std::vector<Rejected> rejected;
+    mappings = Validate(Path(data), mappings, &rejected);
+    EXPECT_TRUE(rejected.empty());
+    return Apply(kFileSystem, Path(data), mappings, &links_);
+  }
+
+  std::filesystem::path root_;
+  std::vector<Link> links_;
+};
+
+TEST_F(StoragePlanTest, MovesContentsAndLinks) {
+  Write("Data/Default/GPUCache/data_0", "gpu");
+  Write("Data/Default/GPUCache/index-dir/the-real-index", "index");
+
+  std::vector<Result> results = Run("Data", {{"Default\\GPUCache", "Fast/GPUCache"}});
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, Status::kMoved);
+  EXPECT_TRUE(IsLinkTo("Data/Default/GPUCache", "Fast/GPUCache"));
+  EXPECT_EQ(Read("Fast/GPUCache/data_0"), "gpu");
+  EXPECT_EQ(Read("Data/Default/GPUCache/index-dir/the-real-index"), "index");
+  ASSERT_EQ(links_.size(), 1u);
+  EXPECT_FALSE(std::filesystem::exists(root_ / "Data/Default/vivaldi_plus.link_probe"));
+
+  // Nothing to do the next time
+  results = Run("Data", {{"Default\\GPUCache", "Fast/GPUCache"}});
+  EXPECT_EQ(results[0].status, Status::kKept);
+}
+
+TEST_F(StoragePlanTest, LinksAMissingDirectory) {
+  std::vector<Result> results = Run("Data", {{"GrShaderCache", "Fast/GrShaderCache"}});
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, Status::kLinked);
+  EXPECT_TRUE(IsLinkTo("Data/GrShaderCache", "Fast/GrShaderCache"));
+}
+
+TEST_F(StoragePlanTest, RetargetsAndMovesBack) {
+  Write("Data/Default/Code Cache/js/a", "code");
+  Run("Data", {{"Default\\Code Cache", "Old/Code Cache"}});
+  ASSERT_TRUE(IsLinkTo("Data/Default/Code Cache", "Old/Code Cache"));
+
+  std::vector<Result> results = Run("Data", {{"Default\\Code Cache", "New/Code Cache"}});
+  EXPECT_EQ(results[0].status, Status::kRetargeted);
+  EXPECT_TRUE(IsLinkTo("Data/Default/Code Cache", "New/Code Cache"));
+  EXPECT_EQ(Read("New/Code Cache/js/a"), "code");
+  EXPECT_FALSE(std::filesystem::exists(root_ / "Old/Code Cache"));
+
+  // The line is removed from the config
+  results = Run("Data", {});
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, Status::kReverted);
+  EXPECT_TRUE(IsPlainDirectory("Data/Default/Code Cache"));
+  EXPECT_EQ(Read("Data/Default/Code Cache/js/a"), "code");
+  EXPECT_TRUE(links_.empty());
+}
+
+TEST_F(StoragePlanTest, UnwritableTargetFallsBack) {
+  Write("Data/Default/GPUCache/data_0", "gpu");
+  std::vector<Result> results = Run("Data", {{"Default\\GPUCache", "ro/GPUCache"}});
+  EXPECT_EQ(results[0].status, Status::kFallback);
+  EXPECT_TRUE(IsPlainDirectory("Data/Default/GPUCache"));
+  EXPECT_EQ(Read("Data/Default/GPUCache/data_0"), "gpu");
+  EXPECT_TRUE(links_.empty());
+}
+
+TEST_F(StoragePlanTest, VolumeWithoutLinksMovesNothing) {
+  Write("fat/Data/Default/GPUCache/data_0", "gpu");
+  std::vector<Result> results = Run("fat/Data", {{"Default\\GPUCache", "Fast/GPUCache"}});
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, Status::kNoLinks);
+  EXPECT_TRUE(IsPlainDirectory("fat/Data/Default/GPUCache"));
+  EXPECT_EQ(Read("fat/Data/Default/GPUCache/data_0"), "gpu");
+  EXPECT_TRUE(std::filesystem::is_empty(root_ / "Fast/GPUCache"));
+  EXPECT_FALSE(std::filesystem::exists(root_ / "fat/Data/Default/vivaldi_plus.link_probe"));
+  EXPECT_TRUE(links_.empty());
+}
+
+TEST_F(StoragePlanTest, PartialMoveIsUndone) {
+  Write("Data/Default/GPUCache/data_0", "gpu");
+  Write("Data/Default/GPUCache/index-dir/index", "index");
+  Write("Data/Default/GPUCache/locked", "open");
+
+  std::vector<Result> results = Run("Data", {{"Default\\GPUCache", "Fast/GPUCache"}});
+  EXPECT_EQ(results[0].status, Status::kFailed);
+  EXPECT_TRUE(IsPlainDirectory("Data/Default/GPUCache"));
+  EXPECT_EQ(Read("Data/Default/GPUCache/data_0"), "gpu");
+  EXPECT_EQ(Read("Data/Default/GPUCache/index-dir/index"), "index");
+  EXPECT_EQ(Read("Data/Default/GPUCache/locked"), "open");
+  EXPECT_FALSE(std::filesystem::exists(root_ / "Fast/GPUCache"));
+  EXPECT_TRUE(links_.empty());
+
+  // Retried on the next start
+  std::filesystem::rename(root_ / "Data/Default/GPUCache/locked", root_ / "Data/Default/GPUCache/closed");
+  results = Run("Data", {{"Default\\GPUCache", "Fast/GPUCache"}});
+  EXPECT_EQ(results[0].status, Status::kMoved);
+  EXPECT_EQ(Read("Data/Default/GPUCache/closed"), "open");
+}
+
+TEST_F(StoragePlanTest, LeavesOtherLinksAndFilesAlone) {
+  std::filesystem::create_directories(root_ / "Elsewhere");
+  std::filesystem::create_directories(root_ / "Data/Default");
+  std::filesystem::create_directory_symlink(root_ / "Elsewhere", root_ / "Data/Default/GPUCache");
+  Write("Data/ShaderCache", "a file");
+
+  std::vector<Result> results =
+      Run("Data", {{"Default\\GPUCache", "Fast/GPUCache"}, {"ShaderCache", "Fast/ShaderCache"}});
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(results[0].status, Status::kSkipped);
+  EXPECT_EQ(results[1].status, Status::kSkipped);
+  EXPECT_TRUE(IsLinkTo("Data/Default/GPUCache", "Elsewhere"));
+  EXPECT_EQ(Read("Data/ShaderCache"), "a file");
+}
+
+TEST(StoragePlanValidateTest, RejectsBadMappings) {
+  std::vector<Mapping> mappings = {
+      {L"Default\\GPUCache\\", L"D:\\Cache\\GPU\\"},
+      {L"..\\Outside", L"D:\\Outside"},
+      {L"\\Rooted", L"D:\\Rooted"},
+      {L"Default\\GPUCache\\Sub", L"D:\\Sub"},
+      {L"Default/Code Cache", L"C:\\Data\\Cache"},
+      {L"ShaderCache", L"D:\\Cache"},
+      {L"GrShaderCache", L""},
+  };
+  std::vector<Rejected> rejected;
+  std::vector<Mapping> valid = Validate(L"C:\\Data", mappings, &rejected);
+  ASSERT_EQ(valid.size(), 1u);
+  EXPECT_EQ(valid[0].relative, L"Default\\GPUCache");
+  EXPECT_EQ(valid[0].target, L"D:\\Cache\\GPU");
+  EXPECT_EQ(rejected.size(), 6u);
+}
+
+TEST(StoragePlanValidateTest, LinksRoundTrip) {
+  std::vector<Link> links = {{L"C:\\Data\\GrShaderCache", L"D:\\Fast\\GrShaderCache"}, {L"C:\\Data\\x", L"E:\\y"}};
+  std::vector<uint8_t> bytes = EncodeLinks(links);
+
+  std::vector<Link> decoded;
+  ASSERT_TRUE(DecodeLinks(bytes.data(), bytes.size(), &decoded));
+  ASSERT_EQ(decoded.size(), 2u);
+  EXPECT_EQ(decoded[0].target, L"D:\\Fast\\GrShaderCache");
+  EXPECT_EQ(decoded[1].path, L"C:\\Data\\x");
+  for (size_t size = 0; size < bytes.size(); size++) {
+    EXPECT_FALSE(DecodeLinks(bytes.data(), size, &decoded)) << size;
+  }
+}
+
+}  // namespace
+}  // namespace storage_layout
@@ -0,0 +1,154 @@
+// Startup timeline recorder: spans, text transport and trace JSON
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "timeline.h"
+
+namespace timeline {
+namespace {
+
+TEST(TimelineTest, BeginEndAndAdd) {
+  Recorder recorder;
+  size_t open = recorder.Begin("relaunch", 10, 11, 100);
+  recorder.Add("config", 10, 12, 150, 180);
+  recorder.End(open, 400);
+
+  std::vector<Span> spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_STREQ(spans[0].name, "relaunch");
+  EXPECT_EQ(spans[0].pid, 10u);
+  EXPECT_EQ(spans[0].tid, 11u);
+  EXPECT_EQ(spans[0].begin_us, 100);
+  EXPECT_EQ(spans[0].end_us, 400);
+  EXPECT_STREQ(spans[1].name, "config");
+  EXPECT_EQ(spans[1].end_us, 180);
+}
+
+TEST(TimelineTest, FullBufferDropsSpans) {
+  Recorder recorder;
+  for (size_t i = 0; i < Recorder::kCapacity; ++i) {
+    ASSERT_NE(recorder.Add("span", 1, 1, i, i + 1), Recorder::kInvalid);
+  }
+  EXPECT_EQ(recorder.Begin("overflow", 1, 1, 0), Recorder::kInvalid);
+  recorder.End(Recorder::kInvalid, 5);  // Ignored
+  EXPECT_EQ(recorder.Spans().size(), Recorder::kCapacity);
+}
+
+TEST(TimelineTest, CloseOpenOnlyTouchesOpenSpans) {
+  Recorder recorder;
+  recorder.Begin("open", 1, 1, 10);
+  recorder.Add("closed", 1, 1, 20, 30);
+  recorder.CloseOpen(99);
+
+  std::vector<Span> spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_EQ(spans[0].end_us, 99);
+  EXPECT_EQ(spans[1].end_us, 30);
+}
+
+TEST(TimelineTest, NamesAreTruncatedAndKeptOnOneLine) {
+  Recorder recorder;
+  recorder.Add(std::string(100, 'x'), 1, 1, 0, 1);
+  recorder.Add("two\nlines\r", 1, 1, 0, 1);
+
+  std::vector<Span> spans = recorder.Spans();
+  EXPECT_EQ(std::string(spans[0].name), std::string(sizeof(spans[0].name) - 1, 'x'));
+  EXPECT_STREQ(spans[1].name, "two lines ");
+}
+
+TEST(TimelineTest, ProcessNamesAreCapped) {
+  Recorder recorder;
+  for (uint32_t pid = 1; pid <= Recorder::kMaxProcesses + 2; ++pid) {
+    recorder.SetProcessName(pid, "process");
+  }
+  EXPECT_EQ(recorder.Processes().size(), Recorder::kMaxProcesses);
+}
+
+TEST(TimelineTest, SerializeRoundTrip) {
+  Recorder stub;
+  stub.SetProcessName(7, "launcher stub");
+  stub.Add("copy profile", 7, 8, 1000, 2500);
+  stub.Begin("wait for browser", 7, 8, 2500);
+
+  Recorder browser;
+  EXPECT_EQ(browser.Deserialize(stub.Serialize()), 2u);
+  EXPECT_EQ(browser.Serialize(), stub.Serialize());
+
+  std::vector<ProcessName> processes = browser.Processes();
+  ASSERT_EQ(processes.size(), 1u);
+  EXPECT_STREQ(processes[0].name, "launcher stub");
+  std::vector<Span> spans = browser.Spans();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_STREQ(spans[1].name, "wait for browser");
+  EXPECT_EQ(spans[1].end_us, 0);
+}
+
+TEST(TimelineTest, DeserializeSkipsMalformedLines) {
+  Recorder recorder;
+  size_t imported = recorder.Deserialize(
+      "garbage\n"
+      "S 1 2 three 4 name\n"
+      "S 1 2 3\n"
+      "P\n"
+      "S 1 2 -5 10 negative start\n"
+      "S 3 4 5 6 last line without newline");
+  EXPECT_EQ(imported, 2u);
+  EXPECT_TRUE(recorder.Processes().empty());
+
+  std::vector<Span> spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_EQ(spans[0].begin_us, -5);
+  EXPECT_STREQ(spans[1].name, "last line without newline");
+}
+
+TEST(TimelineTest, TraceJson) {
+  Recorder recorder;
+  recorder.SetProcessName(5, "brow\"ser");
+  recorder.Add("load \\ ext", 5, 6, 100, 350);
+  recorder.Begin("first\twindow", 5, 6, 400);
+
+  EXPECT_EQ(recorder.ToTraceJson(),
+            "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":5,\"args\":{\"name\":\"brow\\\"ser\"}},\n"
+            "{\"ph\":\"X\",\"cat\":\"startup\",\"pid\":5,\"tid\":6,\"ts\":100,\"dur\":250,"
+            "\"name\":\"load \\\\ ext\"},\n"
+            "{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"startup\",\"pid\":5,\"tid\":6,\"ts\":400,"
+            "\"name\":\"first\\u0009window\"}\n"
+            "]}\n");
+}
+
+TEST(TimelineTest, EmptyTraceJson) {
+  Recorder recorder;
+  EXPECT_EQ(recorder.ToTraceJson(), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n");
+}
+
+TEST(TimelineTest, ConcurrentWritersFillEverySlotOnce) {
+  Recorder recorder;
+  constexpr int kThreads = 8;
+  constexpr int kPerThread = 64;  // 512 attempts for 256 slots
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&recorder, t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        recorder.Add("worker", 1, t, i, i + 1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<Span> spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), Recorder::kCapacity);
+  for (const auto& span : spans) {
+    EXPECT_STREQ(span.name, "worker");
+    EXPECT_EQ(span.end_us, span.begin_us + 1);
+  }
+}
+
+}  // namespace
+}  // namespace timeline
@@ -0,0 +1,128 @@
+//
+// hookstats: dump the hook counters published by running browser instances.
+//
+// Usage: hookstats [pid]
+// Without a pid every process that has published counters is listed.
+// Latencies are upper bounds of the log2 histogram buckets, detour plus
+// original API call.
+//
+
+#include <windows.h>
+#include <tlhelp32.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/hook_stats.h"
+
+using namespace hook_stats;
+
+// Upper bound (ns) of the bucket holding the given quantile
+static uint64_t Quantile(const Counters &counters, uint64_t calls, double quantile)
+{
+    uint64_t rank = static_cast<uint64_t>(calls * quantile);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++)
+    {
+        seen += counters.buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+            return i == 0 ? 0 : 1ull << i;
+    }
+    return 1ull << (kBuckets - 1);
+}
+
+static void PrintLatency(uint64_t ns)
+{
+    if (ns < 1000)
+        printf(" %8llu ns", ns);
+    else if (ns < 1000000)
+        printf(" %8llu us", ns / 1000);
+    else
+        printf(" %8llu ms", ns / 1000000);
+}
+
+static bool Dump(DWORD pid, const wchar_t *exe)
+{
+    wchar_t name[64];
+    SectionName(name, ARRAYSIZE(name), pid);
+
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+    if (!mapping)
+        return false;
+
+    // The writer may be a different build: map the whole section and trust
+    // its count only as far as the mapping reaches
+    auto *section = static_cast<const Section *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION info = {};
+    if (!section || !VirtualQuery(section, &info, sizeof(info)))
+    {
+        if (section)
+            UnmapViewOfFile(section);
+        CloseHandle(mapping);
+        return false;
+    }
+
+    printf("%ls (pid %lu)\n", exe ? exe : L"?", pid);
+    if (info.RegionSize < SectionSize(0) || section->magic != kMagic || section->version != kVersion ||
+        info.RegionSize < SectionSize(section->count))
+    {
+        printf("  unsupported layout (version %u, reader expects %u)\n\n", section->version, kVersion);
+    }
+    else
+    {
+        printf("  %-26s %10s %11s %11s %11s\n", "hook", "calls", "avg", "p50", "p99");
+        for (uint32_t i = 0; i < section->count; i++)
+        {
+            const Counters &counters = section->hooks[i];
+            uint64_t calls = counters.calls.load(std::memory_order_relaxed);
+            if (calls == 0)
+                continue;
+
+            // Hooks added by a newer writer have no name here
+            char unknown[16];
+            snprintf(unknown, sizeof(unknown), "#%u", i);
+            printf("  %-26s %10llu", i < kCount ? kNames[i] : unknown, calls);
+            PrintLatency(counters.total_ns.load(std::memory_order_relaxed) / calls);
+            PrintLatency(Quantile(counters, calls, 0.50));
+            PrintLatency(Quantile(counters, calls, 0.99));
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    UnmapViewOfFile(section);
+    CloseHandle(mapping);
+    return true;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+    if (argc > 1)
+    {
+        DWORD pid = wcstoul(argv[1], nullptr, 10);
+        if (!Dump(pid, nullptr))
+        {
+            fprintf(stderr, "No hook counters published by pid %lu\n", pid);
+            return 1;
+        }
+        return 0;
+    }
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return 1;
+
+    int found = 0;
+    PROCESSENTRY32W entry = {sizeof(entry)};
+    for (BOOL ok = Process32FirstW(snapshot, &entry); ok; ok = Process32NextW(snapshot, &entry))
+    {
+        found += Dump(entry.th32ProcessID, entry.szExeFile);
+    }
+    CloseHandle(snapshot);
+
+    if (!found)
+    {
+        fprintf(stderr, "No running browser publishes hook counters\n");
+        return 1;
+    }
+    return 0;
+}
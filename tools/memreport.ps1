@@ -0,0 +1,116 @@
+<#
+.SYNOPSIS
+    Private bytes and mapped Vivaldi Plus image size per browser process type.
+
+.DESCRIPTION
+    Groups every running vivaldi.exe by its --type= switch (empty = browser)
+    and reports the process count, average and total private bytes, and the
+    image size of version.dll and vivaldi_plus_ext.dll mapped into each type.
+    Run it from an elevated prompt, otherwise sandboxed processes hide their
+    module list.
+
+    To compare two builds, start the browser with each one, open the same
+    set of pages, wait for startup to settle and save a report:
+        .\memreport.ps1 -Out before.csv
+        .\memreport.ps1 -Out after.csv
+        .\memreport.ps1 -Compare before.csv, after.csv
+
+.PARAMETER Name
+    Process name without .exe, default vivaldi.
+#>
+param(
+    [string]$Name = "vivaldi",
+    [string]$Out,
+    [string[]]$Compare
+)
+
+$ErrorActionPreference = "Stop"
+
+function Get-ProcessType([string]$CommandLine) {
+    if ($CommandLine -match '--type=([^\s"]+)') { return $Matches[1] }
+    return "browser"
+}
+
+function Get-ImageSize($Process, [string]$Module) {
+    try {
+        $image = $Process.Modules | Where-Object { $_.ModuleName -ieq $Module } | Select-Object -First 1
+        if ($image) { return [int64]$image.ModuleMemorySize }
+        return [int64]0
+    } catch {
+        return $null  # Access denied
+    }
+}
+
+function Get-Report {
+    $command_lines = @{}
+    Get-CimInstance Win32_Process -Filter "Name = '$Name.exe'" | ForEach-Object {
+        $command_lines[[int]$_.ProcessId] = $_.CommandLine
+    }
+
+    Get-Process -Name $Name -ErrorAction SilentlyContinue | ForEach-Object {
+        [pscustomobject]@{
+            Type         = Get-ProcessType $command_lines[$_.Id]
+            Pid          = $_.Id
+            PrivateBytes = [int64]$_.PrivateMemorySize64
+            CoreImage    = Get-ImageSize $_ "version.dll"
+            ExtImage     = Get-ImageSize $_ "vivaldi_plus_ext.dll"
+        }
+    }
+}
+
+function Get-Summary($Rows) {
+    $Rows | Group-Object Type | Sort-Object Name | ForEach-Object {
+        $bytes = ($_.Group | Measure-Object PrivateBytes -Average -Sum)
+        $core = ($_.Group | Where-Object { $null -ne $_.CoreImage } | Measure-Object CoreImage -Maximum)
+        $ext = ($_.Group | Where-Object { $null -ne $_.ExtImage } | Measure-Object ExtImage -Maximum)
+        [pscustomobject]@{
+            Type           = $_.Name
+            Count          = $_.Count
+            AvgPrivateKB   = [int64]($bytes.Average / 1KB)
+            TotalPrivateKB = [int64]($bytes.Sum / 1KB)
+            CoreImageKB    = if ($core.Count) { [int64]($core.Maximum / 1KB) } else { "n/a" }
+            ExtImageKB     = if ($ext.Count) { [int64]($ext.Maximum / 1KB) } else { "n/a" }
+        }
+    }
+}
+
+# CSV fields come back as strings, empty where the module list was denied
+function Import-Report([string]$Path) {
+    Import-Csv $Path | ForEach-Object {
+        [pscustomobject]@{
+            Type         = $_.Type
+            Pid          = [int]$_.Pid
+            PrivateBytes = [int64]$_.PrivateBytes
+            CoreImage    = if ($_.CoreImage -ne "") { [int64]$_.CoreImage } else { $null }
+            ExtImage     = if ($_.ExtImage -ne "") { [int64]$_.ExtImage } else { $null }
+        }
+    }
+}
+
+if ($Compare) {
+    if ($Compare.Count -ne 2) { throw "-Compare takes two reports: before.csv, after.csv" }
+    $before = Get-Summary (Import-Report $Compare[0])
+    $after = Get-Summary (Import-Report $Compare[1])
+    $types = @($before.Type) + @($after.Type) | Sort-Object -Unique
+    $types | ForEach-Object {
+        $type = $_
+        $b = $before | Where-Object Type -eq $type
+        $a = $after | Where-Object Type -eq $type
+        [pscustomobject]@{
+            Type         = $type
+            Count        = "$($b.Count) -> $($a.Count)"
+            AvgPrivateKB = "$($b.AvgPrivateKB) -> $($a.AvgPrivateKB)"
+            CoreImageKB  = "$($b.CoreImageKB) -> $($a.CoreImageKB)"
+            ExtImageKB   = "$($b.ExtImageKB) -> $($a.ExtImageKB)"
+        }
+    } | Format-Table -AutoSize
+    return
+}
+
+$rows = @(Get-Report)
+if ($rows.Count -eq 0) { throw "No $Name.exe process is running" }
+if ($Out) {
+    $rows | Export-Csv -NoTypeInformation -Path $Out
+    Write-Host "Wrote $($rows.Count) processes to $Out"
+}
+Get-Summary $rows | Format-Table -AutoSize
@@ -0,0 +1,530 @@
+//
+// proxygen - generate lazy export forwarding stubs for a hijacked system DLL
+//
+// Reads the export table of a PE file (any architecture, the host OS does not
+// matter) and writes into <output dir>:
+//   <name>.def          export table, same names and ordinals as the original DLL
+//   <name>_x86.asm      MASM stubs for x86
+//   <name>_x64.asm      MASM stubs for x64
+//   <name>_proxy.h      export name table and resolver glue for src/proxy.h
+//   <name>_forward.h    linker forwarders to the system DLL, used on ARM64
+//
+// Every stub jumps through a writable slot (rax/eax are free at function
+// entry on both ABIs). Slots start out pointing at a resolver thunk, so the
+// real system DLL is only loaded on the first call, after which the slot
+// holds the real function and calls jump there directly.
+//
+// ARM64 has no lazy stubs: the build cannot assemble and test them outside
+// Windows, so ARM64 exports forward to the system DLL at load time instead.
+//
+// Build and run (Linux or Windows):
+//   c++ -std=c++17 -O2 -o proxygen tools/proxygen/proxygen.cpp
+//   ./proxygen C:/Windows/System32/version.dll src/proxy
+//
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Far more than any system DLL worth proxying, keeps the tables small
+constexpr size_t kMaxExports = 4096;
+
+struct Export
+{
+    uint32_t ordinal;
+    std::string name;  // Empty for ordinal-only exports
+};
+
+class PeFile
+{
+public:
+    explicit PeFile(std::vector<uint8_t> data) : data_(std::move(data))
+    {
+    }
+
+    // Parse headers and export directory
+    // Returns false and sets error() on malformed input
+    bool ReadExports(std::vector<Export> *exports)
+    {
+        uint32_t nt_offset = 0;
+        if (!Read32(0x3C, &nt_offset) || Read16(0) != 0x5A4D)
+            return Fail("not a PE file (missing MZ header)");
+        if (Read32(nt_offset) != 0x00004550)
+            return Fail("not a PE file (missing PE signature)");
+
+        uint32_t file_header = nt_offset + 4;
+        uint16_t section_count = Read16(file_header + 2);
+        uint16_t optional_size = Read16(file_header + 16);
+        uint32_t optional_header = file_header + 20;
+
+        // Data directories start at a different offset for PE32 and PE32+
+        uint32_t directories = 0;
+        switch (Read16(optional_header))
+        {
+        case 0x10B:
+            directories = optional_header + 96;
+            break;
+        case 0x20B:
+            directories = optional_header + 112;
+            break;
+        default:
+            return Fail("unknown optional header magic");
+        }
+
+        uint32_t sections = optional_header + optional_size;
+        for (uint16_t i = 0; i < section_count; i++)
+        {
+            uint32_t header = sections + i * 40;
+            Section section;
+            section.virtual_address = Read32(header + 12);
+            section.virtual_size = Read32(header + 8);
+            section.raw_size = Read32(header + 16);
+            section.raw_offset = Read32(header + 20);
+            sections_.push_back(section);
+        }
+
+        uint32_t export_rva = Read32(directories);
+        if (export_rva == 0)
+            return Fail("no export directory");
+
+        uint32_t export_dir = RvaToOffset(export_rva);
+        if (export_dir == 0)
+            return Fail("export directory outside of any section");
+
+        uint32_t base = Read32(export_dir + 16);
+        uint32_t function_count = Read32(export_dir + 20);
+        uint32_t name_count = Read32(export_dir + 24);
+        uint32_t functions = RvaToOffset(Read32(export_dir + 28));
+        uint32_t names = RvaToOffset(Read32(export_dir + 32));
+        uint32_t name_ordinals = RvaToOffset(Read32(export_dir + 36));
+        if (function_count > kMaxExports)
+            return Fail("too many exports");
+
+        std::vector<std::string> function_names(function_count);
+        for (uint32_t i = 0; i < name_count; i++)
+        {
+            uint16_t index = Read16(name_ordinals + i * 2);
+            uint32_t name = RvaToOffset(Read32(names + i * 4));
+            if (index < function_count && name != 0)
+            {
+                function_names[index] = ReadString(name);
+            }
+        }
+
+        for (uint32_t i = 0; i < function_count; i++)
+        {
+            // Unused ordinal slots have a zero RVA
+            if (Read32(functions + i * 4) == 0)
+                continue;
+            exports->push_back({base + i, function_names[i]});
+        }
+        return ok_;
+    }
+
+    const std::string &error() const
+    {
+        return error_;
+    }
+
+private:
+    struct Section
+    {
+        uint32_t virtual_address;
+        uint32_t virtual_size;
+        uint32_t raw_offset;
+        uint32_t raw_size;
+    };
+
+    bool Fail(const char *message)
+    {
+        if (ok_)
+            error_ = message;
+        ok_ = false;
+        return false;
+    }
+
+    bool Read32(uint32_t offset, uint32_t *value)
+    {
+        if (offset > data_.size() || data_.size() - offset < 4)
+            return Fail("truncated file");
+        *value = data_[offset] | data_[offset + 1] << 8 | data_[offset + 2] << 16 |
+                 static_cast<uint32_t>(data_[offset + 3]) << 24;
+        return true;
+    }
+
+    uint32_t Read32(uint32_t offset)
+    {
+        uint32_t value = 0;
+        Read32(offset, &value);
+        return value;
+    }
+
+    uint16_t Read16(uint32_t offset)
+    {
+        if (offset > data_.size() || data_.size() - offset < 2)
+        {
+            Fail("truncated file");
+            return 0;
+        }
+        return static_cast<uint16_t>(data_[offset] | data_[offset + 1] << 8);
+    }
+
+    std::string ReadString(uint32_t offset)
+    {
+        std::string value;
+        while (offset < data_.size() && data_[offset])
+        {
+            value.push_back(static_cast<char>(data_[offset++]));
+        }
+        return value;
+    }
+
+    // Map an RVA to a file offset, 0 if it is not backed by file data
+    uint32_t RvaToOffset(uint32_t rva)
+    {
+        for (const auto &section : sections_)
+        {
+            uint32_t size = std::max(section.virtual_size, section.raw_size);
+            if (rva >= section.virtual_address && rva - section.virtual_address < size)
+            {
+                uint32_t delta = rva - section.virtual_address;
+                return delta < section.raw_size ? section.raw_offset + delta : 0;
+            }
+        }
+        return 0;
+    }
+
+    std::vector<uint8_t> data_;
+    std::vector<Section> sections_;
+    std::string error_;
+    bool ok_ = true;
+};
+
+// "C:/Windows/System32/Version.dll" -> "version"
+std::string ModuleStem(const std::string &path)
+{
+    size_t slash = path.find_last_of("\\/");
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = file.find_last_of('.');
+    if (dot != std::string::npos)
+        file.resize(dot);
+
+    std::string stem;
+    for (char ch : file)
+    {
+        stem.push_back(std::isalnum(static_cast<unsigned char>(ch)) ? static_cast<char>(std::tolower(ch)) : '_');
+    }
+    return stem;
+}
+
+std::string FileName(const std::string &path)
+{
+    size_t slash = path.find_last_of("\\/");
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::transform(file.begin(), file.end(), file.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return file;
+}
+
+std::string Header(const char *comment, const std::string &dll)
+{
+    std::ostringstream out;
+    out << comment << " Generated by tools/proxygen from " << dll << ", do not edit\n";
+    return out.str();
+}
+
+std::string GenerateDef(const std::string &stem, const std::string &dll, const std::vector<Export> &exports)
+{
+    std::ostringstream out;
+    out << Header(";", dll);
+    out << "EXPORTS\n";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        const auto &entry = exports[i];
+        if (entry.name.empty())
+        {
+            out << "    " << stem << "_proxy_" << i << " @" << entry.ordinal << " NONAME\n";
+        }
+        else
+        {
+            out << "    " << entry.name << "=" << stem << "_proxy_" << i << " @" << entry.ordinal << "\n";
+        }
+    }
+    return out.str();
+}
+
+std::string GenerateX64(const std::string &stem, const std::string &dll, const std::vector<Export> &exports)
+{
+    const std::string p = stem + "_proxy";
+    std::ostringstream out;
+    out << Header(";", dll);
+    out << "\n"
+        << "EXTERN " << p << "_resolve:PROC\n"
+        << "PUBLIC " << p << "_slots\n"
+        << "\n"
+        << ".DATA\n"
+        << "ALIGN 8\n"
+        << p << "_slots";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        out << "    DQ " << p << "_thunk_" << i << "\n";
+    }
+
+    out << "\n.CODE\n";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        out << "\n"
+            << p << "_" << i << " PROC  ; " << (exports[i].name.empty() ? "#" + std::to_string(exports[i].ordinal) : exports[i].name) << "\n"
+            << "    mov rax, QWORD PTR [" << p << "_slots + " << i * 8 << "]\n"
+            << "    jmp rax\n"
+            << p << "_" << i << " ENDP\n"
+            << "\n"
+            << p << "_thunk_" << i << " PROC\n"
+            << "    mov eax, " << i << "\n"
+            << "    jmp " << p << "_resolve_common\n"
+            << p << "_thunk_" << i << " ENDP\n";
+    }
+
+    // Preserve all argument registers around the resolver call
+    out << "\n"
+        << p << "_resolve_common PROC FRAME\n"
+        << "    push rcx\n"
+        << "    .pushreg rcx\n"
+        << "    push rdx\n"
+        << "    .pushreg rdx\n"
+        << "    push r8\n"
+        << "    .pushreg r8\n"
+        << "    push r9\n"
+        << "    .pushreg r9\n"
+        << "    sub rsp, 68h\n"
+        << "    .allocstack 68h\n"
+        << "    .endprolog\n"
+        << "    movups XMMWORD PTR [rsp + 20h], xmm0\n"
+        << "    movups XMMWORD PTR [rsp + 30h], xmm1\n"
+        << "    movups XMMWORD PTR [rsp + 40h], xmm2\n"
+        << "    movups XMMWORD PTR [rsp + 50h], xmm3\n"
+        << "    mov ecx, eax\n"
+        << "    call " << p << "_resolve\n"
+        << "    movups xmm0, XMMWORD PTR [rsp + 20h]\n"
+        << "    movups xmm1, XMMWORD PTR [rsp + 30h]\n"
+        << "    movups xmm2, XMMWORD PTR [rsp + 40h]\n"
+        << "    movups xmm3, XMMWORD PTR [rsp + 50h]\n"
+        << "    add rsp, 68h\n"
+        << "    pop r9\n"
+        << "    pop r8\n"
+        << "    pop rdx\n"
+        << "    pop rcx\n"
+        << "    jmp rax\n"
+        << p << "_resolve_common ENDP\n"
+        << "\nEND\n";
+    return out.str();
+}
+
+std::string GenerateX86(const std::string &stem, const std::string &dll, const std::vector<Export> &exports)
+{
+    // cdecl symbols carry a leading underscore on x86
+    const std::string p = "_" + stem + "_proxy";
+    std::ostringstream out;
+    out << Header(";", dll);
+    out << "\n"
+        << ".686P\n"
+        << ".MODEL FLAT\n"
+        << "\n"
+        << "EXTERN " << p << "_resolve:PROC\n"
+        << "PUBLIC " << p << "_slots\n"
+        << "\n"
+        << ".DATA\n"
+        << "ALIGN 4\n"
+        << p << "_slots";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        out << "    DD " << p << "_thunk_" << i << "\n";
+    }
+
+    out << "\n.CODE\n";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        out << "\n"
+            << p << "_" << i << " PROC  ; " << (exports[i].name.empty() ? "#" + std::to_string(exports[i].ordinal) : exports[i].name) << "\n"
+            << "    mov eax, DWORD PTR [" << p << "_slots + " << i * 4 << "]\n"
+            << "    jmp eax\n"
+            << p << "_" << i << " ENDP\n"
+            << "\n"
+            << p << "_thunk_" << i << " PROC\n"
+            << "    mov eax, " << i << "\n"
+            << "    jmp " << p << "_resolve_common\n"
+            << p << "_thunk_" << i << " ENDP\n";
+    }
+
+    // Arguments stay on the stack, only fastcall/thiscall registers need saving
+    out << "\n"
+        << p << "_resolve_common PROC\n"
+        << "    push ecx\n"
+        << "    push edx\n"
+        << "    push eax\n"
+        << "    call " << p << "_resolve\n"
+        << "    add esp, 4\n"
+        << "    pop edx\n"
+        << "    pop ecx\n"
+        << "    jmp eax\n"
+        << p << "_resolve_common ENDP\n"
+        << "\nEND\n";
+    return out.str();
+}
+
+std::string GenerateForward(const std::string &stem, const std::string &dll, const std::vector<Export> &exports)
+{
+    std::string guard = "VIVALDI_PLUS_PROXY_" + stem + "_FORWARD_H_";
+    std::transform(guard.begin(), guard.end(), guard.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+
+    // The system copy by absolute path, never our own DLL from the app directory
+    // (escaped once more for the C string literal of the pragma)
+    const std::string target = R"(\\\\.\\GLOBALROOT\\SystemRoot\\System32\\)" + stem + ".";
+
+    std::ostringstream out;
+    out << Header("//", dll);
+    out << "// Must only be included in ONE translation unit (vivaldi++.cpp)\n"
+        << "// Exports are forwarded to the system DLL when the loader binds them\n"
+        << "\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n"
+        << "\n";
+    for (size_t i = 0; i < exports.size(); i++)
+    {
+        const auto &entry = exports[i];
+        if (entry.name.empty())
+        {
+            out << "#pragma comment(linker, \"/export:" << stem << "_proxy_" << i << "=" << target << "#"
+                << entry.ordinal << ",@" << entry.ordinal << ",NONAME\")\n";
+        }
+        else
+        {
+            out << "#pragma comment(linker, \"/export:" << entry.name << "=" << target << entry.name << ",@"
+                << entry.ordinal << "\")\n";
+        }
+    }
+    out << "\n"
+        << "#endif  // " << guard << "\n";
+    return out.str();
+}
+
+std::string GenerateHeader(const std::string &stem, const std::string &dll, const std::vector<Export> &exports)
+{
+    std::string guard = "VIVALDI_PLUS_PROXY_" + stem + "_PROXY_H_";
+    std::transform(guard.begin(), guard.end(), guard.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+    const std::string p = stem + "_proxy";
+
+    std::ostringstream out;
+    out << Header("//", dll);
+    out << "// Must only be included in ONE translation unit (vivaldi++.cpp)\n"
+        << "\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n"
+        << "\n"
+        << "#include \"../proxy.h\"\n"
+        << "\n"
+        << "// Jump slots defined by " << stem << "_x86.asm / " << stem << "_x64.asm\n"
+        << "extern \"C\" void *" << p << "_slots[];\n"
+        << "\n"
+        << "namespace proxy\n"
+        << "{\n"
+        << "\n"
+        << "static const ExportEntry k_" << stem << "_exports[] = {\n";
+    for (const auto &entry : exports)
+    {
+        if (entry.name.empty())
+            out << "    {nullptr, " << entry.ordinal << "},\n";
+        else
+            out << "    {\"" << entry.name << "\", " << entry.ordinal << "},\n";
+    }
+    out << "};\n"
+        << "\n"
+        << "static Module g_" << stem << "_module = {L\"" << dll << "\", k_" << stem << "_exports, " << exports.size()
+        << ", " << p << "_slots, nullptr};\n"
+        << "\n"
+        << "}  // namespace proxy\n"
+        << "\n"
+        << "// Called by the stubs on the first call of each export\n"
+        << "extern \"C\" void *" << p << "_resolve(unsigned int index)\n"
+        << "{\n"
+        << "    return proxy::Resolve(proxy::g_" << stem << "_module, index);\n"
+        << "}\n"
+        << "\n"
+        << "#endif  // " << guard << "\n";
+    return out.str();
+}
+
+bool WriteFile(const std::string &path, const std::string &content)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+    if (!file)
+    {
+        fprintf(stderr, "proxygen: cannot write %s\n", path.c_str());
+        return false;
+    }
+    printf("wrote %s\n", path.c_str());
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: proxygen <system dll> <output dir>\n");
+        return 2;
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "proxygen: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    PeFile pe(std::move(data));
+    std::vector<Export> exports;
+    if (!pe.ReadExports(&exports))
+    {
+        fprintf(stderr, "proxygen: %s: %s\n", argv[1], pe.error().c_str());
+        return 1;
+    }
+    if (exports.empty())
+    {
+        fprintf(stderr, "proxygen: %s exports nothing\n", argv[1]);
+        return 1;
+    }
+    std::sort(exports.begin(), exports.end(),
+              [](const Export &a, const Export &b) { return a.ordinal < b.ordinal; });
+
+    const std::string stem = ModuleStem(argv[1]);
+    const std::string dll = FileName(argv[1]);
+    const std::string dir = argv[2];
+
+    bool ok = WriteFile(dir + "/" + stem + ".def", GenerateDef(stem, dll, exports)) &&
+              WriteFile(dir + "/" + stem + "_x86.asm", GenerateX86(stem, dll, exports)) &&
+              WriteFile(dir + "/" + stem + "_x64.asm", GenerateX64(stem, dll, exports)) &&
+              WriteFile(dir + "/" + stem + "_proxy.h", GenerateHeader(stem, dll, exports)) &&
+              WriteFile(dir + "/" + stem + "_forward.h", GenerateForward(stem, dll, exports));
+    if (!ok)
+        return 1;
+
+    printf("%zu exports from %s\n", exports.size(), dll.c_str());
+    return 0;
+}
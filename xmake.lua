@@ -23,6 +23,15 @@ end
 
 add_cxflags("/utf-8")
 
+-- Per-hook call counters and latency histograms in shared memory,
+-- read with the hookstats tool; xmake f --hook_stats=n compiles them out
+option("hook_stats")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Publish hook call counters and latency histograms")
+    add_defines("VIVALDI_PLUS_HOOK_STATS")
+option_end()
+
 add_links("gdiplus", "kernel32", "user32", "gdi32", "winspool", "comdlg32")
 add_links("advapi32", "shell32", "ole32", "oleaut32", "uuid", "odbc32", "odbccp32")
 
@@ -46,15 +55,25 @@ target("detours")
         add_files("detours/src/disolarm64.cpp")
     end
 
+-- Core version.dll: mapped into every browser process, so it only holds
+-- export forwarding and the child process fast path
 target("vivaldi_plus")
     set_kind("shared")
     set_languages("c++20")
     set_targetdir("$(builddir)/$(mode)/$(arch)")
     set_basename("version")
-    add_deps("detours")
-    add_files("src/*.cpp")
+    add_files("src/vivaldi++.cpp")
     add_files("src/*.rc")
-    add_links("user32", "crypt32", "propsys", "netapi32")
+    -- version.dll exports, generated by tools/proxygen
+    -- ARM64 forwards them through src/proxy/version_forward.h instead
+    if is_arch("x86") then
+        add_files("src/proxy/version.def")
+        add_files("src/proxy/version_x86.asm")
+        add_asflags("/safeseh")
+    elseif is_arch("x64") then
+        add_files("src/proxy/version.def")
+        add_files("src/proxy/version_x64.asm")
+    end
     if is_mode("release") and not is_arch("arm64") then
         add_packages("vc-ltl5")
     end
@@ -63,3 +82,39 @@ target("vivaldi_plus")
         os.rm(builddir .. "/version.exp")
         os.rm(builddir .. "/version.lib")
     end)
+
+-- Extension loaded by the core in the main browser process only:
+-- config, hooks, portable mode and boss key
+target("vivaldi_plus_ext")
+    set_kind("shared")
+    set_languages("c++20")
+    set_targetdir("$(builddir)/$(mode)/$(arch)")
+    set_basename("vivaldi_plus_ext")
+    add_deps("detours")
+    add_options("hook_stats")
+    add_files("src/*.cpp|vivaldi++.cpp")
+    add_links("user32", "crypt32", "propsys", "netapi32")
+    -- Only pulled in when a hooked or called API is actually used,
+    -- hooks into these modules are attached when they get loaded
+    add_links("delayimp")
+    add_ldflags("/DELAYLOAD:netapi32.dll", "/DELAYLOAD:crypt32.dll", "/DELAYLOAD:propsys.dll", "/DELAYLOAD:shlwapi.dll", {force = true})
+    if is_mode("release") and not is_arch("arm64") then
+        add_packages("vc-ltl5")
+    end
+    after_build(function (target)
+        local builddir = "$(builddir)/$(mode)/$(arch)"
+        os.rm(builddir .. "/vivaldi_plus_ext.exp")
+        os.rm(builddir .. "/vivaldi_plus_ext.lib")
+    end)
+
+-- Reader for the hook_stats shared memory section
+if has_config("hook_stats") then
+    target("hookstats")
+        set_kind("binary")
+        set_languages("c++20")
+        set_targetdir("$(builddir)/$(mode)/$(arch)")
+        add_files("tools/hookstats/hookstats.cpp")
+        if is_mode("release") and not is_arch("arm64") then
+            add_packages("vc-ltl5")
+        end
+end